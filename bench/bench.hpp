@@ -0,0 +1,302 @@
+#pragma once
+
+// Minimal benchmark harness for the blockit_* benchmark executables. Include it from exactly one translation unit
+// per executable: it replaces the global operator new and delete to count allocations.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    inline std::atomic<uint64_t> allocation_count{0};
+    inline std::atomic<uint64_t> allocated_bytes{0};
+
+    inline void *allocate(std::size_t size) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+
+} // namespace bench
+
+void *operator new(std::size_t size) { return bench::allocate(size); }
+void *operator new[](std::size_t size) { return bench::allocate(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+
+namespace bench {
+
+    struct Result {
+        std::string name; // Benchmark name and argument, e.g. "merkle/build/1024"
+        uint64_t iterations = 0;
+        double ns_per_op = 0.0;
+        double bytes_per_op = 0.0;  // Heap bytes allocated
+        double allocs_per_op = 0.0; // Heap allocations
+        std::optional<double> threshold; // Allowed regression in percent; set in baseline files only
+    };
+
+    // Handed to a benchmark body, which sets up its fixture and then calls run() or runBatch() once
+    class State {
+      public:
+        inline State(int64_t arg, double min_time) : arg_(arg), min_time_(min_time) {}
+
+        inline int64_t arg() const { return arg_; }
+
+        // Times `op`, doubling the iteration count until a run lasts at least the minimum time
+        template <typename Op> inline void run(Op &&op) {
+            for (uint64_t iterations = 1;; iterations *= 2) {
+                measure(iterations, [&](uint64_t) { op(); });
+                if (elapsed_ns_ >= min_time_ * 1e9 || iterations >= MAX_ITERATIONS) {
+                    return;
+                }
+            }
+        }
+
+        // Times exactly `iterations` calls of `op(i)`, for operations that consume fixtures prepared up front
+        template <typename Op> inline void runBatch(uint64_t iterations, Op &&op) { measure(iterations, op); }
+
+        // Iterations of an op costing `ns_per_op` that fill the minimum time, for sizing runBatch() fixtures
+        inline uint64_t batchFor(double ns_per_op) const {
+            double wanted = std::ceil(min_time_ * 1e9 / std::max(ns_per_op, 1.0));
+            return std::clamp<uint64_t>(static_cast<uint64_t>(wanted), 1, MAX_ITERATIONS);
+        }
+
+        inline Result result(const std::string &name) const {
+            double n = static_cast<double>(std::max<uint64_t>(iterations_, 1));
+            return Result{name, iterations_, elapsed_ns_ / n, static_cast<double>(bytes_) / n,
+                          static_cast<double>(allocations_) / n, std::nullopt};
+        }
+
+      private:
+        static constexpr uint64_t MAX_ITERATIONS = uint64_t{1} << 30;
+
+        int64_t arg_;
+        double min_time_;
+        uint64_t iterations_ = 0;
+        double elapsed_ns_ = 0.0;
+        uint64_t allocations_ = 0;
+        uint64_t bytes_ = 0;
+
+        template <typename Op> inline void measure(uint64_t iterations, Op &&op) {
+            uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+            uint64_t bytes = allocated_bytes.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                op(i);
+            }
+            auto end = std::chrono::steady_clock::now();
+            iterations_ = iterations;
+            elapsed_ns_ = std::chrono::duration<double, std::nano>(end - start).count();
+            allocations_ = allocation_count.load(std::memory_order_relaxed) - allocations;
+            bytes_ = allocated_bytes.load(std::memory_order_relaxed) - bytes;
+        }
+    };
+
+    struct Benchmark {
+        std::string name;
+        std::vector<int64_t> args; // Run once per argument
+        std::function<void(State &)> body;
+    };
+
+    inline std::vector<Benchmark> &registry() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    inline void add(std::string name, std::vector<int64_t> args, std::function<void(State &)> body) {
+        registry().push_back(Benchmark{std::move(name), std::move(args), std::move(body)});
+    }
+
+    inline void printHeader() {
+        std::printf("%-40s %14s %14s %12s %12s\n", "benchmark", "iterations", "ns/op", "bytes/op", "allocs/op");
+    }
+
+    inline void print(const Result &result) {
+        std::printf("%-40s %14llu %14.1f %12.1f %12.2f\n", result.name.c_str(),
+                    static_cast<unsigned long long>(result.iterations), result.ns_per_op, result.bytes_per_op,
+                    result.allocs_per_op);
+        std::fflush(stdout);
+    }
+
+    // Every registered benchmark whose name contains `filter`, each argument in turn, keeping the fastest of
+    // `repetitions` runs so that scheduler noise does not read as a regression
+    inline std::vector<Result> runAll(const std::string &filter, double min_time, int repetitions = 1) {
+        std::vector<Result> results;
+        printHeader();
+        for (const auto &benchmark : registry()) {
+            for (int64_t arg : benchmark.args) {
+                std::string name = benchmark.name + "/" + std::to_string(arg);
+                if (name.find(filter) == std::string::npos) {
+                    continue;
+                }
+                std::optional<Result> best;
+                for (int r = 0; r < std::max(repetitions, 1); r++) {
+                    State state(arg, min_time);
+                    benchmark.body(state);
+                    Result result = state.result(name);
+                    if (!best || result.ns_per_op < best->ns_per_op) {
+                        best = std::move(result);
+                    }
+                }
+                results.push_back(std::move(*best));
+                print(results.back());
+            }
+        }
+        return results;
+    }
+
+    // Results as JSON: {"benchmarks": [{"name": ..., "iterations": ..., "ns_per_op": ..., ...}, ...]}, with a
+    // "threshold" on the results that have one
+    inline bool writeJson(const std::string &path, const std::vector<Result> &results) {
+        std::ofstream out(path);
+        out << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"bytes_per_op\": %.3f, "
+                          "\"allocs_per_op\": %.3f",
+                          r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.bytes_per_op,
+                          r.allocs_per_op);
+            out << line;
+            if (r.threshold) {
+                std::snprintf(line, sizeof(line), ", \"threshold\": %.1f", *r.threshold);
+                out << line;
+            }
+            out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+    // Reads what writeJson writes, plus an optional per-benchmark "threshold". Only flat objects of string and
+    // number fields are understood; anything else throws.
+    inline std::vector<Result> readJson(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("Cannot read " + path);
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string text = buffer.str();
+
+        size_t pos = text.find("\"benchmarks\"");
+        pos = pos == std::string::npos ? pos : text.find('[', pos);
+        if (pos == std::string::npos) {
+            throw std::runtime_error(path + " has no benchmarks array");
+        }
+        auto skipSpace = [&] {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+                pos++;
+            }
+        };
+        auto expect = [&](char c) {
+            skipSpace();
+            if (pos >= text.size() || text[pos] != c) {
+                throw std::runtime_error(path + ": expected '" + std::string(1, c) + "' at offset " +
+                                         std::to_string(pos));
+            }
+            pos++;
+        };
+        auto readString = [&] {
+            expect('"');
+            size_t end = text.find('"', pos);
+            if (end == std::string::npos) {
+                throw std::runtime_error(path + ": unterminated string");
+            }
+            std::string value = text.substr(pos, end - pos);
+            pos = end + 1;
+            return value;
+        };
+
+        std::vector<Result> results;
+        pos++;
+        skipSpace();
+        while (pos < text.size() && text[pos] != ']') {
+            Result result;
+            expect('{');
+            skipSpace();
+            while (pos < text.size() && text[pos] != '}') {
+                std::string key = readString();
+                expect(':');
+                skipSpace();
+                if (text[pos] == '"') {
+                    std::string value = readString();
+                    if (key == "name") {
+                        result.name = value;
+                    }
+                } else {
+                    size_t used = 0;
+                    double value = std::stod(text.substr(pos, 64), &used);
+                    pos += used;
+                    if (key == "iterations") {
+                        result.iterations = static_cast<uint64_t>(value);
+                    } else if (key == "ns_per_op") {
+                        result.ns_per_op = value;
+                    } else if (key == "bytes_per_op") {
+                        result.bytes_per_op = value;
+                    } else if (key == "allocs_per_op") {
+                        result.allocs_per_op = value;
+                    } else if (key == "threshold") {
+                        result.threshold = value;
+                    }
+                }
+                skipSpace();
+                if (text[pos] == ',') {
+                    pos++;
+                    skipSpace();
+                }
+            }
+            expect('}');
+            skipSpace();
+            if (pos < text.size() && text[pos] == ',') {
+                pos++;
+                skipSpace();
+            }
+            results.push_back(std::move(result));
+        }
+        return results;
+    }
+
+    // Carry the thresholds of the results already in `path` over to the results of the same name, so that
+    // regenerating a baseline keeps the limits set by hand. A missing or unreadable file carries nothing.
+    inline void keepThresholds(const std::string &path, std::vector<Result> &results) {
+        std::vector<Result> previous;
+        try {
+            previous = readJson(path);
+        } catch (const std::exception &) {
+            return;
+        }
+        for (auto &result : results) {
+            for (const auto &old : previous) {
+                if (old.name == result.name && old.threshold) {
+                    result.threshold = old.threshold;
+                }
+            }
+        }
+    }
+
+    // Keeps the compiler from discarding a value whose computation is being timed
+    template <typename V> inline void doNotOptimize(V const &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+} // namespace bench
@@ -0,0 +1,339 @@
+#include "bench.hpp"
+
+#include "blokit/blokit.hpp"
+#include <cstring>
+#include <memory>
+#include <tuple>
+
+// Microbenchmarks for hashing, Merkle trees, serialization, validation and authorization lookups.
+//
+//   blockit_bench [--filter <substring>] [--min-time <seconds>] [--repetitions <n>] [--json <path>]
+//
+// Writing over an existing --json file keeps the "threshold" of every benchmark it already had.
+
+struct BenchData {
+    std::string identifier;
+    double value = 0.0;
+
+    std::string to_string() const { return "BenchData{" + identifier + ":" + std::to_string(value) + "}"; }
+
+    std::string serialize() const {
+        return R"({"identifier": ")" + identifier + R"(", "value": )" + std::to_string(value) + "}";
+    }
+
+    static BenchData deserialize(const std::string &data) {
+        BenchData result;
+        size_t id_start = data.find("\"identifier\": \"") + 15;
+        size_t id_end = data.find("\"", id_start);
+        result.identifier = data.substr(id_start, id_end - id_start);
+        size_t val_start = data.find("\"value\": ") + 9;
+        size_t val_end = data.find("}", val_start);
+        result.value = std::stod(data.substr(val_start, val_end - val_start));
+        return result;
+    }
+
+    std::vector<uint8_t> serializeBinary() const {
+        std::vector<uint8_t> buffer;
+        chain::BinarySerializer::writeString(buffer, identifier);
+        chain::BinarySerializer::writeDouble(buffer, value);
+        return buffer;
+    }
+
+    static BenchData deserializeBinary(const std::vector<uint8_t> &data) {
+        BenchData result;
+        size_t offset = 0;
+        result.identifier = chain::BinarySerializer::readString(data, offset);
+        result.value = chain::BinarySerializer::readDouble(data, offset);
+        return result;
+    }
+};
+
+// BenchData's fields again, encoded through a field list instead of a hand-written serializeBinary()
+struct FieldBenchData {
+    std::string identifier;
+    double value = 0.0;
+
+    std::string to_string() const { return "FieldBenchData{" + identifier + "}"; }
+
+    static constexpr auto fields() { return std::make_tuple(&FieldBenchData::identifier, &FieldBenchData::value); }
+};
+
+// A reading without padding or floating point, opted in to being encoded as its object bytes
+struct PackedBenchData {
+    uint64_t sensor = 0;
+    int64_t micro_volts = 0;
+
+    std::string to_string() const { return "PackedBenchData{" + std::to_string(sensor) + "}"; }
+};
+
+template <> struct chain::object_bytes_encoding<PackedBenchData> : std::true_type {};
+
+namespace {
+    std::shared_ptr<chain::Crypto> benchKey() {
+        static auto key = std::make_shared<chain::Crypto>("bench_key");
+        return key;
+    }
+
+    std::vector<chain::Transaction<BenchData>> makeTransactions(int64_t count, const std::string &prefix) {
+        std::vector<chain::Transaction<BenchData>> transactions;
+        transactions.reserve(static_cast<size_t>(count));
+        for (int64_t i = 0; i < count; i++) {
+            chain::Transaction<BenchData> tx(prefix + std::to_string(i),
+                                             BenchData{"sensor_reading_" + std::to_string(i), i * 0.5}, 100);
+            tx.signTransaction(benchKey());
+            transactions.push_back(std::move(tx));
+        }
+        return transactions;
+    }
+
+    std::vector<std::string> makeLeaves(int64_t count) {
+        std::vector<std::string> leaves;
+        for (int64_t i = 0; i < count; i++) {
+            leaves.push_back("transaction-" + std::to_string(i));
+        }
+        return leaves;
+    }
+
+    void registerBenchmarks() {
+        bench::add("merkle/build", {16, 256, 1024, 10000}, [](bench::State &state) {
+            auto leaves = makeLeaves(state.arg());
+            state.run([&] {
+                chain::MerkleTree tree(leaves);
+                bench::doNotOptimize(tree);
+            });
+        });
+
+        bench::add("merkle/proof", {16, 256, 1024, 10000}, [](bench::State &state) {
+            auto leaves = makeLeaves(state.arg());
+            chain::MerkleTree tree(leaves);
+            size_t index = 0;
+            state.run([&] {
+                index = (index + 7919) % leaves.size();
+                auto proof = tree.getProof(index);
+                bool valid = tree.verifyProof(leaves[index], index, proof);
+                bench::doNotOptimize(valid);
+            });
+        });
+
+        bench::add("block/calculateHash", {1, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "hash-"));
+            state.run([&] {
+                auto hash = block.calculateHash();
+                bench::doNotOptimize(hash);
+            });
+        });
+
+        bench::add("block/buildMerkleTree", {10, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "merkle-"));
+            state.run([&] {
+                block.buildMerkleTree();
+                bench::doNotOptimize(block.merkle_root_);
+            });
+        });
+
+        bench::add("block/isValid", {10, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "valid-"));
+            state.run([&] {
+                bool valid = block.isValid();
+                bench::doNotOptimize(valid);
+            });
+        });
+
+        bench::add("block/serializeBinary", {10, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "ser-"));
+            state.run([&] {
+                auto bytes = block.serializeBinary();
+                bench::doNotOptimize(bytes);
+            });
+        });
+
+        bench::add("block/deserializeBinary", {10, 100}, [](bench::State &state) {
+            auto bytes = chain::Block<BenchData>(makeTransactions(state.arg(), "deser-")).serializeBinary();
+            state.run([&] {
+                auto block = chain::Block<BenchData>::deserializeBinary(bytes);
+                bench::doNotOptimize(block);
+            });
+        });
+
+        bench::add("block/binaryRoundTrip", {10, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "bin-"));
+            state.run([&] {
+                auto copy = chain::Block<BenchData>::deserializeBinary(block.serializeBinary());
+                bench::doNotOptimize(copy);
+            });
+        });
+
+        bench::add("block/jsonRoundTrip", {10, 100}, [](bench::State &state) {
+            chain::Block<BenchData> block(makeTransactions(state.arg(), "json-"));
+            state.run([&] {
+                auto copy = chain::Block<BenchData>::deserialize(block.serialize());
+                bench::doNotOptimize(copy);
+            });
+        });
+
+        // Encoding one transaction payload into a reused buffer, as Block::serializeBinary does
+        bench::add("payload/toString", {1}, [](bench::State &state) {
+            BenchData data{"sensor_reading_42", 21.5};
+            std::vector<uint8_t> buffer;
+            state.run([&] {
+                buffer.clear();
+                chain::BinarySerializer::writeString(buffer, data.to_string());
+                bench::doNotOptimize(buffer);
+            });
+        });
+
+        bench::add("payload/custom", {1}, [](bench::State &state) {
+            BenchData data{"sensor_reading_42", 21.5};
+            std::vector<uint8_t> buffer;
+            state.run([&] {
+                buffer.clear();
+                chain::TypeSerializer<BenchData>::appendBinary(buffer, data);
+                bench::doNotOptimize(buffer);
+            });
+        });
+
+        bench::add("payload/fields", {1}, [](bench::State &state) {
+            FieldBenchData data{"sensor_reading_42", 21.5};
+            std::vector<uint8_t> buffer;
+            state.run([&] {
+                buffer.clear();
+                chain::TypeSerializer<FieldBenchData>::appendBinary(buffer, data);
+                bench::doNotOptimize(buffer);
+            });
+        });
+
+        bench::add("payload/bytes", {1}, [](bench::State &state) {
+            PackedBenchData data{42, 21500000};
+            std::vector<uint8_t> buffer;
+            state.run([&] {
+                buffer.clear();
+                chain::TypeSerializer<PackedBenchData>::appendBinary(buffer, data);
+                bench::doNotOptimize(buffer);
+            });
+        });
+
+        // The same priority filter over the row and the columnar layout of a block body
+        bench::add("scan/rows", {1000, 10000}, [](bench::State &state) {
+            auto transactions = makeTransactions(state.arg(), "rows-");
+            state.run([&] {
+                std::vector<uint8_t> mask(transactions.size());
+                for (size_t i = 0; i < transactions.size(); i++) {
+                    mask[i] = transactions[i].priority_ >= 100 && transactions[i].priority_ <= 150;
+                }
+                bench::doNotOptimize(mask);
+            });
+        });
+
+        bench::add("scan/columns", {1000, 10000}, [](bench::State &state) {
+            chain::BlockColumns<BenchData> columns(makeTransactions(state.arg(), "columns-"));
+            state.run([&] {
+                auto mask = columns.priorityRange(100, 150);
+                bench::doNotOptimize(mask);
+            });
+        });
+
+        // Blocks are built and signed up front; only addBlock itself is timed. A short pilot run sizes the batch so
+        // the timed run lasts about the minimum time.
+        bench::add("chain/addBlock", {1, 10, 100}, [](bench::State &state) {
+            constexpr uint64_t pilot_blocks = 16;
+            chain::Chain<BenchData> pilot("bench-chain", "genesis", BenchData{"genesis", 0.0}, benchKey());
+            std::vector<chain::Block<BenchData>> pending;
+            for (uint64_t b = 0; b < pilot_blocks; b++) {
+                pending.emplace_back(makeTransactions(state.arg(), "pilot-" + std::to_string(b) + "-"));
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (const auto &block : pending) {
+                pilot.addBlock(block);
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            double pilot_ns = std::chrono::duration<double, std::nano>(elapsed).count();
+
+            uint64_t blocks = state.batchFor(pilot_ns / pilot_blocks);
+            chain::Chain<BenchData> blockchain("bench-chain", "genesis", BenchData{"genesis", 0.0}, benchKey());
+            pending.clear();
+            for (uint64_t b = 0; b < blocks; b++) {
+                pending.emplace_back(makeTransactions(state.arg(), "add-" + std::to_string(b) + "-"));
+            }
+            state.runBatch(blocks, [&](uint64_t i) {
+                bool added = blockchain.addBlock(pending[i]);
+                bench::doNotOptimize(added);
+            });
+        });
+
+        bench::add("chain/isValid", {10, 100}, [](bench::State &state) {
+            chain::Chain<BenchData> blockchain("bench-chain", "genesis", BenchData{"genesis", 0.0}, benchKey());
+            for (int64_t b = 0; b < state.arg(); b++) {
+                chain::Block<BenchData> block(makeTransactions(4, "chain-" + std::to_string(b) + "-"));
+                blockchain.addBlock(block);
+            }
+            state.run([&] {
+                bool valid = blockchain.isValid();
+                bench::doNotOptimize(valid);
+            });
+        });
+
+        bench::add("auth/lookup", {100, 10000}, [](bench::State &state) {
+            chain::Authenticator auth;
+            for (int64_t i = 0; i < state.arg(); i++) {
+                std::string id = "robot-" + std::to_string(i);
+                auth.registerParticipant(id, "active");
+                auth.grantCapability(id, "move");
+            }
+            int64_t i = 0;
+            state.run([&] {
+                std::string id = "robot-" + std::to_string(i++ % state.arg());
+                bool allowed = auth.isParticipantAuthorized(id) && auth.hasCapability(id, "move");
+                bench::doNotOptimize(allowed);
+            });
+        });
+
+        // Hot-path recording cost; both read zero unless built with BLOCKIT_ENABLE_METRICS
+        bench::add("metrics/count", {1}, [](bench::State &state) {
+            state.run([] { chain::countMetric(chain::Counter::Hashes); });
+        });
+
+        bench::add("metrics/timer", {1}, [](bench::State &state) {
+            state.run([] { chain::MetricTimer timer(chain::Histogram::MerkleBuild); });
+        });
+
+        // Likewise empty unless built with BLOCKIT_ENABLE_TRACING
+        bench::add("trace/span", {1}, [](bench::State &state) {
+            state.run([] { chain::TraceSpan span("bench"); });
+        });
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string filter, json;
+    double min_time = 0.2;
+    int repetitions = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = std::stod(argv[++i]);
+        } else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            repetitions = std::stoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter <substring>] [--min-time <seconds>] [--repetitions <n>] [--json <path>]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    registerBenchmarks();
+    std::cout.setstate(std::ios::failbit); // The library logs every block it adds; keep the table readable
+    auto results = bench::runAll(filter, min_time, repetitions);
+    std::cout.clear();
+    if (!json.empty()) {
+        bench::keepThresholds(json, results);
+        if (!bench::writeJson(json, results)) {
+            std::cerr << "Cannot write " << json << std::endl;
+            return 1;
+        }
+    }
+    return results.empty() ? 1 : 0;
+}
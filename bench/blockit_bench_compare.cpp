@@ -0,0 +1,81 @@
+#include "bench.hpp"
+
+#include <cstring>
+#include <map>
+
+// Compares a blockit_bench (or blockit_workload) JSON run against a baseline and exits non-zero when any benchmark
+// got slower, or allocates more, by more than its threshold.
+//
+//   blockit_bench_compare <baseline.json> <current.json> [--threshold <percent>]
+//
+// A baseline entry may carry its own "threshold" in percent, overriding the command-line default; benchmarks
+// present in only one of the files are listed but never fail the comparison.
+
+namespace {
+    // Percent change from `before` to `after`; allocation counts near zero compare by absolute difference
+    double change(double before, double after) {
+        if (before <= 0.0) {
+            return after > 0.5 ? 100.0 * after : 0.0;
+        }
+        return 100.0 * (after - before) / before;
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> paths;
+    double default_threshold = 10.0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            default_threshold = std::stod(argv[++i]);
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " <baseline.json> <current.json> [--threshold <percent>]" << std::endl;
+        return 2;
+    }
+
+    std::vector<bench::Result> baseline, current;
+    try {
+        baseline = bench::readJson(paths[0]);
+        current = bench::readJson(paths[1]);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    std::map<std::string, const bench::Result *> by_name;
+    for (const auto &result : current) {
+        by_name[result.name] = &result;
+    }
+
+    std::printf("%-40s %14s %14s %9s %9s %9s\n", "benchmark", "base ns/op", "ns/op", "time", "allocs", "limit");
+    int regressions = 0;
+    for (const auto &base : baseline) {
+        auto it = by_name.find(base.name);
+        if (it == by_name.end()) {
+            std::printf("%-40s %14.1f %14s\n", base.name.c_str(), base.ns_per_op, "missing");
+            continue;
+        }
+        const bench::Result &now = *it->second;
+        by_name.erase(it);
+        double threshold = base.threshold.value_or(default_threshold);
+        double time = change(base.ns_per_op, now.ns_per_op);
+        double allocs = change(base.allocs_per_op, now.allocs_per_op);
+        bool regressed = time > threshold || allocs > threshold;
+        regressions += regressed;
+        std::printf("%-40s %14.1f %14.1f %+8.1f%% %+8.1f%% %8.1f%%%s\n", base.name.c_str(), base.ns_per_op,
+                    now.ns_per_op, time, allocs, threshold, regressed ? "  REGRESSION" : "");
+    }
+    for (const auto &[name, result] : by_name) {
+        std::printf("%-40s %14s %14.1f   (not in baseline)\n", name.c_str(), "-", result->ns_per_op);
+    }
+
+    if (regressions > 0) {
+        std::printf("\n%d benchmark(s) regressed beyond their threshold\n", regressions);
+        return 1;
+    }
+    std::printf("\nNo regressions against %s\n", paths[0].c_str());
+    return 0;
+}
@@ -0,0 +1,310 @@
+#include "bench.hpp"
+
+#include "blokit/blokit.hpp"
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+// Macro benchmark: replays farming, sensor and robot-fleet traffic at configured rates through
+// mempool -> block template -> Chain::addBlock -> block log, and reports sustained throughput, commit latency
+// percentiles and memory growth.
+//
+//   blockit_workload [--duration <s>] [--sensor-rate <tx/s>] [--farming-rate <tx/s>] [--robot-rate <tx/s>]
+//                    [--block-interval <ms>] [--max-block <txs>] [--log <path>] [--report <s>] [--json <path>]
+//                    [--trace <path>]
+//
+// Everything runs on one thread, client-side signing included, so the numbers are a lower bound for a node that
+// receives signed transactions.
+
+// One record type for all three workloads, shaped like the structs in examples/farming_demo.cpp and
+// examples/enhanced_demo.cpp
+struct FleetEvent {
+    std::string kind;   // "sensor", "farming" or "robot"
+    std::string source; // Sensor, equipment or issuing robot
+    std::string target; // Field, location or target robot
+    std::string detail; // Sensor type, operation or command
+    double value = 0.0; // Reading, hectares or priority
+
+    std::string to_string() const {
+        return "FleetEvent{" + kind + ":" + source + "->" + target + "," + detail + "," + std::to_string(value) + "}";
+    }
+
+    std::vector<uint8_t> serializeBinary() const {
+        std::vector<uint8_t> buffer;
+        chain::BinarySerializer::writeString(buffer, kind);
+        chain::BinarySerializer::writeString(buffer, source);
+        chain::BinarySerializer::writeString(buffer, target);
+        chain::BinarySerializer::writeString(buffer, detail);
+        chain::BinarySerializer::writeDouble(buffer, value);
+        return buffer;
+    }
+
+    static FleetEvent deserializeBinary(const std::vector<uint8_t> &data) {
+        FleetEvent result;
+        size_t offset = 0;
+        result.kind = chain::BinarySerializer::readString(data, offset);
+        result.source = chain::BinarySerializer::readString(data, offset);
+        result.target = chain::BinarySerializer::readString(data, offset);
+        result.detail = chain::BinarySerializer::readString(data, offset);
+        result.value = chain::BinarySerializer::readDouble(data, offset);
+        return result;
+    }
+};
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        double duration = 10.0;
+        double sensor_rate = 500.0;
+        double farming_rate = 50.0;
+        double robot_rate = 200.0;
+        double block_interval_ms = 1000.0;
+        size_t max_block = 5000;
+        std::string log_path = "blockit_workload.log";
+        double report_interval = 1.0;
+        std::string json_path;  // Summary in blockit_bench's JSON format, for blockit_bench_compare
+        std::string trace_path; // Chrome trace of the last spans; needs BLOCKIT_ENABLE_TRACING
+    };
+
+    // Deterministic traffic for one transaction type at a fixed rate
+    class Generator {
+      public:
+        inline Generator(std::string kind, double rate, Clock::time_point start)
+            : kind_(std::move(kind)), interval_(rate > 0 ? std::chrono::duration<double>(1.0 / rate)
+                                                          : std::chrono::duration<double>(0)),
+              next_(start), enabled_(rate > 0) {}
+
+        // Transactions due by `now`, each stamped with its scheduled arrival time
+        template <typename Sink> inline void emit(Clock::time_point now, Sink &&sink) {
+            while (enabled_ && next_ <= now) {
+                sink(make(), next_);
+                next_ += std::chrono::duration_cast<Clock::duration>(interval_);
+                count_++;
+            }
+        }
+
+      private:
+        std::string kind_;
+        std::chrono::duration<double> interval_;
+        Clock::time_point next_;
+        bool enabled_;
+        uint64_t count_ = 0;
+
+        inline FleetEvent make() const {
+            std::string n = std::to_string(count_ % 64);
+            if (kind_ == "sensor") {
+                return {kind_, "sensor-" + n, "field-" + std::to_string(count_ % 8), "soil_moisture",
+                        20.0 + static_cast<double>(count_ % 100) / 10.0};
+            }
+            if (kind_ == "farming") {
+                return {kind_, "tractor-" + n, "field-" + std::to_string(count_ % 8), "planting",
+                        static_cast<double>(count_ % 50)};
+            }
+            return {kind_, "robot-" + n, "robot-" + std::to_string((count_ + 1) % 64), "move_to_waypoint",
+                    static_cast<double>(count_ % 10)};
+        }
+    };
+
+    // CPU time this thread has used, so time spent sleeping between blocks does not count
+    inline double threadCpuNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+    }
+
+    inline size_t residentBytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t pages = 0, resident = 0;
+        statm >> pages >> resident;
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    inline double percentile(std::vector<double> &values, double p) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t rank = std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+        return values[rank];
+    }
+
+    bool parse(int argc, char **argv, Config &config) {
+        for (int i = 1; i < argc; i++) {
+            auto is = [&](const char *flag) { return std::strcmp(argv[i], flag) == 0 && i + 1 < argc; };
+            if (is("--duration")) {
+                config.duration = std::stod(argv[++i]);
+            } else if (is("--sensor-rate")) {
+                config.sensor_rate = std::stod(argv[++i]);
+            } else if (is("--farming-rate")) {
+                config.farming_rate = std::stod(argv[++i]);
+            } else if (is("--robot-rate")) {
+                config.robot_rate = std::stod(argv[++i]);
+            } else if (is("--block-interval")) {
+                config.block_interval_ms = std::stod(argv[++i]);
+            } else if (is("--max-block")) {
+                config.max_block = std::stoul(argv[++i]);
+            } else if (is("--log")) {
+                config.log_path = argv[++i];
+            } else if (is("--report")) {
+                config.report_interval = std::stod(argv[++i]);
+            } else if (is("--json")) {
+                config.json_path = argv[++i];
+            } else if (is("--trace")) {
+                config.trace_path = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    Config config;
+    if (!parse(argc, argv, config)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--duration <s>] [--sensor-rate <tx/s>] [--farming-rate <tx/s>] [--robot-rate <tx/s>]"
+                     " [--block-interval <ms>] [--max-block <txs>] [--log <path>] [--report <s>] [--json <path>]"
+                     " [--trace <path>]"
+                  << std::endl;
+        return 1;
+    }
+
+    auto key = std::make_shared<chain::Crypto>("workload_key");
+    std::cout.setstate(std::ios::failbit); // The library logs every block it adds
+    chain::Chain<FleetEvent> blockchain("workload-chain", "genesis", FleetEvent{"genesis", "system", "", "", 0.0},
+                                        key);
+    chain::Mempool<FleetEvent> pool(1000000);
+    std::unordered_map<std::string, Clock::time_point> arrivals;
+    std::ofstream log(config.log_path, std::ios::binary | std::ios::trunc);
+    if (!log) {
+        std::cerr << "Cannot open block log " << config.log_path << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.duration));
+    auto block_interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(config.block_interval_ms));
+    auto report_interval =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.report_interval));
+    std::vector<Generator> generators{{"sensor", config.sensor_rate, start},
+                                      {"farming", config.farming_rate, start},
+                                      {"robot", config.robot_rate, start}};
+
+    std::vector<double> latencies_ms;
+    uint64_t submitted = 0, committed = 0, dropped = 0, log_bytes = 0, window_committed = 0;
+    double commit_cpu_ns = 0.0; // Template building, addBlock and logging
+    size_t rss_start = residentBytes();
+    auto next_block = start + block_interval;
+    auto next_report = start + report_interval;
+
+    std::printf("%8s %10s %10s %10s %10s %10s\n", "time_s", "tps", "mempool", "height", "rss_mb", "log_mb");
+    for (auto now = Clock::now(); now < end; now = Clock::now()) {
+        for (auto &generator : generators) {
+            generator.emit(now, [&](FleetEvent event, Clock::time_point arrival) {
+                chain::Transaction<FleetEvent> tx("tx-" + std::to_string(submitted++), std::move(event), 100);
+                tx.signTransaction(key);
+                if (pool.add(tx)) {
+                    arrivals.emplace(tx.uuid_, arrival);
+                } else {
+                    dropped++;
+                }
+            });
+        }
+
+        if (now >= next_block) {
+            double cpu_start = threadCpuNs();
+            auto candidate = pool.buildTemplate(SIZE_MAX, config.max_block);
+            if (!candidate.transactions.empty()) {
+                chain::Block<FleetEvent> block(std::move(candidate.transactions));
+                if (blockchain.addBlock(block)) {
+                    const auto &connected = blockchain.blocks_.back();
+                    auto bytes = connected.serializeBinary();
+                    uint32_t size = static_cast<uint32_t>(bytes.size());
+                    log.write(reinterpret_cast<const char *>(&size), sizeof(size));
+                    log.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(size));
+                    log.flush();
+                    log_bytes += sizeof(size) + bytes.size();
+
+                    auto commit = Clock::now();
+                    for (const auto &tx : connected.transactions_) {
+                        auto arrival = arrivals.find(tx.uuid_);
+                        latencies_ms.push_back(
+                            std::chrono::duration<double, std::milli>(commit - arrival->second).count());
+                        arrivals.erase(arrival);
+                    }
+                    committed += connected.transactions_.size();
+                    window_committed += connected.transactions_.size();
+                    pool.removeIncluded(connected);
+                }
+            }
+            commit_cpu_ns += threadCpuNs() - cpu_start;
+            next_block += block_interval;
+        }
+
+        if (now >= next_report) {
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            std::printf("%8.1f %10.0f %10zu %10zu %10.1f %10.1f\n", elapsed,
+                        static_cast<double>(window_committed) / config.report_interval, pool.size(),
+                        blockchain.getChainLength() - 1, static_cast<double>(residentBytes()) / 1e6,
+                        static_cast<double>(log_bytes) / 1e6);
+            std::fflush(stdout);
+            window_committed = 0;
+            next_report += report_interval;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    std::cout.clear();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t rss_end = residentBytes();
+    double offered = config.sensor_rate + config.farming_rate + config.robot_rate;
+    std::printf("\noffered %.0f tx/s, submitted %llu, committed %llu, pending %zu, dropped %llu\n", offered,
+                static_cast<unsigned long long>(submitted), static_cast<unsigned long long>(committed), pool.size(),
+                static_cast<unsigned long long>(dropped));
+    std::printf("sustained %.0f tx/s over %.1f s, %zu blocks\n", static_cast<double>(committed) / elapsed, elapsed,
+                blockchain.getChainLength() - 1);
+    double p50 = percentile(latencies_ms, 0.50), p99 = percentile(latencies_ms, 0.99);
+    double p999 = percentile(latencies_ms, 0.999);
+    std::printf("commit latency ms: p50 %.1f  p99 %.1f  p999 %.1f\n", p50, p99, p999);
+    std::printf("commit cpu %.1f us per committed tx\n",
+                committed ? commit_cpu_ns / 1e3 / static_cast<double>(committed) : 0.0);
+    std::printf("rss %.1f MB -> %.1f MB (%.0f bytes per committed tx), block log %.1f MB\n",
+                static_cast<double>(rss_start) / 1e6, static_cast<double>(rss_end) / 1e6,
+                committed ? static_cast<double>(rss_end - std::min(rss_start, rss_end)) / static_cast<double>(committed)
+                          : 0.0,
+                static_cast<double>(log_bytes) / 1e6);
+    std::printf("heap allocations %llu (%.0f per committed tx)\n",
+                static_cast<unsigned long long>(bench::allocation_count.load()),
+                committed ? static_cast<double>(bench::allocation_count.load()) / static_cast<double>(committed)
+                          : 0.0);
+
+    // Lower is better for every entry: CPU time spent committing each transaction and latencies, all in ns. Wall
+    // time per transaction would only echo the offered rate while the node keeps up.
+    if (!config.json_path.empty()) {
+        double per_tx = committed ? static_cast<double>(committed) : 1.0;
+        double allocs = static_cast<double>(bench::allocation_count.load()) / per_tx;
+        double bytes = static_cast<double>(bench::allocated_bytes.load()) / per_tx;
+        std::vector<bench::Result> results{
+            {"workload/commit", committed, commit_cpu_ns / per_tx, bytes, allocs, std::nullopt},
+            {"workload/latency_p50", committed, p50 * 1e6, 0.0, 0.0, std::nullopt},
+            {"workload/latency_p99", committed, p99 * 1e6, 0.0, 0.0, std::nullopt},
+            {"workload/latency_p999", committed, p999 * 1e6, 0.0, 0.0, std::nullopt},
+        };
+        if (!bench::writeJson(config.json_path, results)) {
+            std::cerr << "Cannot write " << config.json_path << std::endl;
+            return 1;
+        }
+    }
+    if (!config.trace_path.empty() && !chain::Tracer::instance().writeChromeTrace(config.trace_path)) {
+        std::cerr << "Cannot write " << config.trace_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
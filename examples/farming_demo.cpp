@@ -3,6 +3,7 @@
 #include <iostream>
 #include <memory>
 #include <thread>
+#include <tuple>
 #include <vector>
 
 // Farming operation data structure
@@ -32,6 +33,12 @@ struct SensorReading {
         return "SensorReading{sensor:" + sensor_id + ",type:" + sensor_type + ",location:" + location +
                ",value:" + std::to_string(value) + ",unit:" + unit + "}";
     }
+
+    // Gives readings a compact fixed-layout binary encoding (see chain::TypeSerializer)
+    static constexpr auto fields() {
+        return std::make_tuple(&SensorReading::sensor_id, &SensorReading::sensor_type, &SensorReading::location,
+                               &SensorReading::value, &SensorReading::unit);
+    }
 };
 
 // Equipment maintenance record
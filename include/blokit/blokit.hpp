@@ -1,6 +1,34 @@
+#include "blokit/consensus/authority.hpp"
+#include "blokit/consensus/difficulty.hpp"
+#include "blokit/consensus/engine.hpp"
+#include "blokit/consensus/finality.hpp"
+#include "blokit/consensus/miner.hpp"
+#include "blokit/network/buffer.hpp"
+#include "blokit/network/compact.hpp"
+#include "blokit/network/frame.hpp"
+#include "blokit/network/gossip.hpp"
+#include "blokit/network/simulator.hpp"
+#include "blokit/network/sync.hpp"
+#include "blokit/network/validator.hpp"
+#ifdef __linux__
+#include "blokit/network/event_loop.hpp"
+#include "blokit/network/node.hpp"
+#endif
+#include "blokit/structure/arena.hpp"
 #include "blokit/structure/auth.hpp"
 #include "blokit/structure/block.hpp"
+#include "blokit/structure/bloom.hpp"
+#include "blokit/structure/block_tree.hpp"
 #include "blokit/structure/chain.hpp"
+#include "blokit/structure/coin_store.hpp"
+#include "blokit/structure/columns.hpp"
+#include "blokit/structure/ledger.hpp"
+#include "blokit/structure/mempool.hpp"
 #include "blokit/structure/merkle.hpp"
+#include "blokit/structure/metrics.hpp"
 #include "blokit/structure/signer.hpp"
+#include "blokit/structure/siphash.hpp"
+#include "blokit/structure/target.hpp"
+#include "blokit/structure/trace.hpp"
 #include "blokit/structure/transaction.hpp"
+#include "blokit/structure/utxo.hpp"
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../structure/auth.hpp"
+#include "../structure/block.hpp"
+#include "../structure/signer.hpp"
+
+namespace chain {
+
+    // Proof-of-authority sealing. Participants holding the sealer capability and a registered public key take
+    // turns signing blocks in round-robin order, so validating a block costs one signature check instead of
+    // hashing work and block latency is bounded by the round time.
+    class ProofOfAuthority {
+      public:
+        static constexpr const char *SEALER_CAPABILITY = "SEAL_BLOCKS";
+        static constexpr const char *PUBLIC_KEY_METADATA = "public_key";
+
+        // Fork choice weights: blocks sealed by the in-turn sealer outweigh out-of-turn ones
+        static constexpr uint64_t IN_TURN_WEIGHT = 2;
+        static constexpr uint64_t OUT_OF_TURN_WEIGHT = 1;
+
+        inline explicit ProofOfAuthority(double round_seconds = 1.0) : round_seconds_(round_seconds) {}
+
+        // Sealers in round-robin order (sorted by id so every node agrees). Cached until the authenticator
+        // changes; not safe to call concurrently.
+        inline const std::vector<std::string> &getSealers(const Authenticator &auth) const {
+            refresh(auth);
+            return sealers_;
+        }
+
+        inline bool isSealer(const Authenticator &auth, const std::string &sealer_id) const {
+            refresh(auth);
+            return keys_.find(sealer_id) != keys_.end();
+        }
+
+        // Sealer whose turn it is to seal the block at `index`
+        inline std::string getInTurnSealer(const Authenticator &auth, int64_t index) const {
+            const auto &sealers = getSealers(auth);
+            if (sealers.empty()) {
+                return "";
+            }
+            return sealers[static_cast<size_t>(index) % sealers.size()];
+        }
+
+        inline bool isInTurn(const Authenticator &auth, int64_t index, const std::string &sealer_id) const {
+            return !sealer_id.empty() && getInTurnSealer(auth, index) == sealer_id;
+        }
+
+        // How long `sealer_id` should wait past the parent before sealing block `index`: the in-turn sealer seals
+        // immediately and the others back off one round per slot behind it, so a stalled sealer costs one round
+        inline double getSealDelay(const Authenticator &auth, int64_t index, const std::string &sealer_id) const {
+            const auto &sealers = getSealers(auth);
+            auto it = std::find(sealers.begin(), sealers.end(), sealer_id);
+            if (it == sealers.end()) {
+                return -1.0;
+            }
+            size_t position = static_cast<size_t>(it - sealers.begin());
+            size_t slot = (position + sealers.size() - static_cast<size_t>(index) % sealers.size()) % sealers.size();
+            return round_seconds_ * static_cast<double>(slot);
+        }
+
+        // A sealer may seal at most one of any `limit` consecutive blocks, so a single compromised sealer cannot
+        // extend the chain on its own
+        inline size_t getRecentSealLimit(const Authenticator &auth) const { return getSealers(auth).size() / 2 + 1; }
+
+        inline double getRoundSeconds() const { return round_seconds_; }
+
+        // Commit the sealer to the header, refresh the hash and sign it. The block must already be linked.
+        template <typename T>
+        inline void seal(Block<T> &block, const std::string &sealer_id, std::shared_ptr<Crypto> key) const {
+            block.sealer_id_ = sealer_id;
+            block.hash_ = block.calculateHash();
+            block.seal_ = key->sign(block.hash_);
+        }
+
+        // One signature check: the header hash already commits to the sealer id
+        template <typename T> inline bool verifySeal(const Block<T> &block, const Authenticator &auth) const {
+            if (block.sealer_id_.empty() || block.seal_.empty()) {
+                std::cout << "Block " << block.index_ << " is not sealed" << std::endl;
+                return false;
+            }
+            refresh(auth);
+            auto it = keys_.find(block.sealer_id_);
+            if (it == keys_.end()) {
+                std::cout << "Block " << block.index_ << " sealed by unauthorized sealer " << block.sealer_id_
+                          << std::endl;
+                return false;
+            }
+            if (!verify(it->second.get(), block.hash_, block.seal_)) {
+                std::cout << "Seal verification failed for block " << block.index_ << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Remember the sealer set the block at `height` was accepted under. A new epoch starts only when the set
+        // changed; epochs from a branch being replaced are dropped first.
+        inline void recordSealers(const Authenticator &auth, int64_t height) {
+            while (!epochs_.empty() && epochs_.back().from_height >= height) {
+                epochs_.pop_back();
+            }
+            refresh(auth);
+            if (epochs_.empty() || epochs_.back().public_keys != public_keys_) {
+                epochs_.push_back({height, public_keys_, keys_});
+            }
+        }
+
+        // Like verifySeal, but against the sealers in force when the block was appended, so revoking a sealer
+        // does not invalidate the blocks it sealed before. Blocks older than the recorded history fall back to the
+        // current sealers.
+        template <typename T> inline bool verifyRecordedSeal(const Block<T> &block, const Authenticator &auth) const {
+            auto epoch = std::find_if(epochs_.rbegin(), epochs_.rend(),
+                                      [&](const SealerEpoch &e) { return e.from_height <= block.index_; });
+            if (epoch == epochs_.rend()) {
+                return verifySeal(block, auth);
+            }
+            if (block.sealer_id_.empty() || block.seal_.empty()) {
+                std::cout << "Block " << block.index_ << " is not sealed" << std::endl;
+                return false;
+            }
+            auto it = epoch->keys.find(block.sealer_id_);
+            if (it == epoch->keys.end()) {
+                std::cout << "Block " << block.index_ << " sealed by " << block.sealer_id_
+                          << ", who was not a sealer at that height" << std::endl;
+                return false;
+            }
+            if (!verify(it->second.get(), block.hash_, block.seal_)) {
+                std::cout << "Seal verification failed for block " << block.index_ << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        inline size_t getSealerEpochCount() const { return epochs_.size(); }
+
+        // Round time and sealer history, with public keys base64 encoded
+        inline std::string serialize() const {
+            std::stringstream ss;
+            ss << R"({"round_seconds": )" << round_seconds_ << R"(, "epochs": [)";
+            for (size_t i = 0; i < epochs_.size(); i++) {
+                ss << (i > 0 ? "," : "") << R"({"from": )" << epochs_[i].from_height << R"(, "sealers": [)";
+                size_t n = 0;
+                for (const auto &[id, pem] : epochs_[i].public_keys) {
+                    ss << (n++ > 0 ? "," : "") << R"({"id": ")" << id << R"(", "public_key": ")"
+                       << base64Encode(std::vector<unsigned char>(pem.begin(), pem.end())) << R"("})";
+                }
+                ss << "]}";
+            }
+            ss << "]}";
+            return ss.str();
+        }
+
+        inline static ProofOfAuthority deserialize(const std::string &data) {
+            size_t round_start = data.find("\"round_seconds\": ") + 17;
+            ProofOfAuthority authority(std::stod(data.substr(round_start, data.find(",", round_start) - round_start)));
+            size_t pos = data.find("{\"from\": ");
+            while (pos != std::string::npos) {
+                size_t next = data.find("{\"from\": ", pos + 1);
+                size_t end = next == std::string::npos ? data.size() : next;
+                SealerEpoch epoch;
+                epoch.from_height = std::stoll(data.substr(pos + 9, data.find(",", pos) - pos - 9));
+                for (size_t id_pos = data.find("\"id\": \"", pos); id_pos < end;
+                     id_pos = data.find("\"id\": \"", id_pos + 1)) {
+                    size_t id_start = id_pos + 7;
+                    std::string id = data.substr(id_start, data.find("\"", id_start) - id_start);
+                    size_t key_start = data.find("\"public_key\": \"", id_start) + 15;
+                    auto pem_bytes = base64Decode(data.substr(key_start, data.find("\"", key_start) - key_start));
+                    std::string pem(pem_bytes.begin(), pem_bytes.end());
+                    epoch.keys[id] = std::shared_ptr<EVP_PKEY>(loadPublicKeyFromPEM(pem));
+                    epoch.public_keys[id] = std::move(pem);
+                }
+                authority.epochs_.push_back(std::move(epoch));
+                pos = next;
+            }
+            return authority;
+        }
+
+        template <typename T> inline uint64_t blockWeight(const Block<T> &block, const Authenticator &auth) const {
+            return isInTurn(auth, block.index_, block.sealer_id_) ? IN_TURN_WEIGHT : OUT_OF_TURN_WEIGHT;
+        }
+
+        // Total seal weight of `blocks[from..]`
+        template <typename T>
+        inline uint64_t chainWeight(const std::vector<Block<T>> &blocks, const Authenticator &auth,
+                                    size_t from = 0) const {
+            uint64_t weight = 0;
+            for (size_t i = from; i < blocks.size(); i++) {
+                weight += blockWeight(blocks[i], auth);
+            }
+            return weight;
+        }
+
+      private:
+        // Sealers and their keys from `from_height` until the next epoch
+        struct SealerEpoch {
+            int64_t from_height = 0;
+            std::map<std::string, std::string> public_keys; // Sealer id to PEM
+            std::unordered_map<std::string, std::shared_ptr<EVP_PKEY>> keys;
+        };
+
+        double round_seconds_;
+        std::vector<SealerEpoch> epochs_; // Oldest first
+
+        // Derived from the authenticator and rebuilt only when it changes
+        mutable const Authenticator *cached_auth_ = nullptr;
+        mutable uint64_t cached_revision_ = 0;
+        mutable std::vector<std::string> sealers_;
+        mutable std::unordered_map<std::string, std::shared_ptr<EVP_PKEY>> keys_;
+        mutable std::map<std::string, std::string> public_keys_;
+
+        inline void refresh(const Authenticator &auth) const {
+            if (cached_auth_ == &auth && cached_revision_ == auth.getRevision()) {
+                return;
+            }
+            sealers_.clear();
+            keys_.clear();
+            public_keys_.clear();
+            for (const auto &participant : auth.getAuthorizedParticipants()) {
+                if (!auth.hasCapability(participant, SEALER_CAPABILITY)) {
+                    continue;
+                }
+                std::string pem = auth.getParticipantMetadata(participant, PUBLIC_KEY_METADATA);
+                if (pem.empty()) {
+                    continue;
+                }
+                keys_[participant] = std::shared_ptr<EVP_PKEY>(loadPublicKeyFromPEM(pem));
+                public_keys_[participant] = pem;
+                sealers_.push_back(participant);
+            }
+            std::sort(sealers_.begin(), sealers_.end());
+            cached_auth_ = &auth;
+            cached_revision_ = auth.getRevision();
+        }
+    };
+
+} // namespace chain
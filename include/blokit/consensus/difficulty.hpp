@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../structure/target.hpp"
+#include "../structure/transaction.hpp"
+
+namespace chain {
+
+    // Rolling window of the most recent block timestamps. Updated once per block so retargeting never has to
+    // walk the chain; the running interval sum gives O(1) moving averages.
+    class DifficultyWindow {
+      public:
+        inline DifficultyWindow(size_t capacity, int64_t target_interval_ns)
+            : capacity_(std::max<size_t>(capacity, 2)), target_interval_ns_(target_interval_ns) {}
+
+        inline void push(const Timestamp &timestamp) {
+            int64_t ns = static_cast<int64_t>(timestamp.sec) * 1000000000LL + timestamp.nanosec;
+            if (!timestamps_.empty()) {
+                interval_sum_ns_ += ns - timestamps_.back();
+            }
+            timestamps_.push_back(ns);
+            if (timestamps_.size() > capacity_) {
+                interval_sum_ns_ -= timestamps_[1] - timestamps_[0];
+                timestamps_.pop_front();
+            }
+            blocks_seen_++;
+        }
+
+        // Number of blocks observed since the window was created (not capped by capacity)
+        inline uint64_t blocksSeen() const { return blocks_seen_; }
+
+        inline size_t size() const { return timestamps_.size(); }
+        inline size_t capacity() const { return capacity_; }
+        inline int64_t targetIntervalNs() const { return target_interval_ns_; }
+
+        // Time spanned by the newest `intervals` block intervals held in the window
+        inline int64_t spanNs(size_t intervals) const {
+            if (timestamps_.size() < 2) {
+                return 0;
+            }
+            intervals = std::min(intervals, timestamps_.size() - 1);
+            return timestamps_.back() - timestamps_[timestamps_.size() - 1 - intervals];
+        }
+
+        inline int64_t lastIntervalNs() const { return spanNs(1); }
+
+        // Rebuild from the newest timestamps (oldest first) after a rollback
+        inline void restore(uint64_t blocks_seen, const std::vector<Timestamp> &timestamps) {
+            timestamps_.clear();
+            interval_sum_ns_ = 0;
+            for (const auto &timestamp : timestamps) {
+                push(timestamp);
+            }
+            blocks_seen_ = blocks_seen;
+        }
+
+        // The same blocks under another capacity and target interval, keeping the newest timestamps that fit
+        inline DifficultyWindow resized(size_t capacity, int64_t target_interval_ns) const {
+            DifficultyWindow window(capacity, target_interval_ns);
+            size_t keep = std::min(timestamps_.size(), window.capacity_);
+            window.timestamps_.assign(timestamps_.end() - static_cast<std::ptrdiff_t>(keep), timestamps_.end());
+            window.interval_sum_ns_ = keep < 2 ? 0 : window.timestamps_.back() - window.timestamps_.front();
+            window.blocks_seen_ = blocks_seen_;
+            return window;
+        }
+
+        inline double averageIntervalNs() const {
+            return timestamps_.size() < 2 ? 0.0
+                                          : static_cast<double>(interval_sum_ns_) / (timestamps_.size() - 1);
+        }
+
+      private:
+        size_t capacity_;
+        int64_t target_interval_ns_;
+        std::deque<int64_t> timestamps_;
+        int64_t interval_sum_ns_ = 0;
+        uint64_t blocks_seen_ = 0;
+    };
+
+    // Strategy for choosing the next block's proof-of-work target from recent block timestamps
+    class DifficultyPolicy {
+      public:
+        virtual ~DifficultyPolicy() = default;
+
+        virtual std::string name() const = 0;
+
+        // Block timestamps the policy needs to look back over
+        virtual size_t windowSize() const = 0;
+
+        // Compact target for the next block given the current one and the window that already includes the
+        // newest block
+        virtual uint32_t nextTargetBits(const DifficultyWindow &window, uint32_t current_bits) const = 0;
+
+        // Name and parameters as stored with a chain. Policies deserializeDifficultyPolicy() does not know are
+        // written by name only and cannot be restored.
+        virtual std::string serialize() const { return R"({"name": ")" + name() + R"("})"; }
+
+      protected:
+        // Doubles printed so they read back exactly
+        static inline std::string formatParameter(double value) {
+            std::ostringstream ss;
+            ss << std::setprecision(17) << value;
+            return ss.str();
+        }
+    };
+
+    // Bitcoin style: keep the target for `interval` blocks, then rescale it by how long those blocks took
+    class FixedWindowRetarget : public DifficultyPolicy {
+      public:
+        inline explicit FixedWindowRetarget(size_t interval, double max_factor = 4.0)
+            : interval_(std::max<size_t>(interval, 1)), max_factor_(max_factor) {}
+
+        inline std::string name() const override { return "fixed-window"; }
+        inline size_t windowSize() const override { return interval_ + 1; }
+
+        inline std::string serialize() const override {
+            return R"({"name": "fixed-window", "interval": )" + std::to_string(interval_) + R"(, "max_factor": )" +
+                   formatParameter(max_factor_) + "}";
+        }
+
+        inline uint32_t nextTargetBits(const DifficultyWindow &window, uint32_t current_bits) const override {
+            if ((window.blocksSeen() - 1) % interval_ != 0 || window.size() < interval_ + 1) {
+                return current_bits;
+            }
+            double expected = static_cast<double>(window.targetIntervalNs()) * interval_;
+            double actual = static_cast<double>(window.spanNs(interval_));
+            double factor = std::clamp(actual / expected, 1.0 / max_factor_, max_factor_);
+            return Target::fromCompact(current_bits).scaled(factor).toCompact();
+        }
+
+      private:
+        size_t interval_;
+        double max_factor_;
+    };
+
+    // Retarget every block towards the average interval of the last `window` blocks
+    class MovingAverageRetarget : public DifficultyPolicy {
+      public:
+        inline explicit MovingAverageRetarget(size_t window, double max_step = 2.0)
+            : window_(std::max<size_t>(window, 1)), max_step_(max_step) {}
+
+        inline std::string name() const override { return "moving-average"; }
+        inline size_t windowSize() const override { return window_ + 1; }
+
+        inline std::string serialize() const override {
+            return R"({"name": "moving-average", "window": )" + std::to_string(window_) + R"(, "max_step": )" +
+                   formatParameter(max_step_) + "}";
+        }
+
+        inline uint32_t nextTargetBits(const DifficultyWindow &window, uint32_t current_bits) const override {
+            if (window.size() < 2) {
+                return current_bits;
+            }
+            double factor = window.averageIntervalNs() / static_cast<double>(window.targetIntervalNs());
+            factor = std::clamp(factor, 1.0 / max_step_, max_step_);
+            return Target::fromCompact(current_bits).scaled(factor).toCompact();
+        }
+
+      private:
+        size_t window_;
+        double max_step_;
+    };
+
+    // Per-block exponential adjustment: every `half_life` of deviation from the target interval doubles or
+    // halves the target, so hash rate shocks are absorbed within a few blocks
+    class ExponentialRetarget : public DifficultyPolicy {
+      public:
+        inline explicit ExponentialRetarget(double half_life_blocks = 8.0) : half_life_blocks_(half_life_blocks) {}
+
+        inline std::string name() const override { return "exponential"; }
+        inline size_t windowSize() const override { return 2; }
+
+        inline std::string serialize() const override {
+            return R"({"name": "exponential", "half_life_blocks": )" + formatParameter(half_life_blocks_) + "}";
+        }
+
+        inline uint32_t nextTargetBits(const DifficultyWindow &window, uint32_t current_bits) const override {
+            if (window.size() < 2) {
+                return current_bits;
+            }
+            double target = static_cast<double>(window.targetIntervalNs());
+            double deviation = (static_cast<double>(window.lastIntervalNs()) - target) / target;
+            double factor = std::exp2(std::clamp(deviation / half_life_blocks_, -1.0, 1.0));
+            return Target::fromCompact(current_bits).scaled(factor).toCompact();
+        }
+
+      private:
+        double half_life_blocks_;
+    };
+
+    // Rebuild one of the policies above from its serialize() output, nullptr for anything else
+    inline std::shared_ptr<DifficultyPolicy> deserializeDifficultyPolicy(const std::string &data) {
+        auto parameter = [&data](const std::string &key) {
+            size_t start = data.find("\"" + key + "\": ");
+            if (start == std::string::npos) {
+                throw std::runtime_error("Difficulty policy is missing " + key);
+            }
+            start += key.size() + 4;
+            return std::stod(data.substr(start, data.find_first_of(",}", start) - start));
+        };
+        size_t name_start = data.find("\"name\": \"");
+        if (name_start == std::string::npos) {
+            return nullptr;
+        }
+        name_start += 9;
+        std::string name = data.substr(name_start, data.find("\"", name_start) - name_start);
+        if (name == "fixed-window") {
+            return std::make_shared<FixedWindowRetarget>(static_cast<size_t>(parameter("interval")),
+                                                         parameter("max_factor"));
+        }
+        if (name == "moving-average") {
+            return std::make_shared<MovingAverageRetarget>(static_cast<size_t>(parameter("window")),
+                                                           parameter("max_step"));
+        }
+        if (name == "exponential") {
+            return std::make_shared<ExponentialRetarget>(parameter("half_life_blocks"));
+        }
+        return nullptr;
+    }
+
+    // A policy and block time in force for the blocks from height `from` on
+    struct DifficultyTuning {
+        size_t from = 0;
+        std::shared_ptr<DifficultyPolicy> policy;
+        double block_seconds = 0.0;
+    };
+
+    // Tracks the target required for the next block. Blocks are fed in as they are appended, so the cost per
+    // block is constant regardless of chain length.
+    class DifficultyAdjuster {
+      public:
+        DifficultyAdjuster() = default;
+        inline DifficultyAdjuster(std::shared_ptr<DifficultyPolicy> policy, uint32_t initial_bits,
+                                  double target_block_seconds)
+            : policy_(std::move(policy)), initial_bits_(initial_bits), next_bits_(initial_bits),
+              target_block_seconds_(target_block_seconds),
+              window_(policy_ ? policy_->windowSize() : 2, toNanoseconds(target_block_seconds)) {}
+
+        inline bool isEnabled() const { return policy_ != nullptr; }
+
+        // Record a newly appended block and compute the target for its successor
+        inline void onBlock(const Timestamp &timestamp) {
+            window_.push(timestamp);
+            if (policy_ && window_.blocksSeen() > 1) {
+                next_bits_ = policy_->nextTargetBits(window_, next_bits_);
+            }
+        }
+
+        // Rewind to an earlier block: the target its successor needed, how many blocks the adjuster had seen and
+        // the newest window-size timestamps up to it. Costs O(window) instead of replaying the chain.
+        inline void restore(uint32_t next_bits, uint64_t blocks_seen, const std::vector<Timestamp> &timestamps) {
+            window_.restore(blocks_seen, timestamps);
+            next_bits_ = next_bits;
+        }
+
+        // Switch to another policy and block time, keeping the blocks seen and the target already required
+        inline void retune(std::shared_ptr<DifficultyPolicy> policy, double target_block_seconds) {
+            window_ = window_.resized(policy ? policy->windowSize() : 2, toNanoseconds(target_block_seconds));
+            policy_ = std::move(policy);
+            target_block_seconds_ = target_block_seconds;
+        }
+
+        // Reset to the initial target, keeping the policy and block time
+        inline void reset() { *this = DifficultyAdjuster(policy_, initial_bits_, target_block_seconds_); }
+
+        inline uint32_t getNextTargetBits() const { return next_bits_; }
+        inline uint32_t getInitialTargetBits() const { return initial_bits_; }
+        inline double getTargetBlockSeconds() const { return target_block_seconds_; }
+        inline const std::shared_ptr<DifficultyPolicy> &getPolicy() const { return policy_; }
+        inline const DifficultyWindow &getWindow() const { return window_; }
+
+        // Policy and starting point; the window and current target are rebuilt by replaying blocks
+        inline std::string serialize() const {
+            std::ostringstream ss;
+            ss << R"({"initial_bits": )" << initial_bits_ << R"(, "block_seconds": )" << std::setprecision(17)
+               << target_block_seconds_ << R"(, "policy": )" << (policy_ ? policy_->serialize() : "null") << "}";
+            return ss.str();
+        }
+
+        // Disabled if the policy is unknown
+        inline static DifficultyAdjuster deserialize(const std::string &data) {
+            size_t bits_start = data.find("\"initial_bits\": ") + 16;
+            size_t seconds_start = data.find("\"block_seconds\": ") + 17;
+            size_t policy_start = data.find("\"policy\": ") + 10;
+            uint32_t initial_bits =
+                static_cast<uint32_t>(std::stoul(data.substr(bits_start, data.find(",", bits_start) - bits_start)));
+            double seconds = std::stod(data.substr(seconds_start, data.find(",", seconds_start) - seconds_start));
+            auto policy = deserializeDifficultyPolicy(data.substr(policy_start));
+            return policy ? DifficultyAdjuster(std::move(policy), initial_bits, seconds) : DifficultyAdjuster();
+        }
+
+      private:
+        std::shared_ptr<DifficultyPolicy> policy_;
+        uint32_t initial_bits_ = 0;
+        uint32_t next_bits_ = 0;
+        double target_block_seconds_ = 0.0;
+        DifficultyWindow window_{2, 0};
+
+        static inline int64_t toNanoseconds(double seconds) { return static_cast<int64_t>(seconds * 1e9); }
+    };
+
+} // namespace chain
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../structure/chain.hpp"
+
+namespace chain {
+
+    // How a node produces blocks and chooses between competing chains. Engines are per node: they hold the node's
+    // identity and key material, while Chain enforces the validity rules every node agrees on.
+    template <typename T> class ConsensusEngine {
+      public:
+        virtual ~ConsensusEngine() = default;
+
+        virtual std::string name() const = 0;
+
+        // Seconds to wait after the current tip before proposing on top of it, negative if this node may not
+        // propose. Randomized engines draw from `rng` so simulations are reproducible.
+        virtual double proposalDelay(const Chain<T> &chain, std::mt19937_64 &rng) const = 0;
+
+        // Link `block` to the tip, make it acceptable (mine, seal, ...) and append it
+        virtual bool produce(Chain<T> &chain, Block<T> block) = 0;
+
+        // Fork choice: true if `candidate` should replace the chain's current blocks. Defers to the chain's own
+        // fork choice rule so engines never disagree with the block tree about which tip is canonical.
+        virtual bool prefer(const Chain<T> &chain, const std::vector<Block<T>> &candidate) const {
+            return chain.prefersFork(candidate);
+        }
+    };
+
+    // Nakamoto consensus on the chain's difficulty policy. Block discovery is modelled as a Poisson process at
+    // `hash_rate` hashes per second so the simulator can schedule it; produce() then mines for real.
+    template <typename T> class ProofOfWorkEngine : public ConsensusEngine<T> {
+      public:
+        inline explicit ProofOfWorkEngine(double hash_rate, size_t threads = 1)
+            : hash_rate_(hash_rate), threads_(threads) {}
+
+        inline std::string name() const override { return "proof-of-work"; }
+
+        inline double proposalDelay(const Chain<T> &chain, std::mt19937_64 &rng) const override {
+            if (!chain.isProofOfWorkEnabled() || hash_rate_ <= 0.0) {
+                return -1.0;
+            }
+            double expected_hashes = Target::fromCompact(chain.getNextTargetBits()).work();
+            std::exponential_distribution<double> discovery(hash_rate_ / expected_hashes);
+            return discovery(rng);
+        }
+
+        inline bool produce(Chain<T> &chain, Block<T> block) override { return chain.mineBlock(block, threads_); }
+
+      private:
+        double hash_rate_;
+        size_t threads_;
+    };
+
+    // Round-robin sealing: the in-turn sealer proposes one round after the tip, the others back off a round per
+    // slot behind it
+    template <typename T> class ProofOfAuthorityEngine : public ConsensusEngine<T> {
+      public:
+        inline ProofOfAuthorityEngine(std::string sealer_id, std::shared_ptr<Crypto> key)
+            : sealer_id_(std::move(sealer_id)), key_(std::move(key)) {}
+
+        inline std::string name() const override { return "proof-of-authority"; }
+
+        inline double proposalDelay(const Chain<T> &chain, std::mt19937_64 &) const override {
+            const auto *authority = chain.getAuthority();
+            if (authority == nullptr || !chain.canSeal(sealer_id_)) {
+                return -1.0;
+            }
+            double delay =
+                authority->getSealDelay(chain.entity_manager_, chain.getLastBlock().index_ + 1, sealer_id_);
+            return delay < 0.0 ? delay : authority->getRoundSeconds() + delay;
+        }
+
+        inline bool produce(Chain<T> &chain, Block<T> block) override {
+            return chain.sealBlock(block, sealer_id_, key_);
+        }
+
+        inline const std::string &getSealerId() const { return sealer_id_; }
+
+      private:
+        std::string sealer_id_;
+        std::shared_ptr<Crypto> key_;
+    };
+
+    // A node's finality vote. It prepares each new tip at most once per height, so it never supports two blocks at
+    // the same height, and commits the highest block on its chain that gathered a prepare certificate. Once it has
+    // committed a block it only prepares tips that build on it.
+    template <typename T> class FinalityVoter {
+      public:
+        inline FinalityVoter(std::string voter_id, std::shared_ptr<Crypto> key)
+            : voter_id_(std::move(voter_id)), key_(std::move(key)) {}
+
+        // Votes to cast now that the chain (or its collected certificates) changed
+        inline std::vector<FinalityVote> onChainUpdated(const Chain<T> &chain) {
+            std::vector<FinalityVote> votes;
+            const auto *finality = chain.getFinality();
+            if (finality == nullptr || !finality->isVoter(chain.entity_manager_, voter_id_)) {
+                return votes;
+            }
+            const auto &blocks = chain.blocks_;
+            bool on_lock = locked_height_ < static_cast<int64_t>(blocks.size()) &&
+                           (locked_hash_.empty() || blocks[locked_height_].hash_ == locked_hash_);
+            const auto &tip = blocks.back();
+            if (on_lock && tip.index_ > prepared_height_ && tip.index_ > chain.getFinalizedHeight()) {
+                prepared_height_ = tip.index_;
+                votes.push_back(finality->makeVote(VotePhase::Prepare, tip.index_, tip.hash_, voter_id_, key_));
+            }
+            int64_t lowest = std::max(locked_height_, chain.getFinalizedHeight()) + 1;
+            for (int64_t h = static_cast<int64_t>(blocks.size()) - 1; h >= lowest; h--) {
+                if (finality->getCertificate(VotePhase::Prepare, blocks[h].hash_) != nullptr) {
+                    locked_height_ = h;
+                    locked_hash_ = blocks[h].hash_;
+                    votes.push_back(finality->makeVote(VotePhase::Commit, h, locked_hash_, voter_id_, key_));
+                    break;
+                }
+            }
+            return votes;
+        }
+
+        inline const std::string &getVoterId() const { return voter_id_; }
+
+      private:
+        std::string voter_id_;
+        std::shared_ptr<Crypto> key_;
+        int64_t prepared_height_ = 0;
+        int64_t locked_height_ = 0;
+        std::string locked_hash_; // Last block this voter committed
+    };
+
+    // Pick between two copies of a chain without an engine: a valid one over an invalid one, then whichever tip
+    // `a`'s fork choice rule prefers
+    template <typename T> inline const Chain<T> &resolveFork(const Chain<T> &a, const Chain<T> &b) {
+        bool a_valid = a.isValid();
+        if (a_valid != b.isValid()) {
+            return a_valid ? a : b;
+        }
+        return a.prefersFork(b.blocks_) ? b : a;
+    }
+
+} // namespace chain
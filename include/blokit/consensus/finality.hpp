@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../structure/auth.hpp"
+#include "../structure/serializer.hpp"
+#include "../structure/signer.hpp"
+#include "authority.hpp"
+
+namespace chain {
+
+    // Two voting rounds per block, as in PBFT: a prepare quorum shows the block is the only one at its height a
+    // quorum will support, a commit quorum makes it final
+    enum class VotePhase : uint8_t { Prepare = 0, Commit = 1 };
+
+    struct FinalityVote {
+        std::string chain_id; // Signed along with the rest, so a vote cannot be replayed on another chain
+        VotePhase phase = VotePhase::Prepare;
+        int64_t height = 0;
+        std::string block_hash;
+        std::string voter_id;
+        std::vector<unsigned char> signature; // Voter's signature over payload()
+
+        inline std::string payload() const {
+            return chain_id + ":" + (phase == VotePhase::Prepare ? "prepare" : "commit") + ":" +
+                   std::to_string(height) + ":" + block_hash;
+        }
+    };
+
+    // A quorum of votes for one block in one phase; anyone holding the voter keys can check it on its own
+    struct QuorumCertificate {
+        std::string chain_id;
+        VotePhase phase = VotePhase::Commit;
+        int64_t height = -1;
+        std::string block_hash;
+        std::vector<FinalityVote> votes;
+
+        inline bool empty() const { return votes.empty(); }
+
+        inline std::string serialize() const {
+            std::stringstream ss;
+            ss << R"({"chain_id": ")" << JsonSerializer::escapeJson(chain_id) << R"(", "phase": )"
+               << static_cast<int>(phase) << R"(, "height": )" << height;
+            ss << R"(, "block_hash": ")" << block_hash << R"(", "votes": [)";
+            for (size_t i = 0; i < votes.size(); i++) {
+                ss << R"({"voter_id": ")" << JsonSerializer::escapeJson(votes[i].voter_id) << R"(", "signature": ")"
+                   << base64Encode(votes[i].signature) << R"("})";
+                if (i + 1 < votes.size()) {
+                    ss << ",";
+                }
+            }
+            ss << "]}";
+            return ss.str();
+        }
+
+        inline static QuorumCertificate deserialize(const std::string &data) {
+            QuorumCertificate qc;
+            size_t chain_start = data.find("\"chain_id\": \"");
+            if (chain_start != std::string::npos) {
+                chain_start += 13;
+                qc.chain_id = data.substr(chain_start, data.find("\"", chain_start) - chain_start);
+            }
+            size_t phase_start = data.find("\"phase\": ") + 9;
+            size_t phase_end = data.find(",", phase_start);
+            qc.phase = static_cast<VotePhase>(std::stoi(data.substr(phase_start, phase_end - phase_start)));
+            size_t height_start = data.find("\"height\": ") + 10;
+            qc.height = std::stoll(data.substr(height_start, data.find(",", height_start) - height_start));
+            size_t hash_start = data.find("\"block_hash\": \"") + 15;
+            qc.block_hash = data.substr(hash_start, data.find("\"", hash_start) - hash_start);
+
+            size_t pos = data.find("\"voter_id\": \"");
+            while (pos != std::string::npos) {
+                FinalityVote vote;
+                vote.chain_id = qc.chain_id;
+                vote.phase = qc.phase;
+                vote.height = qc.height;
+                vote.block_hash = qc.block_hash;
+                size_t id_start = pos + 13;
+                size_t id_end = data.find("\"", id_start);
+                vote.voter_id = data.substr(id_start, id_end - id_start);
+                size_t sig_start = data.find("\"signature\": \"", id_end) + 14;
+                size_t sig_end = data.find("\"", sig_start);
+                vote.signature = base64Decode(data.substr(sig_start, sig_end - sig_start));
+                qc.votes.push_back(std::move(vote));
+                pos = data.find("\"voter_id\": \"", sig_end);
+            }
+            return qc;
+        }
+    };
+
+    // Finality over the block tree. Participants holding the voter capability and a registered public key vote on
+    // blocks; 2f+1 of 3f+1 voters form a certificate, so two conflicting blocks can never both gather one unless
+    // more than f voters sign both. A commit certificate finalizes the block and all of its ancestors.
+    class FinalityGadget {
+      public:
+        static constexpr const char *VOTER_CAPABILITY = "VOTE_FINALITY";
+
+        // Voters and quorum size in force when a block was finalized. Its certificate is checked against these, so
+        // revoking a voter who signed it later does not unfinalize the block.
+        struct VoterSet {
+            std::map<std::string, std::string> public_keys; // Voter id to PEM
+            std::unordered_map<std::string, std::shared_ptr<EVP_PKEY>> keys;
+            size_t quorum = 0;
+
+            inline bool empty() const { return public_keys.empty(); }
+        };
+
+        FinalityGadget() = default;
+        // Votes are only accepted for `chain_id`, normally the chain's uuid
+        inline explicit FinalityGadget(std::string chain_id) : chain_id_(std::move(chain_id)) {}
+
+        inline const std::string &getChainId() const { return chain_id_; }
+
+        // Voters sorted by id, cached until the authenticator changes; not safe to call concurrently
+        inline const std::vector<std::string> &getVoters(const Authenticator &auth) const {
+            refresh(auth);
+            return voters_;
+        }
+
+        inline bool isVoter(const Authenticator &auth, const std::string &voter_id) const {
+            refresh(auth);
+            return keys_.find(voter_id) != keys_.end();
+        }
+
+        // Smallest number of votes that any two quorums share an honest voter in: floor(2n/3) + 1
+        inline size_t getQuorumSize(const Authenticator &auth) const { return getVoters(auth).size() * 2 / 3 + 1; }
+
+        inline FinalityVote makeVote(VotePhase phase, int64_t height, const std::string &block_hash,
+                                     const std::string &voter_id, std::shared_ptr<Crypto> key) const {
+            FinalityVote vote;
+            vote.chain_id = chain_id_;
+            vote.phase = phase;
+            vote.height = height;
+            vote.block_hash = block_hash;
+            vote.voter_id = voter_id;
+            vote.signature = key->sign(vote.payload());
+            return vote;
+        }
+
+        inline bool verifyVote(const FinalityVote &vote, const Authenticator &auth) const {
+            if (vote.chain_id != chain_id_) {
+                std::cout << "Finality vote for another chain: " << vote.chain_id << std::endl;
+                return false;
+            }
+            refresh(auth);
+            auto it = keys_.find(vote.voter_id);
+            if (it == keys_.end()) {
+                std::cout << "Finality vote from non-voter " << vote.voter_id << std::endl;
+                return false;
+            }
+            return !vote.signature.empty() && verify(it->second.get(), vote.payload(), vote.signature);
+        }
+
+        // Every vote is for the certificate's block and phase, comes from a distinct voter and verifies
+        inline bool verifyCertificate(const QuorumCertificate &qc, const Authenticator &auth) const {
+            return checkCertificate(qc, getQuorumSize(auth), [&](const FinalityVote &vote) {
+                return verifyVote(vote, auth);
+            });
+        }
+
+        // Like verifyCertificate, but against a recorded voter set instead of the current voters
+        inline bool verifyCertificate(const QuorumCertificate &qc, const VoterSet &voters) const {
+            return checkCertificate(qc, voters.quorum, [&](const FinalityVote &vote) {
+                auto it = voters.keys.find(vote.voter_id);
+                if (vote.chain_id != chain_id_ || it == voters.keys.end()) {
+                    std::cout << "Finality vote from " << vote.voter_id << ", who was not a voter" << std::endl;
+                    return false;
+                }
+                return !vote.signature.empty() && verify(it->second.get(), vote.payload(), vote.signature);
+            });
+        }
+
+        // Snapshot of the current voters and quorum size
+        inline VoterSet recordVoters(const Authenticator &auth) const {
+            refresh(auth);
+            VoterSet set;
+            for (const auto &voter : voters_) {
+                set.public_keys[voter] = auth.getParticipantMetadata(voter, ProofOfAuthority::PUBLIC_KEY_METADATA);
+            }
+            set.keys = keys_;
+            set.quorum = getQuorumSize(auth);
+            return set;
+        }
+
+        // Voter set from persisted keys
+        inline static VoterSet loadVoters(std::map<std::string, std::string> public_keys, size_t quorum) {
+            VoterSet set;
+            for (const auto &[voter, pem] : public_keys) {
+                set.keys[voter] = std::shared_ptr<EVP_PKEY>(loadPublicKeyFromPEM(pem));
+            }
+            set.public_keys = std::move(public_keys);
+            set.quorum = quorum;
+            return set;
+        }
+
+        // Collect a vote. Returns the certificate the first time its block reaches a quorum in that phase; the
+        // quorum can shrink when voters are revoked, so later votes for a certified block return nothing.
+        // Invalid votes and a voter's second vote at the same height and phase are dropped.
+        inline std::optional<QuorumCertificate> addVote(const FinalityVote &vote, const Authenticator &auth) {
+            if (vote.height <= pruned_height_ || !verifyVote(vote, auth)) {
+                return std::nullopt;
+            }
+            auto &cast = voted_[{vote.height, vote.phase}];
+            auto previous = cast.find(vote.voter_id);
+            if (previous != cast.end()) {
+                if (previous->second != vote.block_hash) {
+                    std::cout << "Voter " << vote.voter_id << " equivocated at height " << vote.height << std::endl;
+                }
+                return std::nullopt;
+            }
+            cast[vote.voter_id] = vote.block_hash;
+
+            std::string key = phaseKey(vote.phase, vote.block_hash);
+            auto &pending = pending_[key];
+            pending.chain_id = chain_id_;
+            pending.phase = vote.phase;
+            pending.height = vote.height;
+            pending.block_hash = vote.block_hash;
+            pending.votes.push_back(vote);
+            if (pending.votes.size() < getQuorumSize(auth) || !certified_.insert(key).second) {
+                return std::nullopt;
+            }
+            certificates_[key] = pending;
+            return pending;
+        }
+
+        // Certificate formed (or imported) for `block_hash`, if any
+        inline const QuorumCertificate *getCertificate(VotePhase phase, const std::string &block_hash) const {
+            auto it = certificates_.find(phaseKey(phase, block_hash));
+            return it != certificates_.end() ? &it->second : nullptr;
+        }
+
+        inline void addCertificate(const QuorumCertificate &qc) {
+            certificates_[phaseKey(qc.phase, qc.block_hash)] = qc;
+        }
+
+        // Forget votes and certificates at or below a finalized height
+        inline void prune(int64_t height) {
+            pruned_height_ = std::max(pruned_height_, height);
+            voted_.erase(voted_.begin(), voted_.lower_bound({height + 1, VotePhase::Prepare}));
+            for (auto *map : {&pending_, &certificates_}) {
+                for (auto it = map->begin(); it != map->end();) {
+                    if (it->second.height <= height) {
+                        certified_.erase(it->first);
+                        it = map->erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+        }
+
+      private:
+        // Who voted for what, per (height, phase), to catch equivocation; ordered so pruning is a range erase
+        std::map<std::pair<int64_t, VotePhase>, std::unordered_map<std::string, std::string>> voted_;
+        std::unordered_map<std::string, QuorumCertificate> pending_;
+        std::unordered_map<std::string, QuorumCertificate> certificates_;
+        std::unordered_set<std::string> certified_; // Phase keys addVote already returned a certificate for
+        int64_t pruned_height_ = -1;
+        std::string chain_id_;
+
+        mutable const Authenticator *cached_auth_ = nullptr;
+        mutable uint64_t cached_revision_ = 0;
+        mutable std::vector<std::string> voters_;
+        mutable std::unordered_map<std::string, std::shared_ptr<EVP_PKEY>> keys_;
+
+        template <typename Verify>
+        inline static bool checkCertificate(const QuorumCertificate &qc, size_t quorum, Verify &&verify_vote) {
+            std::vector<std::string> seen;
+            for (const auto &vote : qc.votes) {
+                if (vote.chain_id != qc.chain_id || vote.phase != qc.phase || vote.height != qc.height ||
+                    vote.block_hash != qc.block_hash) {
+                    return false;
+                }
+                if (std::find(seen.begin(), seen.end(), vote.voter_id) != seen.end() || !verify_vote(vote)) {
+                    return false;
+                }
+                seen.push_back(vote.voter_id);
+            }
+            return seen.size() >= quorum;
+        }
+
+        inline static std::string phaseKey(VotePhase phase, const std::string &block_hash) {
+            return (phase == VotePhase::Prepare ? "p:" : "c:") + block_hash;
+        }
+
+        inline void refresh(const Authenticator &auth) const {
+            if (cached_auth_ == &auth && cached_revision_ == auth.getRevision()) {
+                return;
+            }
+            voters_.clear();
+            keys_.clear();
+            for (const auto &participant : auth.getAuthorizedParticipants()) {
+                if (!auth.hasCapability(participant, VOTER_CAPABILITY)) {
+                    continue;
+                }
+                std::string pem = auth.getParticipantMetadata(participant, ProofOfAuthority::PUBLIC_KEY_METADATA);
+                if (pem.empty()) {
+                    continue;
+                }
+                keys_[participant] = std::shared_ptr<EVP_PKEY>(loadPublicKeyFromPEM(pem));
+                voters_.push_back(participant);
+            }
+            std::sort(voters_.begin(), voters_.end());
+            cached_auth_ = &auth;
+            cached_revision_ = auth.getRevision();
+        }
+    };
+
+} // namespace chain
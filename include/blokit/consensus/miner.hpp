@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../structure/block.hpp"
+#include "../structure/sha256.hpp"
+#include "../structure/target.hpp"
+
+namespace chain {
+
+    // Outcome of a proof-of-work search
+    struct MiningResult {
+        bool found = false;
+        int64_t nonce = 0;
+        std::string hash;
+        uint64_t hashes = 0;  // Total hashes computed across all threads
+        double seconds = 0.0; // Wall clock time spent searching
+
+        inline double hashRate() const { return seconds > 0.0 ? static_cast<double>(hashes) / seconds : 0.0; }
+    };
+
+    // Multi-threaded proof-of-work miner. Each thread searches a disjoint slice of the nonce space and
+    // all threads stop as soon as one of them finds a valid nonce or cancel() is called.
+    //
+    // cancel() advances a job generation rather than setting a flag the next search would clear. A caller that
+    // schedules a search captures currentJob() when it submits the template and passes it to mine(); a cancel()
+    // issued in between, e.g. for a competing block that arrived before mining started, then still applies.
+    template <typename T> class Miner {
+      public:
+        // Nonces are serialized as 32-bit values, so the search never leaves that range
+        static constexpr uint64_t MAX_NONCE = std::numeric_limits<uint32_t>::max();
+
+        // Nonces hashed together per compression call
+        static constexpr size_t LANES = 4;
+
+        inline explicit Miner(size_t threads = std::thread::hardware_concurrency())
+            : threads_(threads == 0 ? 1 : threads) {}
+
+        Miner(const Miner &) = delete;
+        Miner &operator=(const Miner &) = delete;
+
+        // Search for a nonce whose block hash has `difficulty` leading zero hex digits.
+        // On success the block's nonce_ and hash_ are updated in place.
+        inline MiningResult mine(Block<T> &block, uint32_t difficulty, uint64_t max_nonce = MAX_NONCE) {
+            return mine(block, Target::fromLeadingZeroDigits(difficulty), max_nonce);
+        }
+
+        // Search for a nonce whose block hash is at or below `target`, as a job submitted now
+        inline MiningResult mine(Block<T> &block, const Target &target, uint64_t max_nonce = MAX_NONCE) {
+            return mine(block, target, max_nonce, currentJob());
+        }
+
+        // Search as part of `job`, a currentJob() value captured when the template was submitted. Returns at once,
+        // with nothing found, if cancel() was called since.
+        inline MiningResult mine(Block<T> &block, const Target &target, uint64_t max_nonce, uint64_t job) {
+            static_assert(Block<T>::NONCE_OFFSET + 4 == Block<T>::HEADER_SIZE, "nonce must end the header");
+            static_assert(Block<T>::HEADER_SIZE % Sha256::BLOCK_SIZE <= 55, "header tail must fit one block");
+
+            mining_.store(true);
+
+            // Everything except the nonce is fixed for the whole search: hash the leading 64-byte blocks once
+            // and keep the big-endian words of the final padded block as a template
+            const auto header = block.headerBytes();
+            constexpr size_t midstate_bytes = Block<T>::HEADER_SIZE / Sha256::BLOCK_SIZE * Sha256::BLOCK_SIZE;
+            Sha256::State midstate = Sha256::INITIAL_STATE;
+            for (size_t offset = 0; offset < midstate_bytes; offset += Sha256::BLOCK_SIZE) {
+                Sha256::compress(midstate, header.data() + offset);
+            }
+            uint8_t tail[Sha256::BLOCK_SIZE] = {};
+            std::copy(header.begin() + midstate_bytes, header.end(), tail);
+            tail[Block<T>::HEADER_SIZE - midstate_bytes] = 0x80;
+            uint64_t bit_length = Block<T>::HEADER_SIZE * 8;
+            for (int i = 0; i < 8; i++) {
+                tail[56 + i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+            }
+            constexpr size_t nonce_word = (Block<T>::NONCE_OFFSET - midstate_bytes) / 4;
+            static_assert((Block<T>::NONCE_OFFSET - midstate_bytes) % 4 == 0, "nonce must be word aligned");
+
+            max_nonce = std::min(max_nonce, MAX_NONCE);
+
+            std::atomic<bool> found{false};
+            std::atomic<uint64_t> total_hashes{0};
+            std::mutex result_mutex;
+            MiningResult result;
+
+            auto start = steady_clock::now();
+            uint64_t span = (max_nonce / threads_) + 1;
+
+            auto worker = [&](uint64_t first, uint64_t last) {
+                uint32_t words[16][LANES];
+                for (size_t i = 0; i < 16; i++) {
+                    for (size_t l = 0; l < LANES; l++) {
+                        words[i][l] = Sha256::loadBigEndian(tail + i * 4);
+                    }
+                }
+                uint32_t out[8][LANES];
+                uint64_t hashes = 0;
+
+                for (uint64_t base = first; base <= last; base += LANES) {
+                    if (found.load(std::memory_order_relaxed) || generation_.load(std::memory_order_relaxed) != job) {
+                        break;
+                    }
+
+                    // The nonce is stored little-endian in the header, so its SHA-256 word is byte-swapped
+                    for (size_t l = 0; l < LANES; l++) {
+                        words[nonce_word][l] = byteswap32(static_cast<uint32_t>(base + l));
+                    }
+                    Sha256::compressLanes<LANES>(midstate, words, out);
+
+                    for (size_t l = 0; l < LANES && base + l <= last; l++) {
+                        hashes++;
+                        uint32_t lane[8];
+                        for (size_t i = 0; i < 8; i++) {
+                            lane[i] = out[i][l];
+                        }
+                        if (!target.isMetBy(lane)) {
+                            continue;
+                        }
+
+                        std::lock_guard<std::mutex> lock(result_mutex);
+                        if (!found.exchange(true)) {
+                            result.found = true;
+                            result.nonce = static_cast<int64_t>(base + l);
+                        }
+                        break;
+                    }
+                    if (base > last - LANES) {
+                        break; // Avoid wrapping around at the top of the nonce space
+                    }
+                }
+                total_hashes.fetch_add(hashes);
+            };
+
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < threads_; i++) {
+                uint64_t first = i * span;
+                if (first > max_nonce) {
+                    break;
+                }
+                uint64_t last = std::min(max_nonce, first + span - 1);
+                workers.emplace_back(worker, first, last);
+            }
+            for (auto &w : workers) {
+                w.join();
+            }
+
+            result.hashes = total_hashes.load();
+            result.seconds = duration<double>(steady_clock::now() - start).count();
+            last_hash_rate_.store(result.hashRate());
+            mining_.store(false);
+
+            if (result.found) {
+                block.nonce_ = result.nonce;
+                block.hash_ = block.calculateHash();
+                result.hash = block.hash_;
+            }
+            return result;
+        }
+
+        // Abort the in-progress search and every job submitted before this call, e.g. when a competing block for
+        // the same height arrives
+        inline void cancel() { generation_.fetch_add(1); }
+
+        // Generation to capture when submitting a template; see mine(block, target, max_nonce, job)
+        inline uint64_t currentJob() const { return generation_.load(); }
+
+        inline bool isMining() const { return mining_.load(); }
+
+        inline size_t getThreadCount() const { return threads_; }
+
+        // Hash rate of the most recent search in hashes per second
+        inline double getLastHashRate() const { return last_hash_rate_.load(); }
+
+      private:
+        static inline uint32_t byteswap32(uint32_t v) {
+            return (v >> 24) | ((v >> 8) & 0x0000FF00) | ((v << 8) & 0x00FF0000) | (v << 24);
+        }
+
+        size_t threads_;
+        std::atomic<uint64_t> generation_{0}; // Bumped by cancel()
+        std::atomic<bool> mining_{false};
+        std::atomic<double> last_hash_rate_{0.0};
+    };
+
+} // namespace chain
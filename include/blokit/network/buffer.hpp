@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace chain {
+
+    // A view into refcounted bytes. Received frames, relayed payloads and queued outbound frames share buffers
+    // through it instead of copying them; the bytes live as long as any view does.
+    struct SharedBytes {
+        std::shared_ptr<const std::vector<uint8_t>> owner;
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+
+        inline std::span<const uint8_t> span() const { return {data, size}; }
+        inline bool empty() const { return size == 0; }
+
+        inline static SharedBytes from(std::vector<uint8_t> bytes) {
+            auto owner = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+            return SharedBytes{owner, owner->data(), owner->size()};
+        }
+    };
+
+    // Recycles receive buffers: a buffer goes back to the pool when its last reference (the decoder filling it or
+    // a frame decoded from it) is released, so a busy connection stops allocating once the pool is warm. Not
+    // thread-safe; one pool serves one event loop.
+    class BufferPool {
+      public:
+        using Buffer = std::shared_ptr<std::vector<uint8_t>>;
+
+        inline explicit BufferPool(size_t max_free = 64) : state_(std::make_shared<State>()) {
+            state_->max_free = max_free;
+        }
+
+        // A buffer of at least `size` bytes (its size(), not just its capacity)
+        inline Buffer acquire(size_t size) {
+            std::vector<uint8_t> *buffer;
+            if (!state_->free.empty()) {
+                buffer = state_->free.back().release();
+                state_->free.pop_back();
+            } else {
+                buffer = new std::vector<uint8_t>();
+                state_->allocations++;
+            }
+            if (buffer->size() < size) {
+                buffer->resize(size);
+            }
+            std::weak_ptr<State> pool = state_;
+            return Buffer(buffer, [pool](std::vector<uint8_t> *released) {
+                auto state = pool.lock();
+                if (state && state->free.size() < state->max_free) {
+                    state->free.emplace_back(released);
+                } else {
+                    delete released;
+                }
+            });
+        }
+
+        inline size_t getFreeCount() const { return state_->free.size(); }
+        inline uint64_t getAllocations() const { return state_->allocations; }
+
+      private:
+        struct State {
+            std::vector<std::unique_ptr<std::vector<uint8_t>>> free;
+            size_t max_free = 0;
+            uint64_t allocations = 0;
+        };
+
+        std::shared_ptr<State> state_; // Shared with outstanding buffers, which may outlive the pool
+    };
+
+} // namespace chain
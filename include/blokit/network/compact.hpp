@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../structure/block.hpp"
+#include "../structure/mempool.hpp"
+#include "../structure/serializer.hpp"
+#include "../structure/sha256.hpp"
+#include "../structure/siphash.hpp"
+
+namespace chain {
+
+    // A block announced as its header plus a 6-byte short id per transaction. Receivers fill the body from their
+    // own mempool, so a block whose transactions were already gossiped costs a few bytes per transaction instead of
+    // the transactions themselves. Transactions the sender expects peers to lack travel in full ("prefilled").
+    template <typename T> struct CompactBlock {
+        static constexpr size_t SHORT_ID_BYTES = 6;
+        static constexpr uint64_t SHORT_ID_MASK = (uint64_t{1} << (8 * SHORT_ID_BYTES)) - 1;
+
+        Block<T> header;                                            // The block without its transactions
+        uint64_t salt = 0;                                          // Chosen by the sender, mixed into the keys
+        std::vector<uint64_t> short_ids;                            // Non-prefilled transactions, in block order
+        std::vector<std::pair<uint32_t, Transaction<T>>> prefilled; // (index in block, transaction), ascending
+
+        // Transactions for which `prefill` returns true are sent in full
+        inline static CompactBlock
+        fromBlock(const Block<T> &block, uint64_t salt,
+                  const std::function<bool(const Transaction<T> &)> &prefill = nullptr) {
+            CompactBlock compact;
+            compact.header = block;
+            compact.header.transactions_.clear();
+            compact.salt = salt;
+            auto [k0, k1] = compact.keys();
+            for (size_t i = 0; i < block.transactions_.size(); i++) {
+                const auto &tx = block.transactions_[i];
+                if (prefill && prefill(tx)) {
+                    compact.prefilled.emplace_back(static_cast<uint32_t>(i), tx);
+                } else {
+                    compact.short_ids.push_back(SipHash::hash(k0, k1, tx.uuid_) & SHORT_ID_MASK);
+                }
+            }
+            return compact;
+        }
+
+        inline size_t transactionCount() const { return short_ids.size() + prefilled.size(); }
+
+        // SipHash keys are the first 16 bytes of SHA-256(block hash || salt), so ids differ from block to block
+        inline std::pair<uint64_t, uint64_t> keys() const {
+            std::string material = header.hash_;
+            for (int i = 0; i < 8; i++) {
+                material.push_back(static_cast<char>((salt >> (8 * i)) & 0xff));
+            }
+            auto digest = Sha256::hash(material);
+            uint64_t k0 = 0;
+            uint64_t k1 = 0;
+            for (int i = 0; i < 8; i++) {
+                k0 |= static_cast<uint64_t>(digest[i]) << (8 * i);
+                k1 |= static_cast<uint64_t>(digest[8 + i]) << (8 * i);
+            }
+            return {k0, k1};
+        }
+
+        inline uint64_t shortId(const std::string &tx_id) const {
+            auto [k0, k1] = keys();
+            return SipHash::hash(k0, k1, tx_id) & SHORT_ID_MASK;
+        }
+
+        inline std::vector<uint8_t> serializeBinary() const {
+            std::vector<uint8_t> buffer;
+            BinarySerializer::writeBytes(buffer, header.serializeBinary());
+            BinarySerializer::writeUint64(buffer, salt);
+            BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(short_ids.size()));
+            for (uint64_t id : short_ids) {
+                for (size_t i = 0; i < SHORT_ID_BYTES; i++) {
+                    buffer.push_back(static_cast<uint8_t>((id >> (8 * i)) & 0xff));
+                }
+            }
+            BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(prefilled.size()));
+            for (const auto &[index, tx] : prefilled) {
+                BinarySerializer::writeUint32(buffer, index);
+                BinarySerializer::writeBytes(buffer, tx.serializeBinary());
+            }
+            return buffer;
+        }
+
+        inline static CompactBlock deserializeBinary(std::span<const uint8_t> data) {
+            CompactBlock compact;
+            BinaryReader reader(data);
+            compact.header = Block<T>::deserializeBinary(reader.readSpan());
+            compact.salt = reader.readUint64();
+
+            uint32_t id_count = reader.readUint32();
+            if (id_count > reader.remaining() / SHORT_ID_BYTES) {
+                throw std::runtime_error("Compact block short ids exceed payload");
+            }
+            compact.short_ids.reserve(id_count);
+            for (uint32_t n = 0; n < id_count; n++) {
+                uint64_t id = 0;
+                for (size_t i = 0; i < SHORT_ID_BYTES; i++) {
+                    id |= static_cast<uint64_t>(reader.readUint8()) << (8 * i);
+                }
+                compact.short_ids.push_back(id);
+            }
+
+            uint32_t prefilled_count = reader.readUint32();
+            uint32_t previous = 0;
+            for (uint32_t n = 0; n < prefilled_count; n++) {
+                uint32_t index = reader.readUint32();
+                if ((n > 0 && index <= previous) || index >= id_count + prefilled_count) {
+                    throw std::runtime_error("Compact block prefilled index out of order");
+                }
+                previous = index;
+                compact.prefilled.emplace_back(index, Transaction<T>::deserializeBinary(reader.readSpan()));
+            }
+            return compact;
+        }
+
+        inline static CompactBlock deserializeBinary(const std::vector<uint8_t> &data) {
+            return deserializeBinary(std::span<const uint8_t>(data));
+        }
+    };
+
+    // A compact block being filled in. Short ids that match nothing in the mempool, or more than one pooled
+    // transaction, are reported as missing; the receiver asks the sender for exactly those.
+    template <typename T> class PartialBlock {
+      public:
+        inline PartialBlock(const CompactBlock<T> &compact, const Mempool<T> &pool) : header_(compact.header) {
+            slots_.resize(compact.transactionCount());
+            std::vector<bool> prefilled(slots_.size(), false);
+            for (const auto &[index, tx] : compact.prefilled) {
+                slots_[index] = tx;
+                prefilled[index] = true;
+            }
+
+            // Index the pool by short id under this block's keys; a shared id is ambiguous and resolves to nothing
+            auto [k0, k1] = compact.keys();
+            std::unordered_map<uint64_t, const Transaction<T> *> by_id;
+            by_id.reserve(pool.size());
+            for (const auto &tx : pool) {
+                uint64_t id = SipHash::hash(k0, k1, tx.uuid_) & CompactBlock<T>::SHORT_ID_MASK;
+                auto [it, inserted] = by_id.emplace(id, &tx);
+                if (!inserted) {
+                    it->second = nullptr;
+                }
+            }
+
+            size_t next_id = 0;
+            for (size_t i = 0; i < slots_.size(); i++) {
+                if (prefilled[i]) {
+                    continue;
+                }
+                auto it = by_id.find(compact.short_ids[next_id++]);
+                if (it != by_id.end() && it->second != nullptr) {
+                    slots_[i] = *it->second;
+                } else {
+                    missing_.push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+
+        inline const Block<T> &getHeader() const { return header_; }
+        inline const std::vector<uint32_t> &getMissing() const { return missing_; }
+        inline bool isComplete() const { return missing_.empty(); }
+
+        // Supply the missing transactions, in the order getMissing() lists them
+        inline bool fill(const std::vector<Transaction<T>> &transactions) {
+            if (transactions.size() != missing_.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < missing_.size(); i++) {
+                slots_[missing_[i]] = transactions[i];
+            }
+            missing_.clear();
+            return true;
+        }
+
+        // The full block, or nullopt if it is incomplete or the body does not match the header's Merkle root (a
+        // short id matched the wrong transaction); the caller should then fetch the block in full
+        inline std::optional<Block<T>> build() const {
+            if (!isComplete()) {
+                return std::nullopt;
+            }
+            Block<T> block = header_;
+            block.transactions_.reserve(slots_.size());
+            for (const auto &slot : slots_) {
+                block.transactions_.push_back(*slot);
+            }
+            std::string header_root = block.merkle_root_;
+            block.buildMerkleTree();
+            if (block.merkle_root_ != header_root) {
+                return std::nullopt;
+            }
+            return block;
+        }
+
+      private:
+        Block<T> header_;
+        std::vector<std::optional<Transaction<T>>> slots_;
+        std::vector<uint32_t> missing_;
+    };
+
+} // namespace chain
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace chain {
+
+    // Single-threaded readiness loop over epoll. One loop serves any number of sockets, so thousands of peers cost
+    // one thread and one epoll set rather than a thread per connection. Only stop() may be called from another
+    // thread.
+    class EventLoop {
+      public:
+        using Handler = std::function<void(uint32_t events)>;
+
+        inline EventLoop() : events_(MAX_EVENTS) {
+            epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd_ < 0) {
+                throw std::runtime_error("epoll_create1 failed: " + std::string(std::strerror(errno)));
+            }
+            wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd_ < 0) {
+                close(epoll_fd_);
+                throw std::runtime_error("eventfd failed: " + std::string(std::strerror(errno)));
+            }
+            add(wake_fd_, EPOLLIN, [this](uint32_t) {
+                uint64_t count;
+                while (read(wake_fd_, &count, sizeof(count)) > 0) {
+                }
+            });
+        }
+
+        inline ~EventLoop() {
+            close(wake_fd_);
+            close(epoll_fd_);
+        }
+
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        // Watch `fd` for `events` (EPOLLIN, EPOLLOUT, ...). The loop does not own the descriptor.
+        inline void add(int fd, uint32_t events, Handler handler) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                throw std::runtime_error("epoll_ctl add failed: " + std::string(std::strerror(errno)));
+            }
+            handlers_[fd] = std::make_shared<Handler>(std::move(handler));
+        }
+
+        inline void modify(int fd, uint32_t events) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+
+        // Stop watching `fd`; safe from inside a handler, including the fd's own
+        inline void remove(int fd) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            handlers_.erase(fd);
+        }
+
+        // Wait up to `timeout_ms` (-1 forever) and dispatch whatever is ready; returns the number of events
+        inline size_t poll(int timeout_ms) {
+            int ready = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    return 0;
+                }
+                throw std::runtime_error("epoll_wait failed: " + std::string(std::strerror(errno)));
+            }
+            for (int i = 0; i < ready; i++) {
+                // Look the handler up per event: an earlier handler in this batch may have removed it
+                auto it = handlers_.find(events_[i].data.fd);
+                if (it != handlers_.end()) {
+                    auto handler = it->second; // Keep it alive while it runs, even if it removes itself
+                    (*handler)(events_[i].events);
+                }
+            }
+            return static_cast<size_t>(ready);
+        }
+
+        // Dispatch until stop() is called
+        inline void run() {
+            running_ = true;
+            while (running_) {
+                poll(-1);
+            }
+        }
+
+        inline void stop() {
+            running_ = false;
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = write(wake_fd_, &one, sizeof(one));
+        }
+
+        // Dispatch until `done()` holds or `timeout_ms` passes; returns done()
+        template <typename Predicate> inline bool runUntil(Predicate done, int timeout_ms) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (!done()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                                  std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    return done();
+                }
+                poll(static_cast<int>(std::min<int64_t>(left.count(), 10)));
+            }
+            return true;
+        }
+
+        // Descriptors being watched, the loop's own wake-up descriptor excluded
+        inline size_t getWatchedCount() const { return handlers_.size() - 1; }
+
+      private:
+        static constexpr size_t MAX_EVENTS = 1024;
+
+        int epoll_fd_ = -1;
+        int wake_fd_ = -1;
+        std::atomic<bool> running_{false};
+        std::vector<epoll_event> events_;
+        std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+    };
+
+} // namespace chain
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../structure/serializer.hpp"
+#include "buffer.hpp"
+
+namespace chain {
+
+    enum class FrameType : uint8_t {
+        Hello = 1,                // Sender's node id, first frame on every connection
+        Block = 2,                // One binary block
+        Transaction = 3,          // One binary transaction
+        GetChain = 4,             // Ask for a page of the receiver's canonical chain from a height
+        Chain = 5,                // Block count followed by that many binary blocks
+        CompactBlock = 6,         // A CompactBlock: header, short transaction ids and prefilled transactions
+        GetBlockTransactions = 7, // Block hash and the indexes of the transactions the sender could not fill
+        BlockTransactions = 8,    // Block hash and the requested transactions, in the requested order
+        GetHeaders = 9,           // Locator hashes; asks for the canonical headers after the first one known
+        Headers = 10,             // Header count followed by that many binary blocks without transactions
+        GetBodies = 11,           // Count followed by that many block hashes
+        Bodies = 12,              // Per requested hash: the hash and its transactions, or no body if unknown
+        Inventory = 13,           // Count followed by that many 64-bit transaction digests
+        GetTransactions = 14,     // Count followed by the digests of announced transactions to send in full
+        Transactions = 15,        // Count followed by that many binary transactions
+    };
+
+    // A decoded frame. The payload points into the receive buffer it arrived in, which stays alive (and out of the
+    // buffer pool) for as long as the frame or anything sharing its payload does.
+    struct Frame {
+        FrameType type;
+        SharedBytes payload;
+    };
+
+    // Wire format: a BinaryHeader whose length and CRC-32 cover the type byte and the payload, then the type byte,
+    // then the payload
+    class FrameCodec {
+      public:
+        static constexpr size_t HEADER_SIZE = 14;
+        static constexpr size_t PREFIX_SIZE = HEADER_SIZE + 1; // Header and type byte
+        static constexpr uint32_t DEFAULT_MAX_FRAME_SIZE = 32 * 1024 * 1024;
+
+        // Everything that precedes the payload on the wire
+        inline static std::array<uint8_t, PREFIX_SIZE> prefix(FrameType type, std::span<const uint8_t> payload) {
+            uint8_t type_byte = static_cast<uint8_t>(type);
+            uint32_t crc = BinarySerializer::updateCRC32(BinarySerializer::CRC32_INIT, {&type_byte, 1});
+            crc = BinarySerializer::updateCRC32(crc, payload);
+
+            BinaryHeader header;
+            header.data_length = static_cast<uint32_t>(payload.size() + 1);
+            header.checksum = ~crc;
+            std::vector<uint8_t> encoded;
+            encoded.reserve(PREFIX_SIZE);
+            header.serialize(encoded);
+            encoded.push_back(type_byte);
+
+            std::array<uint8_t, PREFIX_SIZE> result{};
+            std::copy(encoded.begin(), encoded.end(), result.begin());
+            return result;
+        }
+
+        inline static std::vector<uint8_t> encode(FrameType type, std::span<const uint8_t> payload) {
+            auto head = prefix(type, payload);
+            std::vector<uint8_t> frame(head.begin(), head.end());
+            frame.insert(frame.end(), payload.begin(), payload.end());
+            return frame;
+        }
+    };
+
+    // One encoded frame ready for writev: the prefix is owned and the payload shared, so a frame sent to many peers
+    // is built once and queued to each of them by reference
+    struct OutboundFrame {
+        std::array<uint8_t, FrameCodec::PREFIX_SIZE> prefix;
+        SharedBytes payload;
+
+        inline size_t size() const { return prefix.size() + payload.size; }
+
+        inline static std::shared_ptr<const OutboundFrame> make(FrameType type, SharedBytes payload) {
+            auto head = FrameCodec::prefix(type, payload.span());
+            return std::make_shared<const OutboundFrame>(OutboundFrame{head, std::move(payload)});
+        }
+    };
+
+    // Reassembles frames from a byte stream that arrives in arbitrary pieces. Bytes are received straight into a
+    // (pooled) buffer via prepare()/commit() and frames are handed out as views into it, so nothing is copied between
+    // the socket and the deserializer. Throws std::runtime_error on a bad magic number, version, checksum or
+    // oversized frame; the connection should then be dropped.
+    class FrameDecoder {
+      public:
+        static constexpr size_t BUFFER_SIZE = 64 * 1024; // Smallest receive buffer
+
+        inline explicit FrameDecoder(uint32_t max_frame_size = FrameCodec::DEFAULT_MAX_FRAME_SIZE,
+                                     std::shared_ptr<BufferPool> pool = nullptr)
+            : pool_(std::move(pool)), max_frame_size_(max_frame_size) {}
+
+        // Writable space for at least `min` more bytes; write into it, then commit() the number written
+        inline std::span<uint8_t> prepare(size_t min) {
+            size_t pending = end_ - begin_;
+            if (buffer_ && buffer_->size() - end_ < min) {
+                if (buffer_.use_count() == 1 && buffer_->size() >= pending + min) {
+                    std::memmove(buffer_->data(), buffer_->data() + begin_, pending);
+                } else {
+                    // Too small, or decoded frames still point into it: continue in a fresh buffer
+                    size_t size = std::max(pending + min, buffer_->size());
+                    if (pending + min > buffer_->size()) {
+                        size = std::max(size, 2 * buffer_->size());
+                    }
+                    auto next = allocate(size);
+                    std::memcpy(next->data(), buffer_->data() + begin_, pending);
+                    buffer_ = std::move(next);
+                }
+                begin_ = 0;
+                end_ = pending;
+            } else if (!buffer_) {
+                buffer_ = allocate(min);
+            }
+            return {buffer_->data() + end_, buffer_->size() - end_};
+        }
+
+        inline void commit(size_t size) { end_ += size; }
+
+        inline void feed(const uint8_t *data, size_t size) {
+            std::memcpy(prepare(size).data(), data, size);
+            commit(size);
+        }
+
+        // Next complete frame, if one has arrived
+        inline std::optional<Frame> next() {
+            size_t pending = end_ - begin_;
+            if (pending < FrameCodec::HEADER_SIZE) {
+                if (pending == 0) {
+                    buffer_.reset(); // Back to the pool until more arrives
+                    begin_ = end_ = 0;
+                }
+                return std::nullopt;
+            }
+            BinaryReader reader(std::span<const uint8_t>(buffer_->data() + begin_, pending));
+            BinaryHeader header = BinaryHeader::deserialize(reader);
+            if (header.data_length == 0 || header.data_length > max_frame_size_) {
+                throw std::runtime_error("Frame length out of range");
+            }
+            if (pending - FrameCodec::HEADER_SIZE < header.data_length) {
+                return std::nullopt;
+            }
+
+            const uint8_t *body = buffer_->data() + begin_ + FrameCodec::HEADER_SIZE;
+            if (BinarySerializer::calculateCRC32({body, header.data_length}) != header.checksum) {
+                throw std::runtime_error("Frame checksum mismatch");
+            }
+            begin_ += FrameCodec::HEADER_SIZE + header.data_length;
+            return Frame{static_cast<FrameType>(body[0]), SharedBytes{buffer_, body + 1, header.data_length - 1}};
+        }
+
+        inline size_t getBufferedBytes() const { return end_ - begin_; }
+
+        // Size of the largest frame accepted, header included
+        inline size_t getMaxFrameBytes() const { return FrameCodec::HEADER_SIZE + max_frame_size_; }
+
+      private:
+        std::shared_ptr<BufferPool> pool_;
+        BufferPool::Buffer buffer_;
+        size_t begin_ = 0; // First unconsumed byte
+        size_t end_ = 0;   // One past the last received byte
+        uint32_t max_frame_size_;
+
+        inline BufferPool::Buffer allocate(size_t size) {
+            size = std::max(size, BUFFER_SIZE);
+            return pool_ ? pool_->acquire(size) : std::make_shared<std::vector<uint8_t>>(size);
+        }
+    };
+
+} // namespace chain
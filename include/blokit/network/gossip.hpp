@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../structure/sha256.hpp"
+
+namespace chain {
+
+    // 64-bit inventory digest of a transaction id: the first 8 bytes of its SHA-256
+    inline uint64_t transactionDigest(std::string_view tx_id) {
+        auto hash = Sha256::hash(reinterpret_cast<const uint8_t *>(tx_id.data()), tx_id.size());
+        uint64_t digest = 0;
+        for (int i = 0; i < 8; i++) {
+            digest |= static_cast<uint64_t>(hash[i]) << (8 * i);
+        }
+        return digest;
+    }
+
+    // Set of recently seen digests holding at most `capacity` entries; the oldest is forgotten first. A forgotten
+    // digest only costs a redundant announcement or request, never a duplicate in the pool.
+    class SeenSet {
+      public:
+        inline explicit SeenSet(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+        // False if the digest was already present
+        inline bool insert(uint64_t digest) {
+            if (!set_.insert(digest).second) {
+                return false;
+            }
+            if (ring_.size() < capacity_) {
+                ring_.push_back(digest);
+            } else {
+                set_.erase(ring_[next_]);
+                ring_[next_] = digest;
+                next_ = (next_ + 1) % capacity_;
+            }
+            return true;
+        }
+
+        inline bool contains(uint64_t digest) const { return set_.count(digest) > 0; }
+        inline size_t size() const { return set_.size(); }
+        inline size_t capacity() const { return capacity_; }
+
+      private:
+        size_t capacity_;
+        std::vector<uint64_t> ring_; // Insertion order; next_ is the oldest once full
+        size_t next_ = 0;
+        std::unordered_set<uint64_t> set_;
+    };
+
+    // Refills at `rate` tokens per second up to `burst`
+    class TokenBucket {
+      public:
+        using Clock = std::chrono::steady_clock;
+
+        inline TokenBucket(double rate, double burst, Clock::time_point now = Clock::now())
+            : rate_(rate), burst_(burst), tokens_(burst), updated_(now) {}
+
+        // Take up to `wanted` whole tokens; returns how many were granted
+        inline size_t take(size_t wanted, Clock::time_point now) {
+            double elapsed = std::chrono::duration<double>(now - updated_).count();
+            if (elapsed > 0) {
+                tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+                updated_ = now;
+            }
+            size_t granted = std::min(wanted, static_cast<size_t>(tokens_));
+            tokens_ -= static_cast<double>(granted);
+            return granted;
+        }
+
+      private:
+        double rate_;
+        double burst_;
+        double tokens_;
+        Clock::time_point updated_;
+    };
+
+    // Announcements waiting for a peer's next inventory batch: highest priority first, oldest first within a
+    // priority. Past `capacity` the lowest-priority, newest announcement is dropped.
+    class InventoryQueue {
+      public:
+        inline explicit InventoryQueue(size_t capacity) : capacity_(capacity) {}
+
+        inline void push(uint64_t digest, int16_t priority) {
+            queue_.emplace(std::make_pair(-static_cast<int>(priority), sequence_++), digest);
+            if (queue_.size() > capacity_) {
+                queue_.erase(std::prev(queue_.end()));
+                dropped_++;
+            }
+        }
+
+        inline std::vector<uint64_t> pop(size_t max) {
+            std::vector<uint64_t> digests;
+            while (!queue_.empty() && digests.size() < max) {
+                digests.push_back(queue_.begin()->second);
+                queue_.erase(queue_.begin());
+            }
+            return digests;
+        }
+
+        inline size_t size() const { return queue_.size(); }
+        inline bool empty() const { return queue_.empty(); }
+        inline uint64_t getDropped() const { return dropped_; }
+
+      private:
+        size_t capacity_;
+        uint64_t sequence_ = 0;
+        uint64_t dropped_ = 0;
+        std::map<std::pair<int, uint64_t>, uint64_t> queue_; // (-priority, arrival) -> digest
+    };
+
+} // namespace chain
@@ -0,0 +1,1272 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../structure/chain.hpp"
+#include "../structure/mempool.hpp"
+#include "buffer.hpp"
+#include "compact.hpp"
+#include "event_loop.hpp"
+#include "frame.hpp"
+#include "gossip.hpp"
+#include "sync.hpp"
+#include "validator.hpp"
+
+namespace chain {
+
+    struct NodeStats {
+        uint64_t frames_sent = 0;
+        uint64_t frames_received = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_received = 0;
+        uint64_t peers_dropped = 0; // Connections closed for protocol or socket errors
+        uint64_t compact_blocks_received = 0;
+        uint64_t compact_blocks_reconstructed = 0; // Filled entirely from the mempool, no extra round trip
+        uint64_t transactions_requested = 0;       // Asked for because a compact block referenced them
+        uint64_t blocks_synced = 0;                // Connected through headers-first sync
+        uint64_t bodies_served = 0;                // Block bodies sent to syncing peers
+        uint64_t inventory_announced = 0;          // Transaction digests sent in inventory batches
+        uint64_t transactions_fetched = 0;         // Transactions requested after an announcement
+        uint64_t duplicate_transactions = 0;       // Transactions received in full that were already known
+        uint64_t chain_requests_refused = 0;       // GetChain requests over the peer's rate limit
+    };
+
+    // A chain replica speaking the framed peer protocol over non-blocking TCP or Unix stream sockets. All of its
+    // sockets live on a shared EventLoop, so many nodes and thousands of peers can run on one thread. Blocks are
+    // gossiped to every peer except the one they came from. Transactions are announced by digest in rate-limited,
+    // priority-ordered inventory batches and fetched by each node once, from the first peer to announce them, so a
+    // transaction body crosses each node once however many peers it has. A block with an unknown parent makes
+    // the node catch up headers-first: it downloads the sender's headers, then fetches bodies in parallel from
+    // every peer that has them. Blocks are relayed as compact blocks by default: peers rebuild them from their
+    // mempools and fetch only the transactions they lack.
+    template <typename T> class NetworkNode {
+      public:
+        static constexpr size_t DEFAULT_MAX_PEERS = 4096;
+
+        inline NetworkNode(EventLoop &loop, std::string id, Chain<T> chain, size_t max_peers = DEFAULT_MAX_PEERS)
+            : loop_(loop), id_(std::move(id)), chain_(std::move(chain)), max_peers_(max_peers) {
+            for (const auto &block : chain_.blocks_) {
+                known_blocks_.insert(block.hash_);
+            }
+        }
+
+        inline ~NetworkNode() { shutdown(); }
+
+        // Sockets are registered with the loop under this node's address
+        NetworkNode(const NetworkNode &) = delete;
+        NetworkNode &operator=(const NetworkNode &) = delete;
+
+        // Accept peers on `host:port`; port 0 picks a free one. Returns the bound port.
+        inline uint16_t listenTcp(const std::string &host, uint16_t port = 0) {
+            addrinfo *address = resolve(host, port, AI_PASSIVE);
+            int fd = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (fd < 0 || bind(fd, address->ai_addr, address->ai_addrlen) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+                std::string error = std::strerror(errno);
+                freeaddrinfo(address);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                throw std::runtime_error("Failed to listen on " + host + ": " + error);
+            }
+            freeaddrinfo(address);
+
+            sockaddr_storage bound{};
+            socklen_t length = sizeof(bound);
+            getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &length);
+            uint16_t bound_port = bound.ss_family == AF_INET6
+                                      ? ntohs(reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port)
+                                      : ntohs(reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+            addListener(fd);
+            return bound_port;
+        }
+
+        // Accept peers on a Unix domain socket at `path`, replacing a stale socket file
+        inline void listenUnix(const std::string &path) {
+            sockaddr_un address = unixAddress(path);
+            unlink(path.c_str());
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+                ::listen(fd, SOMAXCONN) < 0) {
+                std::string error = std::strerror(errno);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                throw std::runtime_error("Failed to listen on " + path + ": " + error);
+            }
+            unix_paths_.push_back(path);
+            addListener(fd);
+        }
+
+        // Start connecting to a peer; the handshake completes inside the event loop
+        inline bool connectTcp(const std::string &host, uint16_t port) {
+            addrinfo *address = resolve(host, port, 0);
+            int fd = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            bool started =
+                fd >= 0 && (connect(fd, address->ai_addr, address->ai_addrlen) == 0 || errno == EINPROGRESS);
+            freeaddrinfo(address);
+            return started ? addPeer(fd, true) : failConnect(fd, host + ":" + std::to_string(port));
+        }
+
+        inline bool connectUnix(const std::string &path) {
+            sockaddr_un address = unixAddress(path);
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            bool started = fd >= 0 && (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 ||
+                                       errno == EINPROGRESS);
+            return started ? addPeer(fd, true) : failConnect(fd, path);
+        }
+
+        // Close every socket and remove Unix socket files
+        inline void shutdown() {
+            stopTimer(sync_timer_fd_);
+            stopTimer(inventory_timer_fd_);
+            for (int fd : listeners_) {
+                loop_.remove(fd);
+                close(fd);
+            }
+            listeners_.clear();
+            for (const auto &path : unix_paths_) {
+                unlink(path.c_str());
+            }
+            unix_paths_.clear();
+            for (auto &[fd, peer] : peers_) {
+                loop_.remove(fd);
+                close(fd);
+            }
+            peers_.clear();
+            sync_.clear();
+            header_peer_ = -1;
+        }
+
+        // Peers that completed the handshake
+        inline size_t getPeerCount() const {
+            size_t count = 0;
+            for (const auto &[fd, peer] : peers_) {
+                count += peer.id.empty() ? 0 : 1;
+            }
+            return count;
+        }
+
+        inline std::vector<std::string> getPeerIds() const {
+            std::vector<std::string> ids;
+            for (const auto &[fd, peer] : peers_) {
+                if (!peer.id.empty()) {
+                    ids.push_back(peer.id);
+                }
+            }
+            return ids;
+        }
+
+        // Accept a block produced locally (already linked to the tip) and gossip it
+        inline bool broadcastBlock(const Block<T> &block) {
+            known_blocks_.insert(block.hash_);
+            if (!chain_.acceptBlock(block)) {
+                return false;
+            }
+            prunePool();
+            relayBlock(block, -1);
+            return true;
+        }
+
+        // Add a transaction to the local pool and announce it
+        inline bool submitTransaction(const Transaction<T> &tx) {
+            uint64_t digest = transactionDigest(tx.uuid_);
+            if (!known_transactions_.insert(digest) || chain_.isTransactionUsed(tx.uuid_) || !pool_.add(tx)) {
+                return false;
+            }
+            pool_digests_[digest] = tx.uuid_;
+            announce(tx, digest, -1);
+            return true;
+        }
+
+        inline bool hasBlock(const std::string &hash) { return chain_.hasBlock(hash); }
+
+        inline bool hasTransaction(const std::string &tx_id) const {
+            return known_transactions_.contains(transactionDigest(tx_id)) || chain_.isTransactionUsed(tx_id);
+        }
+
+        inline Chain<T> &getChain() { return chain_; }
+        inline const Chain<T> &getChain() const { return chain_; }
+
+        // Gossiped transactions not yet in a block on this node's chain
+        inline const Mempool<T> &getPendingTransactions() const { return pool_; }
+
+        // Relay blocks as compact blocks (the default) or in full
+        inline void setCompactRelay(bool enabled) { compact_relay_ = enabled; }
+        inline bool isCompactRelay() const { return compact_relay_; }
+
+        inline const std::string &getId() const { return id_; }
+
+        inline const NodeStats &getStats() const { return stats_; }
+
+        // Limits and per-stage rejection counts for messages from peers
+        inline MessageValidator<T> &getValidator() { return validator_; }
+        inline const MessageValidator<T> &getValidator() const { return validator_; }
+
+        // True while headers or bodies are being downloaded
+        inline bool isSyncing() const { return header_peer_ >= 0 || sync_.isActive(); }
+
+      private:
+        struct Peer {
+            std::string id;          // Empty until its hello arrives
+            bool connecting = false; // Outbound connect still in progress
+            bool want_write = false; // Registered for EPOLLOUT
+            int64_t height = -1;     // Highest block it announced or sent headers for
+            SeenSet seen{PEER_SEEN_CAPACITY}; // Transactions it has or was told about
+            InventoryQueue announcements{ANNOUNCE_QUEUE};
+            TokenBucket announce_budget{ANNOUNCE_RATE, static_cast<double>(MAX_INVENTORY)};
+            TokenBucket chain_budget{CHAIN_REQUEST_RATE, CHAIN_REQUEST_BURST}; // GetChain pages it may ask for
+            std::deque<std::vector<uint64_t>> requested; // Outstanding GetTransactions, oldest first
+            FrameDecoder decoder;
+            std::deque<std::shared_ptr<const OutboundFrame>> outbox; // Shared with other peers' outboxes
+            size_t outbox_offset = 0;                                // Bytes of the front frame already written
+        };
+
+        // A compact block waiting for the transactions requested from `from`
+        struct PendingBlock {
+            int from;
+            PartialBlock<T> partial;
+        };
+
+        static constexpr size_t MIN_READ = 16 * 1024;    // Free receive buffer space asked for per recv
+        static constexpr size_t WRITE_BATCH = 64;        // Frames gathered into one sendmsg
+        static constexpr size_t BLOCK_CACHE = 64;        // Serialized blocks kept for relay and tip announcements
+        static constexpr long SYNC_TICK_NS = 250 * 1000 * 1000;
+        static constexpr uint32_t NO_BODY = 0xffffffff;
+        static constexpr long INVENTORY_TICK_NS = 5 * 1000 * 1000;
+        static constexpr size_t MAX_INVENTORY = 1000;            // Digests per inventory frame
+        static constexpr double ANNOUNCE_RATE = 20000.0;         // Digests per second per peer
+        static constexpr size_t ANNOUNCE_QUEUE = 50000;          // Announcements waiting per peer
+        static constexpr size_t PEER_SEEN_CAPACITY = 16384;      // Digests remembered as known to each peer
+        static constexpr size_t KNOWN_TRANSACTIONS = 1 << 20;    // Digests remembered by the node
+        static constexpr uint32_t CHAIN_PAGE_BLOCKS = 500;       // Blocks per GetChain reply
+        static constexpr size_t CHAIN_PAGE_BYTES = 4 * 1024 * 1024; // Serialized bytes per GetChain reply
+        static constexpr double CHAIN_REQUEST_RATE = 2.0;        // GetChain pages per second per peer
+        static constexpr double CHAIN_REQUEST_BURST = 4.0;
+
+        EventLoop &loop_;
+        std::string id_;
+        Chain<T> chain_;
+        size_t max_peers_;
+        std::vector<int> listeners_;
+        std::vector<std::string> unix_paths_;
+        std::unordered_map<int, Peer> peers_;
+        std::unordered_set<std::string> known_blocks_;
+        std::shared_ptr<BufferPool> buffers_ = std::make_shared<BufferPool>(); // Receive buffers of all peers
+        std::unordered_map<std::string, SharedBytes> block_cache_;
+        std::deque<std::string> block_cache_order_;
+        SeenSet known_transactions_{KNOWN_TRANSACTIONS};
+        Mempool<T> pool_;
+        std::unordered_map<uint64_t, std::string> pool_digests_; // Digest to id for every pooled transaction
+        std::unordered_map<uint64_t, int> fetching_;             // Digest to the peer it was requested from
+        std::unordered_map<std::string, PendingBlock> pending_blocks_;
+        bool compact_relay_ = true;
+        std::mt19937_64 salt_rng_{std::random_device{}()};
+        ChainSync<T> sync_{chain_};
+        int header_peer_ = -1; // Peer the header chain is being downloaded from
+        typename ChainSync<T>::Clock::time_point header_requested_{};
+        int sync_timer_fd_ = -1;      // Periodic stall checks, armed only while syncing
+        int inventory_timer_fd_ = -1; // Inventory batching, armed only while announcements are queued
+        MessageValidator<T> validator_;
+        NodeStats stats_;
+
+        inline static addrinfo *resolve(const std::string &host, uint16_t port, int flags) {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = flags;
+            addrinfo *result = nullptr;
+            int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+            if (status != 0 || result == nullptr) {
+                throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(status));
+            }
+            return result;
+        }
+
+        inline static sockaddr_un unixAddress(const std::string &path) {
+            sockaddr_un address{};
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error("Unix socket path too long: " + path);
+            }
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        inline bool failConnect(int fd, const std::string &target) {
+            std::cout << "Node " << id_ << " failed to connect to " << target << ": " << std::strerror(errno)
+                      << std::endl;
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+
+        inline void addListener(int fd) {
+            listeners_.push_back(fd);
+            loop_.add(fd, EPOLLIN, [this, fd](uint32_t) { acceptPeers(fd); });
+        }
+
+        inline void acceptPeers(int listener) {
+            while (true) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    return; // EAGAIN once the backlog is drained
+                }
+                if (peers_.size() >= max_peers_) {
+                    close(fd);
+                    continue;
+                }
+                addPeer(fd, false);
+            }
+        }
+
+        inline bool addPeer(int fd, bool connecting) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+            auto &peer = peers_[fd];
+            peer.decoder = FrameDecoder(validator_.getLimits().max_frame_size, buffers_);
+            peer.connecting = connecting;
+            peer.want_write = connecting; // Writability signals that the connect finished
+            uint32_t events = connecting ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            loop_.add(fd, events, [this, fd](uint32_t ready) { onReady(fd, ready); });
+
+            std::vector<uint8_t> hello;
+            BinarySerializer::writeString(hello, id_);
+            send(fd, FrameType::Hello, std::move(hello));
+            return true;
+        }
+
+        inline void dropPeer(int fd, const std::string &reason) {
+            auto it = peers_.find(fd);
+            if (it == peers_.end()) {
+                return;
+            }
+            if (!reason.empty()) {
+                stats_.peers_dropped++;
+                std::cout << "Node " << id_ << " dropped peer " << (it->second.id.empty() ? "?" : it->second.id)
+                          << ": " << reason << std::endl;
+            }
+            loop_.remove(fd);
+            close(fd);
+            peers_.erase(it);
+            sync_.removePeer(fd);
+            for (auto fetching = fetching_.begin(); fetching != fetching_.end();) {
+                fetching = fetching->second == fd ? fetching_.erase(fetching) : std::next(fetching);
+            }
+            if (header_peer_ == fd) {
+                header_peer_ = -1;
+                resumeHeaders();
+            }
+            // Its missing transactions will never arrive; let another peer deliver those blocks
+            for (auto pending = pending_blocks_.begin(); pending != pending_blocks_.end();) {
+                if (pending->second.from == fd) {
+                    known_blocks_.erase(pending->first);
+                    pending = pending_blocks_.erase(pending);
+                } else {
+                    ++pending;
+                }
+            }
+        }
+
+        inline void onReady(int fd, uint32_t events) {
+            auto it = peers_.find(fd);
+            if (it == peers_.end()) {
+                return;
+            }
+            Peer &peer = it->second;
+            if (peer.connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0) {
+                    dropPeer(fd, std::string("connect failed: ") + std::strerror(error));
+                    return;
+                }
+                peer.connecting = false;
+            }
+            if ((events & EPOLLIN) && !receive(fd)) {
+                return;
+            }
+            if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN)) {
+                dropPeer(fd, "");
+                return;
+            }
+            if (events & EPOLLOUT) {
+                flush(fd);
+            }
+        }
+
+        // Read what is available, up to a largest frame's worth, straight into the peer's decoder and handle each
+        // complete frame in place; false if the peer was dropped
+        inline bool receive(int fd) {
+            FrameDecoder &decoder = peers_[fd].decoder;
+            while (true) {
+                auto space = decoder.prepare(MIN_READ);
+                ssize_t n = recv(fd, space.data(), space.size(), 0);
+                if (n == 0) {
+                    dropPeer(fd, ""); // Orderly close
+                    return false;
+                }
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    dropPeer(fd, std::strerror(errno));
+                    return false;
+                }
+                stats_.bytes_received += static_cast<uint64_t>(n);
+                decoder.commit(static_cast<size_t>(n));
+                // Decode before reading on once a largest frame's worth is buffered, so a peer sending faster than
+                // we decode cannot grow the buffer without bound. The socket stays readable and is polled again.
+                if (decoder.getBufferedBytes() >= decoder.getMaxFrameBytes()) {
+                    break;
+                }
+            }
+
+            try {
+                while (true) {
+                    auto it = peers_.find(fd);
+                    if (it == peers_.end()) {
+                        return false;
+                    }
+                    std::optional<Frame> frame;
+                    try {
+                        frame = it->second.decoder.next();
+                    } catch (const std::exception &e) {
+                        validator_.reject(ValidationStage::Framing);
+                        dropPeer(fd, e.what());
+                        return false;
+                    }
+                    if (!frame) {
+                        return true;
+                    }
+                    stats_.frames_received++;
+                    if (!validator_.checkStructure(frame->type, frame->payload.span())) {
+                        dropPeer(fd, "malformed frame");
+                        return false;
+                    }
+                    if (!handleFrame(fd, *frame)) {
+                        return false;
+                    }
+                }
+            } catch (const std::exception &e) {
+                validator_.reject(ValidationStage::Structure); // A payload of T that failed to deserialize
+                dropPeer(fd, e.what());
+                return false;
+            }
+        }
+
+        // False if the frame was a protocol violation and the peer was dropped
+        inline bool handleFrame(int fd, const Frame &frame) {
+            Peer &peer = peers_[fd];
+            std::span<const uint8_t> payload = frame.payload.span();
+            BinaryReader reader(payload);
+            if (peer.id.empty() && frame.type != FrameType::Hello) {
+                dropPeer(fd, "expected hello");
+                return false;
+            }
+            switch (frame.type) {
+            case FrameType::Hello: {
+                std::string id = reader.readString();
+                if (id.empty() || id == id_) {
+                    dropPeer(fd, "bad hello");
+                    return false;
+                }
+                for (const auto &[other_fd, other] : peers_) {
+                    if (other_fd != fd && other.id == id) {
+                        dropPeer(fd, "duplicate connection");
+                        return false;
+                    }
+                }
+                peer.id = id;
+                // Announce our tip so a lagging peer can catch up
+                send(fd, FrameType::Block, serializedBlock(chain_.getLastBlock()));
+                return true;
+            }
+            case FrameType::Block:
+                if (!isDuplicateBlock(fd, payload)) {
+                    onBlock(fd, Block<T>::deserializeBinary(payload), frame.payload);
+                }
+                return true;
+            case FrameType::Transaction:
+                if (!isDuplicateTransaction(fd, payload)) {
+                    onTransaction(fd, Transaction<T>::deserializeBinary(payload));
+                }
+                return true;
+            case FrameType::GetChain:
+                onGetChain(fd, reader.readUint64());
+                return true;
+            case FrameType::Chain: {
+                uint32_t count = reader.readUint32();
+                std::vector<Block<T>> blocks;
+                for (uint32_t i = 0; i < count; i++) {
+                    blocks.push_back(Block<T>::deserializeBinary(reader.readSpan()));
+                }
+                onChain(fd, blocks);
+                return true;
+            }
+            case FrameType::CompactBlock:
+                stats_.compact_blocks_received++;
+                if (!isDuplicateBlock(fd, BinaryReader(payload).readSpan())) {
+                    onCompactBlock(fd, CompactBlock<T>::deserializeBinary(payload));
+                }
+                return true;
+            case FrameType::GetBlockTransactions:
+                return onGetBlockTransactions(fd, payload);
+            case FrameType::BlockTransactions:
+                onBlockTransactions(fd, payload);
+                return true;
+            case FrameType::GetHeaders:
+                onGetHeaders(fd, payload);
+                return true;
+            case FrameType::Headers:
+                return onHeaders(fd, payload);
+            case FrameType::GetBodies:
+                onGetBodies(fd, payload);
+                return true;
+            case FrameType::Bodies:
+                return onBodies(fd, payload);
+            case FrameType::Inventory:
+                onInventory(fd, payload);
+                return true;
+            case FrameType::GetTransactions:
+                onGetTransactions(fd, payload);
+                return true;
+            case FrameType::Transactions:
+                onTransactions(fd, payload);
+                return true;
+            }
+            dropPeer(fd, "unknown frame type");
+            return false;
+        }
+
+        // Blocks and transactions already known by id are dropped before they are deserialized
+        inline bool isDuplicateBlock(int from, std::span<const uint8_t> block) {
+            if (known_blocks_.count(std::string(MessageValidator<T>::peekBlockHash(block))) == 0) {
+                return false;
+            }
+            notePeerHeight(from, MessageValidator<T>::peekBlockIndex(block));
+            validator_.reject(ValidationStage::Duplicate);
+            return true;
+        }
+
+        inline bool isDuplicateTransaction(int from, std::span<const uint8_t> transaction) {
+            uint64_t digest = transactionDigest(MessageValidator<T>::peekTransactionId(transaction));
+            if (!known_transactions_.contains(digest)) {
+                return false;
+            }
+            notePeerSeen(from, digest);
+            stats_.duplicate_transactions++;
+            validator_.reject(ValidationStage::Duplicate);
+            return true;
+        }
+
+        // `wire` is the block as received; once accepted it is relayed and announced from those bytes as they are.
+        // A block failing its checks is forgotten again, so a forgery cannot shadow the real block of that hash.
+        inline void onBlock(int from, const Block<T> &block, SharedBytes wire) {
+            notePeerHeight(from, block.index_);
+            if (!known_blocks_.insert(block.hash_).second) {
+                return;
+            }
+            if (!validator_.checkHeader(chain_, block)) {
+                known_blocks_.erase(block.hash_);
+                return;
+            }
+            if (!hasParent(from, block)) {
+                return;
+            }
+            if (!validator_.checkBody(block)) {
+                known_blocks_.erase(block.hash_);
+                return;
+            }
+            acceptAndRelay(from, block, std::move(wire));
+        }
+
+        // On an unknown parent, start syncing from the sender and forget the block so the sync can deliver it
+        inline bool hasParent(int from, const Block<T> &block) {
+            if (chain_.hasBlock(block.previous_hash_)) {
+                return true;
+            }
+            known_blocks_.erase(block.hash_);
+            if (block.index_ > sync_.getHeaderHeight() && header_peer_ < 0) {
+                requestHeaders(from);
+            }
+            return false;
+        }
+
+        inline void acceptAndRelay(int from, const Block<T> &block, SharedBytes wire = {}) {
+            if (chain_.acceptBlock(block)) {
+                if (!wire.empty()) {
+                    cacheBlock(block.hash_, std::move(wire)); // Only after acceptance, so it cannot be poisoned
+                }
+                prunePool();
+                relayBlock(block, from);
+            }
+        }
+
+        // Transactions this node never saw gossiped are prefilled, since its peers most likely lack them too
+        inline void relayBlock(const Block<T> &block, int except) {
+            if (!compact_relay_) {
+                sendToAll(FrameType::Block, serializedBlock(block), except);
+                return;
+            }
+            auto compact = CompactBlock<T>::fromBlock(block, salt_rng_(), [this](const Transaction<T> &tx) {
+                return !known_transactions_.contains(transactionDigest(tx.uuid_));
+            });
+            sendToAll(FrameType::CompactBlock, SharedBytes::from(compact.serializeBinary()), except);
+        }
+
+        // A block's wire bytes, serialized at most once while it stays cached. A cached slice of a receive buffer
+        // keeps that buffer out of the pool, which the small cache bounds.
+        inline SharedBytes serializedBlock(const Block<T> &block) {
+            auto it = block_cache_.find(block.hash_);
+            if (it != block_cache_.end()) {
+                return it->second;
+            }
+            auto bytes = SharedBytes::from(block.serializeBinary());
+            cacheBlock(block.hash_, bytes);
+            return bytes;
+        }
+
+        inline void cacheBlock(const std::string &hash, SharedBytes bytes) {
+            if (!block_cache_.emplace(hash, std::move(bytes)).second) {
+                return;
+            }
+            block_cache_order_.push_back(hash);
+            if (block_cache_order_.size() > BLOCK_CACHE) {
+                block_cache_.erase(block_cache_order_.front());
+                block_cache_order_.pop_front();
+            }
+        }
+
+        inline void onCompactBlock(int from, const CompactBlock<T> &compact) {
+            notePeerHeight(from, compact.header.index_);
+            const std::string &hash = compact.header.hash_;
+            if (!known_blocks_.insert(hash).second) {
+                return;
+            }
+            if (!validator_.checkHeader(chain_, compact.header)) {
+                known_blocks_.erase(hash);
+                return;
+            }
+            if (!hasParent(from, compact.header)) {
+                return;
+            }
+            PartialBlock<T> partial(compact, pool_);
+            if (partial.isComplete()) {
+                stats_.compact_blocks_reconstructed++;
+                completeBlock(from, partial);
+                return;
+            }
+
+            const auto &missing = partial.getMissing();
+            std::vector<uint8_t> request;
+            BinarySerializer::writeString(request, hash);
+            BinarySerializer::writeUint32(request, static_cast<uint32_t>(missing.size()));
+            for (uint32_t index : missing) {
+                BinarySerializer::writeUint32(request, index);
+            }
+            stats_.transactions_requested += missing.size();
+            pending_blocks_.insert_or_assign(hash, PendingBlock{from, std::move(partial)});
+            send(from, FrameType::GetBlockTransactions, std::move(request));
+        }
+
+        // False if the peer asked for transactions outside a block it was sent
+        inline bool onGetBlockTransactions(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            std::string hash = reader.readString();
+            uint32_t count = reader.readUint32();
+            const Block<T> *block = chain_.findBlock(hash);
+            if (block == nullptr) {
+                return true; // Reorganized away; the requester falls back once this peer's chain moves on
+            }
+            std::vector<uint8_t> reply;
+            BinarySerializer::writeString(reply, hash);
+            BinarySerializer::writeUint32(reply, count);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t index = reader.readUint32();
+                if (index >= block->transactions_.size()) {
+                    dropPeer(from, "bad transaction request");
+                    return false;
+                }
+                BinarySerializer::writeBytes(reply, block->transactions_[index].serializeBinary());
+            }
+            send(from, FrameType::BlockTransactions, std::move(reply));
+            return true;
+        }
+
+        inline void onBlockTransactions(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            std::string hash = reader.readString();
+            auto it = pending_blocks_.find(hash);
+            if (it == pending_blocks_.end() || it->second.from != from) {
+                return;
+            }
+            PartialBlock<T> partial = std::move(it->second.partial);
+            pending_blocks_.erase(it);
+
+            uint32_t count = reader.readUint32();
+            std::vector<Transaction<T>> transactions;
+            for (uint32_t i = 0; i < count; i++) {
+                transactions.push_back(Transaction<T>::deserializeBinary(reader.readSpan()));
+            }
+            if (!partial.fill(transactions)) {
+                known_blocks_.erase(hash);
+                recoverBlock(from);
+                return;
+            }
+            completeBlock(from, partial);
+        }
+
+        // A body that does not hash to the header's Merkle root means a short id picked the wrong transaction;
+        // fall back to fetching the block in full
+        inline void completeBlock(int from, const PartialBlock<T> &partial) {
+            auto block = partial.build();
+            if (!block) {
+                validator_.reject(ValidationStage::Merkle);
+                known_blocks_.erase(partial.getHeader().hash_);
+                recoverBlock(from);
+                return;
+            }
+            acceptAndRelay(from, *block);
+        }
+
+        // Fetch a compact block that could not be rebuilt through headers-first sync, which pages the download and
+        // checks each body against its header. A sync already under way picks the block up from its own peer.
+        inline void recoverBlock(int from) {
+            if (header_peer_ < 0) {
+                requestHeaders(from);
+            }
+        }
+
+        // One page of canonical blocks from `start`, bounded by count and size but never empty while `start`
+        // exists. Requests beyond the peer's budget are ignored.
+        inline void onGetChain(int from, uint64_t start) {
+            auto it = peers_.find(from);
+            if (it == peers_.end() || it->second.chain_budget.take(1, TokenBucket::Clock::now()) == 0) {
+                stats_.chain_requests_refused++;
+                return;
+            }
+            std::vector<uint8_t> blocks;
+            uint32_t count = 0;
+            for (size_t i = start; i < chain_.blocks_.size() && count < CHAIN_PAGE_BLOCKS; i++) {
+                auto bytes = chain_.blocks_[i].serializeBinary();
+                if (count > 0 && blocks.size() + bytes.size() > CHAIN_PAGE_BYTES) {
+                    break;
+                }
+                BinarySerializer::writeBytes(blocks, bytes);
+                count++;
+            }
+            std::vector<uint8_t> reply;
+            BinarySerializer::writeUint32(reply, count);
+            reply.insert(reply.end(), blocks.begin(), blocks.end());
+            send(from, FrameType::Chain, std::move(reply));
+        }
+
+        // Connect a page of blocks in order, stopping at the first that does not fit
+        inline void onChain(int from, const std::vector<Block<T>> &blocks) {
+            std::string old_tip = chain_.getLastBlock().hash_;
+            for (const auto &block : blocks) {
+                if (!chain_.hasBlock(block.hash_) && !chain_.acceptBlock(block)) {
+                    break;
+                }
+                known_blocks_.insert(block.hash_);
+            }
+            if (chain_.getLastBlock().hash_ != old_tip) {
+                prunePool();
+                relayBlock(chain_.getLastBlock(), from);
+            }
+        }
+
+        // Queue an announcement for every peer not already known to have the transaction
+        inline void announce(const Transaction<T> &tx, uint64_t digest, int except) {
+            for (auto &[fd, peer] : peers_) {
+                if (fd != except && !peer.id.empty() && !peer.seen.contains(digest)) {
+                    peer.announcements.push(digest, tx.priority_);
+                }
+            }
+            startTimer(inventory_timer_fd_, INVENTORY_TICK_NS, &NetworkNode::onInventoryTick);
+        }
+
+        // Send each peer what its budget allows of its queued announcements
+        inline void onInventoryTick() {
+            auto now = TokenBucket::Clock::now();
+            bool queued = false;
+            std::vector<std::pair<int, std::vector<uint8_t>>> batches;
+            for (auto &[fd, peer] : peers_) {
+                size_t budget = peer.announce_budget.take(std::min(peer.announcements.size(), MAX_INVENTORY), now);
+                std::vector<uint64_t> digests;
+                for (uint64_t digest : peer.announcements.pop(budget)) {
+                    if (peer.seen.insert(digest)) {
+                        digests.push_back(digest);
+                    }
+                }
+                queued = queued || !peer.announcements.empty();
+                if (!digests.empty()) {
+                    stats_.inventory_announced += digests.size();
+                    batches.emplace_back(fd, encodeDigests(digests));
+                }
+            }
+            for (auto &[fd, payload] : batches) {
+                send(fd, FrameType::Inventory, std::move(payload)); // May drop the peer, so not while iterating peers_
+            }
+            if (!queued) {
+                stopTimer(inventory_timer_fd_);
+            }
+        }
+
+        inline static std::vector<uint8_t> encodeDigests(const std::vector<uint64_t> &digests) {
+            std::vector<uint8_t> payload;
+            BinarySerializer::writeUint32(payload, static_cast<uint32_t>(digests.size()));
+            for (uint64_t digest : digests) {
+                BinarySerializer::writeUint64(payload, digest);
+            }
+            return payload;
+        }
+
+        inline static std::vector<uint64_t> decodeDigests(std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            if (count > reader.remaining() / 8) {
+                throw std::runtime_error("Digest count exceeds payload");
+            }
+            std::vector<uint64_t> digests;
+            digests.reserve(count);
+            for (uint32_t i = 0; i < count; i++) {
+                digests.push_back(reader.readUint64());
+            }
+            return digests;
+        }
+
+        // Fetch announced transactions that are new to this node and not already being fetched from someone else
+        inline void onInventory(int from, std::span<const uint8_t> payload) {
+            auto it = peers_.find(from);
+            if (it == peers_.end()) {
+                return;
+            }
+            Peer &peer = it->second;
+            std::vector<uint64_t> wanted;
+            for (uint64_t digest : decodeDigests(payload)) {
+                peer.seen.insert(digest);
+                if (!known_transactions_.contains(digest) && fetching_.emplace(digest, from).second) {
+                    wanted.push_back(digest);
+                }
+            }
+            if (!wanted.empty()) {
+                stats_.transactions_fetched += wanted.size();
+                auto request = encodeDigests(wanted);
+                peer.requested.push_back(std::move(wanted));
+                send(from, FrameType::GetTransactions, std::move(request)); // May drop the peer, so last
+            }
+        }
+
+        inline void onGetTransactions(int from, std::span<const uint8_t> payload) {
+            std::vector<uint8_t> reply;
+            std::vector<const Transaction<T> *> found;
+            for (uint64_t digest : decodeDigests(payload)) {
+                auto it = pool_digests_.find(digest);
+                const Transaction<T> *tx = it != pool_digests_.end() ? pool_.find(it->second) : nullptr;
+                if (tx != nullptr) {
+                    notePeerSeen(from, digest);
+                    found.push_back(tx);
+                }
+            }
+            BinarySerializer::writeUint32(reply, static_cast<uint32_t>(found.size()));
+            for (const auto *tx : found) {
+                BinarySerializer::writeBytes(reply, tx->serializeBinary());
+            }
+            send(from, FrameType::Transactions, std::move(reply));
+        }
+
+        // Answer to our oldest outstanding request; whatever it lacks may be fetched from the next announcer
+        inline void onTransactions(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            for (uint32_t i = 0; i < count; i++) {
+                auto transaction = reader.readSpan();
+                if (!isDuplicateTransaction(from, transaction)) {
+                    onTransaction(from, Transaction<T>::deserializeBinary(transaction));
+                }
+            }
+            auto it = peers_.find(from);
+            if (it == peers_.end() || it->second.requested.empty()) {
+                return;
+            }
+            for (uint64_t digest : it->second.requested.front()) {
+                auto fetching = fetching_.find(digest);
+                if (fetching != fetching_.end() && fetching->second == from) {
+                    fetching_.erase(fetching);
+                }
+            }
+            it->second.requested.pop_front();
+        }
+
+        // A transaction body, requested or pushed; the used-id check is the chain's own double-spend guard
+        inline void onTransaction(int from, const Transaction<T> &tx) {
+            uint64_t digest = transactionDigest(tx.uuid_);
+            notePeerSeen(from, digest);
+            if (known_transactions_.contains(digest)) {
+                stats_.duplicate_transactions++;
+                validator_.reject(ValidationStage::Duplicate);
+                return;
+            }
+            if (!validator_.checkTransaction(tx)) {
+                return; // Not remembered, so an invalid copy cannot shadow a valid transaction with its id
+            }
+            known_transactions_.insert(digest);
+            if (chain_.isTransactionUsed(tx.uuid_) || !pool_.add(tx)) {
+                return;
+            }
+            pool_digests_[digest] = tx.uuid_;
+            announce(tx, digest, from);
+        }
+
+        inline void notePeerSeen(int fd, uint64_t digest) {
+            auto it = peers_.find(fd);
+            if (it != peers_.end()) {
+                it->second.seen.insert(digest);
+            }
+        }
+
+        inline void notePeerHeight(int fd, int64_t height) {
+            auto it = peers_.find(fd);
+            if (it != peers_.end()) {
+                it->second.height = std::max(it->second.height, height);
+            }
+        }
+
+        inline void requestHeaders(int fd) {
+            std::vector<uint8_t> request;
+            auto locator = sync_.locator();
+            BinarySerializer::writeUint32(request, static_cast<uint32_t>(locator.size()));
+            for (const auto &hash : locator) {
+                BinarySerializer::writeString(request, hash);
+            }
+            header_peer_ = fd;
+            header_requested_ = ChainSync<T>::Clock::now();
+            send(fd, FrameType::GetHeaders, std::move(request));
+            startTimer(sync_timer_fd_, SYNC_TICK_NS, &NetworkNode::onSyncTick);
+        }
+
+        // After losing the header peer, continue with any peer known to be ahead of the header chain
+        inline void resumeHeaders() {
+            for (const auto &[fd, peer] : peers_) {
+                if (!peer.id.empty() && peer.height > sync_.getHeaderHeight()) {
+                    requestHeaders(fd);
+                    return;
+                }
+            }
+        }
+
+        // Canonical headers after the first locator hash on our canonical chain
+        inline void onGetHeaders(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            size_t start = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                const Block<T> *block = chain_.findBlock(reader.readString());
+                size_t height = block != nullptr ? static_cast<size_t>(block->index_) : 0;
+                if (block != nullptr && height < chain_.blocks_.size() && &chain_.blocks_[height] == block) {
+                    start = height + 1;
+                    break;
+                }
+            }
+            size_t end = std::min(chain_.blocks_.size(), start + ChainSync<T>::MAX_HEADERS);
+            std::vector<uint8_t> reply;
+            BinarySerializer::writeUint32(reply, static_cast<uint32_t>(end > start ? end - start : 0));
+            for (size_t i = start; i < end; i++) {
+                Block<T> header = chain_.blocks_[i];
+                header.transactions_.clear();
+                BinarySerializer::writeBytes(reply, header.serializeBinary());
+            }
+            send(from, FrameType::Headers, std::move(reply));
+        }
+
+        // False if the headers were invalid and the peer was dropped
+        inline bool onHeaders(int from, std::span<const uint8_t> payload) {
+            if (from != header_peer_) {
+                return true; // Unsolicited, or from a peer we already gave up on
+            }
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            std::vector<Block<T>> headers;
+            for (uint32_t i = 0; i < count; i++) {
+                headers.push_back(Block<T>::deserializeBinary(reader.readSpan()));
+            }
+            if (!sync_.addHeaders(headers)) {
+                validator_.reject(ValidationStage::Signature);
+                dropPeer(from, "invalid headers");
+                return false;
+            }
+            if (!headers.empty()) {
+                notePeerHeight(from, headers.back().index_);
+            }
+            header_peer_ = -1;
+            if (count == ChainSync<T>::MAX_HEADERS && !sync_.isFull()) {
+                requestHeaders(from);
+            }
+            scheduleBodies();
+            return true;
+        }
+
+        // Hand every peer as many body windows as it has free request slots
+        inline void scheduleBodies() {
+            auto now = ChainSync<T>::Clock::now();
+            size_t window = sync_.getConfig().window_size;
+            std::vector<std::pair<int, std::vector<uint8_t>>> requests;
+            for (const auto &[fd, peer] : peers_) {
+                if (peer.id.empty()) {
+                    continue;
+                }
+                auto hashes = sync_.assign(fd, peer.height, now);
+                for (size_t first = 0; first < hashes.size(); first += window) {
+                    size_t last = std::min(hashes.size(), first + window);
+                    std::vector<uint8_t> request;
+                    BinarySerializer::writeUint32(request, static_cast<uint32_t>(last - first));
+                    for (size_t i = first; i < last; i++) {
+                        BinarySerializer::writeString(request, hashes[i]);
+                    }
+                    requests.emplace_back(fd, std::move(request));
+                }
+            }
+            for (auto &[fd, request] : requests) {
+                // A failed send drops the peer and hands its windows back to the sync, so not while iterating peers_
+                if (peers_.contains(fd)) {
+                    send(fd, FrameType::GetBodies, std::move(request));
+                }
+            }
+        }
+
+        inline void onGetBodies(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            std::vector<uint8_t> reply;
+            BinarySerializer::writeUint32(reply, count);
+            for (uint32_t i = 0; i < count; i++) {
+                std::string hash = reader.readString();
+                const Block<T> *block = chain_.findBlock(hash);
+                BinarySerializer::writeString(reply, hash);
+                if (block == nullptr) {
+                    BinarySerializer::writeUint32(reply, NO_BODY);
+                    continue;
+                }
+                stats_.bodies_served++;
+                BinarySerializer::writeUint32(reply, static_cast<uint32_t>(block->transactions_.size()));
+                for (const auto &tx : block->transactions_) {
+                    BinarySerializer::writeBytes(reply, tx.serializeBinary());
+                }
+            }
+            send(from, FrameType::Bodies, std::move(reply));
+        }
+
+        // False if a body contradicted its header and the peer was dropped
+        inline bool onBodies(int from, std::span<const uint8_t> payload) {
+            BinaryReader reader(payload);
+            uint32_t count = reader.readUint32();
+            for (uint32_t i = 0; i < count; i++) {
+                std::string hash = reader.readString();
+                uint32_t tx_count = reader.readUint32();
+                if (tx_count == NO_BODY) {
+                    // It is on another branch or behind what it announced; stop asking it for anything this high
+                    sync_.release(hash);
+                    auto it = peers_.find(from);
+                    if (it != peers_.end()) {
+                        it->second.height = std::min(it->second.height, chain_.getLastBlock().index_);
+                    }
+                    continue;
+                }
+                std::vector<Transaction<T>> transactions;
+                for (uint32_t n = 0; n < tx_count; n++) {
+                    transactions.push_back(Transaction<T>::deserializeBinary(reader.readSpan()));
+                }
+                if (!sync_.addBody(from, hash, std::move(transactions))) {
+                    validator_.reject(ValidationStage::Merkle);
+                    dropPeer(from, "body does not match header");
+                    return false;
+                }
+            }
+            size_t connected = sync_.connect();
+            if (connected > 0) {
+                stats_.blocks_synced += connected;
+                prunePool();
+                // Header download pauses while the sync holds its maximum; continue it as blocks drain
+                if (header_peer_ < 0 && !sync_.isFull()) {
+                    resumeHeaders();
+                }
+            }
+            scheduleBodies();
+            return true;
+        }
+
+        // Call `tick` every `interval_ns` from the loop until stopTimer; a no-op if already running. Without a
+        // timer (timerfd_create failed) the tick runs once right away.
+        inline void startTimer(int &timer_fd, long interval_ns, void (NetworkNode::*tick)()) {
+            if (timer_fd >= 0) {
+                return;
+            }
+            timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (timer_fd < 0) {
+                (this->*tick)();
+                return;
+            }
+            itimerspec interval{};
+            interval.it_interval.tv_nsec = interval_ns;
+            interval.it_value.tv_nsec = interval_ns;
+            timerfd_settime(timer_fd, 0, &interval, nullptr);
+            int fd = timer_fd;
+            loop_.add(fd, EPOLLIN, [this, fd, tick](uint32_t) {
+                uint64_t expirations;
+                [[maybe_unused]] auto n = read(fd, &expirations, sizeof(expirations));
+                (this->*tick)();
+            });
+        }
+
+        inline void stopTimer(int &timer_fd) {
+            if (timer_fd >= 0) {
+                loop_.remove(timer_fd);
+                close(timer_fd);
+                timer_fd = -1;
+            }
+        }
+
+        // Drop peers that stopped answering; their requests go to the others
+        inline void onSyncTick() {
+            auto now = ChainSync<T>::Clock::now();
+            if (header_peer_ >= 0 && now - header_requested_ > sync_.getConfig().stall_timeout) {
+                dropPeer(header_peer_, "stalled");
+            }
+            for (int fd : sync_.stalledPeers(now)) {
+                dropPeer(fd, "stalled");
+            }
+            if (!isSyncing()) {
+                stopTimer(sync_timer_fd_);
+                return;
+            }
+            scheduleBodies();
+        }
+
+        inline void prunePool() {
+            pool_.removeIf([&](const Transaction<T> &tx) { return chain_.isTransactionUsed(tx.uuid_); });
+        }
+
+        // The frame is built once and shared by every peer's outbox
+        inline void sendToAll(FrameType type, SharedBytes payload, int except) {
+            auto frame = OutboundFrame::make(type, std::move(payload));
+            std::vector<int> targets;
+            for (const auto &[fd, peer] : peers_) {
+                if (fd != except && !peer.id.empty()) {
+                    targets.push_back(fd);
+                }
+            }
+            for (int fd : targets) {
+                queue(fd, frame);
+            }
+        }
+
+        inline void send(int fd, FrameType type, SharedBytes payload) {
+            queue(fd, OutboundFrame::make(type, std::move(payload)));
+        }
+
+        inline void send(int fd, FrameType type, std::vector<uint8_t> payload) {
+            send(fd, type, SharedBytes::from(std::move(payload)));
+        }
+
+        inline void queue(int fd, std::shared_ptr<const OutboundFrame> frame) {
+            auto it = peers_.find(fd);
+            if (it == peers_.end()) {
+                return;
+            }
+            stats_.frames_sent++;
+            it->second.outbox.push_back(std::move(frame));
+            if (!it->second.connecting) {
+                flush(fd);
+            }
+        }
+
+        // Write as much of the outbox as the socket takes, gathering prefixes and payloads of up to WRITE_BATCH
+        // frames into each sendmsg, and wait for EPOLLOUT only while something is left
+        inline void flush(int fd) {
+            auto it = peers_.find(fd);
+            if (it == peers_.end()) {
+                return;
+            }
+            Peer &peer = it->second;
+            while (!peer.outbox.empty()) {
+                iovec iov[2 * WRITE_BATCH];
+                size_t count = 0;
+                size_t skip = peer.outbox_offset;
+                auto add = [&](const uint8_t *data, size_t size) {
+                    if (skip >= size) {
+                        skip -= size;
+                        return;
+                    }
+                    iov[count++] = iovec{const_cast<uint8_t *>(data + skip), size - skip};
+                    skip = 0;
+                };
+                for (size_t i = 0; i < peer.outbox.size() && i < WRITE_BATCH; i++) {
+                    add(peer.outbox[i]->prefix.data(), peer.outbox[i]->prefix.size());
+                    add(peer.outbox[i]->payload.data, peer.outbox[i]->payload.size);
+                }
+
+                msghdr message{};
+                message.msg_iov = iov;
+                message.msg_iovlen = count;
+                ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        dropPeer(fd, std::strerror(errno));
+                        return;
+                    }
+                    break;
+                }
+                stats_.bytes_sent += static_cast<uint64_t>(n);
+                size_t written = peer.outbox_offset + static_cast<size_t>(n);
+                while (!peer.outbox.empty() && written >= peer.outbox.front()->size()) {
+                    written -= peer.outbox.front()->size();
+                    peer.outbox.pop_front();
+                }
+                peer.outbox_offset = written;
+            }
+            bool pending = !peer.outbox.empty();
+            if (pending != peer.want_write) {
+                peer.want_write = pending;
+                loop_.modify(fd, pending ? EPOLLIN | EPOLLOUT : EPOLLIN);
+            }
+        }
+    };
+
+} // namespace chain
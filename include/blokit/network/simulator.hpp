@@ -0,0 +1,441 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../consensus/engine.hpp"
+
+namespace chain {
+
+    // Virtual network between simulated nodes
+    struct SimulatorConfig {
+        double min_latency = 0.01; // One-way message delay in seconds, drawn uniformly from [min, max]
+        double max_latency = 0.05;
+        double drop_rate = 0.0; // Probability that any single message is lost
+        size_t max_block_transactions = 100;
+        uint64_t seed = 1;
+    };
+
+    struct SimulationStats {
+        uint64_t blocks_produced = 0;
+        uint64_t messages_sent = 0;
+        uint64_t messages_dropped = 0;
+        uint64_t reorgs = 0;
+        uint64_t blocks_propagated = 0; // Produced blocks that ended up on every node's chain
+        double total_propagation_seconds = 0.0;
+        double elapsed_seconds = 0.0;
+        size_t committed_transactions = 0; // Transactions on the first node's chain, genesis excluded
+        uint64_t blocks_finalized = 0;     // Produced blocks that every node has finalized
+        double total_finality_seconds = 0.0;
+
+        inline double averagePropagationSeconds() const {
+            return blocks_propagated > 0 ? total_propagation_seconds / static_cast<double>(blocks_propagated) : 0.0;
+        }
+
+        // Time from a block being produced until the last node finalized it
+        inline double averageFinalitySeconds() const {
+            return blocks_finalized > 0 ? total_finality_seconds / static_cast<double>(blocks_finalized) : 0.0;
+        }
+
+        inline double transactionsPerSecond() const {
+            return elapsed_seconds > 0.0 ? static_cast<double>(committed_transactions) / elapsed_seconds : 0.0;
+        }
+    };
+
+    // Runs several Chain<T> nodes in one process over a virtual network. Time only advances through the event
+    // queue and all randomness comes from one seeded generator, so a run with the same seed, configuration and
+    // inputs replays exactly.
+    template <typename T> class NetworkSimulator {
+      public:
+        inline explicit NetworkSimulator(const Chain<T> &genesis, SimulatorConfig config = {})
+            : genesis_(genesis), config_(config), rng_(config.seed) {
+            epoch_sec_ = genesis.getLastBlock().timestamp_.sec + 1;
+        }
+
+        // Nodes hold observers pointing back at the simulator
+        NetworkSimulator(const NetworkSimulator &) = delete;
+        NetworkSimulator &operator=(const NetworkSimulator &) = delete;
+
+        // Add a node starting from the genesis chain; returns its index. Nodes with a voter take part in finality
+        // if the genesis chain has it enabled.
+        inline size_t addNode(const std::string &id, std::shared_ptr<ConsensusEngine<T>> engine,
+                              std::shared_ptr<FinalityVoter<T>> voter = nullptr) {
+            Node node;
+            node.id = id;
+            node.chain = genesis_;
+            node.engine = std::move(engine);
+            node.voter = std::move(voter);
+            nodes_.push_back(std::move(node));
+            size_t index = nodes_.size() - 1;
+            nodes_[index].chain.addObserver(std::make_shared<PoolRefiller>(*this, index));
+            onTipChanged(index);
+            return index;
+        }
+
+        // Hand a transaction to `node`, which gossips it to its peers
+        inline void submitTransaction(size_t node, const Transaction<T> &tx) {
+            auto message = std::make_shared<Message>();
+            message->type = MessageType::Transaction;
+            message->from = node;
+            message->transaction = tx;
+            receiveTransaction(node, *message);
+            broadcast(node, message);
+        }
+
+        // Split the network; nodes in different groups cannot reach each other until heal()
+        inline void partition(const std::vector<std::vector<size_t>> &groups) {
+            for (size_t g = 0; g < groups.size(); g++) {
+                for (size_t node : groups[g]) {
+                    nodes_[node].group = g + 1;
+                }
+            }
+        }
+
+        inline void heal() {
+            for (auto &node : nodes_) {
+                node.group = 0;
+            }
+            // Let every node announce its tip so partitions converge
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                announceTip(i);
+            }
+        }
+
+        // Process the next event; false once nothing is scheduled
+        inline bool step() {
+            if (events_.empty()) {
+                return false;
+            }
+            Event event = events_.top();
+            events_.pop();
+            now_ = event.time;
+            if (event.message) {
+                deliver(event.node, *event.message);
+            } else {
+                propose(event.node, event.tip);
+            }
+            return true;
+        }
+
+        inline void runFor(double seconds) {
+            double end = now_ + seconds;
+            while (!events_.empty() && events_.top().time <= end) {
+                step();
+            }
+            now_ = end;
+        }
+
+        inline double now() const { return now_; }
+
+        inline size_t getNodeCount() const { return nodes_.size(); }
+
+        inline const Chain<T> &getChain(size_t node) const { return nodes_[node].chain; }
+
+        // True if every node has the same tip
+        inline bool isConverged() const {
+            for (const auto &node : nodes_) {
+                if (node.chain.getLastBlock().hash_ != nodes_.front().chain.getLastBlock().hash_) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline SimulationStats getStats() const {
+            SimulationStats stats = stats_;
+            stats.elapsed_seconds = now_;
+            for (const auto &node : nodes_) {
+                stats.reorgs += node.chain.getReorgCount();
+            }
+            if (!nodes_.empty()) {
+                const auto &blocks = nodes_.front().chain.blocks_;
+                for (size_t i = 1; i < blocks.size(); i++) {
+                    stats.committed_transactions += blocks[i].transactions_.size();
+                }
+            }
+            return stats;
+        }
+
+      private:
+        enum class MessageType { Block, Transaction, ChainRequest, ChainResponse, Vote };
+
+        struct Message {
+            MessageType type;
+            size_t from = 0;
+            Block<T> block;
+            Transaction<T> transaction;
+            std::vector<Block<T>> blocks;
+            FinalityVote vote;
+        };
+
+        struct Event {
+            double time;
+            uint64_t sequence; // Orders events scheduled for the same instant
+            size_t node;
+            std::string tip;                         // Proposal events: tip the proposal was scheduled on
+            std::shared_ptr<const Message> message; // Delivery events: shared by every recipient of a broadcast
+
+            inline bool operator>(const Event &other) const {
+                return time != other.time ? time > other.time : sequence > other.sequence;
+            }
+        };
+
+        struct Node {
+            std::string id;
+            Chain<T> chain;
+            std::shared_ptr<ConsensusEngine<T>> engine;
+            std::shared_ptr<FinalityVoter<T>> voter;
+            std::vector<Transaction<T>> pool;
+            std::unordered_set<std::string> known_blocks;       // Received or produced, for gossip dedupe
+            std::unordered_set<std::string> known_transactions;
+            std::unordered_set<std::string> adopted;            // Blocks that have been on this node's chain
+            size_t group = 0;
+            int64_t finalized_height = 0; // Last finalized height accounted for in the stats
+        };
+
+        // Returns transactions of blocks disconnected by a reorganization to the node's pool
+        class PoolRefiller : public ChainObserver<T> {
+          public:
+            inline PoolRefiller(NetworkSimulator &sim, size_t node) : sim_(sim), node_(node) {}
+            inline void onBlockConnected(const Block<T> &) override {}
+            inline void onBlockDisconnected(const Block<T> &block) override {
+                auto &pool = sim_.nodes_[node_].pool;
+                pool.insert(pool.end(), block.transactions_.begin(), block.transactions_.end());
+            }
+
+          private:
+            NetworkSimulator &sim_;
+            size_t node_;
+        };
+
+        // When each produced block was created and how many nodes have adopted and finalized it so far
+        struct Propagation {
+            double created;
+            size_t nodes;
+            size_t finalized_nodes;
+        };
+
+        Chain<T> genesis_;
+        SimulatorConfig config_;
+        std::mt19937_64 rng_;
+        double now_ = 0.0;
+        int32_t epoch_sec_;
+        uint64_t sequence_ = 0;
+        std::vector<Node> nodes_;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+        std::unordered_map<std::string, Propagation> propagation_;
+        SimulationStats stats_;
+
+        inline void schedule(double time, size_t node, std::string tip, std::shared_ptr<const Message> message) {
+            events_.push(Event{time, sequence_++, node, std::move(tip), std::move(message)});
+        }
+
+        inline void send(size_t from, size_t to, std::shared_ptr<const Message> message) {
+            stats_.messages_sent++;
+            std::uniform_real_distribution<double> chance(0.0, 1.0);
+            bool partitioned = nodes_[from].group != nodes_[to].group;
+            if (partitioned || (config_.drop_rate > 0.0 && chance(rng_) < config_.drop_rate)) {
+                stats_.messages_dropped++;
+                return;
+            }
+            std::uniform_real_distribution<double> latency(config_.min_latency, config_.max_latency);
+            schedule(now_ + latency(rng_), to, "", std::move(message));
+        }
+
+        inline void broadcast(size_t from, const std::shared_ptr<const Message> &message, size_t except = SIZE_MAX) {
+            for (size_t to = 0; to < nodes_.size(); to++) {
+                if (to != from && to != except) {
+                    send(from, to, message);
+                }
+            }
+        }
+
+        inline void announceTip(size_t node, size_t except = SIZE_MAX) {
+            auto message = std::make_shared<Message>();
+            message->type = MessageType::Block;
+            message->from = node;
+            message->block = nodes_[node].chain.getLastBlock();
+            broadcast(node, message, except);
+        }
+
+        inline Timestamp virtualTimestamp() const {
+            double whole = std::floor(now_);
+            return Timestamp(epoch_sec_ + static_cast<int32_t>(whole), static_cast<uint32_t>((now_ - whole) * 1e9));
+        }
+
+        inline void propose(size_t index, const std::string &tip) {
+            auto &node = nodes_[index];
+            if (node.chain.getLastBlock().hash_ != tip) {
+                return; // The tip moved since this proposal was scheduled
+            }
+            std::vector<Transaction<T>> txns;
+            for (const auto &tx : node.pool) {
+                if (txns.size() >= config_.max_block_transactions) {
+                    break;
+                }
+                txns.push_back(tx);
+            }
+            Block<T> block(txns);
+            block.timestamp_ = virtualTimestamp();
+            if (!node.engine->produce(node.chain, block)) {
+                return;
+            }
+            stats_.blocks_produced++;
+            const auto &hash = node.chain.getLastBlock().hash_;
+            node.known_blocks.insert(hash);
+            propagation_[hash] = Propagation{now_, 0, 0};
+            onTipChanged(index);
+            announceTip(index);
+        }
+
+        inline void deliver(size_t index, const Message &message) {
+            switch (message.type) {
+            case MessageType::Block:
+                receiveBlock(index, message);
+                break;
+            case MessageType::Transaction:
+                receiveTransaction(index, message);
+                break;
+            case MessageType::ChainRequest: {
+                auto response = std::make_shared<Message>();
+                response->type = MessageType::ChainResponse;
+                response->from = index;
+                response->blocks = nodes_[index].chain.blocks_;
+                send(index, message.from, response);
+                break;
+            }
+            case MessageType::ChainResponse:
+                receiveChain(index, message);
+                break;
+            case MessageType::Vote:
+                receiveVote(index, message.vote);
+                break;
+            }
+        }
+
+        inline void receiveBlock(size_t index, const Message &message) {
+            auto &node = nodes_[index];
+            const auto &block = message.block;
+            if (!node.known_blocks.insert(block.hash_).second) {
+                return;
+            }
+            if (node.chain.hasBlock(block.previous_hash_)) {
+                // Extends the tip or a known branch; the chain's fork choice decides whether the tip moves
+                std::string old_tip = node.chain.getLastBlock().hash_;
+                node.chain.acceptBlock(block);
+                if (node.chain.getLastBlock().hash_ != old_tip) {
+                    onTipChanged(index);
+                    announceTip(index, message.from);
+                }
+            } else if (block.index_ >= node.chain.getLastBlock().index_) {
+                // Unknown parent: fetch the sender's chain
+                auto request = std::make_shared<Message>();
+                request->type = MessageType::ChainRequest;
+                request->from = index;
+                send(index, message.from, request);
+            }
+        }
+
+        inline void receiveChain(size_t index, const Message &message) {
+            auto &node = nodes_[index];
+            if (!node.engine->prefer(node.chain, message.blocks)) {
+                return;
+            }
+            for (const auto &block : message.blocks) {
+                node.known_blocks.insert(block.hash_);
+            }
+            std::string old_tip = node.chain.getLastBlock().hash_;
+            node.chain.switchToFork(message.blocks);
+            if (node.chain.getLastBlock().hash_ != old_tip) {
+                onTipChanged(index);
+                announceTip(index, message.from);
+            }
+        }
+
+        inline void receiveTransaction(size_t index, const Message &message) {
+            auto &node = nodes_[index];
+            if (node.known_transactions.insert(message.transaction.uuid_).second &&
+                !node.chain.isTransactionUsed(message.transaction.uuid_)) {
+                node.pool.push_back(message.transaction);
+            }
+        }
+
+        inline void receiveVote(size_t index, const FinalityVote &vote) {
+            auto &node = nodes_[index];
+            auto qc = node.chain.addFinalityVote(vote);
+            if (qc) {
+                recordFinality(index);
+                castVotes(index);
+            }
+        }
+
+        // Let the node's voter react to its chain and certificates; its own votes count locally straight away
+        inline void castVotes(size_t index) {
+            auto &node = nodes_[index];
+            if (!node.voter || !node.chain.isFinalityEnabled()) {
+                return;
+            }
+            for (const auto &vote : node.voter->onChainUpdated(node.chain)) {
+                auto message = std::make_shared<Message>();
+                message->type = MessageType::Vote;
+                message->from = index;
+                message->vote = vote;
+                broadcast(index, message);
+                receiveVote(index, vote);
+            }
+        }
+
+        // Count blocks the node finalized since last time; a block is final network-wide once every node has it
+        inline void recordFinality(size_t index) {
+            auto &node = nodes_[index];
+            int64_t finalized = node.chain.getFinalizedHeight();
+            for (int64_t h = node.finalized_height + 1; h <= finalized; h++) {
+                auto it = propagation_.find(node.chain.blocks_[h].hash_);
+                if (it != propagation_.end() && ++it->second.finalized_nodes == nodes_.size()) {
+                    stats_.blocks_finalized++;
+                    stats_.total_finality_seconds += now_ - it->second.created;
+                }
+            }
+            node.finalized_height = std::max(node.finalized_height, finalized);
+        }
+
+        // Record propagation, drop pool entries the new chain already includes and schedule the next proposal
+        inline void onTipChanged(size_t index) {
+            auto &node = nodes_[index];
+            const auto &blocks = node.chain.blocks_;
+            for (size_t i = blocks.size(); i-- > 0;) {
+                if (!node.adopted.insert(blocks[i].hash_).second) {
+                    break;
+                }
+                auto it = propagation_.find(blocks[i].hash_);
+                if (it != propagation_.end() && ++it->second.nodes == nodes_.size()) {
+                    stats_.blocks_propagated++;
+                    stats_.total_propagation_seconds += now_ - it->second.created;
+                }
+            }
+
+            auto &pool = node.pool;
+            pool.erase(std::remove_if(pool.begin(), pool.end(),
+                                      [&](const Transaction<T> &tx) { return node.chain.isTransactionUsed(tx.uuid_); }),
+                       pool.end());
+
+            recordFinality(index);
+            castVotes(index);
+
+            double delay = node.engine->proposalDelay(node.chain, rng_);
+            if (delay >= 0.0) {
+                schedule(now_ + delay, index, node.chain.getLastBlock().hash_, nullptr);
+            }
+        }
+    };
+
+} // namespace chain
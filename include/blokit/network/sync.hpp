@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../structure/chain.hpp"
+#include "../structure/merkle.hpp"
+
+namespace chain {
+
+    // Headers-first catch-up. The header chain is downloaded from one peer and checked link by link (hash, proof of
+    // work against the target the difficulty policy owes it, seal) before any body is fetched; bodies are then
+    // requested in windows from every peer that has them, checked against their header's Merkle root as they
+    // arrive in any order, and connected to the chain in height order. At most `max_headers` headers and
+    // `max_buffered` blocks past the chain tip are held, which bounds memory however far behind the chain is.
+    // Transport-agnostic: peers are plain integers and time is passed in.
+    template <typename T> class ChainSync {
+      public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr size_t MAX_HEADERS = 2000; // Headers per response; a full batch means ask again
+
+        struct Config {
+            size_t window_size = 16;                        // Bodies per request
+            size_t requests_per_peer = 4;                   // Windows a peer may have in flight
+            size_t max_buffered = 1024;                     // Blocks downloaded ahead of the chain tip
+            size_t max_headers = 16 * MAX_HEADERS;          // Headers held ahead of the chain tip
+            std::chrono::milliseconds stall_timeout{5000}; // A request older than this marks its peer as stalled
+        };
+
+        inline explicit ChainSync(Chain<T> &chain, Config config = {}) : chain_(chain), config_(config) {}
+
+        inline const Config &getConfig() const { return config_; }
+
+        // Hashes for a GetHeaders request: the header tip, then the canonical chain from its tip back to genesis
+        // in exponentially growing steps, so the responder can find the last block both sides share
+        inline std::vector<std::string> locator() const {
+            std::vector<std::string> hashes;
+            if (!headers_.empty()) {
+                hashes.push_back(headers_.back().block.hash_);
+            }
+            size_t step = 1;
+            for (size_t i = chain_.blocks_.size(); i > 0;) {
+                i = i > step ? i - step : 0;
+                hashes.push_back(chain_.blocks_[i].hash_);
+                if (hashes.size() > 10) {
+                    step *= 2;
+                }
+                if (i == 0) {
+                    break;
+                }
+            }
+            return hashes;
+        }
+
+        // Extend the header chain. False if a header fails its checks or does not link, meaning the sender should
+        // be treated as misbehaving. Headers already known are skipped; a batch that starts another branch than
+        // the one being downloaded is ignored until that download finishes. Headers past `max_headers` are dropped
+        // and asked for again once blocks connect.
+        inline bool addHeaders(const std::vector<Block<T>> &headers) {
+            for (const auto &header : headers) {
+                if (isFull()) {
+                    break;
+                }
+                if (by_hash_.count(header.hash_) > 0 || chain_.hasBlock(header.hash_)) {
+                    continue;
+                }
+                if (!headers_.empty() && header.previous_hash_ != headers_.back().block.hash_) {
+                    if (by_hash_.count(header.previous_hash_) == 0 && !chain_.hasBlock(header.previous_hash_)) {
+                        return false;
+                    }
+                    return true;
+                }
+                int64_t parent_height = headers_.empty() ? -1 : headers_.back().block.index_;
+                if (headers_.empty()) {
+                    const Block<T> *parent = chain_.findBlock(header.previous_hash_);
+                    if (parent == nullptr) {
+                        return false;
+                    }
+                    parent_height = parent->index_;
+                }
+                if (headers_.empty()) {
+                    difficulty_ = chain_.headerDifficulty(static_cast<size_t>(parent_height) + 1);
+                }
+                if (header.index_ != parent_height + 1 || !header.transactions_.empty() ||
+                    !chain_.isValidHeader(header, difficulty_)) {
+                    return false;
+                }
+                by_hash_[header.hash_] = header.index_;
+                headers_.push_back(Entry{header});
+            }
+            return true;
+        }
+
+        // Claim up to a window per free request slot for `peer`, which has blocks up to `peer_height`. Returns the
+        // hashes to request, in height order.
+        inline std::vector<std::string> assign(int peer, int64_t peer_height, Clock::time_point now) {
+            size_t limit = config_.window_size * config_.requests_per_peer;
+            size_t &in_flight = in_flight_[peer];
+            std::vector<std::string> hashes;
+            size_t ahead = std::min(headers_.size(), config_.max_buffered);
+            for (size_t i = 0; i < ahead && in_flight < limit; i++) {
+                Entry &entry = headers_[i];
+                if (entry.block.index_ > peer_height) {
+                    break;
+                }
+                if (entry.state == State::Missing) {
+                    entry.state = State::Requested;
+                    entry.peer = peer;
+                    entry.requested = now;
+                    in_flight++;
+                    hashes.push_back(entry.block.hash_);
+                }
+            }
+            return hashes;
+        }
+
+        // Deliver a body. False if it does not match its header's Merkle root; the block goes back to the queue and
+        // the sender should be treated as misbehaving. Bodies for blocks not being downloaded are ignored.
+        inline bool addBody(int peer, const std::string &hash, std::vector<Transaction<T>> transactions) {
+            Entry *entry = find(hash);
+            if (entry == nullptr || entry->state == State::Downloaded) {
+                return true;
+            }
+            std::vector<std::string> leaves;
+            leaves.reserve(transactions.size());
+            for (const auto &tx : transactions) {
+                leaves.push_back(tx.toString());
+            }
+            bool matches = MerkleTree(leaves).getRoot() == entry->block.merkle_root_;
+            unclaim(*entry);
+            if (!matches) {
+                std::cout << "Body of block " << entry->block.index_ << " from peer " << peer
+                          << " does not match its header" << std::endl;
+                return false;
+            }
+            entry->block.transactions_ = std::move(transactions);
+            entry->state = State::Downloaded;
+            return true;
+        }
+
+        // `peer` does not have this block after all; queue it for another peer
+        inline void release(const std::string &hash) {
+            Entry *entry = find(hash);
+            if (entry != nullptr && entry->state == State::Requested) {
+                unclaim(*entry);
+            }
+        }
+
+        // Forget a disconnected peer and queue whatever it still owed
+        inline void removePeer(int peer) {
+            for (auto &entry : headers_) {
+                if (entry.state == State::Requested && entry.peer == peer) {
+                    unclaim(entry);
+                }
+            }
+            in_flight_.erase(peer);
+        }
+
+        // Peers with a request outstanding for longer than the stall timeout
+        inline std::vector<int> stalledPeers(Clock::time_point now) const {
+            std::vector<int> stalled;
+            for (const auto &entry : headers_) {
+                if (entry.state == State::Requested && now - entry.requested > config_.stall_timeout &&
+                    std::find(stalled.begin(), stalled.end(), entry.peer) == stalled.end()) {
+                    stalled.push_back(entry.peer);
+                }
+            }
+            return stalled;
+        }
+
+        // Connect every downloaded block that follows the chain. A block the chain rejects invalidates the rest of
+        // the header chain, which is dropped. Returns the number of blocks connected.
+        inline size_t connect() {
+            size_t connected = 0;
+            while (!headers_.empty() && headers_.front().state == State::Downloaded) {
+                Block<T> block = std::move(headers_.front().block);
+                by_hash_.erase(block.hash_);
+                headers_.pop_front();
+                if (!chain_.hasBlock(block.hash_) && !chain_.acceptBlock(block)) {
+                    std::cout << "Synced block " << block.index_ << " rejected, abandoning its header chain"
+                              << std::endl;
+                    clear();
+                    break;
+                }
+                connected++;
+            }
+            return connected;
+        }
+
+        inline void clear() {
+            headers_.clear();
+            by_hash_.clear();
+            in_flight_.clear();
+        }
+
+        // True while headers are waiting for their bodies
+        inline bool isActive() const { return !headers_.empty(); }
+
+        // True when no more headers are taken until blocks connect
+        inline bool isFull() const { return headers_.size() >= config_.max_headers; }
+
+        // Height of the last downloaded header, or of the chain tip when there is none
+        inline int64_t getHeaderHeight() const {
+            return headers_.empty() ? chain_.getLastBlock().index_ : headers_.back().block.index_;
+        }
+
+        inline size_t getPendingCount() const { return headers_.size(); }
+
+      private:
+        enum class State { Missing, Requested, Downloaded };
+
+        struct Entry {
+            Block<T> block; // The header until its body arrives
+            State state = State::Missing;
+            int peer = -1;
+            Clock::time_point requested{};
+        };
+
+        Chain<T> &chain_;
+        Config config_;
+        std::deque<Entry> headers_; // Starting right above a block the chain has
+        std::unordered_map<std::string, int64_t> by_hash_;
+        std::unordered_map<int, size_t> in_flight_;
+        DifficultyAdjuster difficulty_; // Past the last header, to check the target the next one carries
+
+        inline Entry *find(const std::string &hash) {
+            auto it = by_hash_.find(hash);
+            if (it == by_hash_.end()) {
+                return nullptr;
+            }
+            return &headers_[static_cast<size_t>(it->second - headers_.front().block.index_)];
+        }
+
+        inline void unclaim(Entry &entry) {
+            if (entry.state == State::Requested) {
+                auto it = in_flight_.find(entry.peer);
+                if (it != in_flight_.end() && it->second > 0) {
+                    it->second--;
+                }
+            }
+            entry.state = State::Missing;
+            entry.peer = -1;
+        }
+    };
+
+} // namespace chain
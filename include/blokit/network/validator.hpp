@@ -0,0 +1,335 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+
+#include "../structure/chain.hpp"
+#include "../structure/merkle.hpp"
+#include "../structure/serializer.hpp"
+#include "frame.hpp"
+
+namespace chain {
+
+    // Where a message was turned away, cheapest first
+    enum class ValidationStage : uint8_t {
+        Framing,   // Magic, version, length or CRC of the frame
+        Structure, // Payload layout, counts and field lengths
+        Duplicate, // Already known; dropped before it is deserialized
+        Signature, // Transaction signatures, block hash, proof of work and seal
+        Merkle,    // Block body against its header's Merkle root
+    };
+
+    inline constexpr size_t VALIDATION_STAGES = 5;
+
+    inline const char *validationStageName(ValidationStage stage) {
+        switch (stage) {
+        case ValidationStage::Framing:
+            return "framing";
+        case ValidationStage::Structure:
+            return "structure";
+        case ValidationStage::Duplicate:
+            return "duplicate";
+        case ValidationStage::Signature:
+            return "signature";
+        case ValidationStage::Merkle:
+            return "merkle";
+        }
+        return "unknown";
+    }
+
+    // Checks peer messages in layers of increasing cost, so junk is dropped at the cheapest layer that can tell:
+    // the frame decoder checks framing, checkStructure() walks a payload's length prefixes without allocating, the
+    // node drops duplicates by the id peeked from the raw bytes, and only then are messages deserialized and their
+    // signatures and Merkle roots checked. Every rejection is counted by stage.
+    template <typename T> class MessageValidator {
+      public:
+        struct Limits {
+            uint32_t max_frame_size = FrameCodec::DEFAULT_MAX_FRAME_SIZE;
+            size_t max_string_length = 256;   // Ids, hashes and sealer names
+            size_t max_signature_size = 1024; // Transaction signatures and block seals
+            size_t max_transactions = 100000; // Per block, body or transaction batch
+            size_t max_hashes = 2000;         // Per locator, header batch or body request
+            size_t max_inventory = 1000;      // Digests per inventory or transaction request
+            size_t max_chain_blocks = 2000;   // Per chain page
+        };
+
+        inline explicit MessageValidator(Limits limits = {}) : limits_(limits) {}
+
+        inline const Limits &getLimits() const { return limits_; }
+        inline void setLimits(const Limits &limits) { limits_ = limits; }
+
+        // Extra check run on every transaction after its own field checks, e.g. a signature check against the
+        // issuer's registered key
+        inline void setSignatureVerifier(std::function<bool(const Transaction<T> &)> verifier) {
+            verifier_ = std::move(verifier);
+        }
+
+        inline void reject(ValidationStage stage) { rejected_[static_cast<size_t>(stage)]++; }
+        inline uint64_t getRejected(ValidationStage stage) const { return rejected_[static_cast<size_t>(stage)]; }
+
+        inline uint64_t getRejectedTotal() const {
+            uint64_t total = 0;
+            for (uint64_t count : rejected_) {
+                total += count;
+            }
+            return total;
+        }
+
+        // The payload is laid out as its frame type requires, within the limits, with nothing left over
+        inline bool checkStructure(FrameType type, std::span<const uint8_t> payload) {
+            bool valid = false;
+            try {
+                BinaryReader reader(payload);
+                valid = scanFrame(type, reader) && reader.remaining() == 0;
+            } catch (const std::exception &) {
+                valid = false;
+            }
+            if (!valid) {
+                reject(ValidationStage::Structure);
+            }
+            return valid;
+        }
+
+        // Field checks, then the signature verifier if one is set
+        inline bool checkTransaction(const Transaction<T> &tx) {
+            if (!tx.isValid() || (verifier_ && !verifier_(tx))) {
+                reject(ValidationStage::Signature);
+                return false;
+            }
+            return true;
+        }
+
+        // Hash, proof of work and seal; enough to trust the header before doing anything with the body
+        inline bool checkHeader(const Chain<T> &chain, const Block<T> &block) {
+            if (!chain.isValidHeader(block)) {
+                reject(ValidationStage::Signature);
+                return false;
+            }
+            return true;
+        }
+
+        // Merkle root first, since one hash pass is cheaper than checking every transaction
+        inline bool checkBody(const Block<T> &block) {
+            std::vector<std::string> leaves;
+            leaves.reserve(block.transactions_.size());
+            for (const auto &tx : block.transactions_) {
+                leaves.push_back(tx.toString());
+            }
+            if (MerkleTree(leaves).getRoot() != block.merkle_root_) {
+                reject(ValidationStage::Merkle);
+                return false;
+            }
+            for (const auto &tx : block.transactions_) {
+                if (!checkTransaction(tx)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Fields read straight from serialized bytes that passed checkStructure, for dropping duplicates unparsed
+        inline static std::string_view peekTransactionId(std::span<const uint8_t> transaction) {
+            BinaryReader reader(transaction);
+            reader.readUint32(); // Timestamp
+            reader.readUint32();
+            reader.readInt16(); // Priority
+            return view(reader.readSpan());
+        }
+
+        inline static std::string_view peekBlockHash(std::span<const uint8_t> block) {
+            BinaryReader reader(block);
+            reader.readUint32(); // Index
+            reader.readSpan();   // Previous hash
+            return view(reader.readSpan());
+        }
+
+        inline static int64_t peekBlockIndex(std::span<const uint8_t> block) {
+            BinaryReader reader(block);
+            return static_cast<int64_t>(reader.readUint32());
+        }
+
+      private:
+        static constexpr size_t MIN_TRANSACTION_SIZE = 22; // Timestamp, priority and three empty fields
+        static constexpr size_t MIN_BLOCK_SIZE = 48;       // Fixed fields and empty variable ones
+        static constexpr size_t MIN_DIGEST_SIZE = 8;
+        static constexpr uint32_t NO_BODY = 0xffffffff; // Bodies entry for a block the sender lacks
+
+        Limits limits_;
+        std::function<bool(const Transaction<T> &)> verifier_;
+        std::array<uint64_t, VALIDATION_STAGES> rejected_{};
+
+        inline static std::string_view view(std::span<const uint8_t> bytes) {
+            return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+        }
+
+        // A count of items that each take at least `min_size` bytes must fit both the limit and the payload
+        inline static bool fits(uint32_t count, size_t limit, size_t min_size, const BinaryReader &reader) {
+            return count <= limit && count <= reader.remaining() / min_size;
+        }
+
+        inline bool scanString(BinaryReader &reader) const {
+            return reader.readSpan().size() <= limits_.max_string_length;
+        }
+
+        inline bool scanStrings(BinaryReader &reader, size_t limit) const {
+            uint32_t count = reader.readUint32();
+            if (!fits(count, limit, 4, reader)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (!scanString(reader)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Mirrors Transaction::serializeBinary; the payload of T is opaque here
+        inline bool scanTransaction(std::span<const uint8_t> bytes) const {
+            BinaryReader reader(bytes);
+            reader.readUint32();
+            reader.readUint32();
+            reader.readInt16();
+            if (!scanString(reader)) {
+                return false;
+            }
+            reader.readSpan();
+            return reader.readSpan().size() <= limits_.max_signature_size && reader.remaining() == 0;
+        }
+
+        inline bool scanTransactions(BinaryReader &reader, uint32_t count) const {
+            if (!fits(count, limits_.max_transactions, MIN_TRANSACTION_SIZE, reader)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (!scanTransaction(reader.readSpan())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Mirrors Block::serializeBinary
+        inline bool scanBlock(std::span<const uint8_t> bytes, bool header_only = false) const {
+            BinaryReader reader(bytes);
+            reader.readUint32();
+            if (!scanString(reader) || !scanString(reader)) {
+                return false;
+            }
+            reader.readUint32();
+            if (reader.readSpan().size() != 8 || !scanString(reader)) { // Timestamp, Merkle root
+                return false;
+            }
+            reader.readUint32();
+            if (!scanString(reader) || reader.readSpan().size() > limits_.max_signature_size) {
+                return false;
+            }
+            uint32_t count = reader.readUint32();
+            if (header_only && count != 0) {
+                return false;
+            }
+            return scanTransactions(reader, count) && reader.remaining() == 0;
+        }
+
+        inline bool scanBlocks(BinaryReader &reader, size_t limit, bool header_only) const {
+            uint32_t count = reader.readUint32();
+            if (!fits(count, limit, MIN_BLOCK_SIZE, reader)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (!scanBlock(reader.readSpan(), header_only)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline bool scanFrame(FrameType type, BinaryReader &reader) const {
+            switch (type) {
+            case FrameType::Hello:
+                return scanString(reader);
+            case FrameType::Block:
+                return scanBlock(reader.readRemaining());
+            case FrameType::Transaction:
+                return scanTransaction(reader.readRemaining());
+            case FrameType::GetChain:
+                reader.readUint64(); // First height wanted
+                return true;
+            case FrameType::Chain:
+                return scanBlocks(reader, limits_.max_chain_blocks, false);
+            case FrameType::CompactBlock: {
+                if (!scanBlock(reader.readSpan(), true)) {
+                    return false;
+                }
+                reader.readUint64(); // Salt
+                uint32_t ids = reader.readUint32();
+                if (!fits(ids, limits_.max_transactions, 6, reader)) {
+                    return false;
+                }
+                reader.skip(static_cast<size_t>(ids) * 6);
+                uint32_t prefilled = reader.readUint32();
+                if (!fits(prefilled, limits_.max_transactions - ids, MIN_TRANSACTION_SIZE + 4, reader)) {
+                    return false;
+                }
+                for (uint32_t i = 0; i < prefilled; i++) {
+                    reader.readUint32(); // Index; ordering is checked when decoded
+                    if (!scanTransaction(reader.readSpan())) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case FrameType::GetBlockTransactions: {
+                if (!scanString(reader)) {
+                    return false;
+                }
+                uint32_t count = reader.readUint32();
+                if (!fits(count, limits_.max_transactions, 4, reader)) {
+                    return false;
+                }
+                reader.skip(static_cast<size_t>(count) * 4);
+                return true;
+            }
+            case FrameType::BlockTransactions:
+                return scanString(reader) && scanTransactions(reader, reader.readUint32());
+            case FrameType::GetHeaders:
+            case FrameType::GetBodies:
+                return scanStrings(reader, limits_.max_hashes);
+            case FrameType::Headers:
+                return scanBlocks(reader, limits_.max_hashes, true);
+            case FrameType::Bodies: {
+                uint32_t count = reader.readUint32();
+                if (!fits(count, limits_.max_hashes, 8, reader)) {
+                    return false;
+                }
+                for (uint32_t i = 0; i < count; i++) {
+                    if (!scanString(reader)) {
+                        return false;
+                    }
+                    uint32_t transactions = reader.readUint32();
+                    if (transactions != NO_BODY && !scanTransactions(reader, transactions)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case FrameType::Inventory:
+            case FrameType::GetTransactions: {
+                uint32_t count = reader.readUint32();
+                if (!fits(count, limits_.max_inventory, MIN_DIGEST_SIZE, reader)) {
+                    return false;
+                }
+                reader.skip(static_cast<size_t>(count) * MIN_DIGEST_SIZE);
+                return true;
+            }
+            case FrameType::Transactions:
+                return scanTransactions(reader, reader.readUint32());
+            }
+            return false; // Unknown frame type
+        }
+    };
+
+} // namespace chain
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace chain {
+
+    // Counts what passes through to an upstream resource. Install one with std::pmr::set_default_resource, or
+    // pass it as the upstream of a BlockArena, to check that a hot path stays inside its arena.
+    class CountingResource : public std::pmr::memory_resource {
+      public:
+        inline explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : upstream_(upstream) {}
+
+        inline uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+        inline uint64_t deallocations() const { return deallocations_.load(std::memory_order_relaxed); }
+        inline uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+        inline void reset() {
+            allocations_.store(0, std::memory_order_relaxed);
+            deallocations_.store(0, std::memory_order_relaxed);
+            bytes_.store(0, std::memory_order_relaxed);
+        }
+
+      private:
+        std::pmr::memory_resource *upstream_;
+        std::atomic<uint64_t> allocations_{0};
+        std::atomic<uint64_t> deallocations_{0};
+        std::atomic<uint64_t> bytes_{0};
+
+        inline void *do_allocate(size_t bytes, size_t alignment) override {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        inline void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+            deallocations_.fetch_add(1, std::memory_order_relaxed);
+            upstream_->deallocate(p, bytes, alignment);
+        }
+
+        inline bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    // Scratch memory for one block's worth of work, e.g. the transaction strings and Merkle levels behind a
+    // root. Allocation is a pointer bump, deallocation is a no-op, and everything is released at once when the
+    // arena goes out of scope. The first INLINE_BYTES live inside the object, so small blocks never touch the
+    // heap; larger ones grow geometrically from the upstream resource.
+    class BlockArena {
+      public:
+        static constexpr size_t INLINE_BYTES = 16 * 1024;
+
+        inline explicit BlockArena(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : resource_(inline_.data(), inline_.size(), upstream) {}
+
+        inline BlockArena(const BlockArena &) = delete;
+        inline BlockArena &operator=(const BlockArena &) = delete;
+
+        inline std::pmr::memory_resource *get() { return &resource_; }
+
+      private:
+        alignas(std::max_align_t) std::array<std::byte, INLINE_BYTES> inline_;
+        std::pmr::monotonic_buffer_resource resource_;
+    };
+
+} // namespace chain
@@ -8,6 +8,8 @@
 #include <unordered_set>
 #include <vector>
 
+#include "metrics.hpp"
+
 namespace chain {
 
     // Generic authentication and authorization system for blockchain participants
@@ -21,6 +23,7 @@ namespace chain {
             participant_capabilities_; // Participant capabilities/permissions
         std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
             participant_metadata_; // Additional metadata
+        uint64_t revision_ = 0;    // Bumped whenever participants, capabilities or metadata change
 
       public:
         Authenticator() = default;
@@ -34,6 +37,7 @@ namespace chain {
             if (!metadata.empty()) {
                 participant_metadata_[participant_id] = metadata;
             }
+            revision_++;
             std::cout << "Participant " << participant_id << " registered with state: " << initial_state << std::endl;
         }
 
@@ -73,21 +77,28 @@ namespace chain {
                                            const std::string &value) {
             if (isParticipantAuthorized(participant_id)) {
                 participant_metadata_[participant_id][key] = value;
+                revision_++;
             }
         }
 
         // Check if transaction has been used (prevent duplicate actions/commands)
         inline bool isTransactionUsed(const std::string &tx_id) const {
-            return used_transaction_ids_.find(tx_id) != used_transaction_ids_.end();
+            bool used = used_transaction_ids_.find(tx_id) != used_transaction_ids_.end();
+            countMetric(used ? Counter::DedupHits : Counter::DedupMisses);
+            return used;
         }
 
         // Mark transaction as used
         inline void markTransactionUsed(const std::string &tx_id) { used_transaction_ids_.insert(tx_id); }
 
+        // Forget a transaction, e.g. when the block that recorded it is rolled back in a reorganization
+        inline void unmarkTransactionUsed(const std::string &tx_id) { used_transaction_ids_.erase(tx_id); }
+
         // Add capability to participant (e.g., "SPRAY", "HARVEST", "MOVE", "READ_SENSOR")
         inline void grantCapability(const std::string &participant_id, const std::string &capability) {
             if (isParticipantAuthorized(participant_id)) {
                 participant_capabilities_[participant_id].push_back(capability);
+                revision_++;
             }
         }
 
@@ -97,6 +108,7 @@ namespace chain {
                 auto &capabilities = participant_capabilities_[participant_id];
                 capabilities.erase(std::remove(capabilities.begin(), capabilities.end(), capability),
                                    capabilities.end());
+                revision_++;
             }
         }
 
@@ -140,6 +152,9 @@ namespace chain {
             return true;
         }
 
+        // Changes whenever participants, capabilities or metadata change, so callers can cache derived views
+        inline uint64_t getRevision() const { return revision_; }
+
         // Get all authorized participants
         inline std::unordered_set<std::string> getAuthorizedParticipants() const { return authorized_participants_; }
 
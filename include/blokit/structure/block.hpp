@@ -1,14 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
-#include <lockey/lockey.hpp>
+#include <memory_resource>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "arena.hpp"
 #include "merkle.hpp"
+#include "metrics.hpp"
+#include "sha256.hpp"
+#include "target.hpp"
+#include "trace.hpp"
 #include "transaction.hpp"
 
 using namespace std::chrono;
@@ -23,6 +31,9 @@ namespace chain {
         int64_t nonce_;
         Timestamp timestamp_;
         std::string merkle_root_; // Merkle root for transaction integrity
+        uint32_t target_bits_ = 0; // Compact proof-of-work target, 0 when the block carries no work
+        std::string sealer_id_;          // Proof-of-authority sealer, empty for unsealed blocks
+        std::vector<unsigned char> seal_; // Sealer's signature over hash_
 
         Block() = default;
         inline Block(std::vector<Transaction<T>> txns) {
@@ -41,35 +52,70 @@ namespace chain {
 
         // Build Merkle tree from transactions
         inline void buildMerkleTree() {
-            std::vector<std::string> tx_strings;
+            TraceSpan span("Block::buildMerkleTree");
+            merkle_root_ = computeMerkleRoot();
+        }
+
+        // Merkle root over the transactions as they are now. The leaves and tree levels live in a BlockArena
+        // that is dropped in one go on return.
+        inline std::string computeMerkleRoot() const {
+            BlockArena arena;
+            return MerkleTree::fromLeaves(merkleLeaves(arena.get())).getRoot();
+        }
+
+        // Each transaction's toString(), allocated from `resource`
+        inline std::pmr::vector<std::pmr::string> merkleLeaves(std::pmr::memory_resource *resource) const {
+            std::pmr::vector<std::pmr::string> leaves(resource);
+            leaves.reserve(transactions_.size());
             for (const auto &txn : transactions_) {
-                tx_strings.push_back(txn.toString());
+                txn.appendString(leaves.emplace_back());
             }
-            MerkleTree temp_tree(tx_strings);
-            merkle_root_ = temp_tree.getRoot();
+            return leaves;
         }
 
-        // Method to calculate the hash of the block
-        inline std::string calculateHash() const {
-            std::stringstream ss;
-            ss << index_ << timestamp_.sec << timestamp_.nanosec << previous_hash_ << nonce_;
+        // Fixed binary header layout hashed by calculateHash(). The nonce sits at the very end so a miner can
+        // hash the first 64 bytes once and only recompress the final block for each candidate nonce. Index and
+        // nonce are 32-bit, matching the binary serialization, which keeps the tail within one SHA-256 block.
+        static constexpr size_t HEADER_SIZE = 116;
+        // Reserved per transaction, and once for the header, before serializeBinary starts writing
+        static constexpr size_t SERIALIZED_SIZE_HINT = 256;
+        static constexpr size_t NONCE_OFFSET = 112;
+
+        inline std::array<uint8_t, HEADER_SIZE> headerBytes() const {
+            std::array<uint8_t, HEADER_SIZE> header{};
+            writeLittleEndian(header.data(), static_cast<uint32_t>(index_), 4);
+            writeLittleEndian(header.data() + 4, static_cast<uint32_t>(timestamp_.sec), 4);
+            writeLittleEndian(header.data() + 8, timestamp_.nanosec, 4);
+            auto previous = headerDigest(previous_hash_);
+            std::copy(previous.begin(), previous.end(), header.begin() + 12);
             // Use Merkle root instead of iterating through all transactions
-            ss << merkle_root_;
-
-            // Use lockey hash function and convert to hex
-            lockey::Lockey crypto(lockey::Lockey::Algorithm::AES_256_GCM, lockey::Lockey::HashAlgorithm::SHA256);
-            std::string data = ss.str();
-            std::vector<uint8_t> data_vec(data.begin(), data.end());
-            auto hash_result = crypto.hash(data_vec);
-
-            if (hash_result.success) {
-                return lockey::Lockey::to_hex(hash_result.data);
-            } else {
-                return ""; // Return empty string on hash failure
+            auto root = headerDigest(merkle_root_);
+            std::copy(root.begin(), root.end(), header.begin() + 44);
+            // Commit to the sealer so a seal cannot be moved to another authority; all zeros when unsealed
+            if (!sealer_id_.empty()) {
+                auto sealer = Sha256::hash(sealer_id_);
+                std::copy(sealer.begin(), sealer.end(), header.begin() + 76);
             }
+            writeLittleEndian(header.data() + 108, target_bits_, 4);
+            writeLittleEndian(header.data() + NONCE_OFFSET, static_cast<uint32_t>(nonce_), 4);
+            return header;
+        }
+
+        // Method to calculate the hash of the block
+        inline std::string calculateHash() const {
+            TraceSpan span("Block::calculateHash");
+            auto header = headerBytes();
+            // Same digest and hex encoding as Lockey's SHA-256, which the miner's midstate search already relies on
+            return Sha256::toHex(Sha256::hash(header.data(), header.size()));
         }
 
         inline bool isValid() const {
+            TraceSpan span("Block::isValid");
+            return hasValidHeader() && hasValidBody();
+        }
+
+        // Checks that need only the header: fields, hash and proof of work
+        inline bool hasValidHeader() const {
             // Basic field validation
             if (index_ < 0 || previous_hash_.empty() || hash_.empty()) {
                 std::cout << "Basic validation failed - Index: " << index_ << " Hash: " << hash_
@@ -83,13 +129,18 @@ namespace chain {
                 return false;
             }
 
-            // Verify Merkle root
-            std::vector<std::string> tx_strings;
-            for (const auto &txn : transactions_) {
-                tx_strings.push_back(txn.toString());
+            // Verify proof of work against the target committed in the header
+            if (target_bits_ != 0 && !Target::fromCompact(target_bits_).isMetBy(hash_)) {
+                std::cout << "Proof of work validation failed - hash above target" << std::endl;
+                return false;
             }
-            MerkleTree verification_tree(tx_strings);
-            if (merkle_root_ != verification_tree.getRoot()) {
+            return true;
+        }
+
+        // The transactions match the header's Merkle root and are individually valid
+        inline bool hasValidBody() const {
+            // Verify Merkle root
+            if (merkle_root_ != computeMerkleRoot()) {
                 std::cout << "Merkle root validation failed" << std::endl;
                 return false;
             }
@@ -112,11 +163,8 @@ namespace chain {
             }
 
             // Create temporary Merkle tree for verification
-            std::vector<std::string> tx_strings;
-            for (const auto &txn : transactions_) {
-                tx_strings.push_back(txn.toString());
-            }
-            MerkleTree verification_tree(tx_strings);
+            BlockArena arena;
+            auto verification_tree = MerkleTree::fromLeaves(merkleLeaves(arena.get()));
 
             // Get proof and verify
             auto proof = verification_tree.getProof(transaction_index);
@@ -137,7 +185,9 @@ namespace chain {
 
         // Binary serialization methods for unified system
         inline std::vector<uint8_t> serializeBinary() const {
+            TraceSpan span("Block::serializeBinary");
             std::vector<uint8_t> buffer;
+            buffer.reserve(SERIALIZED_SIZE_HINT * (transactions_.size() + 1));
 
             // Write index
             BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(index_));
@@ -152,50 +202,69 @@ namespace chain {
             BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(nonce_));
 
             // Write timestamp
-            auto timestampData = timestamp_.serializeBinary();
-            BinarySerializer::writeBytes(buffer, timestampData);
+            BinarySerializer::writeNested(buffer, [&](auto &out) { timestamp_.serializeBinary(out); });
 
             // Write merkle root
             BinarySerializer::writeString(buffer, merkle_root_);
 
+            // Write proof-of-work target
+            BinarySerializer::writeUint32(buffer, target_bits_);
+
+            // Write proof-of-authority sealer and seal
+            BinarySerializer::writeString(buffer, sealer_id_);
+            BinarySerializer::writeBytes(buffer, seal_);
+
             // Write transactions count and data
             BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(transactions_.size()));
             for (const auto &tx : transactions_) {
-                auto txData = tx.serializeBinary();
-                BinarySerializer::writeBytes(buffer, txData);
+                BinarySerializer::writeNested(buffer, [&](auto &out) { tx.serializeBinary(out); });
             }
 
+            countMetric(Counter::SerializedBytes, buffer.size());
             return buffer;
         }
 
         static Block<T> deserializeBinary(const std::vector<uint8_t> &data) {
+            return deserializeBinary(std::span<const uint8_t>(data));
+        }
+
+        // Reads in place, e.g. straight out of a network receive buffer
+        static Block<T> deserializeBinary(std::span<const uint8_t> data) {
+            TraceSpan span("Block::deserializeBinary");
+            countMetric(Counter::DeserializedBytes, data.size());
             Block<T> result;
-            size_t offset = 0;
+            BinaryReader reader(data);
 
             // Read index
-            result.index_ = static_cast<int64_t>(BinarySerializer::readUint32(data, offset));
+            result.index_ = static_cast<int64_t>(reader.readUint32());
 
             // Read previous hash
-            result.previous_hash_ = BinarySerializer::readString(data, offset);
+            result.previous_hash_ = reader.readString();
 
             // Read hash
-            result.hash_ = BinarySerializer::readString(data, offset);
+            result.hash_ = reader.readString();
 
             // Read nonce
-            result.nonce_ = static_cast<int64_t>(BinarySerializer::readUint32(data, offset));
+            result.nonce_ = static_cast<int64_t>(reader.readUint32());
 
             // Read timestamp
-            auto timestampData = BinarySerializer::readBytes(data, offset);
-            result.timestamp_ = Timestamp::deserializeBinary(timestampData);
+            result.timestamp_ = Timestamp::deserializeBinary(reader.readSpan());
 
             // Read merkle root
-            result.merkle_root_ = BinarySerializer::readString(data, offset);
+            result.merkle_root_ = reader.readString();
+
+            // Read proof-of-work target
+            result.target_bits_ = reader.readUint32();
+
+            // Read proof-of-authority sealer and seal
+            result.sealer_id_ = reader.readString();
+            result.seal_ = reader.readBytesToUChar();
 
             // Read transactions
-            uint32_t txCount = BinarySerializer::readUint32(data, offset);
+            uint32_t txCount = reader.readUint32();
+            result.transactions_.reserve(std::min<size_t>(txCount, reader.remaining() / 4));
             for (uint32_t i = 0; i < txCount; i++) {
-                auto txData = BinarySerializer::readBytes(data, offset);
-                result.transactions_.push_back(Transaction<T>::deserializeBinary(txData));
+                result.transactions_.push_back(Transaction<T>::deserializeBinary(reader.readSpan()));
             }
 
             return result;
@@ -209,6 +278,9 @@ namespace chain {
             ss << R"("previous_hash": ")" << JsonSerializer::escapeJson(previous_hash_) << R"(",)";
             ss << R"("hash": ")" << JsonSerializer::escapeJson(hash_) << R"(",)";
             ss << R"("nonce": )" << nonce_ << R"(,)";
+            ss << R"("target_bits": )" << target_bits_ << R"(,)";
+            ss << R"("sealer_id": ")" << JsonSerializer::escapeJson(sealer_id_) << R"(",)";
+            ss << R"("seal": ")" << base64Encode(seal_) << R"(",)";
             ss << R"("timestamp": )" << timestamp_.serialize() << R"(,)";
             ss << R"("merkle_root": ")" << JsonSerializer::escapeJson(merkle_root_) << R"(",)";
             ss << R"("transactions": [)";
@@ -252,6 +324,27 @@ namespace chain {
             size_t nonce_end = data.find(",", nonce_start);
             result.nonce_ = std::stoll(data.substr(nonce_start, nonce_end - nonce_start));
 
+            // Parse proof-of-work target (absent in blocks saved before targets were introduced)
+            size_t bits_pos = data.find("\"target_bits\": ");
+            if (bits_pos != std::string::npos && bits_pos < data.find("\"transactions\": [")) {
+                size_t bits_start = bits_pos + 15;
+                size_t bits_end = data.find(",", bits_start);
+                result.target_bits_ =
+                    static_cast<uint32_t>(std::stoul(data.substr(bits_start, bits_end - bits_start)));
+            }
+
+            // Parse proof-of-authority sealer and seal (also absent in older blocks)
+            size_t sealer_pos = data.find("\"sealer_id\": \"");
+            if (sealer_pos != std::string::npos && sealer_pos < data.find("\"transactions\": [")) {
+                size_t sealer_start = sealer_pos + 14;
+                size_t sealer_end = data.find("\"", sealer_start);
+                result.sealer_id_ = data.substr(sealer_start, sealer_end - sealer_start);
+
+                size_t seal_start = data.find("\"seal\": \"", sealer_end) + 9;
+                size_t seal_end = data.find("\"", seal_start);
+                result.seal_ = base64Decode(data.substr(seal_start, seal_end - seal_start));
+            }
+
             // Parse timestamp
             size_t ts_start = data.find("\"timestamp\": ") + 13;
             size_t ts_end = data.find("},", ts_start) + 1;
@@ -289,6 +382,28 @@ namespace chain {
         }
 
       private:
+        static inline void writeLittleEndian(uint8_t *out, uint64_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; i++) {
+                out[i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        // Hex-encoded SHA-256 hashes are stored as their 32 raw bytes; anything else (e.g. "GENESIS" or an
+        // empty Merkle root) is reduced to its SHA-256 so the header keeps a fixed size
+        static inline Sha256::Digest headerDigest(const std::string &field) {
+            bool is_hex = field.size() == 64 && std::all_of(field.begin(), field.end(), [](char c) {
+                              return std::isxdigit(static_cast<unsigned char>(c));
+                          });
+            if (!is_hex) {
+                return Sha256::hash(field);
+            }
+            Sha256::Digest digest;
+            for (size_t i = 0; i < digest.size(); i++) {
+                digest[i] = static_cast<uint8_t>(std::stoi(field.substr(i * 2, 2), nullptr, 16));
+            }
+            return digest;
+        }
+
         // Helper function to get the current timestamp
         inline std::string getCurrentTime() const {
             std::time_t now = std::time(nullptr);
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../consensus/authority.hpp"
+#include "auth.hpp"
+#include "block.hpp"
+
+namespace chain {
+
+    // What a fork choice rule may look at besides the block itself
+    struct ForkContext {
+        const Authenticator &auth;
+        const ProofOfAuthority *authority; // Null unless proof of authority is enabled
+    };
+
+    // Pluggable fork choice. Each block adds score() to its branch; the tip with the highest cumulative score is
+    // canonical, ties going to the greater height and then the lower hash so every node picks the same tip.
+    template <typename T> class ForkChoiceRule {
+      public:
+        virtual ~ForkChoiceRule() = default;
+        virtual std::string name() const = 0;
+        virtual double score(const Block<T> &block, const ForkContext &context) const = 0;
+    };
+
+    // Seal weight for sealed blocks, expected hashes for mined blocks, otherwise one per block
+    template <typename T> class HeaviestChainRule : public ForkChoiceRule<T> {
+      public:
+        inline std::string name() const override { return "heaviest-chain"; }
+
+        inline double score(const Block<T> &block, const ForkContext &context) const override {
+            if (context.authority != nullptr && !block.sealer_id_.empty()) {
+                return static_cast<double>(context.authority->blockWeight(block, context.auth));
+            }
+            return block.target_bits_ != 0 ? Target::fromCompact(block.target_bits_).work() : 1.0;
+        }
+    };
+
+    template <typename T> class LongestChainRule : public ForkChoiceRule<T> {
+      public:
+        inline std::string name() const override { return "longest-chain"; }
+        inline double score(const Block<T> &, const ForkContext &) const override { return 1.0; }
+    };
+
+    // Every known block keyed by hash. Blocks on the canonical chain live in Chain::blocks_; the tree only keeps
+    // their metadata and owns the blocks of side branches, which are moved in and out during reorganizations.
+    template <typename T> class BlockTree {
+      public:
+        struct Entry {
+            std::string hash;
+            std::string parent;
+            int64_t height = 0;
+            double cumulative_score = 0.0;
+            bool canonical = false;
+            std::optional<Block<T>> block; // Only set for side-branch blocks
+        };
+
+        inline bool contains(const std::string &hash) const { return entries_.find(hash) != entries_.end(); }
+
+        inline const Entry *find(const std::string &hash) const {
+            auto it = entries_.find(hash);
+            return it != entries_.end() ? &it->second : nullptr;
+        }
+
+        inline Entry *find(const std::string &hash) {
+            auto it = entries_.find(hash);
+            return it != entries_.end() ? &it->second : nullptr;
+        }
+
+        // Record a block joining the canonical chain; a known side-branch entry hands its block back
+        inline void connect(const Block<T> &block, double cumulative_score) {
+            auto &entry = entries_[block.hash_];
+            if (!entry.canonical) {
+                canonical_count_++;
+            }
+            entry.hash = block.hash_;
+            entry.parent = block.previous_hash_;
+            entry.height = block.index_;
+            entry.cumulative_score = cumulative_score;
+            entry.canonical = true;
+            entry.block.reset();
+        }
+
+        // Move a block that left the canonical chain into its entry
+        inline void disconnect(Block<T> &&block) {
+            auto &entry = entries_[block.hash_];
+            if (entry.canonical) {
+                canonical_count_--;
+            }
+            entry.canonical = false;
+            entry.block = std::move(block);
+        }
+
+        inline Entry &insertSide(const Block<T> &block, double cumulative_score) {
+            auto &entry = entries_[block.hash_];
+            entry.hash = block.hash_;
+            entry.parent = block.previous_hash_;
+            entry.height = block.index_;
+            entry.cumulative_score = cumulative_score;
+            entry.canonical = false;
+            entry.block = block;
+            return entry;
+        }
+
+        inline void erase(const std::string &hash) {
+            auto it = entries_.find(hash);
+            if (it != entries_.end()) {
+                if (it->second.canonical) {
+                    canonical_count_--;
+                }
+                entries_.erase(it);
+            }
+        }
+
+        // Side-branch hashes from `tip` down to (excluding) the first canonical ancestor, tip first
+        inline std::vector<std::string> branchTo(const std::string &tip) const {
+            std::vector<std::string> branch;
+            const Entry *entry = find(tip);
+            while (entry != nullptr && !entry->canonical) {
+                branch.push_back(entry->hash);
+                entry = find(entry->parent);
+            }
+            return branch;
+        }
+
+        // Forget side branches forking off the canonical chain below `height`, e.g. once that height is final and
+        // they can never win. Branches whose ancestry is already gone are dropped too.
+        inline size_t pruneSideBranches(int64_t height) {
+            std::vector<std::string> doomed;
+            for (const auto &[hash, entry] : entries_) {
+                if (entry.canonical) {
+                    continue;
+                }
+                const Entry *ancestor = &entry;
+                while (ancestor != nullptr && !ancestor->canonical) {
+                    ancestor = find(ancestor->parent);
+                }
+                if (ancestor == nullptr || ancestor->height < height) {
+                    doomed.push_back(hash);
+                }
+            }
+            for (const auto &hash : doomed) {
+                entries_.erase(hash);
+            }
+            return doomed.size();
+        }
+
+        inline void clear() {
+            entries_.clear();
+            canonical_count_ = 0;
+        }
+
+        inline size_t size() const { return entries_.size(); }
+        inline size_t canonicalCount() const { return canonical_count_; }
+        inline size_t sideCount() const { return entries_.size() - canonical_count_; }
+
+        // Tip ordering shared by every rule
+        static inline bool isBetterTip(const Entry &candidate, const Entry &current) {
+            if (candidate.cumulative_score != current.cumulative_score) {
+                return candidate.cumulative_score > current.cumulative_score;
+            }
+            if (candidate.height != current.height) {
+                return candidate.height > current.height;
+            }
+            return candidate.hash < current.hash;
+        }
+
+      private:
+        std::unordered_map<std::string, Entry> entries_;
+        size_t canonical_count_ = 0;
+    };
+
+} // namespace chain
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chain {
+
+    // Set membership with no false negatives and a tunable false positive rate. Items are given as two 64-bit
+    // hashes; the k probe positions are derived from them by double hashing, so callers hash each item once.
+    class BloomFilter {
+      public:
+        inline BloomFilter(size_t bits, size_t hashes)
+            : bits_(std::max<size_t>(bits, 64)), hashes_(std::max<size_t>(hashes, 1)), words_((bits_ + 63) / 64) {}
+
+        // Sized for `items` entries at `false_positive_rate`
+        inline static BloomFilter forCapacity(size_t items, double false_positive_rate) {
+            double n = static_cast<double>(std::max<size_t>(items, 1));
+            double ln2 = std::log(2.0);
+            double bits = std::ceil(-n * std::log(false_positive_rate) / (ln2 * ln2));
+            size_t hashes = static_cast<size_t>(std::round(bits / n * ln2));
+            return BloomFilter(static_cast<size_t>(bits), std::clamp<size_t>(hashes, 1, 30));
+        }
+
+        inline void add(uint64_t h1, uint64_t h2) {
+            for (size_t i = 0; i < hashes_; i++) {
+                uint64_t bit = (h1 + i * h2) % bits_;
+                words_[bit / 64] |= uint64_t{1} << (bit % 64);
+            }
+            count_++;
+        }
+
+        inline bool mightContain(uint64_t h1, uint64_t h2) const {
+            for (size_t i = 0; i < hashes_; i++) {
+                uint64_t bit = (h1 + i * h2) % bits_;
+                if ((words_[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline void clear() {
+            std::fill(words_.begin(), words_.end(), 0);
+            count_ = 0;
+        }
+
+        inline size_t getBitCount() const { return bits_; }
+        inline size_t getHashCount() const { return hashes_; }
+        inline uint64_t getInsertCount() const { return count_; } // Adds so far, duplicates included
+
+      private:
+        size_t bits_;
+        size_t hashes_;
+        std::vector<uint64_t> words_;
+        uint64_t count_ = 0;
+    };
+
+} // namespace chain
@@ -1,23 +1,68 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <vector>
 
+#include "../consensus/authority.hpp"
+#include "../consensus/difficulty.hpp"
+#include "../consensus/finality.hpp"
+#include "../consensus/miner.hpp"
 #include "auth.hpp"
 #include "block.hpp"
+#include "block_tree.hpp"
+#include "coin_store.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 using namespace std::chrono;
 
 namespace chain {
+    // Notified as blocks join or leave the canonical chain, e.g. to keep derived state in step across reorgs.
+    // Disconnections arrive tip first.
+    template <typename T> class ChainObserver {
+      public:
+        virtual ~ChainObserver() = default;
+        virtual void onBlockConnected(const Block<T> &block) = 0;
+        virtual void onBlockDisconnected(const Block<T> &block) = 0;
+        // Finalized blocks never disconnect again. Called in height order.
+        virtual void onBlockFinalized(const Block<T> &) {}
+        // Asked before a block joins the canonical chain, after the chain's own checks; false rejects the block
+        virtual bool validateBlock(const Block<T> &) { return true; }
+    };
+
     template <typename T> class Chain {
       public:
         std::string uuid_;
         Timestamp timestamp_;
         std::vector<Block<T>> blocks_;
         EntityManager entity_manager_; // For participant authentication and authorization management
+        DifficultyAdjuster difficulty_; // Proof-of-work target for the next block, disabled by default
+        size_t pow_activation_index_ = 0; // First block index whose target is checked against difficulty_
+        std::vector<DifficultyTuning> pow_tunings_; // Policy and block time by height, the first from activation
+        std::optional<ProofOfAuthority> authority_; // Round-robin sealing, disabled when empty
+        size_t poa_activation_index_ = 0;             // First block index that must carry a valid seal
+        mutable BlockTree<T> tree_;                   // Every known block, including side branches
+        std::shared_ptr<ForkChoiceRule<T>> fork_choice_ = std::make_shared<HeaviestChainRule<T>>();
+        std::vector<std::shared_ptr<ChainObserver<T>>> observers_;
+        uint64_t reorg_count_ = 0;
+        std::optional<FinalityGadget> finality_;  // Vote collection, disabled when empty
+        int64_t finalized_height_ = 0;            // Blocks up to here can no longer be reorganized away
+        QuorumCertificate finality_certificate_; // Commit certificate for the finalized block, empty for genesis
+        FinalityGadget::VoterSet finality_voters_; // Voters the certificate was formed under
+
+        // Bounds on what acceptBlock keeps off the canonical chain, so cheap forks cannot grow the tree without limit
+        static constexpr size_t MAX_SIDE_BRANCH_DEPTH = 256;
+        static constexpr size_t MAX_SIDE_BLOCKS = 1024;
+
+        // Target used when proof of work is switched on without an explicit one (two leading zero hex digits)
+        static constexpr uint32_t DEFAULT_TARGET_BITS = 0x2000ffff;
+        static constexpr double DEFAULT_BLOCK_SECONDS = 10.0;
 
         Chain() = default;
         inline Chain(std::string s_uuid, std::string t_uuid, T function, std::shared_ptr<chain::Crypto> privateKey_,
@@ -38,41 +83,408 @@ namespace chain {
 
         // Method to add a new block to the blockchain
         inline bool addBlock(const Block<T> &newBlock) {
+            MetricTimer timer(Histogram::AddBlock);
+            TraceSpan span("Chain::addBlock");
             Block<T> blockToAdd = newBlock;
             blockToAdd.previous_hash_ = blocks_.back().hash_;
             blockToAdd.index_ = blocks_.back().index_ + 1;
 
-            // Validate transactions against entity manager
-            for (const auto &txn : blockToAdd.transactions_) {
-                // Check for duplicate transaction
-                if (entity_manager_.isTransactionUsed(txn.uuid_)) {
-                    std::cout << "Duplicate transaction detected: " << txn.uuid_ << std::endl;
-                    return false;
+            // Rebuild Merkle tree and recalculate hash after updating previous_hash and index
+            blockToAdd.buildMerkleTree();
+            blockToAdd.hash_ = blockToAdd.calculateHash();
+
+            if (!appendBlock(blockToAdd)) {
+                return false;
+            }
+            finalizePending(blocks_.size() - 1);
+            return true;
+        }
+
+        // Append a block produced elsewhere exactly as received. Unlike addBlock nothing is relinked or rehashed,
+        // so the block must already extend the current tip.
+        inline bool importBlock(const Block<T> &block) {
+            MetricTimer timer(Histogram::AddBlock);
+            TraceSpan span("Chain::importBlock");
+            if (block.previous_hash_ != blocks_.back().hash_ || block.index_ != blocks_.back().index_ + 1) {
+                std::cout << "Block " << block.index_ << " does not extend the chain tip" << std::endl;
+                return false;
+            }
+            if (!appendBlock(block)) {
+                return false;
+            }
+            finalizePending(blocks_.size() - 1);
+            return true;
+        }
+
+        // Accept a block from anywhere in the tree. Blocks extending the tip are appended; blocks on side branches
+        // are kept and trigger a reorganization once their branch wins fork choice. Side-branch blocks get header
+        // checks against their parent (target, seal) up front and the remaining contextual checks on connect.
+        inline bool acceptBlock(const Block<T> &block) {
+            syncTree();
+            if (tree_.contains(block.hash_)) {
+                return false;
+            }
+            const auto *parent = tree_.find(block.previous_hash_);
+            if (parent == nullptr) {
+                std::cout << "Block " << block.index_ << " has an unknown parent" << std::endl;
+                return false;
+            }
+            if (block.index_ != parent->height + 1) {
+                std::cout << "Block " << block.index_ << " does not follow its parent's height" << std::endl;
+                return false;
+            }
+            if (parent->hash == blocks_.back().hash_) {
+                return importBlock(block);
+            }
+
+            if (block.index_ <= finalized_height_) {
+                std::cout << "Block " << block.index_ << " conflicts with a finalized block" << std::endl;
+                return false;
+            }
+            if (!isValidSideBlock(block, *parent)) {
+                std::cout << "Rejected invalid side-branch block " << block.index_ << std::endl;
+                return false;
+            }
+            auto &entry = tree_.insertSide(block, parent->cumulative_score + blockScore(block));
+            if (BlockTree<T>::isBetterTip(entry, *tree_.find(blocks_.back().hash_))) {
+                return reorganize(block.hash_);
+            }
+            return true;
+        }
+
+        // Feed a peer's copy of the chain through acceptBlock. True if this chain now ends on the candidate's tip.
+        inline bool switchToFork(const std::vector<Block<T>> &candidate) {
+            if (candidate.empty() || candidate.front().hash_ != blocks_.front().hash_) {
+                std::cout << "Fork does not share this chain's genesis block" << std::endl;
+                return false;
+            }
+            syncTree();
+            std::string old_tip = blocks_.back().hash_;
+            for (size_t i = 1; i < candidate.size(); i++) {
+                if (!tree_.contains(candidate[i].hash_) && !acceptBlock(candidate[i])) {
+                    break;
                 }
+            }
+            return blocks_.back().hash_ != old_tip && blocks_.back().hash_ == candidate.back().hash_;
+        }
 
-                // For robot coordination, you could add entity authorization checks here
-                // For example: if (!entity_manager_.isEntityAuthorized(txn.issuer_entity_)) { return false; }
+        // Fork choice for a peer's copy of the chain without importing it: true if its tip would beat the current
+        // tip under fork_choice_. Only the blocks this chain does not know yet are scored.
+        inline bool prefersFork(const std::vector<Block<T>> &candidate) const {
+            if (candidate.empty() || candidate.front().hash_ != blocks_.front().hash_) {
+                return false;
+            }
+            syncTree();
+            size_t known = candidate.size();
+            while (!tree_.contains(candidate[known - 1].hash_)) {
+                known--;
             }
+            typename BlockTree<T>::Entry tip;
+            tip.hash = candidate.back().hash_;
+            tip.height = candidate.back().index_;
+            tip.cumulative_score = tree_.find(candidate[known - 1].hash_)->cumulative_score;
+            for (size_t i = known; i < candidate.size(); i++) {
+                tip.cumulative_score += blockScore(candidate[i]);
+            }
+            return BlockTree<T>::isBetterTip(tip, *tree_.find(blocks_.back().hash_));
+        }
 
-            // Rebuild Merkle tree and recalculate hash after updating previous_hash and index
-            blockToAdd.buildMerkleTree();
-            blockToAdd.hash_ = blockToAdd.calculateHash();
+        inline bool hasBlock(const std::string &hash) {
+            syncTree();
+            return tree_.contains(hash);
+        }
 
-            if (!blockToAdd.isValid()) {
-                std::cout << "Invalid block attempted to be added to the blockchain" << std::endl;
+        // A canonical or side-branch block by hash, nullptr if unknown
+        inline const Block<T> *findBlock(const std::string &hash) {
+            syncTree();
+            const auto *entry = tree_.find(hash);
+            if (entry == nullptr) {
+                return nullptr;
+            }
+            if (entry->block) {
+                return &*entry->block;
+            }
+            size_t height = static_cast<size_t>(entry->height);
+            return height < blocks_.size() && blocks_[height].hash_ == hash ? &blocks_[height] : nullptr;
+        }
+
+        // Context-free checks a header can pass before its body arrives: hash, proof of work and, on
+        // proof-of-authority chains, the seal. Sealer rotation and transactions are checked on connect.
+        inline bool isValidHeader(const Block<T> &header) const {
+            if (!header.hasValidHeader()) {
                 return false;
             }
+            size_t height = static_cast<size_t>(header.index_);
+            if (difficulty_.isEnabled() && height >= pow_activation_index_ && header.target_bits_ == 0) {
+                std::cout << "Header " << header.index_ << " carries no proof of work" << std::endl;
+                return false;
+            }
+            return !authority_ || height < poa_activation_index_ || authority_->verifySeal(header, entity_manager_);
+        }
 
-            // Mark all transactions as used
-            for (const auto &txn : blockToAdd.transactions_) {
-                entity_manager_.markTransactionUsed(txn.uuid_);
+        // Difficulty for checking a header chain that follows the first `length` canonical blocks
+        inline DifficultyAdjuster headerDifficulty(size_t length) const {
+            return length < pow_activation_index_ ? difficultyOrigin() : difficultyAt(length);
+        }
+
+        // isValidHeader, plus the proof-of-work target the policy owes the header after the ones before it.
+        // `difficulty` starts from headerDifficulty and is advanced past each header that passes.
+        inline bool isValidHeader(const Block<T> &header, DifficultyAdjuster &difficulty) const {
+            if (!isValidHeader(header)) {
+                return false;
+            }
+            if (!difficulty_.isEnabled()) {
+                return true;
+            }
+            size_t height = static_cast<size_t>(header.index_);
+            if (height >= pow_activation_index_ && header.target_bits_ != difficulty.getNextTargetBits()) {
+                std::cout << "Header " << header.index_ << " has unexpected proof-of-work target" << std::endl;
+                return false;
             }
+            if (height + 1 >= pow_activation_index_) {
+                feedDifficulty(difficulty, height, header.timestamp_);
+            }
+            return true;
+        }
 
-            std::cout << "Adding block to chain" << std::endl;
-            blocks_.push_back(blockToAdd);
+        // Replace the fork choice rule; cumulative scores are recomputed and side branches dropped
+        inline void setForkChoiceRule(std::shared_ptr<ForkChoiceRule<T>> rule) {
+            fork_choice_ = std::move(rule);
+            tree_.clear();
+            syncTree();
+        }
+
+        inline void addObserver(std::shared_ptr<ChainObserver<T>> observer) {
+            observers_.push_back(std::move(observer));
+        }
+
+        inline uint64_t getReorgCount() const { return reorg_count_; }
+
+        inline const BlockTree<T> &getBlockTree() {
+            syncTree();
+            return tree_;
+        }
+
+        // Start collecting finality votes for this chain from participants registered with registerVoter
+        inline void enableFinality() { finality_.emplace(uuid_); }
+
+        inline bool isFinalityEnabled() const { return finality_.has_value(); }
+
+        inline const FinalityGadget *getFinality() const { return finality_ ? &*finality_ : nullptr; }
+
+        // Register (if needed) a participant as a finality voter with the PEM public key its votes verify against
+        inline void registerVoter(const std::string &voter_id, const std::string &public_key_pem) {
+            if (!entity_manager_.isParticipantAuthorized(voter_id)) {
+                entity_manager_.registerParticipant(voter_id, "active");
+            }
+            entity_manager_.setParticipantMetadata(voter_id, ProofOfAuthority::PUBLIC_KEY_METADATA, public_key_pem);
+            if (!entity_manager_.hasCapability(voter_id, FinalityGadget::VOTER_CAPABILITY)) {
+                entity_manager_.grantCapability(voter_id, FinalityGadget::VOTER_CAPABILITY);
+            }
+        }
+
+        // Collect a finality vote. Returns the certificate if this vote completed one; a block is finalized once
+        // it has both certificates and is on this chain, whichever of the two completes last.
+        inline std::optional<QuorumCertificate> addFinalityVote(const FinalityVote &vote) {
+            if (!finality_ || vote.height <= finalized_height_) {
+                return std::nullopt;
+            }
+            auto qc = finality_->addVote(vote, entity_manager_);
+            if (qc) {
+                if (const auto *commit = finality_->getCertificate(VotePhase::Commit, qc->block_hash)) {
+                    QuorumCertificate certificate = *commit;
+                    finalize(certificate);
+                }
+            }
+            return qc;
+        }
+
+        // Finalize the block a commit certificate is for, with all its ancestors. Side branches forking below it
+        // are pruned. The block must also hold a prepare certificate: commit votes alone do not show that no
+        // conflicting block at that height was prepared. A certificate for a block not yet on the chain, or not
+        // yet prepared, is kept until both are there.
+        inline bool finalize(const QuorumCertificate &qc) {
+            if (!finality_ || qc.phase != VotePhase::Commit || qc.height <= finalized_height_ ||
+                !finality_->verifyCertificate(qc, entity_manager_)) {
+                return false;
+            }
+            if (qc.height >= static_cast<int64_t>(blocks_.size()) || blocks_[qc.height].hash_ != qc.block_hash ||
+                finality_->getCertificate(VotePhase::Prepare, qc.block_hash) == nullptr) {
+                finality_->addCertificate(qc);
+                return false;
+            }
+            for (int64_t h = finalized_height_ + 1; h <= qc.height; h++) {
+                for (const auto &observer : observers_) {
+                    observer->onBlockFinalized(blocks_[h]);
+                }
+            }
+            finalized_height_ = qc.height;
+            finality_certificate_ = qc;
+            finality_voters_ = finality_->recordVoters(entity_manager_);
+            syncTree();
+            tree_.pruneSideBranches(finalized_height_);
+            finality_->prune(finalized_height_);
+            std::cout << "Finalized block " << finalized_height_ << std::endl;
+            return true;
+        }
+
+        inline int64_t getFinalizedHeight() const { return finalized_height_; }
+
+        inline const std::string &getFinalizedHash() const { return blocks_[finalized_height_].hash_; }
+
+        inline const QuorumCertificate &getFinalityCertificate() const { return finality_certificate_; }
+
+        inline bool isFinalized(const std::string &hash) const {
+            for (int64_t h = finalized_height_; h >= 0 && h < static_cast<int64_t>(blocks_.size()); h--) {
+                if (blocks_[h].hash_ == hash) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // The persisted finality certificate must still verify, against the voters it was formed under, and point
+        // at the block at its height. A finalized height on a chain without finality enabled cannot be checked and
+        // fails.
+        inline bool hasValidFinality() const {
+            if (finality_certificate_.empty()) {
+                return finalized_height_ == 0;
+            }
+            if (finality_certificate_.height != finalized_height_ ||
+                finalized_height_ >= static_cast<int64_t>(blocks_.size()) ||
+                blocks_[finalized_height_].hash_ != finality_certificate_.block_hash) {
+                return false;
+            }
+            if (!finality_) {
+                std::cout << "Finalized height " << finalized_height_ << " cannot be verified without finality"
+                          << std::endl;
+                return false;
+            }
+            if (finality_voters_.empty()) {
+                return finality_->verifyCertificate(finality_certificate_, entity_manager_);
+            }
+            return finality_->verifyCertificate(finality_certificate_, finality_voters_);
+        }
+
+        // Link a block to the tip, mine it against the current target and append it
+        inline bool mineBlock(Block<T> block, size_t threads = std::thread::hardware_concurrency()) {
+            block.previous_hash_ = blocks_.back().hash_;
+            block.index_ = blocks_.back().index_ + 1;
+            if (difficulty_.isEnabled()) {
+                block.target_bits_ = difficulty_.getNextTargetBits();
+            }
+            block.buildMerkleTree();
+
+            Miner<T> miner(threads);
+            auto result = miner.mine(block, Target::fromCompact(block.target_bits_));
+            if (!result.found) {
+                std::cout << "Mining failed to find a nonce for block " << block.index_ << std::endl;
+                return false;
+            }
+            return addBlock(block);
+        }
+
+        // Require every block appended from now on to be sealed by an authorized sealer in round-robin order
+        inline void enableProofOfAuthority(double round_seconds = 1.0) {
+            authority_.emplace(round_seconds);
+            poa_activation_index_ = blocks_.size();
+        }
+
+        inline bool isProofOfAuthorityEnabled() const { return authority_.has_value(); }
+
+        inline const ProofOfAuthority *getAuthority() const { return authority_ ? &*authority_ : nullptr; }
+
+        // Register (if needed) a participant as a sealer with the PEM public key its seals verify against
+        inline void registerSealer(const std::string &sealer_id, const std::string &public_key_pem) {
+            if (!entity_manager_.isParticipantAuthorized(sealer_id)) {
+                entity_manager_.registerParticipant(sealer_id, "active");
+            }
+            entity_manager_.setParticipantMetadata(sealer_id, ProofOfAuthority::PUBLIC_KEY_METADATA, public_key_pem);
+            if (!entity_manager_.hasCapability(sealer_id, ProofOfAuthority::SEALER_CAPABILITY)) {
+                entity_manager_.grantCapability(sealer_id, ProofOfAuthority::SEALER_CAPABILITY);
+            }
+        }
+
+        // Sealer expected to seal the next block
+        inline std::string getInTurnSealer() const {
+            return authority_ ? authority_->getInTurnSealer(entity_manager_, blocks_.back().index_ + 1) : "";
+        }
+
+        // Link a block to the tip, seal it as `sealer_id` and append it
+        inline bool sealBlock(Block<T> block, const std::string &sealer_id, std::shared_ptr<Crypto> key) {
+            if (!authority_) {
+                std::cout << "Proof of authority is not enabled" << std::endl;
+                return false;
+            }
+            block.previous_hash_ = blocks_.back().hash_;
+            block.index_ = blocks_.back().index_ + 1;
+            block.buildMerkleTree();
+            authority_->seal(block, sealer_id, key);
+            return addBlock(block);
+        }
+
+        // True if `sealer_id` sealed none of the last getRecentSealLimit() - 1 blocks
+        inline bool canSeal(const std::string &sealer_id) const {
+            if (!authority_) {
+                return false;
+            }
+            size_t recent = authority_->getRecentSealLimit(entity_manager_) - 1;
+            for (size_t i = 0; i < recent && i < blocks_.size() - poa_activation_index_; i++) {
+                if (blocks_[blocks_.size() - 1 - i].sealer_id_ == sealer_id) {
+                    return false;
+                }
+            }
             return true;
         }
 
+        // Fork choice weight of the sealed part of the chain (in-turn blocks count double)
+        inline uint64_t getSealWeight() const {
+            return authority_ ? authority_->chainWeight(blocks_, entity_manager_, poa_activation_index_) : 0;
+        }
+
+        // Require proof of work on every block appended from now on. The target starts at `initial_bits`
+        // and `policy` retargets it towards one block every `target_block_seconds`. On a chain that already
+        // requires proof of work this retunes instead: activation and the current target stay where they are,
+        // `initial_bits` is ignored, and the new policy and block time take over from the tip.
+        inline void enableProofOfWork(uint32_t initial_bits, double target_block_seconds,
+                                      std::shared_ptr<DifficultyPolicy> policy) {
+            if (difficulty_.isEnabled()) {
+                retuneDifficulty(std::move(policy), target_block_seconds);
+                return;
+            }
+            pow_activation_index_ = blocks_.size();
+            pow_tunings_ = {DifficultyTuning{pow_activation_index_, policy, target_block_seconds}};
+            difficulty_ = DifficultyAdjuster(std::move(policy), initial_bits, target_block_seconds);
+            if (!blocks_.empty()) {
+                difficulty_.onBlock(blocks_.back().timestamp_);
+            }
+        }
+
+        inline bool isProofOfWorkEnabled() const { return difficulty_.isEnabled(); }
+
+        // Retarget every `interval` blocks from the current tip onwards
+        inline void setDifficultyAdjustmentInterval(size_t interval) {
+            double seconds = difficulty_.isEnabled() ? difficulty_.getTargetBlockSeconds() : DEFAULT_BLOCK_SECONDS;
+            enableProofOfWork(currentOrDefaultBits(), seconds, std::make_shared<FixedWindowRetarget>(interval));
+        }
+
+        // Aim for one block every `seconds` from the current tip onwards
+        inline void setTargetBlockTime(double seconds) {
+            auto policy = difficulty_.isEnabled() ? difficulty_.getPolicy()
+                                                  : std::make_shared<FixedWindowRetarget>(DEFAULT_RETARGET_INTERVAL);
+            enableProofOfWork(currentOrDefaultBits(), seconds, policy);
+        }
+
+        inline uint32_t getNextTargetBits() const { return difficulty_.getNextTargetBits(); }
+
+        inline double getCurrentDifficulty() const {
+            return Target::fromCompact(difficulty_.getNextTargetBits()).difficulty();
+        }
+
+        inline double getInitialDifficulty() const {
+            return Target::fromCompact(difficulty_.getInitialTargetBits()).difficulty();
+        }
+
         inline bool addBlock(std::string uuid, T function, std::shared_ptr<chain::Crypto> privateKey_,
                              int16_t priority = 100) {
             Transaction<T> genesisTransaction(uuid, function, priority);
@@ -105,6 +517,51 @@ namespace chain {
                     return false;
                 }
             }
+            return hasValidTargets() && hasValidSeals() && hasValidFinality();
+        }
+
+        // Every block since proof of authority was enabled must carry a valid seal from a sealer authorized at its
+        // height
+        inline bool hasValidSeals() const {
+            if (!authority_) {
+                return true;
+            }
+            for (size_t i = poa_activation_index_; i < blocks_.size(); i++) {
+                if (!authority_->verifyRecordedSeal(blocks_[i], entity_manager_)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Replay the difficulty policy from the block proof of work was enabled at and check every later block
+        // used the target that was required when it was appended
+        inline bool hasValidTargets() const {
+            if (!difficulty_.isEnabled()) {
+                // A target nobody can check, e.g. on a chain loaded without its difficulty policy
+                for (size_t i = 0; i < blocks_.size(); i++) {
+                    if (blocks_[i].target_bits_ != 0) {
+                        std::cout << "Block " << i << " carries a target but no difficulty policy is set" << std::endl;
+                        return false;
+                    }
+                }
+                return true;
+            }
+            if (pow_activation_index_ > blocks_.size()) {
+                std::cout << "Proof of work activates past the chain tip" << std::endl;
+                return false;
+            }
+            DifficultyAdjuster replay = difficultyOrigin();
+            if (pow_activation_index_ > 0) {
+                feedDifficulty(replay, pow_activation_index_ - 1, blocks_[pow_activation_index_ - 1].timestamp_);
+            }
+            for (size_t i = pow_activation_index_; i < blocks_.size(); i++) {
+                if (blocks_[i].target_bits_ != replay.getNextTargetBits()) {
+                    std::cout << "Block " << i << " has unexpected proof-of-work target" << std::endl;
+                    return false;
+                }
+                feedDifficulty(replay, i, blocks_[i].timestamp_);
+            }
             return true;
         }
 
@@ -235,6 +692,44 @@ namespace chain {
             ss << R"({)";
             ss << R"("uuid": ")" << uuid_ << R"(",)";
             ss << R"("timestamp": )" << timestamp_.serialize() << R"(,)";
+            ss << R"("finality": {"height": )" << finalized_height_ << R"(, "certificate": )"
+               << finality_certificate_.serialize() << R"(, "enabled": )" << (finality_ ? "true" : "false");
+            if (finality_) {
+                // The entity manager does not keep capabilities or metadata, so voters and their keys go here
+                ss << R"(, "voters": [)";
+                const auto &voters = finality_->getVoters(entity_manager_);
+                for (size_t i = 0; i < voters.size(); i++) {
+                    std::string pem = entity_manager_.getParticipantMetadata(voters[i],
+                                                                             ProofOfAuthority::PUBLIC_KEY_METADATA);
+                    ss << (i > 0 ? "," : "") << R"({"id": ")" << voters[i] << R"(", "public_key": ")"
+                       << base64Encode(std::vector<unsigned char>(pem.begin(), pem.end())) << R"("})";
+                }
+                ss << "]";
+                ss << R"(, "certificate_voters": {"quorum": )" << finality_voters_.quorum << R"(, "voters": [)";
+                size_t i = 0;
+                for (const auto &[voter, pem] : finality_voters_.public_keys) {
+                    ss << (i++ > 0 ? "," : "") << R"({"id": ")" << voter << R"(", "public_key": ")"
+                       << base64Encode(std::vector<unsigned char>(pem.begin(), pem.end())) << R"("})";
+                }
+                ss << "]}";
+            }
+            ss << R"(},)";
+            if (difficulty_.isEnabled()) {
+                // The policy in force at activation, then every retune after it
+                ss << R"("proof_of_work": {"activation": )" << pow_activation_index_ << R"(, "difficulty": )"
+                   << difficultyOrigin().serialize() << R"(, "retunes": [)";
+                for (size_t j = 1; j < pow_tunings_.size(); j++) {
+                    DifficultyAdjuster tuning(pow_tunings_[j].policy, difficulty_.getInitialTargetBits(),
+                                              pow_tunings_[j].block_seconds);
+                    ss << (j > 1 ? "," : "") << R"({"from": )" << pow_tunings_[j].from << R"(, "difficulty": )"
+                       << tuning.serialize() << "}";
+                }
+                ss << R"(]},)";
+            }
+            if (authority_) {
+                ss << R"("proof_of_authority": {"activation": )" << poa_activation_index_ << R"(, "authority": )"
+                   << authority_->serialize() << R"(},)";
+            }
             ss << R"("blocks": [)";
 
             for (size_t i = 0; i < blocks_.size(); ++i) {
@@ -264,6 +759,65 @@ namespace chain {
             size_t ts_end = data.find("},", ts_start) + 1;
             result.timestamp_ = Timestamp::deserialize(data.substr(ts_start, ts_end - ts_start));
 
+            // Parse finality checkpoint and voters (absent in older chains)
+            auto parse_voters = [&data](size_t begin, size_t end) {
+                std::map<std::string, std::string> parsed;
+                for (size_t pos = data.find("\"id\": \"", begin); pos < end; pos = data.find("\"id\": \"", pos + 1)) {
+                    size_t id_start = pos + 7;
+                    std::string id = data.substr(id_start, data.find("\"", id_start) - id_start);
+                    size_t key_start = data.find("\"public_key\": \"", id_start) + 15;
+                    auto pem = base64Decode(data.substr(key_start, data.find("\"", key_start) - key_start));
+                    parsed.emplace(std::move(id), std::string(pem.begin(), pem.end()));
+                }
+                return parsed;
+            };
+            std::map<std::string, std::string> voters;
+            size_t finality_pos = data.find("\"finality\": {");
+            if (finality_pos != std::string::npos && finality_pos < data.find("\"blocks\": [")) {
+                size_t height_start = finality_pos + 23;
+                size_t height_end = data.find(",", height_start);
+                result.finalized_height_ = std::stoll(data.substr(height_start, height_end - height_start));
+                size_t cert_start = data.find("\"certificate\": ", height_end) + 15;
+                size_t cert_end = data.find("]}", cert_start) + 2;
+                std::string cert_data = data.substr(cert_start, cert_end - cert_start);
+                result.finality_certificate_ = QuorumCertificate::deserialize(cert_data);
+                if (data.compare(cert_end, 17, ", \"enabled\": true") == 0) {
+                    result.finality_.emplace(result.uuid_);
+                    size_t voters_start = data.find("\"voters\": [", cert_end);
+                    voters = parse_voters(voters_start, data.find("]", voters_start));
+                    // Chains saved before the certificate's voters were recorded check it against the current ones
+                    size_t recorded_pos = data.find("\"certificate_voters\": {", voters_start);
+                    if (recorded_pos < data.find("\"blocks\": [")) {
+                        size_t quorum_start = recorded_pos + 33;
+                        size_t quorum = std::stoull(
+                            data.substr(quorum_start, data.find(",", quorum_start) - quorum_start));
+                        size_t recorded_start = data.find("\"voters\": [", quorum_start);
+                        result.finality_voters_ = FinalityGadget::loadVoters(
+                            parse_voters(recorded_start, data.find("]", recorded_start)), quorum);
+                    }
+                }
+            }
+
+            // Parse proof-of-work settings, applied once the blocks are in (absent unless proof of work is on)
+            size_t pow_pos = data.find("\"proof_of_work\": {");
+            std::string pow_data;
+            if (pow_pos != std::string::npos && pow_pos < data.find("\"blocks\": [")) {
+                size_t pow_end = std::min(data.find("\"proof_of_authority\": {", pow_pos), data.find("\"blocks\": ["));
+                pow_data = data.substr(pow_pos, pow_end - pow_pos);
+            }
+
+            // Parse proof-of-authority settings and sealer history (absent unless proof of authority is on)
+            size_t poa_pos = data.find("\"proof_of_authority\": {");
+            if (poa_pos != std::string::npos && poa_pos < data.find("\"blocks\": [")) {
+                size_t activation_start = poa_pos + 37;
+                result.poa_activation_index_ = std::stoull(
+                    data.substr(activation_start, data.find(",", activation_start) - activation_start));
+                size_t authority_start = data.find("\"authority\": ", poa_pos) + 13;
+                size_t authority_end = data.find("]}},", authority_start) + 3;
+                result.authority_ =
+                    ProofOfAuthority::deserialize(data.substr(authority_start, authority_end - authority_start));
+            }
+
             // Parse blocks array
             size_t blocks_array_start = data.find("\"blocks\": [") + 11;
             size_t blocks_array_end = data.find("],", blocks_array_start);
@@ -292,6 +846,45 @@ namespace chain {
             size_t entity_end = data.rfind("}");
             std::string entity_data = data.substr(entity_start, entity_end - entity_start);
             result.entity_manager_ = EntityManager::deserialize(entity_data);
+            for (const auto &[voter_id, public_key_pem] : voters) {
+                result.registerVoter(voter_id, public_key_pem);
+            }
+
+            // Replay the blocks since activation to rebuild the difficulty window. An unknown policy leaves proof
+            // of work off, and isValid() then rejects the blocks that carry targets.
+            if (!pow_data.empty()) {
+                size_t activation_start = pow_data.find("\"activation\": ") + 14;
+                result.pow_activation_index_ = std::stoull(
+                    pow_data.substr(activation_start, pow_data.find(",", activation_start) - activation_start));
+                size_t difficulty_start = pow_data.find("\"difficulty\": ");
+                result.difficulty_ = DifficultyAdjuster::deserialize(pow_data.substr(difficulty_start));
+                if (result.difficulty_.isEnabled()) {
+                    result.pow_tunings_ = {DifficultyTuning{result.pow_activation_index_,
+                                                            result.difficulty_.getPolicy(),
+                                                            result.difficulty_.getTargetBlockSeconds()}};
+                }
+                size_t retunes = pow_data.find("\"retunes\": [");
+                for (size_t pos = retunes == std::string::npos ? retunes : pow_data.find("{\"from\": ", retunes);
+                     pos != std::string::npos && result.difficulty_.isEnabled();
+                     pos = pow_data.find("{\"from\": ", pos + 1)) {
+                    size_t from_start = pos + 9;
+                    size_t tuning_start = pow_data.find("\"difficulty\": ", pos);
+                    auto tuning = DifficultyAdjuster::deserialize(pow_data.substr(tuning_start));
+                    if (!tuning.isEnabled()) {
+                        result.difficulty_ = DifficultyAdjuster(); // A retune nobody can replay
+                        break;
+                    }
+                    result.pow_tunings_.push_back(DifficultyTuning{
+                        std::stoull(pow_data.substr(from_start, pow_data.find(",", from_start) - from_start)),
+                        tuning.getPolicy(), tuning.getTargetBlockSeconds()});
+                }
+                if (result.difficulty_.isEnabled()) {
+                    size_t first = result.pow_activation_index_ > 0 ? result.pow_activation_index_ - 1 : 0;
+                    for (size_t i = first; i < result.blocks_.size(); i++) {
+                        result.feedDifficulty(result.difficulty_, i, result.blocks_[i].timestamp_);
+                    }
+                }
+            }
 
             return result;
         }
@@ -305,8 +898,16 @@ namespace chain {
                     return false;
                 }
 
-                file << serialize();
-                file.close();
+                std::string data = serialize();
+                {
+                    MetricTimer timer(Histogram::StorageSync);
+                    file << data;
+                    file.close();
+                    if (file.fail() || !syncFileToDisk(filename)) {
+                        std::cerr << "Failed to write blockchain to " << filename << std::endl;
+                        return false;
+                    }
+                }
 
                 std::cout << "Blockchain saved to " << filename << std::endl;
                 return true;
@@ -337,5 +938,281 @@ namespace chain {
                 return false;
             }
         }
+
+      private:
+        static constexpr size_t DEFAULT_RETARGET_INTERVAL = 10;
+
+        // Consensus, duplicate and integrity checks shared by addBlock and importBlock
+        inline bool appendBlock(const Block<T> &blockToAdd) {
+            TraceSpan span("Chain::appendBlock");
+            syncTree();
+
+            // Proof-of-work chains only accept the target the difficulty policy asks for
+            if (difficulty_.isEnabled() && blockToAdd.target_bits_ != difficulty_.getNextTargetBits()) {
+                std::cout << "Block target " << blockToAdd.target_bits_ << " does not match required target "
+                          << difficulty_.getNextTargetBits() << std::endl;
+                return false;
+            }
+
+            // Proof-of-authority chains only accept sealers that have not sealed too recently
+            if (authority_ && !canSeal(blockToAdd.sealer_id_)) {
+                std::cout << "Sealer " << blockToAdd.sealer_id_ << " sealed too recently" << std::endl;
+                return false;
+            }
+
+            // Validate transactions against entity manager
+            for (const auto &txn : blockToAdd.transactions_) {
+                // Check for duplicate transaction
+                if (entity_manager_.isTransactionUsed(txn.uuid_)) {
+                    std::cout << "Duplicate transaction detected: " << txn.uuid_ << std::endl;
+                    return false;
+                }
+
+                // For robot coordination, you could add entity authorization checks here
+                // For example: if (!entity_manager_.isEntityAuthorized(txn.issuer_entity_)) { return false; }
+            }
+
+            if (!blockToAdd.isValid()) {
+                std::cout << "Invalid block attempted to be added to the blockchain" << std::endl;
+                return false;
+            }
+
+            // The seal signs the final hash, so it only verifies if the block was sealed against this tip
+            if (authority_ && !authority_->verifySeal(blockToAdd, entity_manager_)) {
+                return false;
+            }
+
+            // Observers that keep derived state, like the UTXO set, veto blocks that state cannot apply
+            for (const auto &observer : observers_) {
+                if (!observer->validateBlock(blockToAdd)) {
+                    return false;
+                }
+            }
+
+            // Mark all transactions as used
+            for (const auto &txn : blockToAdd.transactions_) {
+                entity_manager_.markTransactionUsed(txn.uuid_);
+            }
+
+            std::cout << "Adding block to chain" << std::endl;
+            blocks_.push_back(blockToAdd);
+            countMetric(Counter::BlocksAdded);
+            if (authority_ && blocks_.size() > poa_activation_index_) {
+                authority_->recordSealers(entity_manager_, blockToAdd.index_);
+            }
+            if (difficulty_.isEnabled()) {
+                feedDifficulty(difficulty_, blocks_.size() - 1, blockToAdd.timestamp_);
+            }
+
+            const auto *parent = tree_.find(blocks_.back().previous_hash_);
+            tree_.connect(blocks_.back(), (parent ? parent->cumulative_score : 0.0) + blockScore(blocks_.back()));
+            for (const auto &observer : observers_) {
+                observer->onBlockConnected(blocks_.back());
+            }
+            return true;
+        }
+
+        inline double blockScore(const Block<T> &block) const {
+            return fork_choice_->score(block, ForkContext{entity_manager_, getAuthority()});
+        }
+
+        // Index blocks_ into the tree when it was filled or edited without going through appendBlock, e.g. by the
+        // constructors or deserialize(). A no-op while the two agree.
+        inline void syncTree() const {
+            if (tree_.canonicalCount() == blocks_.size()) {
+                const auto *tip = blocks_.empty() ? nullptr : tree_.find(blocks_.back().hash_);
+                if (blocks_.empty() || (tip != nullptr && tip->canonical)) {
+                    return;
+                }
+            }
+            tree_.clear();
+            double score = 0.0;
+            for (const auto &block : blocks_) {
+                score += blockScore(block);
+                tree_.connect(block, score);
+            }
+        }
+
+        // Move every block from `length` on out of blocks_ and into the tree, tip first, releasing their transaction
+        // ids and rewinding the difficulty. Cost is proportional to the number of blocks removed.
+        inline void detach(size_t length) {
+            if (length >= blocks_.size()) {
+                return;
+            }
+            DifficultyAdjuster rewound = difficultyAt(length);
+            while (blocks_.size() > length) {
+                Block<T> &block = blocks_.back();
+                for (const auto &txn : block.transactions_) {
+                    entity_manager_.unmarkTransactionUsed(txn.uuid_);
+                }
+                for (const auto &observer : observers_) {
+                    observer->onBlockDisconnected(block);
+                }
+                tree_.disconnect(std::move(block));
+                blocks_.pop_back();
+            }
+            difficulty_ = std::move(rewound);
+        }
+
+        // The difficulty adjuster as it stood with only the first `length` blocks appended. Rebuilt from the target
+        // the next block carries and the window before it, so it costs O(window) instead of a replay.
+        inline DifficultyAdjuster difficultyAt(size_t length) const {
+            if (!difficulty_.isEnabled() || length >= blocks_.size()) {
+                return difficulty_;
+            }
+            DifficultyAdjuster adjuster = difficultyOrigin();
+            for (size_t j = 1; j < pow_tunings_.size() && pow_tunings_[j].from < length; j++) {
+                adjuster.retune(pow_tunings_[j].policy, pow_tunings_[j].block_seconds);
+            }
+            size_t first = pow_activation_index_ > 0 ? pow_activation_index_ - 1 : 0;
+            size_t window = adjuster.getWindow().capacity();
+            size_t start = std::max(first, length > window ? length - window : 0);
+            std::vector<Timestamp> timestamps;
+            for (size_t i = start; i < length; i++) {
+                timestamps.push_back(blocks_[i].timestamp_);
+            }
+            adjuster.restore(blocks_[length].target_bits_, length - first, timestamps);
+            return adjuster;
+        }
+
+        // Header checks for a block joining a side branch at `parent`: the branch must fork above consensus
+        // activation and stay within the side-branch limits, the seal must verify and, under proof of work, the
+        // target must be the one the difficulty policy requires after the branch's own blocks
+        inline bool isValidSideBlock(const Block<T> &block, const typename BlockTree<T>::Entry &parent) const {
+            auto branch = tree_.branchTo(parent.hash); // Parent's side-branch ancestry, tip first
+            int64_t fork_height = branch.empty() ? parent.height : tree_.find(branch.back())->height - 1;
+            size_t fork_length = static_cast<size_t>(fork_height) + 1;
+            if (fork_length < std::max(pow_activation_index_, poa_activation_index_)) {
+                std::cout << "Side branch forks below consensus activation" << std::endl;
+                return false;
+            }
+            if (branch.size() + 1 > MAX_SIDE_BRANCH_DEPTH || tree_.sideCount() >= MAX_SIDE_BLOCKS) {
+                std::cout << "Side-branch limit reached" << std::endl;
+                return false;
+            }
+            if (!isValidHeader(block) || !block.isValid()) {
+                return false;
+            }
+            if (difficulty_.isEnabled()) {
+                DifficultyAdjuster adjuster = difficultyAt(fork_length);
+                for (size_t i = branch.size(); i-- > 0;) {
+                    const auto *entry = tree_.find(branch[i]);
+                    feedDifficulty(adjuster, static_cast<size_t>(entry->height), entry->block->timestamp_);
+                }
+                if (block.target_bits_ != adjuster.getNextTargetBits()) {
+                    std::cout << "Side-branch block " << block.index_ << " has unexpected proof-of-work target"
+                              << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Switch the canonical chain to the side branch ending at `tip`. Only the diverging suffixes are touched.
+        // If a block of the new branch fails contextual validation, it and its descendants are dropped and fork
+        // choice picks between the valid part and the old branch. False unless the whole branch connected.
+        inline bool reorganize(const std::string &tip) {
+            auto branch = tree_.branchTo(tip);
+            const auto *fork = tree_.find(tree_.find(branch.back())->parent);
+            if (fork == nullptr || fork->height < finalized_height_) {
+                std::cout << "Refusing to reorganize below the finalized block" << std::endl;
+                return false;
+            }
+            size_t fork_length = static_cast<size_t>(fork->height) + 1;
+            if (fork_length < std::max(pow_activation_index_, poa_activation_index_)) {
+                std::cout << "Refusing to reorganize below consensus activation" << std::endl;
+                return false;
+            }
+
+            std::vector<std::string> old_branch;
+            for (size_t i = fork_length; i < blocks_.size(); i++) {
+                old_branch.push_back(blocks_[i].hash_);
+            }
+            detach(fork_length);
+            for (size_t i = branch.size(); i-- > 0;) {
+                Block<T> block = std::move(*tree_.find(branch[i])->block);
+                if (!appendBlock(block)) {
+                    // The rest of the branch builds on an invalid block: forget it, then keep the valid part if fork
+                    // choice still prefers it to the old branch, and restore the old branch otherwise
+                    for (size_t j = 0; j <= i; j++) {
+                        tree_.erase(branch[j]);
+                    }
+                    const auto *old_tip = old_branch.empty() ? nullptr : tree_.find(old_branch.back());
+                    if (old_tip == nullptr || !BlockTree<T>::isBetterTip(*old_tip, *tree_.find(blocks_.back().hash_))) {
+                        reorg_count_++;
+                        finalizePending(fork_length);
+                        std::cout << "Reorganized to block " << blocks_.back().index_ << " (" << old_branch.size()
+                                  << " blocks disconnected, " << branch.size() - i - 1
+                                  << " connected, the rest invalid)" << std::endl;
+                        return false;
+                    }
+                    detach(fork_length);
+                    for (const auto &hash : old_branch) {
+                        Block<T> old_block = std::move(*tree_.find(hash)->block);
+                        if (!appendBlock(old_block)) {
+                            throw std::runtime_error("Failed to restore block " + std::to_string(old_block.index_) +
+                                                     " after an aborted reorganization");
+                        }
+                    }
+                    return false;
+                }
+            }
+            reorg_count_++;
+            finalizePending(fork_length);
+            std::cout << "Reorganized to block " << blocks_.back().index_ << " (" << old_branch.size()
+                      << " blocks disconnected, " << branch.size() << " connected)" << std::endl;
+            return true;
+        }
+
+        // Apply a commit certificate that completed before its block was connected, for the highest block from
+        // `from` on that has one
+        inline void finalizePending(size_t from) {
+            if (!finality_) {
+                return;
+            }
+            size_t lowest = std::max(from, static_cast<size_t>(finalized_height_ + 1));
+            for (size_t i = blocks_.size(); i-- > lowest;) {
+                if (const auto *qc = finality_->getCertificate(VotePhase::Commit, blocks_[i].hash_)) {
+                    QuorumCertificate certificate = *qc;
+                    finalize(certificate);
+                    return;
+                }
+            }
+        }
+
+        // Switch policy and block time from the tip on. Activation and the current target stay, so blocks mined
+        // under the earlier tuning keep their checks and forks above activation stay possible.
+        inline void retuneDifficulty(std::shared_ptr<DifficultyPolicy> policy, double target_block_seconds) {
+            size_t from = blocks_.size();
+            while (!pow_tunings_.empty() && pow_tunings_.back().from >= from) {
+                pow_tunings_.pop_back();
+            }
+            pow_tunings_.push_back(DifficultyTuning{from, policy, target_block_seconds});
+            difficulty_.retune(std::move(policy), target_block_seconds);
+        }
+
+        // A fresh adjuster under the tuning in force at activation
+        inline DifficultyAdjuster difficultyOrigin() const {
+            if (pow_tunings_.empty()) {
+                return DifficultyAdjuster(difficulty_.getPolicy(), difficulty_.getInitialTargetBits(),
+                                          difficulty_.getTargetBlockSeconds());
+            }
+            return DifficultyAdjuster(pow_tunings_.front().policy, difficulty_.getInitialTargetBits(),
+                                      pow_tunings_.front().block_seconds);
+        }
+
+        // Feed the block at `height` to `adjuster`, first switching to any tuning that starts there
+        inline void feedDifficulty(DifficultyAdjuster &adjuster, size_t height, const Timestamp &timestamp) const {
+            for (size_t j = 1; j < pow_tunings_.size(); j++) {
+                if (pow_tunings_[j].from == height) {
+                    adjuster.retune(pow_tunings_[j].policy, pow_tunings_[j].block_seconds);
+                }
+            }
+            adjuster.onBlock(timestamp);
+        }
+
+        inline uint32_t currentOrDefaultBits() const {
+            return difficulty_.isEnabled() ? difficulty_.getNextTargetBits() : DEFAULT_TARGET_BITS;
+        }
     };
 } // namespace chain
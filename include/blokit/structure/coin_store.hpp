@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "metrics.hpp"
+#include "sha256.hpp"
+#include "trace.hpp"
+
+namespace chain {
+
+    // Push what has been written to `path` through to stable storage; a stream flush only hands it to the OS.
+    // Where there is no fsync this is a no-op that reports success.
+    inline bool syncFileToDisk(const std::string &path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+#else
+        return true;
+#endif
+    }
+
+    // 128 bits of SHA-256 over an outpoint; what the coin cache, store and bloom filter are keyed by
+    using CoinKey = std::array<uint8_t, 16>;
+
+    struct CoinKeyHash {
+        inline size_t operator()(const CoinKey &key) const {
+            uint64_t value;
+            std::memcpy(&value, key.data(), sizeof(value));
+            return static_cast<size_t>(value);
+        }
+    };
+
+    // Output `index` of transaction `tx_id`
+    struct OutPoint {
+        std::string tx_id;
+        uint32_t index = 0;
+
+        inline CoinKey key() const {
+            std::vector<uint8_t> bytes(tx_id.begin(), tx_id.end());
+            for (size_t i = 0; i < 4; i++) {
+                bytes.push_back(static_cast<uint8_t>(index >> (8 * i)));
+            }
+            auto digest = Sha256::hash(bytes.data(), bytes.size());
+            CoinKey key;
+            std::memcpy(key.data(), digest.data(), key.size());
+            return key;
+        }
+
+        inline bool operator==(const OutPoint &other) const = default;
+    };
+
+    // An unspent output
+    struct Coin {
+        std::string owner; // Account name or key hash, at most DiskCoinStore::MAX_OWNER bytes
+        int64_t amount = 0;
+        int64_t height = 0; // Block that created it
+
+        inline bool operator==(const Coin &other) const = default;
+    };
+
+    // Coins in a file laid out as an open-addressing hash table of fixed 128-byte slots with linear probing, so a
+    // lookup reads one 4 KiB page in the common case and the set never has to fit in memory. The table rehashes
+    // into a larger file at half load. The header also records the block the contents are current to. Writes are
+    // not journaled: a crash in the middle of a flush leaves a file that has to be rebuilt from the chain.
+    class DiskCoinStore {
+      public:
+        static constexpr size_t SLOT_SIZE = 128;
+        static constexpr size_t PAGE_SIZE = 4096;
+        static constexpr size_t PAGE_SLOTS = PAGE_SIZE / SLOT_SIZE;
+        static constexpr size_t MAX_OWNER = SLOT_SIZE - 34; // After state, key, amount, height and owner length
+        static constexpr uint64_t MIN_CAPACITY = 1024;
+
+        // Opens the store at `path`, or creates it with room for `initial_capacity` slots
+        inline explicit DiskCoinStore(std::string path, uint64_t initial_capacity = 1 << 16) : path_(std::move(path)) {
+            if (std::filesystem::exists(path_)) {
+                open();
+            } else {
+                uint64_t capacity = MIN_CAPACITY;
+                while (capacity < initial_capacity) {
+                    capacity *= 2;
+                }
+                create(capacity);
+            }
+        }
+
+        inline DiskCoinStore(const DiskCoinStore &) = delete;
+        inline DiskCoinStore &operator=(const DiskCoinStore &) = delete;
+
+        inline std::optional<Coin> get(const CoinKey &key) {
+            auto found = probe(key).found;
+            if (!found) {
+                return std::nullopt;
+            }
+            return decode(slotBytes(*found));
+        }
+
+        inline void put(const CoinKey &key, const Coin &coin) {
+            if (coin.owner.size() > MAX_OWNER) {
+                throw std::runtime_error("Coin owner longer than " + std::to_string(MAX_OWNER) + " bytes");
+            }
+            auto result = probe(key);
+            if (result.found) {
+                writeSlot(*result.found, key, coin);
+                return;
+            }
+            if ((occupied_ + 1) * 2 > capacity_) {
+                rehash();
+                result = probe(key);
+            }
+            if (result.free_empty) {
+                occupied_++;
+            }
+            used_++;
+            writeSlot(result.free, key, coin);
+        }
+
+        inline bool erase(const CoinKey &key) {
+            auto found = probe(key).found;
+            if (!found) {
+                return false;
+            }
+            uint8_t tombstone = DELETED;
+            write(slotOffset(*found), &tombstone, 1);
+            used_--;
+            return true;
+        }
+
+        // Sequential scan of every coin, in slot order
+        template <typename Fn> inline void forEach(Fn &&fn) {
+            std::vector<uint8_t> page(PAGE_SIZE);
+            for (uint64_t p = 0; p < capacity_ / PAGE_SLOTS; p++) {
+                read(HEADER_SIZE + p * PAGE_SIZE, page.data(), PAGE_SIZE);
+                for (size_t i = 0; i < PAGE_SLOTS; i++) {
+                    const uint8_t *slot = page.data() + i * SLOT_SIZE;
+                    if (slot[0] == USED) {
+                        CoinKey key;
+                        std::memcpy(key.data(), slot + 1, key.size());
+                        fn(key, decode(slot));
+                    }
+                }
+            }
+        }
+
+        // The block the contents are current to; height -1 for none
+        inline void setTip(int64_t height, const std::string &hash) {
+            if (hash.size() > MAX_TIP_HASH) {
+                throw std::runtime_error("Tip hash too long for the coin store header");
+            }
+            tip_height_ = height;
+            tip_hash_ = hash;
+        }
+
+        inline int64_t getTipHeight() const { return tip_height_; }
+        inline const std::string &getTipHash() const { return tip_hash_; }
+
+        // Writes the header, flushes the file and waits for it to reach the disk
+        inline void sync() {
+            MetricTimer timer(Histogram::StorageSync);
+            TraceSpan span("DiskCoinStore::sync");
+            writeHeader();
+            file_.flush();
+            if (!file_) {
+                throw std::runtime_error("Failed to flush coin store " + path_);
+            }
+            if (!syncFileToDisk(path_)) {
+                throw std::runtime_error("Failed to sync coin store " + path_);
+            }
+        }
+
+        inline uint64_t size() const { return used_; }
+        inline uint64_t getCapacity() const { return capacity_; }
+        inline uint64_t getPageReads() const { return page_reads_; }
+        inline const std::string &getPath() const { return path_; }
+
+      private:
+        static constexpr uint8_t EMPTY = 0;
+        static constexpr uint8_t USED = 1;
+        static constexpr uint8_t DELETED = 2;
+        static constexpr uint64_t HEADER_SIZE = PAGE_SIZE;
+        static constexpr size_t MAX_TIP_HASH = 256;
+        static constexpr char MAGIC[8] = {'B', 'L', 'K', 'C', 'O', 'I', 'N', '1'};
+        static constexpr uint64_t NO_PAGE = ~uint64_t{0};
+
+        struct Probe {
+            std::optional<uint64_t> found;
+            uint64_t free = 0;       // Where the key would be inserted: the first tombstone or empty slot
+            bool free_empty = false; // Whether `free` is empty rather than a tombstone
+        };
+
+        std::string path_;
+        std::fstream file_;
+        uint64_t capacity_ = 0;
+        uint64_t used_ = 0;
+        uint64_t occupied_ = 0; // Used slots plus tombstones
+        int64_t tip_height_ = -1;
+        std::string tip_hash_;
+        std::vector<uint8_t> page_ = std::vector<uint8_t>(PAGE_SIZE); // Last page read
+        uint64_t page_index_ = NO_PAGE;
+        uint64_t page_reads_ = 0;
+
+        inline static void putU64(uint8_t *out, uint64_t value) {
+            for (size_t i = 0; i < 8; i++) {
+                out[i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        inline static uint64_t getU64(const uint8_t *in) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < 8; i++) {
+                value |= static_cast<uint64_t>(in[i]) << (8 * i);
+            }
+            return value;
+        }
+
+        inline static Coin decode(const uint8_t *slot) {
+            Coin coin;
+            coin.amount = static_cast<int64_t>(getU64(slot + 17));
+            coin.height = static_cast<int64_t>(getU64(slot + 25));
+            coin.owner.assign(reinterpret_cast<const char *>(slot + 34), std::min<size_t>(slot[33], MAX_OWNER));
+            return coin;
+        }
+
+        inline uint64_t home(const CoinKey &key) const { return getU64(key.data() + 8) & (capacity_ - 1); }
+        inline uint64_t slotOffset(uint64_t slot) const { return HEADER_SIZE + slot * SLOT_SIZE; }
+
+        inline const uint8_t *slotBytes(uint64_t slot) {
+            loadPage(slot / PAGE_SLOTS);
+            return page_.data() + (slot % PAGE_SLOTS) * SLOT_SIZE;
+        }
+
+        inline void loadPage(uint64_t page) {
+            if (page != page_index_) {
+                read(HEADER_SIZE + page * PAGE_SIZE, page_.data(), PAGE_SIZE);
+                page_index_ = page;
+                page_reads_++;
+            }
+        }
+
+        // Walks the probe sequence from the key's home slot up to the first empty slot
+        inline Probe probe(const CoinKey &key) {
+            Probe result;
+            bool have_free = false;
+            uint64_t slot = home(key);
+            for (uint64_t probed = 0; probed < capacity_; probed++, slot = (slot + 1) & (capacity_ - 1)) {
+                const uint8_t *bytes = slotBytes(slot);
+                if (bytes[0] == EMPTY) {
+                    if (!have_free) {
+                        result.free = slot;
+                        result.free_empty = true;
+                    }
+                    return result;
+                }
+                if (bytes[0] == USED && std::memcmp(bytes + 1, key.data(), key.size()) == 0) {
+                    result.found = slot;
+                    return result;
+                }
+                if (bytes[0] == DELETED && !have_free) {
+                    result.free = slot;
+                    have_free = true;
+                }
+            }
+            return result; // Only tombstones and other keys; the load limit keeps this from happening
+        }
+
+        inline void writeSlot(uint64_t slot, const CoinKey &key, const Coin &coin) {
+            uint8_t bytes[SLOT_SIZE] = {};
+            bytes[0] = USED;
+            std::memcpy(bytes + 1, key.data(), key.size());
+            putU64(bytes + 17, static_cast<uint64_t>(coin.amount));
+            putU64(bytes + 25, static_cast<uint64_t>(coin.height));
+            bytes[33] = static_cast<uint8_t>(coin.owner.size());
+            std::memcpy(bytes + 34, coin.owner.data(), coin.owner.size());
+            write(slotOffset(slot), bytes, SLOT_SIZE);
+        }
+
+        inline void read(uint64_t offset, uint8_t *out, size_t size) {
+            file_.seekg(static_cast<std::streamoff>(offset));
+            file_.read(reinterpret_cast<char *>(out), static_cast<std::streamsize>(size));
+            if (!file_) {
+                throw std::runtime_error("Failed to read coin store " + path_);
+            }
+        }
+
+        inline void write(uint64_t offset, const uint8_t *bytes, size_t size) {
+            file_.seekp(static_cast<std::streamoff>(offset));
+            file_.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(size));
+            if (!file_) {
+                throw std::runtime_error("Failed to write coin store " + path_);
+            }
+            // Keep the cached page in step with the file
+            uint64_t page = (offset - HEADER_SIZE) / PAGE_SIZE;
+            if (offset >= HEADER_SIZE && page == page_index_) {
+                std::memcpy(page_.data() + (offset - HEADER_SIZE) % PAGE_SIZE, bytes, size);
+            }
+        }
+
+        inline void create(uint64_t capacity) {
+            std::ofstream(path_, std::ios::binary | std::ios::trunc);
+            std::filesystem::resize_file(path_, HEADER_SIZE + capacity * SLOT_SIZE); // Sparse, reads back as zeros
+            capacity_ = capacity;
+            used_ = 0;
+            occupied_ = 0;
+            file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+            if (!file_) {
+                throw std::runtime_error("Failed to create coin store " + path_);
+            }
+            writeHeader();
+        }
+
+        inline void open() {
+            file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+            if (!file_) {
+                throw std::runtime_error("Failed to open coin store " + path_);
+            }
+            uint8_t header[HEADER_SIZE];
+            read(0, header, HEADER_SIZE);
+            if (std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+                throw std::runtime_error("Not a coin store: " + path_);
+            }
+            capacity_ = getU64(header + 8);
+            used_ = getU64(header + 16);
+            occupied_ = getU64(header + 24);
+            tip_height_ = static_cast<int64_t>(getU64(header + 32));
+            size_t hash_size = std::min<size_t>(getU64(header + 40), MAX_TIP_HASH);
+            tip_hash_.assign(reinterpret_cast<const char *>(header + 48), hash_size);
+            if (capacity_ < MIN_CAPACITY || (capacity_ & (capacity_ - 1)) != 0) {
+                throw std::runtime_error("Corrupt coin store header: " + path_);
+            }
+        }
+
+        inline void writeHeader() {
+            uint8_t header[HEADER_SIZE] = {};
+            std::memcpy(header, MAGIC, sizeof(MAGIC));
+            putU64(header + 8, capacity_);
+            putU64(header + 16, used_);
+            putU64(header + 24, occupied_);
+            putU64(header + 32, static_cast<uint64_t>(tip_height_));
+            putU64(header + 40, tip_hash_.size());
+            std::memcpy(header + 48, tip_hash_.data(), tip_hash_.size());
+            write(0, header, HEADER_SIZE);
+        }
+
+        // Copies the coins into a fresh table at most a quarter full, which also drops the tombstones
+        inline void rehash() {
+            uint64_t capacity = capacity_;
+            while ((used_ + 1) * 4 > capacity) {
+                capacity *= 2;
+            }
+            std::string resized_path = path_ + ".rehash";
+            std::filesystem::remove(resized_path);
+            {
+                DiskCoinStore resized(resized_path, capacity);
+                forEach([&](const CoinKey &key, const Coin &coin) { resized.put(key, coin); });
+                resized.setTip(tip_height_, tip_hash_);
+                resized.sync();
+            }
+            file_.close();
+            std::filesystem::rename(resized_path, path_);
+            page_index_ = NO_PAGE;
+            open();
+        }
+    };
+
+} // namespace chain
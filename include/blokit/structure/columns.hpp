@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "siphash.hpp"
+#include "transaction.hpp"
+
+namespace chain {
+
+    // Rows picked out by a BlockColumns scan, one byte (0 or 1) per transaction
+    class RowMask {
+      public:
+        inline explicit RowMask(size_t rows = 0) : rows_(rows, 0) {}
+
+        inline size_t size() const { return rows_.size(); }
+        inline bool operator[](size_t i) const { return rows_[i] != 0; }
+        inline uint8_t *data() { return rows_.data(); }
+
+        inline size_t count() const {
+            size_t n = 0;
+            for (uint8_t row : rows_) {
+                n += row;
+            }
+            return n;
+        }
+
+        inline std::vector<size_t> indices() const {
+            std::vector<size_t> out;
+            for (size_t i = 0; i < rows_.size(); i++) {
+                if (rows_[i]) {
+                    out.push_back(i);
+                }
+            }
+            return out;
+        }
+
+        // Combine scans over the same block, e.g. a time range within a priority band
+        inline RowMask &operator&=(const RowMask &other) {
+            for (size_t i = 0; i < std::min(rows_.size(), other.rows_.size()); i++) {
+                rows_[i] &= other.rows_[i];
+            }
+            return *this;
+        }
+
+        inline RowMask &operator|=(const RowMask &other) {
+            for (size_t i = 0; i < std::min(rows_.size(), other.rows_.size()); i++) {
+                rows_[i] |= other.rows_[i];
+            }
+            return *this;
+        }
+
+      private:
+        std::vector<uint8_t> rows_;
+    };
+
+    // A block body laid out column by column: timestamps, priorities and uuid digests each sit in their own
+    // contiguous array, so a scan over one field reads only that field instead of striding across whole
+    // transactions with their strings and signatures. Uuids and signatures are packed end to end behind offset
+    // arrays. Converting from and back to the row form is lossless.
+    template <typename T> class BlockColumns {
+      public:
+        // Rows evaluated per batch. A fixed trip count lets the compiler vectorize predicates at -O2.
+        static constexpr size_t SCAN_BATCH = 64;
+
+        BlockColumns() = default;
+
+        inline explicit BlockColumns(const std::vector<Transaction<T>> &transactions) {
+            size_t n = transactions.size();
+            seconds_.reserve(n);
+            nanoseconds_.reserve(n);
+            priorities_.reserve(n);
+            uuid_digests_.reserve(n);
+            uuid_offsets_.reserve(n + 1);
+            signature_offsets_.reserve(n + 1);
+            payloads_.reserve(n);
+            for (const auto &tx : transactions) {
+                seconds_.push_back(tx.timestamp_.sec);
+                nanoseconds_.push_back(tx.timestamp_.nanosec);
+                priorities_.push_back(tx.priority_);
+                uuid_digests_.push_back(uuidDigest(tx.uuid_));
+                uuid_bytes_ += tx.uuid_;
+                uuid_offsets_.push_back(static_cast<uint32_t>(uuid_bytes_.size()));
+                signature_bytes_.insert(signature_bytes_.end(), tx.signature_.begin(), tx.signature_.end());
+                signature_offsets_.push_back(static_cast<uint32_t>(signature_bytes_.size()));
+                payloads_.push_back(tx.function_);
+            }
+        }
+
+        inline size_t size() const { return priorities_.size(); }
+        inline bool empty() const { return priorities_.empty(); }
+
+        inline std::span<const int32_t> seconds() const { return seconds_; }
+        inline std::span<const uint32_t> nanoseconds() const { return nanoseconds_; }
+        inline std::span<const int16_t> priorities() const { return priorities_; }
+        inline std::span<const uint64_t> uuidDigests() const { return uuid_digests_; }
+        inline const std::vector<T> &payloads() const { return payloads_; }
+
+        inline Timestamp timestamp(size_t i) const { return Timestamp(seconds_[i], nanoseconds_[i]); }
+
+        inline std::string_view uuid(size_t i) const {
+            return std::string_view(uuid_bytes_).substr(uuid_offsets_[i], uuid_offsets_[i + 1] - uuid_offsets_[i]);
+        }
+
+        inline std::span<const unsigned char> signature(size_t i) const {
+            return std::span<const unsigned char>(signature_bytes_)
+                .subspan(signature_offsets_[i], signature_offsets_[i + 1] - signature_offsets_[i]);
+        }
+
+        inline Transaction<T> row(size_t i) const {
+            Transaction<T> tx;
+            tx.timestamp_ = timestamp(i);
+            tx.priority_ = priorities_[i];
+            tx.uuid_ = std::string(uuid(i));
+            tx.function_ = payloads_[i];
+            auto sig = signature(i);
+            tx.signature_.assign(sig.begin(), sig.end());
+            return tx;
+        }
+
+        // Back to the row form, e.g. to build a Block
+        inline std::vector<Transaction<T>> toTransactions() const {
+            std::vector<Transaction<T>> out;
+            out.reserve(size());
+            for (size_t i = 0; i < size(); i++) {
+                out.push_back(row(i));
+            }
+            return out;
+        }
+
+        // Transactions stamped within [from, to], both ends inclusive
+        inline RowMask timeRange(Timestamp from, Timestamp to) const {
+            const int32_t *sec = seconds_.data();
+            const uint32_t *ns = nanoseconds_.data();
+            return scan([=](size_t i) -> uint8_t {
+                bool after = (sec[i] > from.sec) | ((sec[i] == from.sec) & (ns[i] >= from.nanosec));
+                bool before = (sec[i] < to.sec) | ((sec[i] == to.sec) & (ns[i] <= to.nanosec));
+                return after & before;
+            });
+        }
+
+        // Transactions with min <= priority <= max
+        inline RowMask priorityRange(int16_t min, int16_t max) const {
+            const int16_t *priority = priorities_.data();
+            return scan([=](size_t i) -> uint8_t { return (priority[i] >= min) & (priority[i] <= max); });
+        }
+
+        // Row of the transaction with this uuid. Compares digests first and only checks the bytes of a match.
+        inline std::optional<size_t> find(std::string_view uuid_value) const {
+            const uint64_t *digest = uuid_digests_.data();
+            uint64_t wanted = uuidDigest(uuid_value);
+            RowMask hits = scan([=](size_t i) -> uint8_t { return digest[i] == wanted; });
+            for (size_t i : hits.indices()) {
+                if (uuid(i) == uuid_value) {
+                    return i;
+                }
+            }
+            return std::nullopt;
+        }
+
+      private:
+        std::vector<int32_t> seconds_;
+        std::vector<uint32_t> nanoseconds_;
+        std::vector<int16_t> priorities_;
+        std::vector<uint64_t> uuid_digests_;
+        std::vector<uint32_t> uuid_offsets_{0}; // Row i's uuid is uuid_bytes_[offsets[i], offsets[i + 1])
+        std::string uuid_bytes_;
+        std::vector<uint32_t> signature_offsets_{0};
+        std::vector<unsigned char> signature_bytes_;
+        std::vector<T> payloads_;
+
+        // Unkeyed: a collision only costs a byte comparison in find()
+        static inline uint64_t uuidDigest(std::string_view uuid_value) {
+            return SipHash::hash(0, 0, reinterpret_cast<const uint8_t *>(uuid_value.data()), uuid_value.size());
+        }
+
+        // Evaluates `keep` branch-free over every row. Each batch is written to a local array first, which no
+        // column can alias, so the loop compiles to vector compares.
+        template <typename Predicate> inline RowMask scan(Predicate keep) const {
+            RowMask mask(size());
+            uint8_t *out = mask.data();
+            size_t full = size() - size() % SCAN_BATCH;
+            for (size_t base = 0; base < full; base += SCAN_BATCH) {
+                uint8_t batch[SCAN_BATCH];
+                for (size_t j = 0; j < SCAN_BATCH; j++) {
+                    batch[j] = keep(base + j);
+                }
+                std::memcpy(out + base, batch, SCAN_BATCH);
+            }
+            for (size_t i = full; i < size(); i++) {
+                out[i] = keep(i);
+            }
+            return mask;
+        }
+    };
+
+} // namespace chain
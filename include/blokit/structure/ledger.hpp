@@ -0,0 +1,560 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "block.hpp"
+#include "chain.hpp"
+#include "sha256.hpp"
+
+namespace chain {
+
+    using AccountId = uint32_t; // Index into the account table; stable for the life of the account
+
+    // Order-independent hash of a set: the sum modulo 2^256 of its members' SHA-256 digests. Adding or removing a
+    // member costs one hash, however large the set.
+    class SetHash {
+      public:
+        inline void add(const Sha256::Digest &member) { combine(member, false); }
+        inline void remove(const Sha256::Digest &member) { combine(member, true); }
+
+        // SHA-256 of the accumulator, as hex
+        inline std::string hex() const {
+            uint8_t bytes[32];
+            for (size_t i = 0; i < 32; i++) {
+                bytes[i] = static_cast<uint8_t>(limbs_[i / 8] >> (8 * (i % 8)));
+            }
+            auto digest = Sha256::hash(bytes, sizeof(bytes));
+            static const char *digits = "0123456789abcdef";
+            std::string result;
+            result.reserve(64);
+            for (uint8_t byte : digest) {
+                result.push_back(digits[byte >> 4]);
+                result.push_back(digits[byte & 0x0f]);
+            }
+            return result;
+        }
+
+        inline bool operator==(const SetHash &other) const = default;
+
+      private:
+        std::array<uint64_t, 4> limbs_{}; // Least significant first
+
+        inline void combine(const Sha256::Digest &member, bool subtract) {
+            uint64_t carry = 0;
+            for (size_t i = 0; i < 4; i++) {
+                uint64_t word = 0;
+                for (size_t b = 0; b < 8; b++) {
+                    word |= static_cast<uint64_t>(member[8 * i + b]) << (8 * b);
+                }
+                uint64_t limb = limbs_[i];
+                if (subtract) {
+                    uint64_t difference = limb - word;
+                    limbs_[i] = difference - carry;
+                    carry = (limb < word) | (difference < carry);
+                } else {
+                    uint64_t sum = limb + word;
+                    limbs_[i] = sum + carry;
+                    carry = (sum < limb) | (limbs_[i] < sum);
+                }
+            }
+        }
+    };
+
+    // Global state of reward-per-share staking. Distributing a reward only raises reward_per_share; each staker's
+    // share is settled when the account is next touched, so a payout costs O(1) however many stake.
+    struct StakingState {
+        static constexpr int64_t SCALE = 1000000; // Fixed-point denominator of reward_per_share
+
+        uint64_t reward_per_share = 0; // Cumulative reward per unit staked, times SCALE
+        int64_t total_stake = 0;
+        int64_t unallocated = 0; // Distributed while nobody staked; goes out with the next distribution
+        uint64_t dust = 0;       // Rounding remainder of reward_per_share, times SCALE, carried to the next one
+
+        inline bool operator==(const StakingState &other) const = default;
+    };
+
+    // Flat table of named integer balances with a state root. Changes are grouped per block between beginBlock()
+    // and commitBlock(); each block records the previous state of every account it touched, so committing,
+    // reverting and updating the root all cost O(accounts changed), not O(accounts).
+    //
+    // Accounts can also stake. Staked funds sit in a pool account; rewards distributed to stakers are credited to
+    // the pool and owed to each staker in proportion to stake, tracked by StakingState::reward_per_share and a
+    // per-account reward debt. settle() pays an account what it is owed and happens on every stake and unstake.
+    class AccountTable {
+      public:
+        inline size_t size() const { return accounts_.size(); }
+
+        inline std::optional<AccountId> find(const std::string &name) const {
+            auto it = ids_.find(name);
+            return it != ids_.end() ? std::optional<AccountId>(it->second) : std::nullopt;
+        }
+
+        inline const std::string &getName(AccountId id) const { return accounts_.at(id).name; }
+        inline int64_t getBalance(AccountId id) const { return accounts_.at(id).state.balance; }
+        inline int64_t getStake(AccountId id) const { return accounts_.at(id).state.stake; }
+        inline const StakingState &getStaking() const { return staking_; }
+
+        inline int64_t getBalance(const std::string &name) const {
+            auto id = find(name);
+            return id ? accounts_[*id].state.balance : 0;
+        }
+
+        // Reward owed to a staker and not yet settled
+        inline int64_t getPendingReward(AccountId id) const {
+            const State &state = accounts_.at(id).state;
+            return accrued(state.stake) - state.reward_debt;
+        }
+
+        // Commitment to every account's handle, name, balance, stake and reward debt, and the staking state
+        inline std::string getStateRoot() const { return root_.hex(); }
+
+        // Blocks that can still be reverted
+        inline size_t getUndoDepth() const { return undo_.size(); }
+
+        inline void beginBlock() {
+            if (open_) {
+                throw std::runtime_error("Ledger block already open");
+            }
+            open_ = true;
+            epoch_++;
+            undo_.push_back(Undo{accounts_.size(), {}, std::nullopt});
+        }
+
+        // The account's handle, creating it with a zero balance if needed. Only inside a block, so creation is
+        // undone with the block.
+        inline AccountId account(const std::string &name) {
+            auto it = ids_.find(name);
+            if (it != ids_.end()) {
+                return it->second;
+            }
+            requireOpen();
+            AccountId id = static_cast<AccountId>(accounts_.size());
+            accounts_.push_back(Account{name, {}, epoch_});
+            ids_.emplace(name, id);
+            return id;
+        }
+
+        // False, changing nothing, for a negative amount or a balance that would overflow
+        inline bool credit(AccountId id, int64_t amount) {
+            State &entry = touch(id);
+            if (amount < 0 || entry.balance > std::numeric_limits<int64_t>::max() - amount) {
+                return false;
+            }
+            entry.balance += amount;
+            return true;
+        }
+
+        // False, changing nothing, for a negative amount or insufficient funds
+        inline bool debit(AccountId id, int64_t amount) {
+            State &entry = touch(id);
+            if (amount < 0 || entry.balance < amount) {
+                return false;
+            }
+            entry.balance -= amount;
+            return true;
+        }
+
+        inline bool transfer(AccountId from, AccountId to, int64_t amount) {
+            if (!debit(from, amount)) {
+                return false;
+            }
+            if (!credit(to, amount)) {
+                accounts_[from].state.balance += amount;
+                return false;
+            }
+            return true;
+        }
+
+        // Pay the account its pending reward out of the pool
+        inline bool settle(AccountId id, AccountId pool) {
+            int64_t pending = getPendingReward(id);
+            if (pending > 0 && !transfer(pool, id, pending)) {
+                return false;
+            }
+            touch(id).reward_debt = accrued(accounts_[id].state.stake);
+            return true;
+        }
+
+        // Move `amount` of the account's balance into its stake, settling first
+        inline bool stake(AccountId id, AccountId pool, int64_t amount) {
+            if (amount <= 0 || id == pool || !settle(id, pool) ||
+                staking_.total_stake > std::numeric_limits<int64_t>::max() - amount || !transfer(id, pool, amount)) {
+                return false;
+            }
+            State &entry = touch(id);
+            entry.stake += amount;
+            entry.reward_debt = accrued(entry.stake);
+            changeStaking().total_stake += amount;
+            return true;
+        }
+
+        // Move `amount` of the account's stake back to its balance, settling first
+        inline bool unstake(AccountId id, AccountId pool, int64_t amount) {
+            if (amount <= 0 || id == pool || getStake(id) < amount || !settle(id, pool) ||
+                !transfer(pool, id, amount)) {
+                return false;
+            }
+            State &entry = touch(id);
+            entry.stake -= amount;
+            entry.reward_debt = accrued(entry.stake);
+            changeStaking().total_stake -= amount;
+            return true;
+        }
+
+        // Share `amount`, already credited to the pool, among stakers in proportion to stake. O(1): only the
+        // global accumulator changes. With nobody staking, the amount waits for the next distribution.
+        inline bool distribute(int64_t amount) {
+            requireOpen();
+            if (amount < 0 || staking_.unallocated > std::numeric_limits<int64_t>::max() - amount) {
+                return false;
+            }
+            StakingState next = staking_;
+            next.unallocated += amount;
+            if (next.total_stake > 0 && next.unallocated > 0) {
+                constexpr uint64_t limit = std::numeric_limits<uint64_t>::max() / StakingState::SCALE - 1;
+                if (static_cast<uint64_t>(next.unallocated) > limit) {
+                    return false;
+                }
+                uint64_t total = static_cast<uint64_t>(next.total_stake);
+                uint64_t scaled = static_cast<uint64_t>(next.unallocated) * StakingState::SCALE + next.dust;
+                uint64_t increment = scaled / total;
+                if (next.reward_per_share > std::numeric_limits<uint64_t>::max() - increment) {
+                    return false;
+                }
+                next.reward_per_share += increment;
+                next.dust = scaled % total;
+                next.unallocated = 0;
+            }
+            changeStaking() = next;
+            return true;
+        }
+
+        // Fold the open block's changes into the state root
+        inline void commitBlock() {
+            requireOpen();
+            Undo &undo = undo_.back();
+            for (const auto &[id, previous] : undo.previous) {
+                root_.remove(leaf(id, previous));
+                root_.add(leaf(id, accounts_[id].state));
+            }
+            for (size_t id = undo.account_count; id < accounts_.size(); id++) {
+                root_.add(leaf(static_cast<AccountId>(id), accounts_[id].state));
+            }
+            if (undo.staking) {
+                root_.remove(stakingLeaf(*undo.staking));
+                root_.add(stakingLeaf(staking_));
+            }
+            open_ = false;
+        }
+
+        // Undo the last committed block
+        inline void revertBlock() {
+            if (open_ || undo_.empty()) {
+                throw std::runtime_error("No committed ledger block to revert");
+            }
+            Undo &undo = undo_.back();
+            for (const auto &[id, previous] : undo.previous) {
+                root_.remove(leaf(id, accounts_[id].state));
+                root_.add(leaf(id, previous));
+                accounts_[id].state = previous;
+            }
+            while (accounts_.size() > undo.account_count) {
+                root_.remove(leaf(static_cast<AccountId>(accounts_.size() - 1), accounts_.back().state));
+                ids_.erase(accounts_.back().name);
+                accounts_.pop_back();
+            }
+            if (undo.staking) {
+                root_.remove(stakingLeaf(staking_));
+                root_.add(stakingLeaf(*undo.staking));
+                staking_ = *undo.staking;
+            }
+            undo_.pop_back();
+        }
+
+        // Drop the undo records of the oldest `count` blocks, which can then no longer be reverted
+        inline void forget(size_t count) {
+            count = std::min(count, undo_.size() - (open_ ? 1 : 0));
+            undo_.erase(undo_.begin(), undo_.begin() + static_cast<std::ptrdiff_t>(count));
+        }
+
+      private:
+        struct State {
+            int64_t balance = 0;
+            int64_t stake = 0;
+            int64_t reward_debt = 0; // Reward accrued by the stake up to its last settlement
+
+            inline bool operator==(const State &other) const = default;
+        };
+
+        struct Account {
+            std::string name;
+            State state;
+            uint64_t touched = 0; // Epoch of the last block that recorded its previous state
+        };
+
+        struct Undo {
+            size_t account_count;                              // Table size when the block began
+            std::vector<std::pair<AccountId, State>> previous; // States before the block, accounts it found
+            std::optional<StakingState> staking;               // Before the block, if it changed
+        };
+
+        std::vector<Account> accounts_;
+        std::unordered_map<std::string, AccountId> ids_;
+        std::vector<Undo> undo_;
+        StakingState staking_;
+        SetHash root_ = initialRoot();
+        uint64_t epoch_ = 0;
+        bool open_ = false;
+
+        inline void requireOpen() const {
+            if (!open_) {
+                throw std::runtime_error("Ledger changes need an open block");
+            }
+        }
+
+        inline State &touch(AccountId id) {
+            requireOpen();
+            Account &entry = accounts_.at(id);
+            if (entry.touched != epoch_) {
+                entry.touched = epoch_;
+                undo_.back().previous.emplace_back(id, entry.state);
+            }
+            return entry.state;
+        }
+
+        inline StakingState &changeStaking() {
+            requireOpen();
+            if (!undo_.back().staking) {
+                undo_.back().staking = staking_;
+            }
+            return staking_;
+        }
+
+        // stake * reward_per_share / SCALE, split so the product cannot overflow for realistic stakes
+        inline int64_t accrued(int64_t stake) const {
+            uint64_t units = static_cast<uint64_t>(stake);
+            uint64_t whole = staking_.reward_per_share / StakingState::SCALE;
+            uint64_t fraction = staking_.reward_per_share % StakingState::SCALE;
+            return static_cast<int64_t>(units * whole + units * fraction / StakingState::SCALE);
+        }
+
+        inline Sha256::Digest leaf(AccountId id, const State &state) const {
+            const std::string &name = accounts_[id].name;
+            std::vector<uint8_t> bytes;
+            bytes.reserve(name.size() + 32);
+            BinarySerializer::writeUint32(bytes, id);
+            BinarySerializer::writeString(bytes, name);
+            BinarySerializer::writeUint64(bytes, static_cast<uint64_t>(state.balance));
+            BinarySerializer::writeUint64(bytes, static_cast<uint64_t>(state.stake));
+            BinarySerializer::writeUint64(bytes, static_cast<uint64_t>(state.reward_debt));
+            return Sha256::hash(bytes.data(), bytes.size());
+        }
+
+        inline static Sha256::Digest stakingLeaf(const StakingState &staking) {
+            std::vector<uint8_t> bytes;
+            BinarySerializer::writeString(bytes, "staking");
+            BinarySerializer::writeUint64(bytes, staking.reward_per_share);
+            BinarySerializer::writeUint64(bytes, static_cast<uint64_t>(staking.total_stake));
+            BinarySerializer::writeUint64(bytes, static_cast<uint64_t>(staking.unallocated));
+            BinarySerializer::writeUint64(bytes, staking.dust);
+            return Sha256::hash(bytes.data(), bytes.size());
+        }
+
+        inline static SetHash initialRoot() {
+            SetHash root;
+            root.add(stakingLeaf(StakingState{}));
+            return root;
+        }
+    };
+
+    // How a block changes balances: coinbase, fees, transfers, payouts. Called once per connected block with the
+    // block open on the table; must depend only on the block and the table so every replica agrees.
+    template <typename T> class LedgerRules {
+      public:
+        virtual ~LedgerRules() = default;
+        virtual void apply(const Block<T> &block, AccountTable &accounts) = 0;
+    };
+
+    // Account balances kept in step with a chain's canonical blocks, reorgs included. Register it with
+    // Chain::addObserver; call catchUp() for the blocks the chain already had.
+    template <typename T> class Ledger : public ChainObserver<T> {
+      public:
+        inline explicit Ledger(std::shared_ptr<LedgerRules<T>> rules) : rules_(std::move(rules)) {}
+
+        inline void onBlockConnected(const Block<T> &block) override {
+            accounts_.beginBlock();
+            try {
+                rules_->apply(block, accounts_);
+            } catch (...) {
+                accounts_.commitBlock();
+                accounts_.revertBlock();
+                throw;
+            }
+            accounts_.commitBlock();
+            roots_.push_back(accounts_.getStateRoot());
+        }
+
+        inline void onBlockDisconnected(const Block<T> &) override {
+            accounts_.revertBlock();
+            roots_.pop_back();
+        }
+
+        // Finalized blocks never disconnect, so their undo records can go
+        inline void onBlockFinalized(const Block<T> &block) override {
+            int64_t oldest = getHeight() - static_cast<int64_t>(accounts_.getUndoDepth()) + 1;
+            if (block.index_ >= oldest) {
+                accounts_.forget(static_cast<size_t>(block.index_ - oldest + 1));
+            }
+        }
+
+        // Apply the chain's canonical blocks above getHeight()
+        inline void catchUp(const Chain<T> &chain) {
+            for (size_t i = static_cast<size_t>(getHeight() + 1); i < chain.blocks_.size(); i++) {
+                onBlockConnected(chain.blocks_[i]);
+            }
+        }
+
+        inline const AccountTable &getAccounts() const { return accounts_; }
+        inline int64_t getBalance(const std::string &name) const { return accounts_.getBalance(name); }
+
+        // Height of the last applied block, -1 before the first
+        inline int64_t getHeight() const { return static_cast<int64_t>(roots_.size()) - 1; }
+
+        inline std::string getStateRoot() const { return accounts_.getStateRoot(); }
+
+        // State root committed after the block at `height`
+        inline const std::string &getStateRoot(int64_t height) const { return roots_.at(static_cast<size_t>(height)); }
+
+      private:
+        std::shared_ptr<LedgerRules<T>> rules_;
+        AccountTable accounts_;
+        std::vector<std::string> roots_; // By height
+    };
+
+    enum class TransferKind : uint8_t {
+        Payment, // `amount` from `from` to `to`
+        Stake,   // `amount` of `from`'s balance into its stake
+        Unstake, // `amount` of `from`'s stake back to its balance
+        Claim,   // Settle `from`'s pending staking reward
+    };
+
+    // A value transfer carried by a transaction
+    struct Transfer {
+        std::string from;
+        std::string to;
+        int64_t amount = 0;
+        int64_t fee = 0; // Paid to the block's producer
+        TransferKind kind = TransferKind::Payment;
+    };
+
+    // Coinbase with halvings, transfers and fees. The producer is the block's sealer_id_, which the block hash
+    // commits to, so proof-of-work miners set it before mining. Transactions are read through `transfer_of`; one
+    // whose sender cannot pay amount plus fee is skipped, since the chain has already accepted the block. The
+    // staking share of each coinbase goes to stakers through AccountTable::distribute, with staking_account as the
+    // pool holding stakes and undistributed rewards.
+    template <typename T> class RewardRules : public LedgerRules<T> {
+      public:
+        struct Config {
+            int64_t initial_reward = 50;
+            int64_t halving_interval = 210000;       // Blocks between halvings
+            uint32_t staking_share_bps = 0;          // Part of each coinbase paid to stakers, in 1/10000
+            std::string staking_account = "staking"; // Staking pool
+        };
+
+        using TransferOf = std::function<std::optional<Transfer>(const Transaction<T> &)>;
+
+        inline RewardRules(Config config, TransferOf transfer_of)
+            : config_(std::move(config)), transfer_of_(std::move(transfer_of)) {}
+
+        inline const Config &getConfig() const { return config_; }
+
+        // Coinbase for the block at `height`; the genesis block has none
+        inline int64_t getReward(int64_t height) const {
+            if (height <= 0 || config_.halving_interval <= 0) {
+                return height <= 0 ? 0 : config_.initial_reward;
+            }
+            int64_t halvings = height / config_.halving_interval;
+            return halvings >= 63 ? 0 : config_.initial_reward >> halvings;
+        }
+
+        inline void apply(const Block<T> &block, AccountTable &accounts) override {
+            std::optional<AccountId> producer;
+            if (!block.sealer_id_.empty()) {
+                producer = accounts.account(block.sealer_id_);
+            }
+            for (const auto &tx : block.transactions_) {
+                auto transfer = transfer_of_(tx);
+                if (!transfer || transfer->amount < 0 || transfer->fee < 0 ||
+                    transfer->amount > std::numeric_limits<int64_t>::max() - transfer->fee ||
+                    !applyTransfer(*transfer, accounts)) {
+                    continue;
+                }
+                if (producer) {
+                    accounts.credit(*producer, transfer->fee); // Without a producer the fee is burned
+                }
+            }
+
+            int64_t reward = getReward(block.index_);
+            if (producer && reward > 0) {
+                int64_t staking = reward / 10000 * config_.staking_share_bps +
+                                  reward % 10000 * config_.staking_share_bps / 10000;
+                if (staking > 0 && accounts.credit(accounts.account(config_.staking_account), staking)) {
+                    accounts.distribute(staking);
+                }
+                accounts.credit(*producer, reward - staking);
+            }
+        }
+
+      private:
+        Config config_;
+        TransferOf transfer_of_;
+
+        // Debits the fee along with the transfer; false if the transfer is not possible
+        inline bool applyTransfer(const Transfer &transfer, AccountTable &accounts) const {
+            AccountId from = accounts.account(transfer.from);
+            if (transfer.kind == TransferKind::Payment) {
+                if (!accounts.debit(from, transfer.amount + transfer.fee)) {
+                    return false;
+                }
+                if (!accounts.credit(accounts.account(transfer.to), transfer.amount)) {
+                    accounts.credit(from, transfer.amount + transfer.fee); // Undo the debit, fee included
+                    return false;
+                }
+                return true;
+            }
+
+            // Staking operations never lower the balance below what is checked here, so the fee debit holds
+            AccountId pool = accounts.account(config_.staking_account);
+            int64_t needed = transfer.fee + (transfer.kind == TransferKind::Stake ? transfer.amount : 0);
+            if (from == pool || accounts.getBalance(from) < needed) {
+                return false;
+            }
+            bool applied = false;
+            switch (transfer.kind) {
+            case TransferKind::Stake:
+                applied = accounts.stake(from, pool, transfer.amount);
+                break;
+            case TransferKind::Unstake:
+                applied = accounts.unstake(from, pool, transfer.amount);
+                break;
+            case TransferKind::Claim:
+                applied = accounts.settle(from, pool);
+                break;
+            case TransferKind::Payment:
+                break;
+            }
+            return applied && accounts.debit(from, transfer.fee);
+        }
+    };
+
+} // namespace chain
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <queue>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "block.hpp"
+#include "trace.hpp"
+#include "transaction.hpp"
+
+namespace chain {
+
+    // How the pool ranks transactions for a block. Without a fee function every fee is zero and the ranking falls
+    // back to Transaction::priority_, then arrival order.
+    template <typename T> struct FeeModel {
+        std::function<int64_t(const Transaction<T> &)> fee;
+        // Transactions that must come earlier in the same block or be on chain already, e.g. the ones whose outputs
+        // this one spends. Parents that are not pooled are taken to be on chain.
+        std::function<std::vector<std::string>(const Transaction<T> &)> parents;
+        // Bytes counted against the template budget; the binary serialization by default
+        std::function<size_t(const Transaction<T> &)> size;
+    };
+
+    template <typename T> struct BlockTemplate {
+        std::vector<Transaction<T>> transactions; // Parents before children
+        int64_t fees = 0;
+        size_t bytes = 0;
+    };
+
+    // Transactions waiting for a block, keyed by UUID and kept in arrival order. Lookups and removals are O(1);
+    // pointers returned by find() stay valid until that transaction is removed. A second index ranks the pool by fee
+    // rate and is updated on every add and remove in O(log n), so building a block template is a walk from the top
+    // rather than a sort of the whole pool.
+    template <typename T> class Mempool {
+      public:
+        static constexpr size_t DEFAULT_MAX_SIZE = 100000;
+        static constexpr size_t MAX_TEMPLATE_MISSES = 1000; // Transactions too large for what is left, then stop
+
+        inline explicit Mempool(size_t max_size = DEFAULT_MAX_SIZE, FeeModel<T> fees = {})
+            : max_size_(max_size), fees_(std::move(fees)) {}
+
+        // Re-ranks everything already pooled
+        inline void setFeeModel(FeeModel<T> fees) {
+            fees_ = std::move(fees);
+            ranking_.clear();
+            for (auto &[id, entry] : index_) {
+                describe(*entry.tx, entry);
+                ranking_.insert(rank(entry));
+            }
+        }
+
+        // False if the transaction is already pooled or the pool is full
+        inline bool add(const Transaction<T> &tx) {
+            if (index_.size() >= max_size_ || index_.count(tx.uuid_) > 0) {
+                return false;
+            }
+            order_.push_back(tx);
+            Entry &entry = index_[tx.uuid_];
+            entry.tx = std::prev(order_.end());
+            entry.sequence = next_sequence_++;
+            describe(tx, entry);
+            ranking_.insert(rank(entry));
+            return true;
+        }
+
+        inline bool contains(const std::string &tx_id) const { return index_.count(tx_id) > 0; }
+
+        inline const Transaction<T> *find(const std::string &tx_id) const {
+            auto it = index_.find(tx_id);
+            return it != index_.end() ? &*it->second.tx : nullptr;
+        }
+
+        inline bool remove(const std::string &tx_id) {
+            auto it = index_.find(tx_id);
+            if (it == index_.end()) {
+                return false;
+            }
+            ranking_.erase(rank(it->second));
+            order_.erase(it->second.tx);
+            index_.erase(it);
+            return true;
+        }
+
+        // Drop every transaction a block includes
+        inline size_t removeIncluded(const Block<T> &block) {
+            size_t removed = 0;
+            for (const auto &tx : block.transactions_) {
+                removed += remove(tx.uuid_) ? 1 : 0;
+            }
+            return removed;
+        }
+
+        template <typename Predicate> inline size_t removeIf(Predicate predicate) {
+            size_t removed = 0;
+            for (auto it = order_.begin(); it != order_.end();) {
+                if (predicate(*it)) {
+                    auto entry = index_.find(it->uuid_);
+                    ranking_.erase(rank(entry->second));
+                    index_.erase(entry);
+                    it = order_.erase(it);
+                    removed++;
+                } else {
+                    ++it;
+                }
+            }
+            return removed;
+        }
+
+        // Up to `max` transactions, oldest first
+        inline std::vector<Transaction<T>> select(size_t max) const {
+            std::vector<Transaction<T>> selected;
+            for (auto it = order_.begin(); it != order_.end() && selected.size() < max; ++it) {
+                selected.push_back(*it);
+            }
+            return selected;
+        }
+
+        // The highest-paying set that fits `max_bytes` and `max_count`, chosen greedily by fee rate. A transaction
+        // whose pooled parents are not in yet waits until they are, then competes at its own rate.
+        inline BlockTemplate<T> buildTemplate(size_t max_bytes, size_t max_count) const {
+            TraceSpan span("Mempool::buildTemplate");
+            BlockTemplate<T> result;
+            std::unordered_set<std::string_view> included;
+            std::unordered_map<std::string_view, std::vector<const Entry *>> waiting; // By missing parent
+            std::unordered_map<const Entry *, size_t> missing;
+            auto later = [](const Entry *a, const Entry *b) { return RankOrder{}(rank(*b), rank(*a)); };
+            std::priority_queue<const Entry *, std::vector<const Entry *>, decltype(later)> released(later);
+            size_t misses = 0;
+
+            auto next = ranking_.begin();
+            while (result.transactions.size() < max_count && misses < MAX_TEMPLATE_MISSES) {
+                const Entry *entry;
+                bool from_ranking = next != ranking_.end() &&
+                                    (released.empty() || RankOrder{}(*next, rank(*released.top())));
+                if (from_ranking) {
+                    entry = next->entry;
+                    ++next;
+                    size_t unmet = 0;
+                    for (const auto &parent : entry->parents) {
+                        if (index_.count(parent) > 0 && included.count(parent) == 0) {
+                            waiting[parent].push_back(entry);
+                            unmet++;
+                        }
+                    }
+                    if (unmet > 0) {
+                        missing[entry] = unmet;
+                        continue;
+                    }
+                } else if (!released.empty()) {
+                    entry = released.top();
+                    released.pop();
+                } else {
+                    break;
+                }
+
+                if (entry->size > max_bytes - result.bytes) {
+                    misses++; // Its children stay waiting for good
+                    continue;
+                }
+                result.transactions.push_back(*entry->tx);
+                result.fees += entry->fee;
+                result.bytes += entry->size;
+                included.insert(entry->tx->uuid_);
+                if (auto children = waiting.find(entry->tx->uuid_); children != waiting.end()) {
+                    for (const Entry *child : children->second) {
+                        if (--missing[child] == 0) {
+                            released.push(child);
+                        }
+                    }
+                    waiting.erase(children);
+                }
+            }
+            return result;
+        }
+
+        inline typename std::list<Transaction<T>>::const_iterator begin() const { return order_.begin(); }
+        inline typename std::list<Transaction<T>>::const_iterator end() const { return order_.end(); }
+
+        inline size_t size() const { return index_.size(); }
+        inline bool empty() const { return index_.empty(); }
+
+        inline void clear() {
+            order_.clear();
+            index_.clear();
+            ranking_.clear();
+        }
+
+      private:
+        using Position = typename std::list<Transaction<T>>::iterator;
+
+        struct Entry {
+            Position tx;
+            int64_t fee = 0;
+            size_t size = 1;
+            double fee_rate = 0.0; // Per byte
+            uint64_t sequence = 0; // Arrival order
+            std::vector<std::string> parents;
+        };
+
+        struct Rank {
+            double fee_rate;
+            int16_t priority;
+            uint64_t sequence;
+            const Entry *entry;
+        };
+
+        // Best first: fee rate, then priority, then the earlier arrival
+        struct RankOrder {
+            inline bool operator()(const Rank &a, const Rank &b) const {
+                if (a.fee_rate != b.fee_rate) {
+                    return a.fee_rate > b.fee_rate;
+                }
+                if (a.priority != b.priority) {
+                    return a.priority > b.priority;
+                }
+                return a.sequence < b.sequence;
+            }
+        };
+
+        size_t max_size_;
+        FeeModel<T> fees_;
+        std::list<Transaction<T>> order_;
+        std::unordered_map<std::string, Entry> index_; // Node-based, so the ranking can point into it
+        std::set<Rank, RankOrder> ranking_;
+        uint64_t next_sequence_ = 0;
+
+        inline static Rank rank(const Entry &entry) {
+            return Rank{entry.fee_rate, entry.tx->priority_, entry.sequence, &entry};
+        }
+
+        inline void describe(const Transaction<T> &tx, Entry &entry) const {
+            entry.fee = fees_.fee ? fees_.fee(tx) : 0;
+            entry.size = std::max<size_t>(fees_.size ? fees_.size(tx) : tx.serializeBinary().size(), 1);
+            entry.fee_rate = static_cast<double>(entry.fee) / static_cast<double>(entry.size);
+            entry.parents = fees_.parents ? fees_.parents(tx) : std::vector<std::string>{};
+        }
+    };
+
+} // namespace chain
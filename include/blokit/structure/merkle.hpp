@@ -1,86 +1,101 @@
 #pragma once
 
 #include <iostream>
-#include <lockey/lockey.hpp>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "metrics.hpp"
+#include "sha256.hpp"
+#include "trace.hpp"
+
 namespace chain {
 
+    // Nodes are SHA-256 digests; an inner node hashes the hex encodings of its two children, so roots and proofs
+    // are the same hex strings Lockey-based trees produced. Leaves and levels live in a caller-supplied memory
+    // resource, which lets Block build its trees in a per-block arena (see BlockArena).
     class MerkleTree {
       private:
-        std::vector<std::string> leaves_;
-        std::vector<std::vector<std::string>> tree_levels_;
+        using Digest = Sha256::Digest;
+
+        std::pmr::vector<std::pmr::string> leaves_;
+        std::pmr::vector<std::pmr::vector<Digest>> tree_levels_;
         std::string root_hash_;
 
-        // Hash function using Lockey
-        inline std::string hashData(const std::string &data) const {
-            lockey::Lockey crypto(lockey::Lockey::Algorithm::AES_256_GCM, lockey::Lockey::HashAlgorithm::SHA256);
-            std::vector<uint8_t> data_vec(data.begin(), data.end());
-            auto hash_result = crypto.hash(data_vec);
+        inline explicit MerkleTree(std::pmr::memory_resource *resource) : leaves_(resource), tree_levels_(resource) {}
 
-            if (hash_result.success) {
-                return lockey::Lockey::to_hex(hash_result.data);
-            } else {
-                return "";
-            }
+        inline static Digest hashData(std::string_view data) {
+            return Sha256::hash(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        }
+
+        // Hash of the concatenation, without building it
+        inline static Digest combineHashes(std::string_view left, std::string_view right) {
+            Sha256 sha;
+            sha.update(reinterpret_cast<const uint8_t *>(left.data()), left.size());
+            sha.update(reinterpret_cast<const uint8_t *>(right.data()), right.size());
+            return sha.finalize();
         }
 
-        // Combine two hashes
-        inline std::string combineHashes(const std::string &left, const std::string &right) const {
-            return hashData(left + right);
+        inline static Digest combineHashes(const Digest &left, const Digest &right) {
+            char hex[128];
+            Sha256::toHex(left, hex);
+            Sha256::toHex(right, hex + 64);
+            return hashData(std::string_view(hex, sizeof(hex)));
         }
 
       public:
         MerkleTree() = default;
 
         // Construct Merkle tree from transaction strings
-        inline explicit MerkleTree(const std::vector<std::string> &transaction_strings) {
-            if (transaction_strings.empty()) {
-                root_hash_ = "";
-                return;
+        inline explicit MerkleTree(const std::vector<std::string> &transaction_strings,
+                                   std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : leaves_(resource), tree_levels_(resource) {
+            leaves_.reserve(transaction_strings.size());
+            for (const auto &tx : transaction_strings) {
+                leaves_.emplace_back(tx);
             }
-
-            leaves_ = transaction_strings;
             buildTree();
         }
 
+        // Takes the leaves over, building the tree in the memory resource they were allocated from
+        static inline MerkleTree fromLeaves(std::pmr::vector<std::pmr::string> &&leaves) {
+            MerkleTree tree(leaves.get_allocator().resource());
+            tree.leaves_ = std::move(leaves);
+            tree.buildTree();
+            return tree;
+        }
+
         // Build the Merkle tree
         inline void buildTree() {
+            MetricTimer timer(Histogram::MerkleBuild);
+            TraceSpan span("MerkleTree::buildTree");
+            tree_levels_.clear();
             if (leaves_.empty()) {
                 root_hash_ = "";
                 return;
             }
 
-            tree_levels_.clear();
-
-            // Start with leaf level (hash each transaction)
-            std::vector<std::string> current_level;
+            // Leaf level hashes each transaction, then each level halves up to the root
+            std::pmr::vector<Digest> current_level(tree_levels_.get_allocator());
+            current_level.reserve(leaves_.size());
             for (const auto &leaf : leaves_) {
                 current_level.push_back(hashData(leaf));
             }
-            tree_levels_.push_back(current_level);
-
-            // Build tree levels up to root
-            while (current_level.size() > 1) {
-                std::vector<std::string> next_level;
-
-                for (size_t i = 0; i < current_level.size(); i += 2) {
-                    if (i + 1 < current_level.size()) {
-                        // Pair exists
-                        next_level.push_back(combineHashes(current_level[i], current_level[i + 1]));
-                    } else {
-                        // Odd number, hash with itself
-                        next_level.push_back(combineHashes(current_level[i], current_level[i]));
-                    }
+            tree_levels_.push_back(std::move(current_level));
+
+            while (tree_levels_.back().size() > 1) {
+                const auto &level = tree_levels_.back();
+                std::pmr::vector<Digest> next_level(tree_levels_.get_allocator());
+                next_level.reserve((level.size() + 1) / 2);
+                for (size_t i = 0; i < level.size(); i += 2) {
+                    // An odd node out is paired with itself
+                    next_level.push_back(combineHashes(level[i], level[i + 1 < level.size() ? i + 1 : i]));
                 }
-
-                tree_levels_.push_back(next_level);
-                current_level = next_level;
+                tree_levels_.push_back(std::move(next_level));
             }
 
-            // Root is the single element in the final level
-            root_hash_ = current_level.empty() ? "" : current_level[0];
+            root_hash_ = Sha256::toHex(tree_levels_.back()[0]);
         }
 
         // Get the Merkle root
@@ -112,10 +127,10 @@ namespace chain {
 
                 // Add sibling to proof if it exists
                 if (sibling_index < current_level_nodes.size()) {
-                    proof.push_back(current_level_nodes[sibling_index]);
+                    proof.push_back(Sha256::toHex(current_level_nodes[sibling_index]));
                 } else {
                     // If no sibling, use the same node (for odd numbers)
-                    proof.push_back(current_level_nodes[current_index]);
+                    proof.push_back(Sha256::toHex(current_level_nodes[current_index]));
                 }
 
                 // Move to parent index
@@ -129,7 +144,7 @@ namespace chain {
         inline std::vector<std::string> generateProof(const std::string &transaction_data) const {
             // Find the index of the transaction
             for (size_t i = 0; i < leaves_.size(); i++) {
-                if (leaves_[i] == transaction_data) {
+                if (std::string_view(leaves_[i]) == transaction_data) {
                     return getProof(i);
                 }
             }
@@ -139,27 +154,24 @@ namespace chain {
         // Verify a transaction is in the tree using proof
         inline bool verifyProof(const std::string &transaction_data, size_t transaction_index,
                                 const std::vector<std::string> &proof) const {
-            if (proof.empty() && leaves_.size() == 1) {
-                // Single transaction case
-                return hashData(transaction_data) == root_hash_;
-            }
-
-            std::string current_hash = hashData(transaction_data);
+            char current_hash[64];
+            Sha256::toHex(hashData(transaction_data), current_hash);
+            std::string_view current(current_hash, sizeof(current_hash));
             size_t current_index = transaction_index;
 
-            // Traverse proof
+            // Traverse proof; with a single transaction the proof is empty and the leaf is the root
             for (const auto &proof_hash : proof) {
                 if (current_index % 2 == 0) {
                     // Current is left child
-                    current_hash = combineHashes(current_hash, proof_hash);
+                    Sha256::toHex(combineHashes(current, proof_hash), current_hash);
                 } else {
                     // Current is right child
-                    current_hash = combineHashes(proof_hash, current_hash);
+                    Sha256::toHex(combineHashes(proof_hash, current), current_hash);
                 }
                 current_index = current_index / 2;
             }
 
-            return current_hash == root_hash_;
+            return current == root_hash_;
         }
 
         // Verify proof using transaction data and root
@@ -167,7 +179,7 @@ namespace chain {
                                 const std::string &expected_root) const {
             // Find the index of the transaction
             for (size_t i = 0; i < leaves_.size(); i++) {
-                if (leaves_[i] == transaction_data) {
+                if (std::string_view(leaves_[i]) == transaction_data) {
                     return verifyProof(transaction_data, i, proof) && (root_hash_ == expected_root);
                 }
             }
@@ -186,7 +198,7 @@ namespace chain {
             for (size_t level = 0; level < tree_levels_.size(); level++) {
                 std::cout << "Level " << level << " (" << tree_levels_[level].size() << " nodes):" << std::endl;
                 for (size_t i = 0; i < tree_levels_[level].size(); i++) {
-                    std::cout << "  " << tree_levels_[level][i].substr(0, 16) << "..." << std::endl;
+                    std::cout << "  " << Sha256::toHex(tree_levels_[level][i]).substr(0, 16) << "..." << std::endl;
                 }
             }
 
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace chain {
+
+    // Recording compiles away unless BLOCKIT_ENABLE_METRICS is defined (CMake option BLOCKIT_ENABLE_METRICS);
+    // the registry and snapshots stay available either way and simply read zero.
+#ifdef BLOCKIT_ENABLE_METRICS
+    inline constexpr bool METRICS_ENABLED = true;
+#else
+    inline constexpr bool METRICS_ENABLED = false;
+#endif
+
+    enum class Counter : size_t {
+        Hashes,                 // SHA-256 digests: block headers, Merkle nodes and Sha256::finalize
+        SignatureVerifications, // Calls to verify(), e.g. seals and finality votes
+        DedupHits,              // Transaction ids found already used
+        DedupMisses,
+        SerializedBytes, // Block::serializeBinary output
+        DeserializedBytes,
+        BlocksAdded, // Blocks connected to the canonical chain, reorganizations included
+        Count
+    };
+
+    enum class Histogram : size_t {
+        AddBlock,    // Chain::addBlock and importBlock, rejected blocks included
+        MerkleBuild, // MerkleTree::buildTree
+        StorageSync, // DiskCoinStore::sync and Chain::saveToFile, up to the fsync returning
+        Count
+    };
+
+    inline constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+    inline constexpr size_t HISTOGRAM_COUNT = static_cast<size_t>(Histogram::Count);
+
+    // Prometheus names, prefixed with "blockit_" on export
+    inline constexpr std::array<const char *, COUNTER_COUNT> COUNTER_NAMES = {
+        "hashes_total",           "signature_verifications_total", "dedup_hits_total",  "dedup_misses_total",
+        "serialized_bytes_total", "deserialized_bytes_total",      "blocks_added_total"};
+    inline constexpr std::array<const char *, HISTOGRAM_COUNT> HISTOGRAM_NAMES = {
+        "add_block_seconds", "merkle_build_seconds", "storage_sync_seconds"};
+
+    // Log-linear buckets in the style of HdrHistogram: values below 16 get a bucket each, and every power of two
+    // above that is split into 16 sub-buckets, so any recorded value is known to within 1/16 (6%) over the
+    // whole 64-bit range
+    struct HistogramBuckets {
+        static constexpr unsigned SUB_BITS = 4;
+        static constexpr uint64_t SUB_COUNT = uint64_t{1} << SUB_BITS;
+        static constexpr size_t COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+        static inline size_t index(uint64_t value) {
+            if (value < SUB_COUNT) {
+                return static_cast<size_t>(value);
+            }
+            unsigned exponent = 63 - static_cast<unsigned>(std::countl_zero(value));
+            uint64_t sub = (value >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+            return static_cast<size_t>((exponent - SUB_BITS + 1) * SUB_COUNT + sub);
+        }
+
+        // Largest value that lands in bucket `i`
+        static inline uint64_t upperBound(size_t i) {
+            if (i < SUB_COUNT) {
+                return i;
+            }
+            unsigned exponent = static_cast<unsigned>(i / SUB_COUNT) + SUB_BITS - 1;
+            uint64_t lower = (SUB_COUNT + i % SUB_COUNT) << (exponent - SUB_BITS);
+            return lower + ((uint64_t{1} << (exponent - SUB_BITS)) - 1);
+        }
+    };
+
+    struct HistogramSnapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0; // Nanoseconds
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(HistogramBuckets::COUNT);
+
+        // Upper bound of the bucket holding the p-th fraction of recorded values, in nanoseconds
+        inline uint64_t percentile(double p) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(count) + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); i++) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return HistogramBuckets::upperBound(i);
+                }
+            }
+            return HistogramBuckets::upperBound(buckets.size() - 1);
+        }
+
+        inline double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+    };
+
+    struct MetricsSnapshot {
+        std::array<uint64_t, COUNTER_COUNT> counters{};
+        std::array<HistogramSnapshot, HISTOGRAM_COUNT> histograms;
+
+        inline uint64_t counter(Counter c) const { return counters[static_cast<size_t>(c)]; }
+        inline const HistogramSnapshot &histogram(Histogram h) const { return histograms[static_cast<size_t>(h)]; }
+
+        // Prometheus text exposition format; histograms are exported as summaries with fixed quantiles
+        inline std::string toPrometheus() const {
+            std::string out;
+            char line[160];
+            for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                std::snprintf(line, sizeof(line), "# TYPE blockit_%s counter\nblockit_%s %llu\n", COUNTER_NAMES[i],
+                              COUNTER_NAMES[i], static_cast<unsigned long long>(counters[i]));
+                out += line;
+            }
+            for (size_t i = 0; i < HISTOGRAM_COUNT; i++) {
+                const char *name = HISTOGRAM_NAMES[i];
+                std::snprintf(line, sizeof(line), "# TYPE blockit_%s summary\n", name);
+                out += line;
+                for (double q : {0.5, 0.9, 0.99, 0.999}) {
+                    std::snprintf(line, sizeof(line), "blockit_%s{quantile=\"%g\"} %.9f\n", name, q,
+                                  static_cast<double>(histograms[i].percentile(q)) / 1e9);
+                    out += line;
+                }
+                std::snprintf(line, sizeof(line), "blockit_%s_sum %.9f\nblockit_%s_count %llu\n", name,
+                              static_cast<double>(histograms[i].sum) / 1e9, name,
+                              static_cast<unsigned long long>(histograms[i].count));
+                out += line;
+            }
+            return out;
+        }
+    };
+
+    // Process-wide metrics. Each thread records into its own shard, which only that thread writes, so an update
+    // is a relaxed load and store with no locked instruction and no contention; snapshot() sums the shards.
+    // Shards of exited threads are folded into a retired total.
+    class MetricsRegistry {
+      public:
+        static inline MetricsRegistry &instance() {
+            static MetricsRegistry registry;
+            return registry;
+        }
+
+        inline void add(Counter c, uint64_t n) { bump(shard().counters[static_cast<size_t>(c)], n); }
+
+        inline void record(Histogram h, uint64_t nanoseconds) {
+            Cells &cells = shard().histograms[static_cast<size_t>(h)];
+            bump(cells.buckets[HistogramBuckets::index(nanoseconds)], 1);
+            bump(cells.sum, nanoseconds);
+        }
+
+        // Totals since the last reset(). Values recorded concurrently may or may not be included.
+        inline MetricsSnapshot snapshot() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            MetricsSnapshot totals = retired_;
+            for (const Shard *s : shards_) {
+                accumulate(totals, *s);
+            }
+            for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                totals.counters[i] -= baseline_.counters[i];
+            }
+            for (size_t h = 0; h < HISTOGRAM_COUNT; h++) {
+                HistogramSnapshot &hist = totals.histograms[h];
+                const HistogramSnapshot &base = baseline_.histograms[h];
+                hist.sum -= base.sum;
+                hist.count = 0;
+                for (size_t b = 0; b < HistogramBuckets::COUNT; b++) {
+                    hist.buckets[b] -= base.buckets[b];
+                    hist.count += hist.buckets[b];
+                }
+            }
+            return totals;
+        }
+
+        // Shards are never written by other threads, so a reset is a new baseline that snapshots subtract
+        inline void reset() {
+            auto current = snapshot();
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                baseline_.counters[i] += current.counters[i];
+            }
+            for (size_t h = 0; h < HISTOGRAM_COUNT; h++) {
+                baseline_.histograms[h].sum += current.histograms[h].sum;
+                for (size_t b = 0; b < HistogramBuckets::COUNT; b++) {
+                    baseline_.histograms[h].buckets[b] += current.histograms[h].buckets[b];
+                }
+            }
+        }
+
+      private:
+        struct Cells {
+            std::array<std::atomic<uint64_t>, HistogramBuckets::COUNT> buckets{};
+            std::atomic<uint64_t> sum{0};
+        };
+
+        struct Shard {
+            std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+            std::array<Cells, HISTOGRAM_COUNT> histograms{};
+        };
+
+        // Registers the calling thread's shard on first use and retires it when the thread exits
+        class ShardHandle {
+          public:
+            inline explicit ShardHandle(MetricsRegistry &registry)
+                : registry_(registry), shard_(std::make_unique<Shard>()) {
+                std::lock_guard<std::mutex> lock(registry_.mutex_);
+                registry_.shards_.push_back(shard_.get());
+            }
+
+            inline ~ShardHandle() {
+                std::lock_guard<std::mutex> lock(registry_.mutex_);
+                accumulate(registry_.retired_, *shard_);
+                registry_.shards_.erase(std::find(registry_.shards_.begin(), registry_.shards_.end(), shard_.get()));
+            }
+
+            inline ShardHandle(const ShardHandle &) = delete;
+            inline ShardHandle &operator=(const ShardHandle &) = delete;
+
+            inline Shard &get() { return *shard_; }
+
+          private:
+            MetricsRegistry &registry_;
+            std::unique_ptr<Shard> shard_;
+        };
+
+        mutable std::mutex mutex_;
+        std::vector<Shard *> shards_;
+        MetricsSnapshot retired_;  // Threads that have exited
+        MetricsSnapshot baseline_; // Totals at the last reset()
+
+        inline MetricsRegistry() = default;
+
+        inline Shard &shard() {
+            thread_local ShardHandle handle(*this);
+            return handle.get();
+        }
+
+        static inline void bump(std::atomic<uint64_t> &cell, uint64_t n) {
+            cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        static inline void accumulate(MetricsSnapshot &totals, const Shard &shard) {
+            for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                totals.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t h = 0; h < HISTOGRAM_COUNT; h++) {
+                HistogramSnapshot &hist = totals.histograms[h];
+                hist.sum += shard.histograms[h].sum.load(std::memory_order_relaxed);
+                for (size_t b = 0; b < HistogramBuckets::COUNT; b++) {
+                    uint64_t n = shard.histograms[h].buckets[b].load(std::memory_order_relaxed);
+                    hist.buckets[b] += n;
+                    hist.count += n;
+                }
+            }
+        }
+    };
+
+    // Hot-path entry points; both vanish when metrics are disabled
+
+    inline void countMetric(Counter c, uint64_t n = 1) {
+        if constexpr (METRICS_ENABLED) {
+            MetricsRegistry::instance().add(c, n);
+        }
+    }
+
+    // Records the time from construction to destruction into a histogram
+    class MetricTimer {
+      public:
+        inline explicit MetricTimer(Histogram histogram) : histogram_(histogram) {
+            if constexpr (METRICS_ENABLED) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        inline ~MetricTimer() {
+            if constexpr (METRICS_ENABLED) {
+                auto elapsed = std::chrono::steady_clock::now() - start_;
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                MetricsRegistry::instance().record(histogram_, static_cast<uint64_t>(ns));
+            }
+        }
+
+        inline MetricTimer(const MetricTimer &) = delete;
+        inline MetricTimer &operator=(const MetricTimer &) = delete;
+
+      private:
+        Histogram histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+} // namespace chain
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <cstring>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <vector>
 
@@ -27,6 +32,16 @@ namespace chain {
         static constexpr bool value = has_serialize_method && has_deserialize_method;
     };
 
+    template <typename T> class has_span_deserialize {
+        template <typename U>
+        static auto test(int) -> decltype(U::deserializeBinary(std::declval<std::span<const uint8_t>>()),
+                                          std::true_type{});
+        template <typename> static std::false_type test(...);
+
+      public:
+        static constexpr bool value = decltype(test<T>(0))::value;
+    };
+
     template <typename T> class has_json_serialize {
         template <typename U>
         static auto test_json_serialize(int) -> decltype(std::declval<U>().serialize(), std::true_type{});
@@ -43,6 +58,31 @@ namespace chain {
         static constexpr bool value = has_serialize_method && has_deserialize_method;
     };
 
+    // A payload can list its serialized fields in order and get a generated fixed-layout binary encoding:
+    //     static constexpr auto fields() { return std::make_tuple(&Reading::sensor_id, &Reading::value); }
+    template <typename T>
+    concept has_field_list =
+        std::is_default_constructible_v<T> && requires { std::tuple_size<decltype(T::fields())>::value; };
+
+    // Opts a payload into being encoded as its object bytes; nothing is encoded that way unless asked for:
+    //     template <> struct chain::object_bytes_encoding<ImuSample> : std::true_type {};
+    template <typename T> struct object_bytes_encoding : std::false_type {};
+
+    // Object bytes are only a wire format if every bit belongs to a value: no padding and no floating point, whose
+    // equal values can differ in their bits
+    template <typename T>
+    concept has_plain_bytes = std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> &&
+                              std::has_unique_object_representations_v<T> && !std::is_pointer_v<T>;
+
+    // Opted-in payloads with plain bytes are encoded as those bytes, which already are the little-endian wire order
+    // on little-endian hosts
+    template <typename T>
+    concept has_trivial_layout =
+        object_bytes_encoding<T>::value && has_plain_bytes<T> && std::endian::native == std::endian::little;
+
+    template <typename T> struct is_std_array : std::false_type {};
+    template <typename E, size_t N> struct is_std_array<std::array<E, N>> : std::true_type {};
+
     // Serialization format enum
     enum class SerializationFormat {
         BINARY, // Default
@@ -69,6 +109,11 @@ namespace chain {
             buffer.push_back(static_cast<uint8_t>((value >> 24) & 0xFF));
         }
 
+        static void writeUint64(std::vector<uint8_t> &buffer, uint64_t value) {
+            writeUint32(buffer, static_cast<uint32_t>(value & 0xFFFFFFFF));
+            writeUint32(buffer, static_cast<uint32_t>(value >> 32));
+        }
+
         static void writeInt16(std::vector<uint8_t> &buffer, int16_t value) {
             writeUint16(buffer, static_cast<uint16_t>(value));
         }
@@ -88,6 +133,18 @@ namespace chain {
             buffer.insert(buffer.end(), data.begin(), data.end());
         }
 
+        // Same layout as writeBytes, but `write` appends the payload straight into the buffer and the length is
+        // filled in afterwards, saving the temporary vector
+        template <typename Write> static void writeNested(std::vector<uint8_t> &buffer, Write &&write) {
+            size_t length_at = buffer.size();
+            writeUint32(buffer, 0);
+            write(buffer);
+            uint32_t length = static_cast<uint32_t>(buffer.size() - length_at - 4);
+            for (size_t i = 0; i < 4; i++) {
+                buffer[length_at + i] = static_cast<uint8_t>(length >> (8 * i));
+            }
+        }
+
         // Read operations
         static uint8_t readUint8(const std::vector<uint8_t> &buffer, size_t &offset) {
             if (offset >= buffer.size()) {
@@ -116,6 +173,12 @@ namespace chain {
             return value;
         }
 
+        static uint64_t readUint64(const std::vector<uint8_t> &buffer, size_t &offset) {
+            uint64_t low = readUint32(buffer, offset);
+            uint64_t high = readUint32(buffer, offset);
+            return low | (high << 32);
+        }
+
         static int16_t readInt16(const std::vector<uint8_t> &buffer, size_t &offset) {
             return static_cast<int16_t>(readUint16(buffer, offset));
         }
@@ -161,15 +224,112 @@ namespace chain {
         }
 
         // CRC32 checksum calculation
+        static uint32_t calculateCRC32(std::span<const uint8_t> data) { return ~updateCRC32(CRC32_INIT, data); }
+
         static uint32_t calculateCRC32(const std::vector<uint8_t> &data) {
-            uint32_t crc = 0xFFFFFFFF;
+            return calculateCRC32(std::span<const uint8_t>(data));
+        }
+
+        // Incremental form for data in several pieces: start from CRC32_INIT and complement the final state
+        static constexpr uint32_t CRC32_INIT = 0xFFFFFFFF;
+
+        static uint32_t updateCRC32(uint32_t state, std::span<const uint8_t> data) {
+            const auto &table = crc32Table();
             for (uint8_t byte : data) {
-                crc ^= byte;
-                for (int i = 0; i < 8; i++) {
-                    crc = (crc >> 1) ^ (0xEDB88320 * (crc & 1));
+                state = (state >> 8) ^ table[(state ^ byte) & 0xFF];
+            }
+            return state;
+        }
+
+      private:
+        static const std::array<uint32_t, 256> &crc32Table() {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> entries{};
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t crc = n;
+                    for (int i = 0; i < 8; i++) {
+                        crc = (crc >> 1) ^ (0xEDB88320 * (crc & 1));
+                    }
+                    entries[n] = crc;
                 }
+                return entries;
+            }();
+            return table;
+        }
+    };
+
+    // Bounds-checked reader over bytes it does not own. Length-prefixed fields come back as spans into the same
+    // memory, so nested structures decode without intermediate copies; only the final field values are copied.
+    class BinaryReader {
+      public:
+        inline explicit BinaryReader(std::span<const uint8_t> data) : data_(data) {}
+
+        inline uint8_t readUint8() { return take(1, "uint8")[0]; }
+
+        inline uint16_t readUint16() {
+            auto bytes = take(2, "uint16");
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        inline uint32_t readUint32() {
+            auto bytes = take(4, "uint32");
+            return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                   (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        inline uint64_t readUint64() {
+            uint64_t low = readUint32();
+            uint64_t high = readUint32();
+            return low | (high << 32);
+        }
+
+        inline int16_t readInt16() { return static_cast<int16_t>(readUint16()); }
+
+        inline double readDouble() {
+            double value;
+            std::memcpy(&value, take(sizeof(double), "double").data(), sizeof(double));
+            return value;
+        }
+
+        inline std::string readString() {
+            uint32_t length = readUint32();
+            auto bytes = take(length, "string");
+            return std::string(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        }
+
+        // A length-prefixed field as written by BinarySerializer::writeBytes, without copying it
+        inline std::span<const uint8_t> readSpan() {
+            uint32_t length = readUint32();
+            return take(length, "bytes");
+        }
+
+        // The next `size` bytes, without copying them
+        inline std::span<const uint8_t> readRaw(size_t size) { return take(size, "bytes"); }
+
+        // Everything not read yet
+        inline std::span<const uint8_t> readRemaining() { return take(remaining(), "bytes"); }
+
+        inline void skip(size_t size) { take(size, "bytes"); }
+
+        inline std::vector<unsigned char> readBytesToUChar() {
+            auto bytes = readSpan();
+            return std::vector<unsigned char>(bytes.begin(), bytes.end());
+        }
+
+        inline size_t offset() const { return offset_; }
+        inline size_t remaining() const { return data_.size() - offset_; }
+
+      private:
+        std::span<const uint8_t> data_;
+        size_t offset_ = 0;
+
+        inline std::span<const uint8_t> take(size_t size, const char *what) {
+            if (size > remaining()) {
+                throw std::runtime_error(std::string("Buffer underflow reading ") + what);
             }
-            return ~crc;
+            auto bytes = data_.subspan(offset_, size);
+            offset_ += size;
+            return bytes;
         }
     };
 
@@ -257,11 +417,18 @@ namespace chain {
         }
 
         static BinaryHeader deserialize(const std::vector<uint8_t> &buffer, size_t &offset) {
+            BinaryReader reader(std::span<const uint8_t>(buffer).subspan(std::min(offset, buffer.size())));
+            BinaryHeader header = deserialize(reader);
+            offset += reader.offset();
+            return header;
+        }
+
+        static BinaryHeader deserialize(BinaryReader &reader) {
             BinaryHeader header;
-            header.magic = BinarySerializer::readUint32(buffer, offset);
-            header.version = BinarySerializer::readUint16(buffer, offset);
-            header.data_length = BinarySerializer::readUint32(buffer, offset);
-            header.checksum = BinarySerializer::readUint32(buffer, offset);
+            header.magic = reader.readUint32();
+            header.version = reader.readUint16();
+            header.data_length = reader.readUint32();
+            header.checksum = reader.readUint32();
 
             if (header.magic != MAGIC_NUMBER) {
                 throw std::runtime_error("Invalid binary format magic number");
@@ -274,25 +441,127 @@ namespace chain {
         }
     };
 
-    // Unified type serialization helper
+    // Generated encoding for types with a field list. Each field is written in declaration order, little-endian
+    // whatever the host: arithmetic and enum values at their own width, bools as one byte, strings length-prefixed
+    // as by writeString, std::arrays element by element, and nested field-listed types in place.
+    struct FieldCodec {
+        template <size_t N>
+        using Bits = std::conditional_t<
+            N == 1, uint8_t, std::conditional_t<N == 2, uint16_t, std::conditional_t<N == 4, uint32_t, uint64_t>>>;
+
+        template <typename T> static void writeFields(std::vector<uint8_t> &buffer, const T &obj) {
+            std::apply([&](auto... field) { (write(buffer, obj.*field), ...); }, T::fields());
+        }
+
+        template <typename T> static void readFields(BinaryReader &reader, T &obj) {
+            std::apply([&](auto... field) { (read(reader, obj.*field), ...); }, T::fields());
+        }
+
+        template <typename F> static void write(std::vector<uint8_t> &buffer, const F &value) {
+            if constexpr (std::is_same_v<F, std::string>) {
+                BinarySerializer::writeString(buffer, value);
+            } else if constexpr (std::is_same_v<F, bool>) {
+                buffer.push_back(value ? 1 : 0);
+            } else if constexpr (std::is_enum_v<F>) {
+                write(buffer, static_cast<std::underlying_type_t<F>>(value));
+            } else if constexpr (std::is_arithmetic_v<F>) {
+                static_assert(sizeof(F) <= 8, "Field is too wide for the fixed layout");
+                auto bits = std::bit_cast<Bits<sizeof(F)>>(value);
+                size_t at = buffer.size();
+                buffer.resize(at + sizeof(F));
+                if constexpr (std::endian::native == std::endian::little) {
+                    std::memcpy(buffer.data() + at, &bits, sizeof(F));
+                } else {
+                    for (size_t i = 0; i < sizeof(F); i++) {
+                        buffer[at + i] = static_cast<uint8_t>(bits >> (8 * i));
+                    }
+                }
+            } else if constexpr (is_std_array<F>::value) {
+                for (const auto &element : value) {
+                    write(buffer, element);
+                }
+            } else {
+                static_assert(has_field_list<F>, "Field type has no fixed-layout encoding");
+                writeFields(buffer, value);
+            }
+        }
+
+        template <typename F> static void read(BinaryReader &reader, F &value) {
+            if constexpr (std::is_same_v<F, std::string>) {
+                value = reader.readString();
+            } else if constexpr (std::is_same_v<F, bool>) {
+                value = reader.readUint8() != 0;
+            } else if constexpr (std::is_enum_v<F>) {
+                std::underlying_type_t<F> raw;
+                read(reader, raw);
+                value = static_cast<F>(raw);
+            } else if constexpr (std::is_arithmetic_v<F>) {
+                static_assert(sizeof(F) <= 8, "Field is too wide for the fixed layout");
+                auto bytes = reader.readRaw(sizeof(F));
+                Bits<sizeof(F)> bits = 0;
+                if constexpr (std::endian::native == std::endian::little) {
+                    std::memcpy(&bits, bytes.data(), sizeof(F));
+                } else {
+                    for (size_t i = 0; i < sizeof(F); i++) {
+                        bits |= static_cast<Bits<sizeof(F)>>(static_cast<Bits<sizeof(F)>>(bytes[i]) << (8 * i));
+                    }
+                }
+                value = std::bit_cast<F>(bits);
+            } else if constexpr (is_std_array<F>::value) {
+                for (auto &element : value) {
+                    read(reader, element);
+                }
+            } else {
+                static_assert(has_field_list<F>, "Field type has no fixed-layout encoding");
+                readFields(reader, value);
+            }
+        }
+    };
+
+    // Unified type serialization helper. In order of preference a payload is encoded by its own
+    // serializeBinary(), by its field list, as its object bytes if opted in, or as its to_string().
     template <typename T> class TypeSerializer {
+        static_assert(!object_bytes_encoding<T>::value || has_plain_bytes<T>,
+                      "Only trivially copyable types without padding or floating point can be encoded as object bytes");
+
+        static constexpr bool uses_field_list = !has_binary_serialize<T>::value && has_field_list<T>;
+        static constexpr bool uses_object_bytes =
+            !has_binary_serialize<T>::value && !has_field_list<T> && has_trivial_layout<T>;
+
       public:
         // Serialize T to binary format
         static std::vector<uint8_t> serializeBinary(const T &obj) {
             if constexpr (has_binary_serialize<T>::value) {
                 return obj.serializeBinary();
             } else {
-                // Fallback: serialize to_string() as binary
                 std::vector<uint8_t> buffer;
-                BinarySerializer::writeString(buffer, obj.to_string());
+                appendBinary(buffer, obj);
                 return buffer;
             }
         }
 
+        // Appends the encoding of `obj` to `buffer`; the fixed-layout paths write in place
+        static void appendBinary(std::vector<uint8_t> &buffer, const T &obj) {
+            if constexpr (has_binary_serialize<T>::value) {
+                auto bytes = obj.serializeBinary();
+                buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+            } else if constexpr (uses_field_list) {
+                FieldCodec::writeFields(buffer, obj);
+            } else if constexpr (uses_object_bytes) {
+                const auto *bytes = reinterpret_cast<const uint8_t *>(&obj);
+                buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+            } else {
+                // Fallback: serialize to_string() as binary
+                BinarySerializer::writeString(buffer, obj.to_string());
+            }
+        }
+
         // Deserialize T from binary format
         static T deserializeBinary(const std::vector<uint8_t> &data) {
             if constexpr (has_binary_serialize<T>::value) {
                 return T::deserializeBinary(data);
+            } else if constexpr (uses_field_list || uses_object_bytes) {
+                return deserializeBinary(std::span<const uint8_t>(data));
             } else {
                 // Fallback: This is limited - cannot reconstruct T from just to_string()
                 // The type should implement binary serialization for full functionality
@@ -300,6 +569,30 @@ namespace chain {
             }
         }
 
+        // Types that can read from a span get the bytes in place; others get an owned copy
+        static T deserializeBinary(std::span<const uint8_t> data) {
+            if constexpr (has_span_deserialize<T>::value) {
+                return T::deserializeBinary(data);
+            } else if constexpr (uses_field_list) {
+                BinaryReader reader(data);
+                T obj{};
+                FieldCodec::readFields(reader, obj);
+                if (reader.remaining() != 0) {
+                    throw std::runtime_error("Trailing bytes after payload fields");
+                }
+                return obj;
+            } else if constexpr (uses_object_bytes) {
+                if (data.size() != sizeof(T)) {
+                    throw std::runtime_error("Payload size does not match the type's layout");
+                }
+                std::array<uint8_t, sizeof(T)> bytes;
+                std::memcpy(bytes.data(), data.data(), sizeof(T));
+                return std::bit_cast<T>(bytes);
+            } else {
+                return deserializeBinary(std::vector<uint8_t>(data.begin(), data.end()));
+            }
+        }
+
         // Serialize T to JSON format
         static std::string serializeJson(const T &obj) {
             if constexpr (has_json_serialize<T>::value) {
@@ -322,7 +615,9 @@ namespace chain {
         }
 
         // Check if type supports binary serialization
-        static constexpr bool supportsBinary() { return has_binary_serialize<T>::value; }
+        static constexpr bool supportsBinary() {
+            return has_binary_serialize<T>::value || uses_field_list || uses_object_bytes;
+        }
 
         // Check if type supports JSON serialization
         static constexpr bool supportsJson() { return has_json_serialize<T>::value; }
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "metrics.hpp"
+
+namespace chain {
+
+    // Self-contained SHA-256 that exposes its chaining state. Lockey remains the general purpose hash; this
+    // exists so a miner can hash the constant part of a block header once (the "midstate") and then pay a
+    // single compression per candidate nonce.
+    class Sha256 {
+      public:
+        using Digest = std::array<uint8_t, 32>;
+        using State = std::array<uint32_t, 8>;
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        static constexpr State INITIAL_STATE = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                                0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+        inline Sha256() { reset(); }
+
+        inline void reset() {
+            state_ = INITIAL_STATE;
+            buffered_ = 0;
+            length_ = 0;
+        }
+
+        inline void update(const uint8_t *data, size_t len) {
+            length_ += len;
+            if (buffered_ > 0) {
+                size_t take = std::min(len, BLOCK_SIZE - buffered_);
+                std::memcpy(buffer_.data() + buffered_, data, take);
+                buffered_ += take;
+                data += take;
+                len -= take;
+                if (buffered_ < BLOCK_SIZE) {
+                    return;
+                }
+                compress(state_, buffer_.data());
+                buffered_ = 0;
+            }
+            while (len >= BLOCK_SIZE) {
+                compress(state_, data);
+                data += BLOCK_SIZE;
+                len -= BLOCK_SIZE;
+            }
+            std::memcpy(buffer_.data(), data, len);
+            buffered_ = len;
+        }
+
+        inline void update(const std::string &data) {
+            update(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        }
+
+        inline Digest finalize() {
+            uint64_t bit_length = length_ * 8;
+            uint8_t pad[BLOCK_SIZE * 2] = {0x80};
+            size_t pad_len = (buffered_ < 56 ? 56 : 120) - buffered_;
+            for (int i = 0; i < 8; i++) {
+                pad[pad_len + i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+            }
+            update(pad, pad_len + 8);
+            countMetric(Counter::Hashes);
+            return toDigest(state_);
+        }
+
+        // Chaining state after all complete 64-byte blocks absorbed so far
+        inline const State &state() const { return state_; }
+
+        static inline Digest hash(const uint8_t *data, size_t len) {
+            Sha256 sha;
+            sha.update(data, len);
+            return sha.finalize();
+        }
+
+        static inline Digest hash(const std::string &data) {
+            return hash(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        }
+
+        // Lowercase hex, the encoding Lockey::to_hex uses; writes exactly 64 characters
+        static inline void toHex(const Digest &digest, char *out) {
+            static constexpr char digits[] = "0123456789abcdef";
+            for (size_t i = 0; i < digest.size(); i++) {
+                out[2 * i] = digits[digest[i] >> 4];
+                out[2 * i + 1] = digits[digest[i] & 0x0f];
+            }
+        }
+
+        static inline std::string toHex(const Digest &digest) {
+            std::string hex(digest.size() * 2, '\0');
+            toHex(digest, hex.data());
+            return hex;
+        }
+
+        static inline uint32_t loadBigEndian(const uint8_t *p) {
+            return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+        }
+
+        static inline Digest toDigest(const State &state) {
+            Digest digest;
+            for (size_t i = 0; i < 8; i++) {
+                digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+                digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+                digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+                digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+            }
+            return digest;
+        }
+
+        // Process one 64-byte block
+        static inline void compress(State &state, const uint8_t *block) {
+            uint32_t words[16][1];
+            for (size_t i = 0; i < 16; i++) {
+                words[i][0] = loadBigEndian(block + i * 4);
+            }
+            uint32_t out[8][1];
+            compressLanes<1>(state, words, out);
+            for (size_t i = 0; i < 8; i++) {
+                state[i] = out[i][0];
+            }
+        }
+
+        // Compress LANES independent message blocks that share the same input state. The per-lane loops are
+        // written so the compiler can keep each lane in its own SIMD slot.
+        template <size_t LANES>
+        static inline void compressLanes(const State &state, const uint32_t (&words)[16][LANES],
+                                         uint32_t (&out)[8][LANES]) {
+            uint32_t w[64][LANES];
+            for (size_t i = 0; i < 16; i++) {
+                for (size_t l = 0; l < LANES; l++) {
+                    w[i][l] = words[i][l];
+                }
+            }
+            for (size_t i = 16; i < 64; i++) {
+                for (size_t l = 0; l < LANES; l++) {
+                    uint32_t s0 = rotr(w[i - 15][l], 7) ^ rotr(w[i - 15][l], 18) ^ (w[i - 15][l] >> 3);
+                    uint32_t s1 = rotr(w[i - 2][l], 17) ^ rotr(w[i - 2][l], 19) ^ (w[i - 2][l] >> 10);
+                    w[i][l] = w[i - 16][l] + s0 + w[i - 7][l] + s1;
+                }
+            }
+
+            uint32_t a[LANES], b[LANES], c[LANES], d[LANES], e[LANES], f[LANES], g[LANES], h[LANES];
+            for (size_t l = 0; l < LANES; l++) {
+                a[l] = state[0];
+                b[l] = state[1];
+                c[l] = state[2];
+                d[l] = state[3];
+                e[l] = state[4];
+                f[l] = state[5];
+                g[l] = state[6];
+                h[l] = state[7];
+            }
+
+            for (size_t i = 0; i < 64; i++) {
+                for (size_t l = 0; l < LANES; l++) {
+                    uint32_t s1 = rotr(e[l], 6) ^ rotr(e[l], 11) ^ rotr(e[l], 25);
+                    uint32_t ch = (e[l] & f[l]) ^ (~e[l] & g[l]);
+                    uint32_t t1 = h[l] + s1 + ch + K[i] + w[i][l];
+                    uint32_t s0 = rotr(a[l], 2) ^ rotr(a[l], 13) ^ rotr(a[l], 22);
+                    uint32_t maj = (a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]);
+                    uint32_t t2 = s0 + maj;
+                    h[l] = g[l];
+                    g[l] = f[l];
+                    f[l] = e[l];
+                    e[l] = d[l] + t1;
+                    d[l] = c[l];
+                    c[l] = b[l];
+                    b[l] = a[l];
+                    a[l] = t1 + t2;
+                }
+            }
+
+            for (size_t l = 0; l < LANES; l++) {
+                out[0][l] = state[0] + a[l];
+                out[1][l] = state[1] + b[l];
+                out[2][l] = state[2] + c[l];
+                out[3][l] = state[3] + d[l];
+                out[4][l] = state[4] + e[l];
+                out[5][l] = state[5] + f[l];
+                out[6][l] = state[6] + g[l];
+                out[7][l] = state[7] + h[l];
+            }
+        }
+
+      private:
+        State state_;
+        std::array<uint8_t, BLOCK_SIZE> buffer_;
+        size_t buffered_;
+        uint64_t length_;
+
+        static inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+        static constexpr uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    };
+
+} // namespace chain
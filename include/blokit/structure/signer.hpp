@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 
+#include "metrics.hpp"
+
 namespace chain {
 
     // Helper functions for string/vector conversion
@@ -134,6 +136,7 @@ namespace chain {
 
     // Verify signature using the same crypto instance
     inline bool verify(EVP_PKEY *pubkey, const std::string &data, const std::vector<unsigned char> &signature) {
+        countMetric(Counter::SignatureVerifications);
         try {
             if (pubkey->public_key.empty()) {
                 return false;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace chain {
+
+    // SipHash-2-4: a fast keyed 64-bit hash. Short transaction ids use it with per-block keys so that nobody can
+    // grind transactions whose ids collide across every block.
+    class SipHash {
+      public:
+        inline static uint64_t hash(uint64_t k0, uint64_t k1, const uint8_t *data, size_t len) {
+            uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+            uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+            uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+            uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+            size_t whole = len - len % 8;
+            for (size_t i = 0; i < whole; i += 8) {
+                uint64_t m = load(data + i, 8);
+                v3 ^= m;
+                round(v0, v1, v2, v3);
+                round(v0, v1, v2, v3);
+                v0 ^= m;
+            }
+            uint64_t last = load(data + whole, len % 8) | (static_cast<uint64_t>(len & 0xff) << 56);
+            v3 ^= last;
+            round(v0, v1, v2, v3);
+            round(v0, v1, v2, v3);
+            v0 ^= last;
+
+            v2 ^= 0xff;
+            for (int i = 0; i < 4; i++) {
+                round(v0, v1, v2, v3);
+            }
+            return v0 ^ v1 ^ v2 ^ v3;
+        }
+
+        inline static uint64_t hash(uint64_t k0, uint64_t k1, const std::string &data) {
+            return hash(k0, k1, reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        }
+
+      private:
+        inline static uint64_t rotl(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+        // Little-endian load of up to 8 bytes
+        inline static uint64_t load(const uint8_t *p, size_t n) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < n; i++) {
+                value |= static_cast<uint64_t>(p[i]) << (8 * i);
+            }
+            return value;
+        }
+
+        inline static void round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+            v0 += v1;
+            v1 = rotl(v1, 13);
+            v1 ^= v0;
+            v0 = rotl(v0, 32);
+            v2 += v3;
+            v3 = rotl(v3, 16);
+            v3 ^= v2;
+            v0 += v3;
+            v3 = rotl(v3, 21);
+            v3 ^= v0;
+            v2 += v1;
+            v1 = rotl(v1, 17);
+            v1 ^= v2;
+            v2 = rotl(v2, 32);
+        }
+    };
+
+} // namespace chain
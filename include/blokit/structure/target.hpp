@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace chain {
+
+    // 256-bit proof-of-work target. A block hash, read as a big-endian number, must not exceed it.
+    // Words are most significant first, matching the SHA-256 state words of the hash.
+    class Target {
+      public:
+        using Words = std::array<uint32_t, 8>;
+
+        // Easiest target that can be expressed in compact form ("ffff" followed by zeros)
+        static constexpr uint32_t MAX_COMPACT = 0x2100ffff;
+
+        Target() : words_{} {}
+        explicit Target(const Words &words) : words_(words) {}
+
+        static inline Target max() { return fromCompact(MAX_COMPACT); }
+
+        // Decode the compact "bits" representation: one exponent byte (length in bytes) and a 23-bit mantissa
+        static inline Target fromCompact(uint32_t bits) {
+            Target result;
+            uint32_t exponent = bits >> 24;
+            uint32_t mantissa = bits & 0x007fffff;
+            if (mantissa == 0 || exponent == 0) {
+                return result;
+            }
+            for (int i = 0; i < 3; i++) {
+                int byte_pos = static_cast<int>(exponent) - 1 - i; // Byte position counted from the low end
+                if (byte_pos < 0 || byte_pos >= 32) {
+                    continue;
+                }
+                uint8_t byte = static_cast<uint8_t>(mantissa >> (16 - 8 * i));
+                result.setByte(static_cast<size_t>(byte_pos), byte);
+            }
+            return result;
+        }
+
+        // Encode to compact form, rounding down to the 23-bit mantissa precision
+        inline uint32_t toCompact() const {
+            int top = -1;
+            for (int pos = 31; pos >= 0; pos--) {
+                if (byte(static_cast<size_t>(pos)) != 0) {
+                    top = pos;
+                    break;
+                }
+            }
+            if (top < 0) {
+                return 0;
+            }
+            uint32_t exponent = static_cast<uint32_t>(top) + 1;
+            uint32_t mantissa = 0;
+            for (int i = 0; i < 3; i++) {
+                int pos = top - i;
+                mantissa = (mantissa << 8) | (pos >= 0 ? byte(static_cast<size_t>(pos)) : 0);
+            }
+            // The top mantissa bit is reserved as a sign bit in the compact format
+            if (mantissa & 0x00800000) {
+                mantissa >>= 8;
+                exponent++;
+            }
+            return (exponent << 24) | mantissa;
+        }
+
+        // Target met by any hash with at least `digits` leading zero hex digits
+        static inline Target fromLeadingZeroDigits(uint32_t digits) {
+            Target result;
+            uint32_t zero_bits = std::min<uint32_t>(digits * 4, 256);
+            for (size_t i = 0; i < 8; i++) {
+                uint32_t word_start = static_cast<uint32_t>(i) * 32;
+                if (zero_bits >= word_start + 32) {
+                    result.words_[i] = 0;
+                } else if (zero_bits <= word_start) {
+                    result.words_[i] = 0xFFFFFFFF;
+                } else {
+                    result.words_[i] = 0xFFFFFFFF >> (zero_bits - word_start);
+                }
+            }
+            return result;
+        }
+
+        // True if the hash given as SHA-256 state words is at or below the target
+        inline bool isMetBy(const uint32_t (&hash_words)[8]) const {
+            for (size_t i = 0; i < 8; i++) {
+                if (hash_words[i] != words_[i]) {
+                    return hash_words[i] < words_[i];
+                }
+            }
+            return true;
+        }
+
+        // True if the hex encoded hash is at or below the target
+        inline bool isMetBy(const std::string &hex_hash) const {
+            if (hex_hash.size() != 64) {
+                return false;
+            }
+            uint32_t hash_words[8];
+            for (size_t i = 0; i < 8; i++) {
+                try {
+                    hash_words[i] = static_cast<uint32_t>(std::stoul(hex_hash.substr(i * 8, 8), nullptr, 16));
+                } catch (...) {
+                    return false;
+                }
+            }
+            return isMetBy(hash_words);
+        }
+
+        // Multiply the target by `factor`, saturating at the easiest compact target
+        inline Target scaled(double factor) const {
+            if (!(factor > 0.0)) {
+                return *this;
+            }
+            // Fixed point factor with 16 fractional bits keeps the arithmetic in 64-bit words
+            constexpr uint64_t ONE = 1u << 16;
+            double fixed = std::round(factor * static_cast<double>(ONE));
+            if (fixed >= static_cast<double>(UINT32_MAX)) {
+                return max();
+            }
+            uint64_t num = std::max<uint64_t>(1, static_cast<uint64_t>(fixed));
+
+            // Multiply into nine words, the extra word catching overflow
+            uint32_t product[9] = {};
+            uint64_t carry = 0;
+            for (int i = 7; i >= 0; i--) {
+                uint64_t v = static_cast<uint64_t>(words_[i]) * num + carry;
+                product[i + 1] = static_cast<uint32_t>(v);
+                carry = v >> 32;
+            }
+            product[0] = static_cast<uint32_t>(carry);
+
+            // Divide by the fixed point scale
+            Target result;
+            uint64_t remainder = product[0];
+            for (size_t i = 1; i < 9; i++) {
+                uint64_t v = (remainder << 32) | product[i];
+                result.words_[i - 1] = static_cast<uint32_t>(v / ONE);
+                remainder = v % ONE;
+            }
+            if ((product[0] >> 16) != 0 || max() < result) {
+                return max();
+            }
+            return result;
+        }
+
+        // Difficulty relative to the easiest target (1.0 == no work beyond the maximum target)
+        inline double difficulty() const {
+            double value = toDouble();
+            return value > 0.0 ? max().toDouble() / value : 0.0;
+        }
+
+        // Expected number of hashes needed to meet this target
+        inline double work() const { return std::ldexp(1.0, 256) / (toDouble() + 1.0); }
+
+        inline double toDouble() const {
+            double value = 0.0;
+            for (uint32_t word : words_) {
+                value = value * 4294967296.0 + static_cast<double>(word);
+            }
+            return value;
+        }
+
+        inline const Words &words() const { return words_; }
+
+        inline bool operator==(const Target &other) const { return words_ == other.words_; }
+        inline bool operator<(const Target &other) const { return words_ < other.words_; }
+
+      private:
+        Words words_;
+
+        // Byte `pos` counted from the least significant end
+        inline uint8_t byte(size_t pos) const {
+            return static_cast<uint8_t>(words_[7 - pos / 4] >> (8 * (pos % 4)));
+        }
+
+        inline void setByte(size_t pos, uint8_t value) {
+            uint32_t shift = 8 * (pos % 4);
+            uint32_t &word = words_[7 - pos / 4];
+            word = (word & ~(0xFFu << shift)) | (static_cast<uint32_t>(value) << shift);
+        }
+    };
+
+} // namespace chain
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace chain {
+
+    // Spans are recorded only when BLOCKIT_ENABLE_TRACING is defined (CMake option BLOCKIT_ENABLE_TRACING);
+    // otherwise TraceSpan is empty and dumps contain no events.
+#ifdef BLOCKIT_ENABLE_TRACING
+    inline constexpr bool TRACING_ENABLED = true;
+#else
+    inline constexpr bool TRACING_ENABLED = false;
+#endif
+
+    struct TraceEvent {
+        const char *name = nullptr;
+        uint64_t start = 0;    // Nanoseconds since the tracer started
+        uint64_t duration = 0; // Nanoseconds
+        uint32_t thread = 0;   // Small sequential id, in order of each thread's first span
+    };
+
+    // Collects spans into one fixed-size ring buffer per thread, so recording never allocates, locks or
+    // contends, and under sustained load only the most recent spans of each thread are kept. Write them out with
+    // writeChromeTrace() and open the file in Perfetto (ui.perfetto.dev) or chrome://tracing.
+    class Tracer {
+      public:
+        static constexpr size_t RING_SIZE = 1 << 14;      // Slots per thread; the newest RING_SIZE - 1 are read
+        static constexpr size_t MAX_RETIRED_THREADS = 64; // Buffers kept after their thread exits
+
+        static inline Tracer &instance() {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        inline uint64_t now() const {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_)
+                    .count());
+        }
+
+        // `name` must outlive the tracer, e.g. a string literal
+        inline void record(const char *name, uint64_t start, uint64_t duration) {
+            buffer().push(name, start, duration);
+        }
+
+        // Every span still held, oldest first within each thread. Spans being written while this runs may be
+        // left out, but are never returned torn.
+        inline std::vector<TraceEvent> events() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<TraceEvent> out;
+            for (const auto &buffer : buffers_) {
+                buffer->collect(out);
+            }
+            for (const auto &buffer : retired_) {
+                buffer->collect(out);
+            }
+            return out;
+        }
+
+        // Chrome trace event format: one complete ("X") event per span, timestamps in microseconds
+        inline void writeChromeTrace(std::ostream &out) const {
+            auto spans = events();
+            out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+            char line[256];
+            for (size_t i = 0; i < spans.size(); i++) {
+                const TraceEvent &e = spans[i];
+                std::snprintf(line, sizeof(line),
+                              "%s\n{\"name\": \"%s\", \"cat\": \"blockit\", \"ph\": \"X\", \"ts\": %.3f, "
+                              "\"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+                              i ? "," : "", e.name, static_cast<double>(e.start) / 1e3,
+                              static_cast<double>(e.duration) / 1e3, e.thread);
+                out << line;
+            }
+            out << "\n]}\n";
+        }
+
+        inline bool writeChromeTrace(const std::string &path) const {
+            std::ofstream file(path, std::ios::trunc);
+            writeChromeTrace(file);
+            return static_cast<bool>(file);
+        }
+
+        // Drops every recorded span. Only call while no thread is recording.
+        inline void clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto &buffer : buffers_) {
+                buffer->head.store(0, std::memory_order_release);
+            }
+            retired_.clear();
+        }
+
+      private:
+        struct Slot {
+            std::atomic<const char *> name{nullptr};
+            std::atomic<uint64_t> start{0};
+            std::atomic<uint64_t> duration{0};
+        };
+
+        // Written by its thread only. `head` counts every span ever pushed; a reader copies the slots and then
+        // discards any the writer may have lapped in the meantime.
+        struct Buffer {
+            uint32_t thread = 0;
+            std::atomic<uint64_t> head{0};
+            std::array<Slot, RING_SIZE> slots;
+
+            inline void push(const char *name, uint64_t start, uint64_t duration) {
+                uint64_t h = head.load(std::memory_order_relaxed);
+                Slot &slot = slots[h % RING_SIZE];
+                // Pairs with the fence in collect(): a reader that sees these stores also sees head >= h
+                std::atomic_thread_fence(std::memory_order_release);
+                slot.name.store(name, std::memory_order_relaxed);
+                slot.start.store(start, std::memory_order_relaxed);
+                slot.duration.store(duration, std::memory_order_relaxed);
+                head.store(h + 1, std::memory_order_release);
+            }
+
+            inline void collect(std::vector<TraceEvent> &out) const {
+                uint64_t end = head.load(std::memory_order_acquire);
+                uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+                std::vector<TraceEvent> copied;
+                copied.reserve(static_cast<size_t>(end - begin));
+                for (uint64_t i = begin; i < end; i++) {
+                    const Slot &slot = slots[i % RING_SIZE];
+                    copied.push_back(TraceEvent{slot.name.load(std::memory_order_relaxed),
+                                                slot.start.load(std::memory_order_relaxed),
+                                                slot.duration.load(std::memory_order_relaxed), thread});
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // Slots below this may have been overwritten while copying, including the one a push in progress
+                // is writing
+                uint64_t now = head.load(std::memory_order_relaxed);
+                uint64_t safe = now > RING_SIZE ? now - RING_SIZE + 1 : 0;
+                size_t skip = static_cast<size_t>(std::min(end, std::max(begin, safe)) - begin);
+                out.insert(out.end(), copied.begin() + static_cast<std::ptrdiff_t>(skip), copied.end());
+            }
+        };
+
+        // Registers the calling thread's buffer on its first span and retires it when the thread exits
+        class BufferHandle {
+          public:
+            inline explicit BufferHandle(Tracer &tracer) : tracer_(tracer), buffer_(std::make_shared<Buffer>()) {
+                std::lock_guard<std::mutex> lock(tracer_.mutex_);
+                buffer_->thread = tracer_.next_thread_++;
+                tracer_.buffers_.push_back(buffer_);
+            }
+
+            inline ~BufferHandle() {
+                std::lock_guard<std::mutex> lock(tracer_.mutex_);
+                auto &buffers = tracer_.buffers_;
+                buffers.erase(std::find(buffers.begin(), buffers.end(), buffer_));
+                tracer_.retired_.push_back(buffer_);
+                if (tracer_.retired_.size() > MAX_RETIRED_THREADS) {
+                    tracer_.retired_.pop_front();
+                }
+            }
+
+            inline BufferHandle(const BufferHandle &) = delete;
+            inline BufferHandle &operator=(const BufferHandle &) = delete;
+
+            inline Buffer &get() { return *buffer_; }
+
+          private:
+            Tracer &tracer_;
+            std::shared_ptr<Buffer> buffer_;
+        };
+
+        std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+        mutable std::mutex mutex_;
+        std::vector<std::shared_ptr<Buffer>> buffers_; // Live threads
+        std::deque<std::shared_ptr<Buffer>> retired_;  // Exited threads, oldest first
+        uint32_t next_thread_ = 1;
+
+        inline Tracer() = default;
+
+        inline Buffer &buffer() {
+            thread_local BufferHandle handle(*this);
+            return handle.get();
+        }
+    };
+
+    // Records the time from construction to destruction as a span named `name`, which must be a string literal
+    class TraceSpan {
+      public:
+        inline explicit TraceSpan(const char *name) : name_(name) {
+            if constexpr (TRACING_ENABLED) {
+                start_ = Tracer::instance().now();
+            }
+        }
+
+        inline ~TraceSpan() {
+            if constexpr (TRACING_ENABLED) {
+                Tracer &tracer = Tracer::instance();
+                tracer.record(name_, start_, tracer.now() - start_);
+            }
+        }
+
+        inline TraceSpan(const TraceSpan &) = delete;
+        inline TraceSpan &operator=(const TraceSpan &) = delete;
+
+      private:
+        const char *name_;
+        uint64_t start_ = 0;
+    };
+
+} // namespace chain
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <charconv>
 #include <chrono>
 #include <ctime>
 #include <iostream>
@@ -42,16 +43,24 @@ namespace chain {
         // Binary serialization methods
         inline std::vector<uint8_t> serializeBinary() const {
             std::vector<uint8_t> buffer;
+            serializeBinary(buffer);
+            return buffer;
+        }
+
+        inline void serializeBinary(std::vector<uint8_t> &buffer) const {
             BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(sec));
             BinarySerializer::writeUint32(buffer, nanosec);
-            return buffer;
         }
 
         inline static Timestamp deserializeBinary(const std::vector<uint8_t> &data) {
+            return deserializeBinary(std::span<const uint8_t>(data));
+        }
+
+        inline static Timestamp deserializeBinary(std::span<const uint8_t> data) {
             Timestamp result;
-            size_t offset = 0;
-            result.sec = static_cast<int32_t>(BinarySerializer::readUint32(data, offset));
-            result.nanosec = BinarySerializer::readUint32(data, offset);
+            BinaryReader reader(data);
+            result.sec = static_cast<int32_t>(reader.readUint32());
+            result.nanosec = reader.readUint32();
             return result;
         }
     };
@@ -100,10 +109,26 @@ namespace chain {
             return true;
         }
 
+        // The signed form: timestamp, priority, uuid and payload run together
         inline std::string toString() const {
-            std::stringstream ss;
-            ss << timestamp_.sec << timestamp_.nanosec << priority_ << uuid_ << function_.to_string();
-            return ss.str();
+            std::string out;
+            appendString(out);
+            return out;
+        }
+
+        // Appends what toString() returns, e.g. to a std::pmr::string allocated from a BlockArena
+        template <typename String> inline void appendString(String &out) const {
+            std::string function = function_.to_string();
+            char digits[16];
+            out.reserve(out.size() + 3 * sizeof(digits) + uuid_.size() + function.size());
+            auto appendNumber = [&](auto value) {
+                out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+            };
+            appendNumber(timestamp_.sec);
+            appendNumber(timestamp_.nanosec);
+            appendNumber(priority_);
+            out.append(uuid_.data(), uuid_.size());
+            out.append(function.data(), function.size());
         }
 
         // Serialization methods - maintain backward compatibility with string JSON
@@ -114,7 +139,12 @@ namespace chain {
         // Binary serialization (explicit method)
         inline std::vector<uint8_t> serializeBinary() const {
             std::vector<uint8_t> buffer;
+            serializeBinary(buffer);
+            return buffer;
+        }
 
+        // Appends the binary form to `buffer`, so a block can serialize its transactions without temporaries
+        inline void serializeBinary(std::vector<uint8_t> &buffer) const {
             // Write timestamp
             BinarySerializer::writeUint32(buffer, static_cast<uint32_t>(timestamp_.sec));
             BinarySerializer::writeUint32(buffer, timestamp_.nanosec);
@@ -126,13 +156,10 @@ namespace chain {
             BinarySerializer::writeString(buffer, uuid_);
 
             // Write function data - use TypeSerializer to handle different T capabilities
-            auto functionData = TypeSerializer<T>::serializeBinary(function_);
-            BinarySerializer::writeBytes(buffer, functionData);
+            BinarySerializer::writeNested(buffer, [&](auto &out) { TypeSerializer<T>::appendBinary(out, function_); });
 
             // Write signature
             BinarySerializer::writeBytes(buffer, signature_);
-
-            return buffer;
         }
 
         // JSON serialization
@@ -196,25 +223,29 @@ namespace chain {
 
         // Binary deserialization
         static Transaction<T> deserializeBinary(const std::vector<uint8_t> &data) {
+            return deserializeBinary(std::span<const uint8_t>(data));
+        }
+
+        // Reads in place, e.g. straight out of a network receive buffer
+        static Transaction<T> deserializeBinary(std::span<const uint8_t> data) {
             Transaction<T> result;
-            size_t offset = 0;
+            BinaryReader reader(data);
 
             // Read timestamp
-            result.timestamp_.sec = static_cast<int32_t>(BinarySerializer::readUint32(data, offset));
-            result.timestamp_.nanosec = BinarySerializer::readUint32(data, offset);
+            result.timestamp_.sec = static_cast<int32_t>(reader.readUint32());
+            result.timestamp_.nanosec = reader.readUint32();
 
             // Read priority
-            result.priority_ = BinarySerializer::readInt16(data, offset);
+            result.priority_ = reader.readInt16();
 
             // Read UUID
-            result.uuid_ = BinarySerializer::readString(data, offset);
+            result.uuid_ = reader.readString();
 
             // Read function data using TypeSerializer
-            auto functionData = BinarySerializer::readBytes(data, offset);
-            result.function_ = TypeSerializer<T>::deserializeBinary(functionData);
+            result.function_ = TypeSerializer<T>::deserializeBinary(reader.readSpan());
 
             // Read signature
-            result.signature_ = BinarySerializer::readBytesToUChar(data, offset);
+            result.signature_ = reader.readBytesToUChar();
 
             return result;
         }
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bloom.hpp"
+#include "chain.hpp"
+#include "coin_store.hpp"
+#include "trace.hpp"
+
+namespace chain {
+
+    // The coins a transaction spends and creates. A transaction with no inputs issues new coins.
+    struct CoinTransfer {
+        std::string spender; // Must own every input; empty skips the ownership check
+        std::vector<OutPoint> inputs;
+        std::vector<Coin> outputs; // Output i becomes OutPoint{tx.uuid_, i}; height is filled in on connect
+    };
+
+    // Unspent outputs, the alternative to account balances: each transaction consumes whole coins and creates new
+    // ones, and a block that spends a coin that does not exist or is already spent, in the chain or earlier in the
+    // same block, is rejected through ChainObserver::validateBlock. The coins live in a DiskCoinStore behind a
+    // write-back cache that is written out at block boundaries once it outgrows its budget, and a bloom filter
+    // over every coin the store holds lets most lookups of missing coins skip the disk. Register it with
+    // Chain::addObserver and call catchUp() for the blocks the chain already had; reopening the same store path
+    // resumes from the block it was last flushed at.
+    template <typename T> class UtxoSet : public ChainObserver<T> {
+      public:
+        struct Config {
+            std::string path = "utxo.dat";
+            uint64_t initial_capacity = 1 << 16; // Store slots when the file is created
+            size_t cache_size = 1 << 20;         // Cached coins before a flush at the next block boundary
+            size_t expected_coins = 1 << 24;     // Bloom filter sizing
+            double false_positive_rate = 0.01;
+            bool allow_issuance = true; // Accept transactions with no inputs
+        };
+
+        struct Stats {
+            uint64_t cache_hits = 0;
+            uint64_t disk_reads = 0;
+            uint64_t bloom_skips = 0; // Lookups answered "missing" without touching the disk
+            uint64_t flushes = 0;
+            uint64_t coins_written = 0;
+            uint64_t blocks_rejected = 0;
+        };
+
+        using TransferOf = std::function<std::optional<CoinTransfer>(const Transaction<T> &)>;
+
+        inline UtxoSet(Config config, TransferOf transfer_of)
+            : config_(std::move(config)), transfer_of_(std::move(transfer_of)),
+              store_(config_.path, config_.initial_capacity),
+              bloom_(BloomFilter::forCapacity(config_.expected_coins, config_.false_positive_rate)) {
+            store_.forEach([this](const CoinKey &key, const Coin &) { addToBloom(key); });
+            count_ = store_.size();
+            height_ = store_.getTipHeight();
+            tip_ = store_.getTipHash();
+        }
+
+        inline ~UtxoSet() override {
+            try {
+                flush();
+            } catch (const std::exception &e) {
+                std::cout << "Failed to flush UTXO set: " << e.what() << std::endl;
+            }
+        }
+
+        inline UtxoSet(const UtxoSet &) = delete;
+        inline UtxoSet &operator=(const UtxoSet &) = delete;
+
+        inline std::optional<Coin> getCoin(const OutPoint &outpoint) {
+            const Entry *entry = fetch(outpoint.key());
+            if (!entry || !entry->coin) {
+                return std::nullopt;
+            }
+            return entry->coin;
+        }
+
+        // Every input exists unspent and belongs to the spender, nothing is spent twice and no transaction
+        // creates more than it spends
+        inline bool validateBlock(const Block<T> &block) override {
+            TraceSpan span("UtxoSet::validateBlock");
+            std::unordered_map<CoinKey, Coin, CoinKeyHash> created; // Spendable later in the same block
+            std::unordered_set<CoinKey, CoinKeyHash> spent;
+            for (const auto &tx : block.transactions_) {
+                auto transfer = transfer_of_(tx);
+                if (!transfer) {
+                    continue;
+                }
+                if (transfer->inputs.empty() && !config_.allow_issuance) {
+                    return rejectBlock("Transaction " + tx.uuid_ + " issues coins");
+                }
+                int64_t in = 0;
+                for (const auto &input : transfer->inputs) {
+                    CoinKey key = input.key();
+                    if (!spent.insert(key).second) {
+                        return rejectBlock("Output " + describe(input) + " spent twice in the block");
+                    }
+                    std::optional<Coin> coin;
+                    if (auto it = created.find(key); it != created.end()) {
+                        coin = it->second;
+                    } else if (const Entry *entry = fetch(key)) {
+                        coin = entry->coin;
+                    }
+                    if (!coin) {
+                        return rejectBlock("Output " + describe(input) + " is missing or already spent");
+                    }
+                    if (!transfer->spender.empty() && coin->owner != transfer->spender) {
+                        return rejectBlock("Output " + describe(input) + " does not belong to " + transfer->spender);
+                    }
+                    if (!addAmount(in, coin->amount)) {
+                        return rejectBlock("Inputs of " + tx.uuid_ + " overflow");
+                    }
+                }
+                int64_t out = 0;
+                for (const auto &output : transfer->outputs) {
+                    if (output.amount < 0 || !addAmount(out, output.amount)) {
+                        return rejectBlock("Outputs of " + tx.uuid_ + " are negative or overflow");
+                    }
+                    if (output.owner.size() > DiskCoinStore::MAX_OWNER) {
+                        return rejectBlock("Output owner of " + tx.uuid_ + " is too long");
+                    }
+                }
+                if (!transfer->inputs.empty() && out > in) {
+                    return rejectBlock("Transaction " + tx.uuid_ + " spends more than its inputs");
+                }
+                for (uint32_t i = 0; i < transfer->outputs.size(); i++) {
+                    created[OutPoint{tx.uuid_, i}.key()] = transfer->outputs[i];
+                }
+            }
+            return true;
+        }
+
+        inline void onBlockConnected(const Block<T> &block) override {
+            BlockUndo undo;
+            undo.hash = block.previous_hash_;
+            for (const auto &tx : block.transactions_) {
+                auto transfer = transfer_of_(tx);
+                if (!transfer) {
+                    continue;
+                }
+                for (const auto &input : transfer->inputs) {
+                    CoinKey key = input.key();
+                    undo.changes.emplace_back(key, spendCoin(key));
+                }
+                for (uint32_t i = 0; i < transfer->outputs.size(); i++) {
+                    Coin coin = transfer->outputs[i];
+                    coin.height = block.index_;
+                    CoinKey key = OutPoint{tx.uuid_, i}.key();
+                    addCoin(key, std::move(coin));
+                    undo.changes.emplace_back(key, std::nullopt);
+                }
+            }
+            undo_.push_back(std::move(undo));
+            height_ = block.index_;
+            tip_ = block.hash_;
+            flushIfFull();
+        }
+
+        inline void onBlockDisconnected(const Block<T> &block) override {
+            if (undo_.empty()) {
+                throw std::runtime_error("No undo data to disconnect block " + block.hash_ + " from the UTXO set");
+            }
+            BlockUndo undo = std::move(undo_.back());
+            undo_.pop_back();
+            // Newest first, since a coin can be created and spent within the block
+            for (auto it = undo.changes.rbegin(); it != undo.changes.rend(); ++it) {
+                if (it->second) {
+                    addCoin(it->first, std::move(*it->second));
+                } else {
+                    spendCoin(it->first);
+                }
+            }
+            height_ = block.index_ - 1;
+            tip_ = undo.hash;
+            flushIfFull();
+        }
+
+        // Finalized blocks never disconnect, so their undo data can go
+        inline void onBlockFinalized(const Block<T> &block) override {
+            int64_t oldest = height_ - static_cast<int64_t>(undo_.size()) + 1;
+            while (!undo_.empty() && oldest <= block.index_) {
+                undo_.pop_front();
+                oldest++;
+            }
+        }
+
+        // Apply the chain's canonical blocks above getHeight()
+        inline void catchUp(const Chain<T> &chain) {
+            if (height_ >= static_cast<int64_t>(chain.blocks_.size()) ||
+                (height_ >= 0 && chain.blocks_[static_cast<size_t>(height_)].hash_ != tip_)) {
+                throw std::runtime_error("UTXO store at " + config_.path + " is not on this chain");
+            }
+            for (size_t i = static_cast<size_t>(height_ + 1); i < chain.blocks_.size(); i++) {
+                onBlockConnected(chain.blocks_[i]);
+            }
+        }
+
+        // Writes dirty coins and the tip to the store. Undo data stays in memory, so after a restart the set
+        // cannot disconnect blocks applied before it.
+        inline void flush() {
+            TraceSpan span("UtxoSet::flush");
+            for (auto &[key, entry] : cache_) {
+                if (!entry.dirty) {
+                    continue;
+                }
+                if (entry.coin) {
+                    store_.put(key, *entry.coin);
+                    addToBloom(key);
+                } else {
+                    store_.erase(key);
+                }
+                stats_.coins_written++;
+                entry.dirty = false;
+                entry.fresh = false;
+            }
+            store_.setTip(height_, tip_);
+            store_.sync();
+            cache_.clear();
+            stats_.flushes++;
+        }
+
+        // Height of the last applied block, -1 before the first
+        inline int64_t getHeight() const { return height_; }
+        inline uint64_t size() const { return count_; }
+        inline size_t getCacheSize() const { return cache_.size(); }
+        inline size_t getUndoDepth() const { return undo_.size(); }
+        inline const Stats &getStats() const { return stats_; }
+        inline const DiskCoinStore &getStore() const { return store_; }
+
+      private:
+        // A cached coin, or a spend the store has not seen yet when `coin` is empty
+        struct Entry {
+            std::optional<Coin> coin;
+            bool dirty = false;
+            bool fresh = false; // Not in the store, so spending it before a flush needs no write at all
+        };
+
+        struct BlockUndo {
+            std::string hash; // Tip before the block
+            std::vector<std::pair<CoinKey, std::optional<Coin>>> changes; // The coin spent, or empty for one created
+        };
+
+        Config config_;
+        TransferOf transfer_of_;
+        DiskCoinStore store_;
+        BloomFilter bloom_; // Every key ever added to the store; coins are never removed from it
+        std::unordered_map<CoinKey, Entry, CoinKeyHash> cache_;
+        std::deque<BlockUndo> undo_; // Oldest first
+        uint64_t count_ = 0;
+        int64_t height_ = -1;
+        std::string tip_;
+        Stats stats_;
+
+        inline static std::string describe(const OutPoint &outpoint) {
+            return outpoint.tx_id + ":" + std::to_string(outpoint.index);
+        }
+
+        inline static bool addAmount(int64_t &total, int64_t amount) {
+            if (amount < 0 || total > std::numeric_limits<int64_t>::max() - amount) {
+                return false;
+            }
+            total += amount;
+            return true;
+        }
+
+        inline static uint64_t keyWord(const CoinKey &key, size_t offset) {
+            uint64_t word;
+            std::memcpy(&word, key.data() + offset, sizeof(word));
+            return word;
+        }
+
+        inline void addToBloom(const CoinKey &key) { bloom_.add(keyWord(key, 0), keyWord(key, 8) | 1); }
+        inline bool inBloom(const CoinKey &key) const {
+            return bloom_.mightContain(keyWord(key, 0), keyWord(key, 8) | 1);
+        }
+
+        inline bool rejectBlock(const std::string &reason) {
+            std::cout << "UTXO check failed: " << reason << std::endl;
+            stats_.blocks_rejected++;
+            return false;
+        }
+
+        // The cache entry for a key, loading it from the store on a miss; null if the store does not have it
+        inline const Entry *fetch(const CoinKey &key) {
+            if (auto it = cache_.find(key); it != cache_.end()) {
+                stats_.cache_hits++;
+                return &it->second;
+            }
+            if (!inBloom(key)) {
+                stats_.bloom_skips++;
+                return nullptr;
+            }
+            stats_.disk_reads++;
+            auto coin = store_.get(key);
+            if (!coin) {
+                return nullptr;
+            }
+            return &cache_.emplace(key, Entry{std::move(coin), false, false}).first->second;
+        }
+
+        inline void addCoin(const CoinKey &key, Coin coin) {
+            auto [it, inserted] = cache_.try_emplace(key);
+            Entry &entry = it->second;
+            // A pending spend means the store still has the coin; otherwise only the bloom filter can say it might
+            if (inserted) {
+                entry.fresh = !inBloom(key);
+            }
+            entry.coin = std::move(coin);
+            entry.dirty = true;
+            count_++;
+        }
+
+        inline Coin spendCoin(const CoinKey &key) {
+            fetch(key);
+            auto it = cache_.find(key);
+            if (it == cache_.end() || !it->second.coin) {
+                throw std::runtime_error("UTXO set is missing a coin the chain spends");
+            }
+            Coin coin = std::move(*it->second.coin);
+            if (it->second.fresh) {
+                cache_.erase(it);
+            } else {
+                it->second.coin.reset();
+                it->second.dirty = true;
+            }
+            count_--;
+            return coin;
+        }
+
+        inline void flushIfFull() {
+            if (cache_.size() > config_.cache_size) {
+                flush();
+            }
+        }
+    };
+
+} // namespace chain
@@ -0,0 +1,166 @@
+#include <doctest/doctest.h>
+#include "blokit/blokit.hpp"
+#include <memory>
+
+struct FleetCommand {
+    std::string content;
+    std::string to_string() const { return "FleetCommand{" + content + "}"; }
+
+    // JSON serialization support, for the save and load round trip
+    std::string serialize() const { return R"({"content": ")" + content + R"("})"; }
+
+    static FleetCommand deserialize(const std::string &data) {
+        size_t start = data.find("\"content\": \"") + 12;
+        return FleetCommand{data.substr(start, data.find("\"", start) - start)};
+    }
+};
+
+namespace {
+    struct Sealer {
+        std::string id;
+        std::shared_ptr<chain::Crypto> key;
+    };
+
+    std::vector<Sealer> makeSealers(chain::Chain<FleetCommand> &blockchain, const std::vector<std::string> &ids) {
+        std::vector<Sealer> sealers;
+        for (const auto &id : ids) {
+            auto key = std::make_shared<chain::Crypto>(id + "_key");
+            blockchain.registerSealer(id, key->getPublicHalf());
+            sealers.push_back({id, key});
+        }
+        return sealers;
+    }
+
+    chain::Block<FleetCommand> makeBlock(const std::string &tx_id, std::shared_ptr<chain::Crypto> key) {
+        chain::Transaction<FleetCommand> tx(tx_id, FleetCommand{"move"}, 100);
+        tx.signTransaction(key);
+        return chain::Block<FleetCommand>({tx});
+    }
+} // namespace
+
+TEST_SUITE("Proof of Authority") {
+    TEST_CASE("Sealers take turns in a fixed order") {
+        auto key = std::make_shared<chain::Crypto>("fleet_key");
+        chain::Chain<FleetCommand> blockchain("fleet-chain", "genesis", FleetCommand{"genesis"}, key);
+        blockchain.enableProofOfAuthority(2.0);
+        makeSealers(blockchain, {"robot-c", "robot-a", "robot-b"});
+
+        // Participants without a key or the capability are not sealers
+        blockchain.registerParticipant("tractor-001", "active");
+        blockchain.grantCapability("tractor-001", chain::ProofOfAuthority::SEALER_CAPABILITY);
+
+        auto authority = blockchain.getAuthority();
+        const auto &sealers = authority->getSealers(blockchain.entity_manager_);
+        REQUIRE(sealers.size() == 3);
+        CHECK(sealers[0] == "robot-a");
+        CHECK(sealers[2] == "robot-c");
+
+        CHECK(authority->getInTurnSealer(blockchain.entity_manager_, 3) == "robot-a");
+        CHECK(authority->getInTurnSealer(blockchain.entity_manager_, 4) == "robot-b");
+        CHECK(blockchain.getInTurnSealer() == "robot-b"); // Next block is index 1
+
+        CHECK(authority->getSealDelay(blockchain.entity_manager_, 1, "robot-b") == doctest::Approx(0.0));
+        CHECK(authority->getSealDelay(blockchain.entity_manager_, 1, "robot-c") == doctest::Approx(2.0));
+        CHECK(authority->getSealDelay(blockchain.entity_manager_, 1, "robot-a") == doctest::Approx(4.0));
+        CHECK(authority->getSealDelay(blockchain.entity_manager_, 1, "tractor-001") < 0.0);
+        CHECK(authority->getRecentSealLimit(blockchain.entity_manager_) == 2);
+    }
+
+    TEST_CASE("Sealed blocks are validated with one signature each") {
+        auto key = std::make_shared<chain::Crypto>("fleet_key");
+        chain::Chain<FleetCommand> blockchain("fleet-chain", "genesis", FleetCommand{"genesis"}, key);
+        blockchain.enableProofOfAuthority();
+        auto sealers = makeSealers(blockchain, {"robot-a", "robot-b", "robot-c"});
+
+        for (int i = 0; i < 6; i++) {
+            auto in_turn = blockchain.getInTurnSealer();
+            auto it = std::find_if(sealers.begin(), sealers.end(), [&](const Sealer &s) { return s.id == in_turn; });
+            REQUIRE(it != sealers.end());
+            CHECK(blockchain.sealBlock(makeBlock("tx-" + std::to_string(i), key), it->id, it->key));
+        }
+        CHECK(blockchain.getChainLength() == 7);
+        CHECK(blockchain.isValid());
+        CHECK(blockchain.getSealWeight() == 6 * chain::ProofOfAuthority::IN_TURN_WEIGHT);
+
+        SUBCASE("Unsealed and unauthorized blocks are rejected") {
+            CHECK_FALSE(blockchain.addBlock(makeBlock("tx-unsealed", key)));
+
+            auto outsider = std::make_shared<chain::Crypto>("outsider_key");
+            CHECK_FALSE(blockchain.sealBlock(makeBlock("tx-outsider", key), "outsider", outsider));
+
+            // Right id, wrong key
+            auto in_turn = blockchain.getInTurnSealer();
+            CHECK_FALSE(blockchain.sealBlock(makeBlock("tx-forged", key), in_turn, outsider));
+            CHECK(blockchain.getChainLength() == 7);
+        }
+
+        SUBCASE("A sealer cannot seal consecutive blocks") {
+            const auto &last_sealer = blockchain.getLastBlock().sealer_id_;
+            auto it =
+                std::find_if(sealers.begin(), sealers.end(), [&](const Sealer &s) { return s.id == last_sealer; });
+            CHECK_FALSE(blockchain.sealBlock(makeBlock("tx-again", key), it->id, it->key));
+        }
+
+        SUBCASE("Moving a seal to another sealer breaks it") {
+            blockchain.blocks_[3].sealer_id_ = blockchain.blocks_[4].sealer_id_;
+            blockchain.blocks_[3].hash_ = blockchain.blocks_[3].calculateHash();
+            CHECK_FALSE(blockchain.hasValidSeals());
+        }
+    }
+
+    TEST_CASE("Revoking a sealer keeps its earlier blocks valid") {
+        auto key = std::make_shared<chain::Crypto>("fleet_key");
+        chain::Chain<FleetCommand> blockchain("fleet-chain", "genesis", FleetCommand{"genesis"}, key);
+        blockchain.enableProofOfAuthority(2.0);
+        auto sealers = makeSealers(blockchain, {"robot-a", "robot-b", "robot-c"});
+        auto sealInTurn = [&](const std::string &tx_id) {
+            auto in_turn = blockchain.getInTurnSealer();
+            auto it = std::find_if(sealers.begin(), sealers.end(), [&](const Sealer &s) { return s.id == in_turn; });
+            REQUIRE(it != sealers.end());
+            return blockchain.sealBlock(makeBlock(tx_id, key), it->id, it->key);
+        };
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(sealInTurn("tx-" + std::to_string(i)));
+        }
+        REQUIRE(blockchain.blocks_[3].sealer_id_ == "robot-a");
+
+        blockchain.revokeCapability("robot-a", chain::ProofOfAuthority::SEALER_CAPABILITY);
+        CHECK(blockchain.isValid());
+        CHECK_FALSE(blockchain.sealBlock(makeBlock("tx-revoked", key), "robot-a", sealers[0].key));
+        REQUIRE(sealInTurn("tx-4"));
+        CHECK(blockchain.getAuthority()->getSealerEpochCount() == 2);
+        CHECK(blockchain.isValid());
+
+        // The sealer history and activation point are saved with the chain
+        auto loaded = chain::Chain<FleetCommand>::deserialize(blockchain.serialize());
+        REQUIRE(loaded.isProofOfAuthorityEnabled());
+        CHECK(loaded.poa_activation_index_ == blockchain.poa_activation_index_);
+        CHECK(loaded.getAuthority()->getSealerEpochCount() == 2);
+        CHECK(loaded.getAuthority()->getRoundSeconds() == doctest::Approx(2.0));
+        CHECK(loaded.isValid());
+
+        // A seal by a sealer revoked before that height is still rejected
+        loaded.blocks_[5].sealer_id_ = "robot-a";
+        loaded.blocks_[5].hash_ = loaded.blocks_[5].calculateHash();
+        loaded.blocks_[5].seal_ = sealers[0].key->sign(loaded.blocks_[5].hash_);
+        CHECK_FALSE(loaded.hasValidSeals());
+    }
+
+    TEST_CASE("Fork choice prefers in-turn seals") {
+        auto key = std::make_shared<chain::Crypto>("fleet_key");
+        chain::Chain<FleetCommand> in_turn_chain("fleet-chain", "genesis", FleetCommand{"genesis"}, key);
+        in_turn_chain.enableProofOfAuthority();
+        auto sealers = makeSealers(in_turn_chain, {"robot-a", "robot-b", "robot-c"});
+        chain::Chain<FleetCommand> out_of_turn_chain = in_turn_chain;
+        out_of_turn_chain.enableProofOfAuthority();
+
+        // Block 1 is robot-b's turn; robot-c seals it out of turn on the competing fork
+        CHECK(in_turn_chain.sealBlock(makeBlock("tx-1", key), sealers[1].id, sealers[1].key));
+        CHECK(out_of_turn_chain.sealBlock(makeBlock("tx-1b", key), sealers[2].id, sealers[2].key));
+
+        CHECK(in_turn_chain.getSealWeight() > out_of_turn_chain.getSealWeight());
+        // The chain's own fork choice prefers the in-turn fork from either side
+        CHECK(out_of_turn_chain.prefersFork(in_turn_chain.blocks_));
+        CHECK_FALSE(in_turn_chain.prefersFork(out_of_turn_chain.blocks_));
+    }
+}
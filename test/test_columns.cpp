@@ -0,0 +1,85 @@
+#include "blokit/blokit.hpp"
+#include <doctest/doctest.h>
+#include <memory>
+
+struct ColumnTestData {
+    std::string reading;
+    int value = 0;
+
+    std::string to_string() const { return "ColumnTestData{" + reading + "," + std::to_string(value) + "}"; }
+};
+
+namespace {
+    // Timestamps one second apart starting at 1000, priorities cycling through 0..9, every other one signed
+    std::vector<chain::Transaction<ColumnTestData>> makeTransactions(int count) {
+        auto key = std::make_shared<chain::Crypto>("columns_key");
+        std::vector<chain::Transaction<ColumnTestData>> transactions;
+        for (int i = 0; i < count; i++) {
+            chain::Transaction<ColumnTestData> tx("tx-" + std::to_string(i), ColumnTestData{"r", i},
+                                                  static_cast<int16_t>(i % 10));
+            tx.timestamp_ = chain::Timestamp(1000 + i, static_cast<uint32_t>(i * 7));
+            if (i % 2 == 0) {
+                tx.signTransaction(key);
+            }
+            transactions.push_back(tx);
+        }
+        return transactions;
+    }
+} // namespace
+
+TEST_SUITE("Block Columns") {
+    TEST_CASE("Rows survive the round trip through columns") {
+        auto transactions = makeTransactions(150);
+        chain::BlockColumns<ColumnTestData> columns(transactions);
+        REQUIRE(columns.size() == transactions.size());
+
+        auto rows = columns.toTransactions();
+        REQUIRE(rows.size() == transactions.size());
+        for (size_t i = 0; i < rows.size(); i++) {
+            CHECK(rows[i].toString() == transactions[i].toString());
+            CHECK(rows[i].signature_ == transactions[i].signature_);
+        }
+        CHECK(columns.uuid(42) == "tx-42");
+        CHECK(columns.signature(1).empty());
+        CHECK(columns.payloads()[7].value == 7);
+
+        chain::Block<ColumnTestData> original(transactions);
+        chain::Block<ColumnTestData> rebuilt(rows);
+        CHECK(rebuilt.merkle_root_ == original.merkle_root_);
+
+        chain::BlockColumns<ColumnTestData> none(std::vector<chain::Transaction<ColumnTestData>>{});
+        CHECK(none.empty());
+        CHECK(none.toTransactions().empty());
+        CHECK(none.priorityRange(0, 10).count() == 0);
+        CHECK_FALSE(none.find("tx-0").has_value());
+    }
+
+    TEST_CASE("Scans match a row-by-row filter") {
+        // 150 rows: two full batches of 64 and a tail
+        auto transactions = makeTransactions(150);
+        chain::BlockColumns<ColumnTestData> columns(transactions);
+
+        auto priority = columns.priorityRange(3, 5);
+        auto time = columns.timeRange(chain::Timestamp(1010, 70), chain::Timestamp(1140, 0));
+        for (size_t i = 0; i < transactions.size(); i++) {
+            const auto &tx = transactions[i];
+            CHECK(priority[i] == (tx.priority_ >= 3 && tx.priority_ <= 5));
+            // Row 10 is stamped exactly at the lower bound; row 140 is 980ns past the upper one
+            CHECK(time[i] == (i >= 10 && i < 140));
+        }
+        CHECK(priority.count() == 45);
+        CHECK(time.count() == 130);
+
+        priority &= time;
+        CHECK(priority.count() == 39);
+        for (size_t i : priority.indices()) {
+            CHECK(transactions[i].priority_ >= 3);
+            CHECK(transactions[i].timestamp_.sec >= 1010);
+        }
+
+        REQUIRE(columns.find("tx-149").has_value());
+        CHECK(*columns.find("tx-149") == 149);
+        CHECK(*columns.find("tx-0") == 0);
+        CHECK_FALSE(columns.find("tx-150").has_value());
+    }
+}
@@ -0,0 +1,292 @@
+#include <doctest/doctest.h>
+#include "blokit/blokit.hpp"
+#include <memory>
+
+struct FinalityTestData {
+    std::string value;
+    std::string to_string() const { return "FinalityTestData{" + value + "}"; }
+
+    // JSON serialization support, for the save and load round trip
+    std::string serialize() const { return R"({"value": ")" + value + R"("})"; }
+
+    static FinalityTestData deserialize(const std::string &data) {
+        size_t start = data.find("\"value\": \"") + 10;
+        return FinalityTestData{data.substr(start, data.find("\"", start) - start)};
+    }
+};
+
+namespace {
+    using FinalChain = chain::Chain<FinalityTestData>;
+
+    struct Voter {
+        std::string id;
+        std::shared_ptr<chain::Crypto> key;
+    };
+
+    std::vector<Voter> makeVoters(FinalChain &blockchain, size_t count) {
+        std::vector<Voter> voters;
+        for (size_t i = 0; i < count; i++) {
+            std::string id = "voter-" + std::to_string(i);
+            auto key = std::make_shared<chain::Crypto>(id + "_key");
+            blockchain.registerVoter(id, key->getPublicHalf());
+            voters.push_back({id, key});
+        }
+        return voters;
+    }
+
+    chain::Block<FinalityTestData> makeBlock(const std::string &tx_id, std::shared_ptr<chain::Crypto> key) {
+        chain::Transaction<FinalityTestData> tx(tx_id, FinalityTestData{"cmd"}, 100);
+        tx.signTransaction(key);
+        return chain::Block<FinalityTestData>({tx});
+    }
+
+    // Every voter prepares and then commits the block at `height`
+    void finalizeAt(FinalChain &blockchain, const std::vector<Voter> &voters, int64_t height) {
+        const auto &hash = blockchain.blocks_[height].hash_;
+        const auto *finality = blockchain.getFinality();
+        for (auto phase : {chain::VotePhase::Prepare, chain::VotePhase::Commit}) {
+            for (const auto &voter : voters) {
+                blockchain.addFinalityVote(finality->makeVote(phase, height, hash, voter.id, voter.key));
+            }
+        }
+    }
+
+    struct FinalityCounter : chain::ChainObserver<FinalityTestData> {
+        std::vector<int64_t> finalized;
+        void onBlockConnected(const chain::Block<FinalityTestData> &) override {}
+        void onBlockDisconnected(const chain::Block<FinalityTestData> &) override {}
+        void onBlockFinalized(const chain::Block<FinalityTestData> &block) override {
+            finalized.push_back(block.index_);
+        }
+    };
+} // namespace
+
+TEST_SUITE("Finality") {
+    TEST_CASE("Votes aggregate into quorum certificates") {
+        auto key = std::make_shared<chain::Crypto>("final_key");
+        FinalChain blockchain("final-chain", "genesis", FinalityTestData{"genesis"}, key);
+        blockchain.enableFinality();
+        auto voters = makeVoters(blockchain, 4);
+        REQUIRE(blockchain.addBlock(makeBlock("tx-1", key)));
+
+        const auto *finality = blockchain.getFinality();
+        CHECK(finality->getVoters(blockchain.entity_manager_).size() == 4);
+        CHECK(finality->getQuorumSize(blockchain.entity_manager_) == 3);
+
+        const auto &hash = blockchain.getLastBlock().hash_;
+        auto prepare = [&](size_t i, const std::string &block_hash) {
+            return finality->makeVote(chain::VotePhase::Prepare, 1, block_hash, voters[i].id, voters[i].key);
+        };
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(0, hash)).has_value());
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(0, hash)).has_value()); // Counted once
+
+        // Voting for a second block at the same height is dropped
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(1, std::string(64, 'f'))).has_value());
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(1, hash)).has_value());
+
+        // Outsiders and forged signatures do not count
+        auto outsider = std::make_shared<chain::Crypto>("outsider_key");
+        CHECK_FALSE(blockchain.addFinalityVote(
+            finality->makeVote(chain::VotePhase::Prepare, 1, hash, "outsider", outsider)).has_value());
+        CHECK_FALSE(blockchain.addFinalityVote(
+            finality->makeVote(chain::VotePhase::Prepare, 1, hash, voters[2].id, outsider)).has_value());
+
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(2, hash)).has_value());
+        auto qc = blockchain.addFinalityVote(prepare(3, hash));
+        REQUIRE(qc.has_value());
+        CHECK(qc->phase == chain::VotePhase::Prepare);
+        CHECK(qc->votes.size() == 3);
+        CHECK(finality->verifyCertificate(*qc, blockchain.entity_manager_));
+        CHECK(blockchain.getFinalizedHeight() == 0); // Prepare certificates do not finalize
+
+        auto copy = chain::QuorumCertificate::deserialize(qc->serialize());
+        CHECK(copy.block_hash == hash);
+        CHECK(finality->verifyCertificate(copy, blockchain.entity_manager_));
+        copy.votes.pop_back();
+        CHECK_FALSE(finality->verifyCertificate(copy, blockchain.entity_manager_));
+    }
+
+    TEST_CASE("Finalized blocks cannot be reorganized away") {
+        auto key = std::make_shared<chain::Crypto>("final_key");
+        FinalChain blockchain("final-chain", "genesis", FinalityTestData{"genesis"}, key);
+        blockchain.enableFinality();
+        auto voters = makeVoters(blockchain, 4);
+        auto observer = std::make_shared<FinalityCounter>();
+        blockchain.addObserver(observer);
+
+        REQUIRE(blockchain.addBlock(makeBlock("tx-1", key)));
+        FinalChain side = blockchain;
+        REQUIRE(blockchain.addBlock(makeBlock("tx-2", key)));
+        REQUIRE(blockchain.addBlock(makeBlock("tx-3", key)));
+        for (int i = 2; i <= 5; i++) {
+            REQUIRE(side.addBlock(makeBlock("tx-side-" + std::to_string(i), key)));
+        }
+
+        finalizeAt(blockchain, voters, 2);
+        CHECK(blockchain.getFinalizedHeight() == 2);
+        CHECK(blockchain.getFinalizedHash() == blockchain.blocks_[2].hash_);
+        CHECK(blockchain.isFinalized(blockchain.blocks_[1].hash_));
+        CHECK(observer->finalized == std::vector<int64_t>{1, 2});
+
+        // The longer side branch forks below the finalized block and is refused
+        std::string tip = blockchain.getLastBlock().hash_;
+        CHECK_FALSE(blockchain.switchToFork(side.blocks_));
+        CHECK(blockchain.getLastBlock().hash_ == tip);
+        CHECK(blockchain.getBlockTree().sideCount() == 0);
+
+        // Finality survives a save and load, checked against the voters saved in the entity manager
+        std::string saved = blockchain.serialize();
+        auto restored = FinalChain::deserialize(saved);
+        CHECK(restored.getFinalizedHeight() == 2);
+        CHECK(restored.getFinalityCertificate().votes.size() == 3); // The quorum that completed it
+        REQUIRE(restored.isFinalityEnabled());
+        CHECK(restored.getFinality()->getChainId() == "final-chain");
+        CHECK(restored.hasValidFinality());
+        CHECK(restored.isValid());
+
+        // A tampered certificate no longer verifies, and neither does one that cannot be checked
+        restored.finality_certificate_.votes[0].signature[0] ^= 0xff;
+        CHECK_FALSE(restored.hasValidFinality());
+        std::string disabled = saved;
+        disabled.replace(disabled.find("\"enabled\": true"), 15, "\"enabled\": false");
+        auto unchecked = FinalChain::deserialize(disabled);
+        CHECK_FALSE(unchecked.isFinalityEnabled());
+        CHECK_FALSE(unchecked.isValid());
+    }
+
+    TEST_CASE("Certificates form once, for their own chain") {
+        auto key = std::make_shared<chain::Crypto>("final_key");
+        FinalChain blockchain("final-chain", "genesis", FinalityTestData{"genesis"}, key);
+        blockchain.enableFinality();
+        auto voters = makeVoters(blockchain, 7);
+        REQUIRE(blockchain.addBlock(makeBlock("tx-1", key)));
+        const auto *finality = blockchain.getFinality();
+        const auto &hash = blockchain.getLastBlock().hash_;
+        auto prepare = [&](size_t i) {
+            return finality->makeVote(chain::VotePhase::Prepare, 1, hash, voters[i].id, voters[i].key);
+        };
+
+        // A vote signed for another chain with the same voters does not count here
+        FinalChain other("other-chain", "genesis", FinalityTestData{"genesis"}, key);
+        other.enableFinality();
+        auto replayed = other.getFinality()->makeVote(chain::VotePhase::Prepare, 1, hash, voters[0].id, voters[0].key);
+        CHECK(replayed.payload() != prepare(0).payload());
+        CHECK_FALSE(blockchain.addFinalityVote(replayed).has_value());
+
+        // Four of seven votes fall short of the quorum of five
+        for (size_t i = 0; i < 4; i++) {
+            CHECK_FALSE(blockchain.addFinalityVote(prepare(i)).has_value());
+        }
+
+        // Revoking two voters lowers the quorum to four; the next vote completes the certificate
+        for (size_t i = 5; i < 7; i++) {
+            blockchain.revokeCapability(voters[i].id, chain::FinalityGadget::VOTER_CAPABILITY);
+        }
+        CHECK(finality->getQuorumSize(blockchain.entity_manager_) == 4);
+        auto qc = blockchain.addFinalityVote(prepare(4));
+        REQUIRE(qc.has_value());
+        CHECK(qc->votes.size() == 5);
+        CHECK(qc->chain_id == "final-chain");
+
+        // Later votes for the same block do not produce a second certificate
+        blockchain.registerVoter(voters[5].id, voters[5].key->getPublicHalf());
+        CHECK_FALSE(blockchain.addFinalityVote(prepare(5)).has_value());
+    }
+
+    TEST_CASE("Certificates ahead of their block apply once it connects") {
+        auto key = std::make_shared<chain::Crypto>("final_key");
+        FinalChain blockchain("final-chain", "genesis", FinalityTestData{"genesis"}, key);
+        blockchain.enableFinality();
+        auto voters = makeVoters(blockchain, 4);
+        FinalChain producer = blockchain;
+        REQUIRE(producer.addBlock(makeBlock("tx-1", key)));
+
+        const auto &block = producer.getLastBlock();
+        auto vote_all = [&](chain::VotePhase phase) {
+            for (const auto &voter : voters) {
+                blockchain.addFinalityVote(
+                    blockchain.getFinality()->makeVote(phase, 1, block.hash_, voter.id, voter.key));
+            }
+        };
+        vote_all(chain::VotePhase::Commit);
+        CHECK(blockchain.getFinalizedHeight() == 0);
+        REQUIRE(blockchain.importBlock(block));
+        CHECK(blockchain.getFinalizedHeight() == 0); // Committed but never prepared
+
+        // The prepare certificate completing late finalizes with the commit certificate already held
+        vote_all(chain::VotePhase::Prepare);
+        CHECK(blockchain.getFinalizedHeight() == 1);
+    }
+
+    TEST_CASE("Finality outlives the voters that certified it") {
+        auto key = std::make_shared<chain::Crypto>("final_key");
+        FinalChain blockchain("final-chain", "genesis", FinalityTestData{"genesis"}, key);
+        blockchain.enableFinality();
+        auto voters = makeVoters(blockchain, 4);
+        REQUIRE(blockchain.addBlock(makeBlock("tx-1", key)));
+        finalizeAt(blockchain, voters, 1);
+        REQUIRE(blockchain.getFinalizedHeight() == 1);
+
+        // Revoking a voter who signed the certificate neither unfinalizes the block nor breaks the chain
+        const auto &signer = blockchain.getFinalityCertificate().votes[0].voter_id;
+        blockchain.revokeCapability(signer, chain::FinalityGadget::VOTER_CAPABILITY);
+        CHECK_FALSE(blockchain.getFinality()->verifyCertificate(blockchain.getFinalityCertificate(),
+                                                                 blockchain.entity_manager_));
+        CHECK(blockchain.hasValidFinality());
+        CHECK(blockchain.isValid());
+
+        // The recorded voters are saved with the certificate
+        auto restored = FinalChain::deserialize(blockchain.serialize());
+        CHECK(restored.getFinality()->getVoters(restored.entity_manager_).size() == 3);
+        CHECK(restored.hasValidFinality());
+        CHECK(restored.isValid());
+        restored.finality_voters_.quorum = 4;
+        CHECK_FALSE(restored.hasValidFinality());
+    }
+
+    TEST_CASE("Simulated authority network finalizes within a few message delays") {
+        auto key = std::make_shared<chain::Crypto>("genesis_key");
+        FinalChain genesis("sim-chain", "genesis", FinalityTestData{"genesis"}, key);
+        genesis.enableProofOfAuthority(1.0);
+        genesis.enableFinality();
+
+        chain::SimulatorConfig config;
+        config.min_latency = 0.005;
+        config.max_latency = 0.02;
+        config.seed = 11;
+
+        std::vector<std::pair<std::string, std::shared_ptr<chain::Crypto>>> nodes;
+        for (int i = 0; i < 4; i++) {
+            std::string id = "robot-" + std::to_string(i);
+            auto node_key = std::make_shared<chain::Crypto>(id + "_key");
+            genesis.registerSealer(id, node_key->getPublicHalf());
+            genesis.registerVoter(id, node_key->getPublicHalf());
+            nodes.emplace_back(id, node_key);
+        }
+
+        chain::NetworkSimulator<FinalityTestData> sim(genesis, config);
+        for (const auto &[id, node_key] : nodes) {
+            sim.addNode(id, std::make_shared<chain::ProofOfAuthorityEngine<FinalityTestData>>(id, node_key),
+                        std::make_shared<chain::FinalityVoter<FinalityTestData>>(id, node_key));
+        }
+        for (int i = 0; i < 10; i++) {
+            chain::Transaction<FinalityTestData> tx("cmd-" + std::to_string(i), FinalityTestData{"move"}, 100);
+            tx.signTransaction(key);
+            sim.submitTransaction(static_cast<size_t>(i) % 4, tx);
+        }
+        sim.runFor(8.5);
+
+        auto stats = sim.getStats();
+        MESSAGE("finalized " << stats.blocks_finalized << " of " << stats.blocks_produced
+                             << " blocks, average finality " << stats.averageFinalitySeconds() * 1000.0 << " ms");
+        CHECK(stats.blocks_finalized >= 7);
+        // Two voting rounds over links of at most 20 ms
+        CHECK(stats.averageFinalitySeconds() < 0.1);
+        for (size_t i = 0; i < sim.getNodeCount(); i++) {
+            const auto &node = sim.getChain(i);
+            CHECK(node.getFinalizedHeight() >= 7);
+            CHECK(node.isValid());
+            CHECK(node.getFinalizedHash() == sim.getChain(0).blocks_[node.getFinalizedHeight()].hash_);
+        }
+    }
+}
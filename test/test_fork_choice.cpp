@@ -0,0 +1,279 @@
+#include <doctest/doctest.h>
+#include "blokit/blokit.hpp"
+#include <memory>
+#include <unordered_map>
+
+struct ForkTestData {
+    std::string value;
+    std::string to_string() const { return "ForkTestData{" + value + "}"; }
+};
+
+namespace {
+    using ForkChain = chain::Chain<ForkTestData>;
+
+    chain::Block<ForkTestData> makeBlock(const std::vector<std::string> &tx_ids, std::shared_ptr<chain::Crypto> key) {
+        std::vector<chain::Transaction<ForkTestData>> txns;
+        for (const auto &id : tx_ids) {
+            chain::Transaction<ForkTestData> tx(id, ForkTestData{"cmd"}, 100);
+            tx.signTransaction(key);
+            txns.push_back(tx);
+        }
+        return chain::Block<ForkTestData>(txns);
+    }
+
+    struct CountingObserver : chain::ChainObserver<ForkTestData> {
+        size_t connected = 0;
+        size_t disconnected = 0;
+        void onBlockConnected(const chain::Block<ForkTestData> &) override { connected++; }
+        void onBlockDisconnected(const chain::Block<ForkTestData> &) override { disconnected++; }
+    };
+
+    struct TransactionCountRule : chain::ForkChoiceRule<ForkTestData> {
+        std::string name() const override { return "transaction-count"; }
+        double score(const chain::Block<ForkTestData> &block, const chain::ForkContext &) const override {
+            return static_cast<double>(block.transactions_.size());
+        }
+    };
+
+    // Weights looked up by a block's first transaction id when the block is scored, 1 if absent
+    struct WeightTableRule : chain::ForkChoiceRule<ForkTestData> {
+        std::shared_ptr<std::unordered_map<std::string, double>> weights =
+            std::make_shared<std::unordered_map<std::string, double>>();
+        std::string name() const override { return "weight-table"; }
+        double score(const chain::Block<ForkTestData> &block, const chain::ForkContext &) const override {
+            auto it = weights->find(block.transactions_.front().uuid_);
+            return it != weights->end() ? it->second : 1.0;
+        }
+    };
+} // namespace
+
+TEST_SUITE("Block Tree") {
+    TEST_CASE("Side branches are kept until they win fork choice") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-shared"}, key)));
+
+        ForkChain side = main_chain;
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-main-1"}, key)));
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-main-2"}, key)));
+        REQUIRE(side.addBlock(makeBlock({"tx-side-1"}, key)));
+        REQUIRE(side.addBlock(makeBlock({"tx-side-2"}, key)));
+        REQUIRE(side.addBlock(makeBlock({"tx-side-3"}, key)));
+
+        auto observer = std::make_shared<CountingObserver>();
+        main_chain.addObserver(observer);
+        std::string main_tip = main_chain.getLastBlock().hash_;
+
+        // Two side blocks only tie or trail the main branch
+        CHECK(main_chain.acceptBlock(side.blocks_[2]));
+        CHECK(main_chain.acceptBlock(side.blocks_[3]));
+        CHECK(main_chain.getBlockTree().size() == 6);
+        CHECK_FALSE(main_chain.acceptBlock(side.blocks_[3])); // Already known
+
+        // The third makes the side branch strictly heavier
+        CHECK(main_chain.acceptBlock(side.blocks_[4]));
+        CHECK(main_chain.getLastBlock().hash_ == side.getLastBlock().hash_);
+        CHECK(main_chain.getChainLength() == 5);
+        CHECK(main_chain.isValid());
+
+        // Only the diverging suffixes were touched, whether the tie at height 3 switched early or not
+        CHECK(observer->disconnected == 2);
+        CHECK(observer->connected == 3);
+        CHECK(main_chain.getReorgCount() == 1);
+
+        // Transaction ids follow the canonical branch
+        CHECK(main_chain.isTransactionUsed("tx-shared"));
+        CHECK(main_chain.isTransactionUsed("tx-side-3"));
+        CHECK_FALSE(main_chain.isTransactionUsed("tx-main-1"));
+        CHECK_FALSE(main_chain.isTransactionUsed("tx-main-2"));
+
+        // The old branch is still in the tree and can win back
+        CHECK(main_chain.hasBlock(main_tip));
+        CHECK(main_chain.getBlockTree().sideCount() == 2);
+    }
+
+    TEST_CASE("Blocks are checked before joining the tree") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-main"}, key)));
+
+        // Extending the tip with a reused transaction id fails contextual validation
+        auto replay = makeBlock({"tx-main"}, key);
+        replay.previous_hash_ = main_chain.getLastBlock().hash_;
+        replay.index_ = main_chain.getLastBlock().index_ + 1;
+        replay.buildMerkleTree();
+        replay.hash_ = replay.calculateHash();
+        CHECK_FALSE(main_chain.acceptBlock(replay));
+        CHECK_FALSE(main_chain.hasBlock(replay.hash_));
+
+        // Unknown parents and wrong heights are rejected outright
+        auto orphan = makeBlock({"tx-orphan"}, key);
+        orphan.previous_hash_ = std::string(64, 'a');
+        orphan.index_ = 9;
+        CHECK_FALSE(main_chain.acceptBlock(orphan));
+
+        auto skipped = makeBlock({"tx-skip"}, key);
+        skipped.previous_hash_ = main_chain.blocks_[0].hash_;
+        skipped.index_ = 5;
+        skipped.buildMerkleTree();
+        skipped.hash_ = skipped.calculateHash();
+        CHECK_FALSE(main_chain.acceptBlock(skipped));
+
+        // Side-branch blocks must be valid on their own
+        auto tampered = makeBlock({"tx-tampered"}, key);
+        tampered.previous_hash_ = main_chain.blocks_[0].hash_;
+        tampered.index_ = 1;
+        tampered.buildMerkleTree();
+        tampered.hash_ = std::string(64, 'b');
+        CHECK_FALSE(main_chain.acceptBlock(tampered));
+        CHECK(main_chain.getBlockTree().size() == 2);
+    }
+
+    TEST_CASE("Failed reorganization keeps the original branch") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        ForkChain side = main_chain;
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-a"}, key)));
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-b"}, key)));
+
+        // The side branch's second block reuses tx-s1, which only fails contextual validation
+        REQUIRE(side.addBlock(makeBlock({"tx-s1"}, key)));
+        auto dup = makeBlock({"tx-s1"}, key);
+        dup.previous_hash_ = side.getLastBlock().hash_;
+        dup.index_ = side.getLastBlock().index_ + 1;
+        dup.buildMerkleTree();
+        dup.hash_ = dup.calculateHash();
+        auto after = makeBlock({"tx-s3"}, key);
+        after.previous_hash_ = dup.hash_;
+        after.index_ = dup.index_ + 1;
+        after.buildMerkleTree();
+        after.hash_ = after.calculateHash();
+
+        std::string tip = main_chain.getLastBlock().hash_;
+        CHECK(main_chain.acceptBlock(side.blocks_[1]));
+        main_chain.acceptBlock(dup); // Ties the main branch: may try (and fail) to reorganize already
+        CHECK_FALSE(main_chain.acceptBlock(after));
+
+        CHECK(main_chain.getLastBlock().hash_ == tip);
+        CHECK(main_chain.isValid());
+        CHECK(main_chain.isTransactionUsed("tx-a"));
+        CHECK(main_chain.isTransactionUsed("tx-b"));
+        CHECK_FALSE(main_chain.isTransactionUsed("tx-s1"));
+        CHECK_FALSE(main_chain.hasBlock(dup.hash_));
+        CHECK_FALSE(main_chain.hasBlock(after.hash_));
+        CHECK(main_chain.hasBlock(side.blocks_[1].hash_));
+    }
+
+    TEST_CASE("Failed reorganization keeps a valid prefix that still wins") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        auto rule = std::make_shared<WeightTableRule>();
+        main_chain.setForkChoiceRule(rule);
+        ForkChain side = main_chain;
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-a"}, key)));
+        REQUIRE(main_chain.addBlock(makeBlock({"tx-b"}, key)));
+        std::string old_tip = main_chain.getLastBlock().hash_;
+
+        REQUIRE(side.addBlock(makeBlock({"tx-s1"}, key)));
+        auto dup = makeBlock({"tx-s1"}, key);
+        dup.previous_hash_ = side.getLastBlock().hash_;
+        dup.index_ = side.getLastBlock().index_ + 1;
+        dup.buildMerkleTree();
+        dup.hash_ = dup.calculateHash();
+        CHECK(main_chain.acceptBlock(side.blocks_[1]));
+        CHECK(main_chain.getLastBlock().hash_ == old_tip);
+
+        // Scores can depend on chain state, like seal weight does, so the side block is worth more once it is
+        // reconnected. Its duplicate child triggers the reorganization and fails, but the prefix now outscores
+        // the old tip, so it stays canonical.
+        (*rule->weights)["tx-s1"] = 5.0;
+        CHECK_FALSE(main_chain.acceptBlock(dup));
+        CHECK(main_chain.getLastBlock().hash_ == side.blocks_[1].hash_);
+        CHECK(main_chain.getReorgCount() == 1);
+        CHECK(main_chain.isValid());
+        CHECK(main_chain.isTransactionUsed("tx-s1"));
+        CHECK_FALSE(main_chain.isTransactionUsed("tx-a"));
+        CHECK_FALSE(main_chain.hasBlock(dup.hash_));
+        CHECK(main_chain.hasBlock(old_tip));
+        CHECK_FALSE(main_chain.getBlockTree().find(old_tip)->canonical);
+    }
+
+    TEST_CASE("Fork choice rule is pluggable") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        main_chain.setForkChoiceRule(std::make_shared<TransactionCountRule>());
+        ForkChain side = main_chain;
+
+        REQUIRE(main_chain.addBlock(makeBlock({"a1"}, key)));
+        REQUIRE(main_chain.addBlock(makeBlock({"a2"}, key)));
+        REQUIRE(side.addBlock(makeBlock({"b1", "b2", "b3"}, key)));
+
+        // One block with three transactions outweighs two blocks with one each, and engines defer to the rule
+        CHECK(main_chain.prefersFork(side.blocks_));
+        CHECK(chain::ProofOfWorkEngine<ForkTestData>(1.0).prefer(main_chain, side.blocks_));
+        CHECK_FALSE(side.prefersFork(main_chain.blocks_));
+        CHECK(main_chain.acceptBlock(side.blocks_[1]));
+        CHECK(main_chain.getLastBlock().hash_ == side.getLastBlock().hash_);
+        CHECK(main_chain.getChainLength() == 2);
+        CHECK_FALSE(main_chain.prefersFork(side.blocks_));
+    }
+
+    TEST_CASE("Side branches are bounded") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("tree-chain", "genesis", ForkTestData{"genesis"}, key);
+        main_chain.setForkChoiceRule(std::make_shared<TransactionCountRule>());
+        ForkChain side = main_chain;
+
+        // One heavy block keeps a long run of light side blocks from ever winning
+        std::vector<std::string> heavy;
+        for (int i = 0; i < 300; i++) {
+            heavy.push_back("heavy-" + std::to_string(i));
+        }
+        REQUIRE(main_chain.addBlock(makeBlock(heavy, key)));
+        for (size_t i = 0; i <= ForkChain::MAX_SIDE_BRANCH_DEPTH; i++) {
+            REQUIRE(side.addBlock(makeBlock({"light-" + std::to_string(i)}, key)));
+        }
+
+        for (size_t i = 1; i <= ForkChain::MAX_SIDE_BRANCH_DEPTH; i++) {
+            REQUIRE(main_chain.acceptBlock(side.blocks_[i]));
+        }
+        CHECK_FALSE(main_chain.acceptBlock(side.blocks_.back()));
+        CHECK(main_chain.getBlockTree().sideCount() == ForkChain::MAX_SIDE_BRANCH_DEPTH);
+        CHECK(main_chain.getChainLength() == 2);
+    }
+
+    TEST_CASE("Reorganization rewinds proof-of-work difficulty") {
+        auto key = std::make_shared<chain::Crypto>("tree_key");
+        ForkChain main_chain("pow-tree", "genesis", ForkTestData{"genesis"}, key);
+        main_chain.setTargetBlockTime(10);
+        main_chain.setDifficultyAdjustmentInterval(3);
+        REQUIRE(main_chain.mineBlock(makeBlock({"p1"}, key), 2));
+
+        ForkChain side = main_chain;
+        REQUIRE(main_chain.mineBlock(makeBlock({"m2"}, key), 2));
+        for (int i = 2; i <= 5; i++) {
+            REQUIRE(side.mineBlock(makeBlock({"s" + std::to_string(i)}, key), 2));
+        }
+
+        // A side block claiming an easier target than its branch requires never reaches the tree
+        auto cheap = makeBlock({"cheap"}, key);
+        cheap.previous_hash_ = side.blocks_[1].hash_;
+        cheap.index_ = 2;
+        cheap.target_bits_ = chain::Target::MAX_COMPACT;
+        cheap.buildMerkleTree();
+        REQUIRE(chain::Miner<ForkTestData>(1).mine(cheap, chain::Target::max()).found);
+        CHECK_FALSE(main_chain.acceptBlock(cheap));
+        CHECK_FALSE(main_chain.hasBlock(cheap.hash_));
+
+        for (size_t i = 2; i < side.blocks_.size(); i++) {
+            main_chain.acceptBlock(side.blocks_[i]);
+        }
+        CHECK(main_chain.getLastBlock().hash_ == side.getLastBlock().hash_);
+        CHECK(main_chain.getNextTargetBits() == side.getNextTargetBits());
+        CHECK(main_chain.isValid());
+
+        // Mining continues on the adopted branch with the right target
+        CHECK(main_chain.mineBlock(makeBlock({"after"}, key), 2));
+        CHECK(main_chain.isValid());
+    }
+}
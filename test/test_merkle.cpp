@@ -1,8 +1,15 @@
 #include "blokit/blokit.hpp"
 #include <doctest/doctest.h>
+#include <memory>
 #include <string>
 #include <vector>
 
+struct MerkleTestData {
+    std::string payload;
+
+    std::string to_string() const { return payload; }
+};
+
 TEST_SUITE("Merkle Tree Tests") {
     TEST_CASE("Empty Merkle Tree") {
         std::vector<std::string> empty_transactions;
@@ -112,4 +119,56 @@ TEST_SUITE("Merkle Tree Tests") {
 
         CHECK(tree1.getRoot() == tree2.getRoot());
     }
+
+    TEST_CASE("Roots match the Lockey hex-of-hex construction") {
+        auto lockeyHash = [](const std::string &data) {
+            lockey::Lockey crypto(lockey::Lockey::Algorithm::AES_256_GCM, lockey::Lockey::HashAlgorithm::SHA256);
+            return lockey::Lockey::to_hex(crypto.hash(std::vector<uint8_t>(data.begin(), data.end())).data);
+        };
+        std::string a = lockeyHash("tx_a"), b = lockeyHash("tx_b"), c = lockeyHash("tx_c");
+        std::string expected = lockeyHash(lockeyHash(a + b) + lockeyHash(c + c));
+
+        CHECK(chain::MerkleTree(std::vector<std::string>{"tx_a", "tx_b", "tx_c"}).getRoot() == expected);
+    }
+
+    TEST_CASE("Trees allocate from the resource they are given") {
+        std::vector<std::string> leaves;
+        for (int i = 0; i < 300; i++) {
+            leaves.push_back("a transaction string long enough to need the heap #" + std::to_string(i));
+        }
+        chain::CountingResource counting;
+        chain::MerkleTree counted(leaves, &counting);
+        CHECK(counted.getRoot() == chain::MerkleTree(leaves).getRoot());
+        CHECK(counting.allocations() >= leaves.size());
+
+        // Small blocks fit in the arena's inline buffer and never reach upstream
+        auto key = std::make_shared<chain::Crypto>("arena_key");
+        std::vector<chain::Transaction<MerkleTestData>> txs;
+        auto makeBlock = [&](int count) {
+            txs.clear();
+            for (int i = 0; i < count; i++) {
+                txs.emplace_back("tx-" + std::to_string(i), MerkleTestData{leaves[static_cast<size_t>(i)]}, 100);
+                txs.back().signTransaction(key);
+            }
+            return chain::Block<MerkleTestData>(txs);
+        };
+        chain::CountingResource upstream;
+        auto small = makeBlock(8);
+        {
+            chain::BlockArena arena(&upstream);
+            CHECK(chain::MerkleTree::fromLeaves(small.merkleLeaves(arena.get())).getRoot() == small.merkle_root_);
+        }
+        CHECK(upstream.allocations() == 0);
+
+        // Larger ones take a few geometrically growing chunks rather than one allocation per string
+        auto large = makeBlock(300);
+        {
+            chain::BlockArena arena(&upstream);
+            auto tree = chain::MerkleTree::fromLeaves(large.merkleLeaves(arena.get()));
+            CHECK(tree.getRoot() == large.computeMerkleRoot());
+        }
+        CHECK(upstream.allocations() > 0);
+        CHECK(upstream.allocations() < 20);
+        CHECK(upstream.deallocations() == upstream.allocations());
+    }
 }
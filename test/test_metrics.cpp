@@ -0,0 +1,111 @@
+// Metrics are compiled out by default; this test builds them in
+#ifndef BLOCKIT_ENABLE_METRICS
+#define BLOCKIT_ENABLE_METRICS
+#endif
+
+#include "blokit/blokit.hpp"
+#include <doctest/doctest.h>
+#include <memory>
+#include <thread>
+
+struct MetricsTestData {
+    std::string reading;
+
+    std::string to_string() const { return "MetricsTestData{" + reading + "}"; }
+
+    std::vector<uint8_t> serializeBinary() const {
+        std::vector<uint8_t> buffer;
+        chain::BinarySerializer::writeString(buffer, reading);
+        return buffer;
+    }
+
+    static MetricsTestData deserializeBinary(const std::vector<uint8_t> &data) {
+        size_t offset = 0;
+        return MetricsTestData{chain::BinarySerializer::readString(data, offset)};
+    }
+};
+
+TEST_SUITE("Metrics") {
+    TEST_CASE("Histogram buckets bound every value within 1/16") {
+        for (uint64_t value : {0ULL, 1ULL, 15ULL, 16ULL, 17ULL, 1000ULL, 123456789ULL, ~0ULL}) {
+            size_t bucket = chain::HistogramBuckets::index(value);
+            REQUIRE(bucket < chain::HistogramBuckets::COUNT);
+            uint64_t upper = chain::HistogramBuckets::upperBound(bucket);
+            CHECK(upper >= value);
+            CHECK(static_cast<double>(upper - value) <= static_cast<double>(value) / 16.0);
+            CHECK(chain::HistogramBuckets::index(upper) == bucket);
+        }
+
+        chain::HistogramSnapshot histogram;
+        for (uint64_t ns = 1; ns <= 1000; ns++) {
+            histogram.buckets[chain::HistogramBuckets::index(ns * 1000)]++;
+            histogram.count++;
+            histogram.sum += ns * 1000;
+        }
+        CHECK(histogram.percentile(0.5) >= 500000);
+        CHECK(histogram.percentile(0.5) <= 500000 + 500000 / 16);
+        CHECK(histogram.percentile(0.99) >= 990000);
+        CHECK(histogram.mean() == doctest::Approx(500500.0));
+    }
+
+    TEST_CASE("Counters from every thread add up, including exited ones") {
+        auto &registry = chain::MetricsRegistry::instance();
+        registry.reset();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 10000; i++) {
+                    chain::countMetric(chain::Counter::DedupMisses);
+                }
+                chain::MetricsRegistry::instance().record(chain::Histogram::StorageSync, 2000);
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        chain::countMetric(chain::Counter::DedupMisses, 5);
+
+        auto snapshot = registry.snapshot();
+        CHECK(snapshot.counter(chain::Counter::DedupMisses) == 40005);
+        CHECK(snapshot.histogram(chain::Histogram::StorageSync).count == 4);
+        CHECK(snapshot.histogram(chain::Histogram::StorageSync).sum == 8000);
+
+        registry.reset();
+        CHECK(registry.snapshot().counter(chain::Counter::DedupMisses) == 0);
+        CHECK(registry.snapshot().histogram(chain::Histogram::StorageSync).count == 0);
+    }
+
+    TEST_CASE("Chain operations are recorded and exported") {
+        auto key = std::make_shared<chain::Crypto>("metrics_key");
+        chain::Chain<MetricsTestData> blockchain("metrics-chain", "genesis", MetricsTestData{"genesis"}, key);
+        auto &registry = chain::MetricsRegistry::instance();
+        registry.reset();
+
+        for (int i = 0; i < 3; i++) {
+            chain::Transaction<MetricsTestData> tx("tx-" + std::to_string(i), MetricsTestData{"reading"}, 100);
+            tx.signTransaction(key);
+            REQUIRE(blockchain.addBlock(chain::Block<MetricsTestData>({tx})));
+        }
+        chain::Transaction<MetricsTestData> duplicate("tx-0", MetricsTestData{"reading"}, 100);
+        duplicate.signTransaction(key);
+        CHECK_FALSE(blockchain.addBlock(chain::Block<MetricsTestData>({duplicate})));
+        auto bytes = blockchain.blocks_.back().serializeBinary();
+        chain::Block<MetricsTestData>::deserializeBinary(bytes);
+
+        auto snapshot = registry.snapshot();
+        CHECK(snapshot.counter(chain::Counter::BlocksAdded) == 3);
+        CHECK(snapshot.counter(chain::Counter::DedupHits) == 1);
+        CHECK(snapshot.counter(chain::Counter::DedupMisses) >= 3);
+        CHECK(snapshot.counter(chain::Counter::Hashes) > 0);
+        CHECK(snapshot.counter(chain::Counter::SerializedBytes) == bytes.size());
+        CHECK(snapshot.counter(chain::Counter::DeserializedBytes) == bytes.size());
+        CHECK(snapshot.histogram(chain::Histogram::AddBlock).count == 4);
+        CHECK(snapshot.histogram(chain::Histogram::MerkleBuild).count >= 4);
+
+        std::string text = snapshot.toPrometheus();
+        CHECK(text.find("# TYPE blockit_blocks_added_total counter\nblockit_blocks_added_total 3\n") !=
+              std::string::npos);
+        CHECK(text.find("blockit_add_block_seconds_count 4\n") != std::string::npos);
+        CHECK(text.find("blockit_add_block_seconds{quantile=\"0.99\"}") != std::string::npos);
+    }
+}
@@ -1,142 +1,828 @@
 #include <doctest/doctest.h>
 #include "blokit/blokit.hpp"
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
-// These tests are designed to FAIL initially and guide development of networking features
-
 struct NetworkTestData {
     std::string message;
     std::string to_string() const { return "NetworkTestData{" + message + "}"; }
+
+    // Binary serialization support, needed on the wire
+    std::vector<uint8_t> serializeBinary() const {
+        std::vector<uint8_t> buffer;
+        chain::BinarySerializer::writeString(buffer, message);
+        return buffer;
+    }
+
+    static NetworkTestData deserializeBinary(const std::vector<uint8_t> &data) {
+        size_t offset = 0;
+        return NetworkTestData{chain::BinarySerializer::readString(data, offset)};
+    }
 };
 
-TEST_SUITE("Missing Features - Networking") {
-    TEST_CASE("Peer-to-peer communication (NOT IMPLEMENTED)") {
-        auto privateKey = std::make_shared<chain::Crypto>("network_key");
-        
-        // TODO: Implement P2P networking
-        // chain::NetworkNode node1("localhost", 8001);
-        // chain::NetworkNode node2("localhost", 8002);
-        // 
-        // node1.connectToPeer("localhost", 8002);
-        // 
-        // CHECK(node1.getPeerCount() == 1);
-        // CHECK(node2.getPeerCount() == 1);
-        
-        WARN("P2P networking not yet implemented");
-    }
-    
-    TEST_CASE("Block propagation across network (NOT IMPLEMENTED)") {
-        auto privateKey = std::make_shared<chain::Crypto>("propagation_key");
-        
-        // TODO: Implement block propagation
-        // chain::NetworkNode node1("localhost", 8003);
-        // chain::NetworkNode node2("localhost", 8004);
-        // chain::NetworkNode node3("localhost", 8005);
-        // 
-        // node1.connectToPeer("localhost", 8004);
-        // node2.connectToPeer("localhost", 8005);
-        // 
-        // // Create and mine block on node1
-        // chain::Chain<NetworkTestData> blockchain("network-chain", "genesis", 
-        //                                         NetworkTestData{"genesis"}, privateKey);
-        // 
-        // chain::Transaction<NetworkTestData> tx("tx-network", NetworkTestData{"test"}, 100);
-        // tx.signTransaction(privateKey);
-        // chain::Block<NetworkTestData> block({tx});
-        // 
-        // node1.broadcastBlock(block);
-        // 
-        // // Wait for propagation
-        // std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        // 
-        // CHECK(node2.hasBlock(block.hash_));
-        // CHECK(node3.hasBlock(block.hash_));
-        
-        WARN("Block propagation not yet implemented");
-    }
-    
-    TEST_CASE("Consensus mechanism (NOT IMPLEMENTED)") {
-        auto privateKey = std::make_shared<chain::Crypto>("consensus_key");
-        
-        // TODO: Implement consensus mechanism
-        // std::vector<chain::NetworkNode> nodes;
-        // for (int i = 0; i < 5; i++) {
-        //     nodes.emplace_back("localhost", 9000 + i);
-        // }
-        // 
-        // // Connect all nodes
-        // for (size_t i = 0; i < nodes.size(); i++) {
-        //     for (size_t j = i + 1; j < nodes.size(); j++) {
-        //         nodes[i].connectToPeer("localhost", 9000 + j);
-        //     }
-        // }
-        // 
-        // // Simulate conflicting blocks
-        // chain::Transaction<NetworkTestData> tx1("tx-conflict1", NetworkTestData{"version1"}, 100);
-        // chain::Transaction<NetworkTestData> tx2("tx-conflict2", NetworkTestData{"version2"}, 100);
-        // 
-        // // Different nodes mine different blocks
-        // nodes[0].mineAndPropose(tx1);
-        // nodes[1].mineAndPropose(tx2);
-        // 
-        // // Wait for consensus
-        // std::this_thread::sleep_for(std::chrono::seconds(1));
-        // 
-        // // All nodes should agree on the same chain
-        // std::string consensusHash = nodes[0].getLatestBlockHash();
-        // for (const auto& node : nodes) {
-        //     CHECK(node.getLatestBlockHash() == consensusHash);
-        // }
-        
-        WARN("Consensus mechanism not yet implemented");
-    }
-    
-    TEST_CASE("Fork resolution (NOT IMPLEMENTED)") {
+namespace {
+    chain::Transaction<NetworkTestData> makeTx(const std::string &id, std::shared_ptr<chain::Crypto> key) {
+        chain::Transaction<NetworkTestData> tx(id, NetworkTestData{"payload"}, 100);
+        tx.signTransaction(key);
+        return tx;
+    }
+
+    // Genesis chain with `count` registered sealers, plus one engine per sealer
+    chain::Chain<NetworkTestData>
+    makeAuthorityNetwork(size_t count, std::vector<std::shared_ptr<chain::ConsensusEngine<NetworkTestData>>> &engines) {
+        auto key = std::make_shared<chain::Crypto>("genesis_key");
+        chain::Chain<NetworkTestData> genesis("sim-chain", "genesis", NetworkTestData{"genesis"}, key);
+        genesis.enableProofOfAuthority(1.0);
+        for (size_t i = 0; i < count; i++) {
+            std::string id = "robot-" + std::to_string(i);
+            auto sealer_key = std::make_shared<chain::Crypto>(id + "_key");
+            genesis.registerSealer(id, sealer_key->getPublicHalf());
+            engines.push_back(std::make_shared<chain::ProofOfAuthorityEngine<NetworkTestData>>(id, sealer_key));
+        }
+        return genesis;
+    }
+} // namespace
+
+TEST_SUITE("Networking") {
+    TEST_CASE("Frames survive arbitrary splits and reject corruption") {
+        std::vector<uint8_t> payload(1000);
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<uint8_t>(i * 7);
+        }
+        auto first = chain::FrameCodec::encode(chain::FrameType::Block, payload);
+        auto second = chain::FrameCodec::encode(chain::FrameType::GetChain, {});
+        std::vector<uint8_t> stream = first;
+        stream.insert(stream.end(), second.begin(), second.end());
+
+        chain::FrameDecoder decoder;
+        std::vector<chain::Frame> frames;
+        for (size_t i = 0; i < stream.size(); i += 3) {
+            decoder.feed(stream.data() + i, std::min<size_t>(3, stream.size() - i));
+            while (auto frame = decoder.next()) {
+                frames.push_back(*frame);
+            }
+        }
+        REQUIRE(frames.size() == 2);
+        CHECK(frames[0].type == chain::FrameType::Block);
+        CHECK(std::ranges::equal(frames[0].payload.span(), payload));
+        CHECK(frames[1].type == chain::FrameType::GetChain);
+        CHECK(decoder.getBufferedBytes() == 0);
+
+        auto corrupted = first;
+        corrupted.back() ^= 0x01;
+        chain::FrameDecoder checksum_decoder;
+        checksum_decoder.feed(corrupted.data(), corrupted.size());
+        CHECK_THROWS_AS(checksum_decoder.next(), std::runtime_error);
+
+        auto garbage = first;
+        garbage[0] = 'X';
+        chain::FrameDecoder magic_decoder;
+        magic_decoder.feed(garbage.data(), garbage.size());
+        CHECK_THROWS_AS(magic_decoder.next(), std::runtime_error);
+
+        chain::FrameDecoder small_decoder(100);
+        CHECK(small_decoder.getMaxFrameBytes() == chain::FrameCodec::HEADER_SIZE + 100); // Where receive() pauses
+        small_decoder.feed(first.data(), first.size());
+        CHECK_THROWS_AS(small_decoder.next(), std::runtime_error);
+    }
+
+    TEST_CASE("Frames are decoded in place from pooled buffers") {
+        auto key = std::make_shared<chain::Crypto>("zero_copy_key");
+        chain::Block<NetworkTestData> block({makeTx("tx-1", key), makeTx("tx-2", key)});
+        auto bytes = block.serializeBinary();
+        auto encoded = chain::FrameCodec::encode(chain::FrameType::Block, bytes);
+
+        // The shared outbound form puts the same bytes on the wire
+        auto outbound = chain::OutboundFrame::make(chain::FrameType::Block, chain::SharedBytes::from(bytes));
+        std::vector<uint8_t> gathered(outbound->prefix.begin(), outbound->prefix.end());
+        gathered.insert(gathered.end(), bytes.begin(), bytes.end());
+        CHECK(gathered == encoded);
+
+        auto pool = std::make_shared<chain::BufferPool>();
+        chain::FrameDecoder decoder(chain::FrameCodec::DEFAULT_MAX_FRAME_SIZE, pool);
+        decoder.feed(encoded.data(), encoded.size());
+        auto frame = decoder.next();
+        REQUIRE(frame);
+        CHECK(frame->payload.owner != nullptr);
+        auto decoded = chain::Block<NetworkTestData>::deserializeBinary(frame->payload.span());
+        CHECK(decoded.serializeBinary() == bytes);
+        CHECK(decoded.transactions_[1].uuid_ == "tx-2");
+
+        // A held frame survives later reads, and its buffer returns to the pool once released
+        decoder.feed(encoded.data(), 10);
+        CHECK_FALSE(decoder.next());
+        decoder.feed(encoded.data() + 10, encoded.size() - 10);
+        auto second = decoder.next();
+        REQUIRE(second);
+        CHECK(std::ranges::equal(frame->payload.span(), bytes));
+        CHECK(std::ranges::equal(second->payload.span(), bytes));
+        frame.reset();
+        second.reset();
+        CHECK_FALSE(decoder.next());
+        CHECK(pool->getFreeCount() == 1);
+        decoder.feed(encoded.data(), encoded.size());
+        CHECK(decoder.next());
+        CHECK(pool->getAllocations() == 1);
+
+        // Truncated input is rejected rather than read past
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 5);
+        CHECK_THROWS_AS(chain::Block<NetworkTestData>::deserializeBinary(std::span<const uint8_t>(truncated)),
+                        std::runtime_error);
+    }
+
+    TEST_CASE("Messages are rejected at the cheapest stage") {
+        auto key = std::make_shared<chain::Crypto>("validation_key");
+        chain::MessageValidator<NetworkTestData> validator;
+        auto bytes = makeTx("tx-valid", key).serializeBinary();
+        CHECK(validator.checkStructure(chain::FrameType::Transaction, bytes));
+        CHECK(chain::MessageValidator<NetworkTestData>::peekTransactionId(bytes) == "tx-valid");
+
+        // Layout and limits are checked on the raw bytes
+        auto long_id = makeTx(std::string(1000, 'x'), key).serializeBinary();
+        CHECK_FALSE(validator.checkStructure(chain::FrameType::Transaction, long_id));
+        auto truncated = bytes;
+        truncated.pop_back();
+        CHECK_FALSE(validator.checkStructure(chain::FrameType::Transaction, truncated));
+        auto padded = bytes;
+        padded.push_back(0);
+        CHECK_FALSE(validator.checkStructure(chain::FrameType::Transaction, padded));
+        std::vector<uint8_t> inventory;
+        chain::BinarySerializer::writeUint32(inventory, 1u << 30); // More digests than the payload holds
+        CHECK_FALSE(validator.checkStructure(chain::FrameType::Inventory, inventory));
+        CHECK_FALSE(validator.checkStructure(static_cast<chain::FrameType>(200), {}));
+        CHECK(validator.getRejected(chain::ValidationStage::Structure) == 5);
+
+        chain::Transaction<NetworkTestData> unsigned_tx("tx-unsigned", NetworkTestData{"payload"}, 100);
+        CHECK_FALSE(validator.checkTransaction(unsigned_tx));
+        CHECK(validator.getRejected(chain::ValidationStage::Signature) == 1);
+
+        chain::Block<NetworkTestData> block({makeTx("tx-a", key), makeTx("tx-b", key)});
+        CHECK(validator.checkBody(block));
+        block.transactions_[1].priority_ = 7;
+        CHECK_FALSE(validator.checkBody(block));
+        CHECK(validator.getRejected(chain::ValidationStage::Merkle) == 1);
+
+        // A raw peer: a duplicate and an unsigned transaction are dropped, a corrupt frame ends the connection
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string path = "/tmp/blokit-test-" + std::to_string(getpid()) + "-validator.sock";
+        chain::EventLoop loop;
+        chain::NetworkNode<NetworkTestData> node(loop, "node-v", genesis);
+        node.listenUnix(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+        auto transmit = [&](const std::vector<uint8_t> &frame) {
+            CHECK(write(fd, frame.data(), frame.size()) == static_cast<ssize_t>(frame.size()));
+        };
+        std::vector<uint8_t> hello;
+        chain::BinarySerializer::writeString(hello, "raw-peer");
+        transmit(chain::FrameCodec::encode(chain::FrameType::Hello, hello));
+        transmit(chain::FrameCodec::encode(chain::FrameType::Transaction, bytes));
+        transmit(chain::FrameCodec::encode(chain::FrameType::Transaction, bytes));
+        transmit(chain::FrameCodec::encode(chain::FrameType::Transaction, unsigned_tx.serializeBinary()));
+
+        const auto &stages = node.getValidator();
+        CHECK(loop.runUntil([&] { return stages.getRejected(chain::ValidationStage::Signature) == 1; }, 2000));
+        CHECK(stages.getRejected(chain::ValidationStage::Duplicate) == 1);
+        CHECK(node.hasTransaction("tx-valid"));
+        CHECK_FALSE(node.hasTransaction("tx-unsigned"));
+
+        auto corrupted = chain::FrameCodec::encode(chain::FrameType::Transaction, bytes);
+        corrupted.back() ^= 0x01;
+        transmit(corrupted);
+        CHECK(loop.runUntil([&] { return node.getPeerCount() == 0; }, 2000));
+        CHECK(stages.getRejected(chain::ValidationStage::Framing) == 1);
+        CHECK(stages.getRejected(chain::ValidationStage::Structure) == 0);
+        close(fd);
+    }
+
+    TEST_CASE("Chain requests are paged and rate-limited") {
+        auto key = std::make_shared<chain::Crypto>("paging_key");
+        chain::Chain<NetworkTestData> source("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        for (int i = 0; i < 40; i++) {
+            REQUIRE(source.addBlock(chain::Block<NetworkTestData>({makeTx("tx-page-" + std::to_string(i), key)})));
+        }
+        std::string path = "/tmp/blokit-test-" + std::to_string(getpid()) + "-paging.sock";
+        chain::EventLoop loop;
+        chain::NetworkNode<NetworkTestData> node(loop, "node-p", source);
+        node.listenUnix(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+        std::vector<uint8_t> requests;
+        auto queue = [&](chain::FrameType type, const std::vector<uint8_t> &payload) {
+            auto frame = chain::FrameCodec::encode(type, payload);
+            requests.insert(requests.end(), frame.begin(), frame.end());
+        };
+        std::vector<uint8_t> hello;
+        chain::BinarySerializer::writeString(hello, "raw-peer");
+        queue(chain::FrameType::Hello, hello);
+        // A page from height 30, one past the tip, then more than the burst allows
+        for (uint64_t start : {30, 41, 0, 0, 0, 0}) {
+            std::vector<uint8_t> payload;
+            chain::BinarySerializer::writeUint64(payload, start);
+            queue(chain::FrameType::GetChain, payload);
+        }
+        REQUIRE(write(fd, requests.data(), requests.size()) == static_cast<ssize_t>(requests.size()));
+        CHECK(loop.runUntil([&] { return node.getStats().chain_requests_refused == 2; }, 2000));
+        loop.runUntil([&] { return false; }, 50);
+
+        chain::FrameDecoder decoder;
+        std::vector<std::vector<chain::Block<NetworkTestData>>> pages;
+        uint8_t buffer[64 * 1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            decoder.feed(buffer, static_cast<size_t>(n));
+            while (auto frame = decoder.next()) {
+                if (frame->type != chain::FrameType::Chain) {
+                    continue;
+                }
+                chain::BinaryReader reader(frame->payload.span());
+                pages.emplace_back();
+                for (uint32_t count = reader.readUint32(); count > 0; count--) {
+                    pages.back().push_back(chain::Block<NetworkTestData>::deserializeBinary(reader.readSpan()));
+                }
+            }
+        }
+        REQUIRE(pages.size() == 4);
+        REQUIRE(pages[0].size() == 11);
+        CHECK(pages[0].front().hash_ == source.blocks_[30].hash_);
+        CHECK(pages[0].back().hash_ == source.getLastBlock().hash_);
+        CHECK(pages[1].empty());
+        CHECK(pages[2].size() == 41);
+        CHECK(node.getPeerCount() == 1);
+        close(fd);
+    }
+
+    TEST_CASE("Peers connect over loopback TCP and Unix sockets") {
+        auto key = std::make_shared<chain::Crypto>("network_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string path = "/tmp/blokit-test-" + std::to_string(getpid()) + "-a.sock";
+
+        chain::EventLoop loop;
+        chain::NetworkNode<NetworkTestData> a(loop, "node-a", genesis);
+        chain::NetworkNode<NetworkTestData> b(loop, "node-b", genesis);
+        chain::NetworkNode<NetworkTestData> c(loop, "node-c", genesis);
+        uint16_t port = a.listenTcp("127.0.0.1");
+        a.listenUnix(path);
+
+        CHECK(b.connectTcp("127.0.0.1", port));
+        CHECK(c.connectUnix(path));
+        CHECK(loop.runUntil([&] { return a.getPeerCount() == 2 && b.getPeerCount() == 1 && c.getPeerCount() == 1; },
+                            2000));
+
+        // A second connection between the same pair is refused
+        CHECK(b.connectUnix(path));
+        loop.runUntil([&] { return false; }, 50);
+        CHECK(a.getPeerCount() == 2);
+
+        // Closing one side is noticed by the other
+        c.shutdown();
+        CHECK(loop.runUntil([&] { return a.getPeerCount() == 1; }, 2000));
+    }
+
+    TEST_CASE("Blocks and transactions propagate across the network") {
+        auto key = std::make_shared<chain::Crypto>("propagation_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string prefix = "/tmp/blokit-test-" + std::to_string(getpid()) + "-line-";
+
+        // A line of five nodes: everything has to be relayed hop by hop
+        chain::EventLoop loop;
+        std::vector<std::unique_ptr<chain::NetworkNode<NetworkTestData>>> nodes;
+        for (int i = 0; i < 5; i++) {
+            nodes.push_back(
+                std::make_unique<chain::NetworkNode<NetworkTestData>>(loop, "node-" + std::to_string(i), genesis));
+            nodes.back()->listenUnix(prefix + std::to_string(i));
+            if (i > 0) {
+                nodes.back()->connectUnix(prefix + std::to_string(i - 1));
+            }
+        }
+        auto everyone = [&](auto predicate) {
+            return loop.runUntil(
+                [&] { return std::all_of(nodes.begin(), nodes.end(), [&](auto &node) { return predicate(*node); }); },
+                3000);
+        };
+        REQUIRE(everyone([](auto &node) { return node.getPeerCount() >= 1; }));
+
+        CHECK(nodes[2]->submitTransaction(makeTx("tx-gossip", key)));
+        CHECK(everyone([](auto &node) { return node.hasTransaction("tx-gossip"); }));
+        CHECK(nodes[4]->getPendingTransactions().size() == 1);
+
+        auto &producer = nodes[0]->getChain();
+        chain::Block<NetworkTestData> block({makeTx("tx-block", key)});
+        block.previous_hash_ = producer.getLastBlock().hash_;
+        block.index_ = 1;
+        block.buildMerkleTree();
+        block.hash_ = block.calculateHash();
+        CHECK(nodes[0]->broadcastBlock(block));
+        CHECK(everyone([&](auto &node) { return node.getChain().getLastBlock().hash_ == block.hash_; }));
+
+        // A latecomer learns the chain from its first peer's tip announcement
+        chain::NetworkNode<NetworkTestData> late(loop, "node-late", genesis);
+        late.connectUnix(prefix + "4");
+        CHECK(loop.runUntil([&] { return late.getChain().getChainLength() == 2; }, 3000));
+        CHECK(late.getChain().isValid());
+        CHECK(nodes[4]->getStats().peers_dropped == 0);
+    }
+
+    TEST_CASE("One event loop serves hundreds of peers") {
+        auto key = std::make_shared<chain::Crypto>("fanout_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string path = "/tmp/blokit-test-" + std::to_string(getpid()) + "-hub.sock";
+
+        chain::EventLoop loop;
+        chain::NetworkNode<NetworkTestData> hub(loop, "hub", genesis);
+        hub.listenUnix(path);
+        std::vector<std::unique_ptr<chain::NetworkNode<NetworkTestData>>> leaves;
+        for (int i = 0; i < 300; i++) {
+            leaves.push_back(
+                std::make_unique<chain::NetworkNode<NetworkTestData>>(loop, "leaf-" + std::to_string(i), genesis));
+            leaves.back()->connectUnix(path);
+        }
+        REQUIRE(loop.runUntil([&] { return hub.getPeerCount() == leaves.size(); }, 5000));
+        CHECK(loop.getWatchedCount() == 1 + 2 * leaves.size());
+
+        CHECK(hub.submitTransaction(makeTx("tx-fanout", key)));
+        CHECK(loop.runUntil(
+            [&] {
+                return std::all_of(leaves.begin(), leaves.end(),
+                                   [](auto &leaf) { return leaf->hasTransaction("tx-fanout"); });
+            },
+            5000));
+
+        // A peer sending garbage is dropped without disturbing the others
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+        std::string junk(64, 'x');
+        REQUIRE(write(fd, junk.data(), junk.size()) == static_cast<ssize_t>(junk.size()));
+        CHECK(loop.runUntil([&] { return hub.getStats().peers_dropped == 1; }, 2000));
+        close(fd);
+        CHECK(hub.getPeerCount() == leaves.size());
+    }
+
+    TEST_CASE("Compact blocks are rebuilt from the mempool") {
+        // Reference vector from the SipHash paper: key 00..0f, message 00..0e
+        std::vector<uint8_t> message(15);
+        for (size_t i = 0; i < message.size(); i++) {
+            message[i] = static_cast<uint8_t>(i);
+        }
+        CHECK(chain::SipHash::hash(0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, message.data(), message.size()) ==
+              0xa129ca6149be45e5ULL);
+
+        auto key = std::make_shared<chain::Crypto>("compact_key");
+        std::vector<chain::Transaction<NetworkTestData>> txns;
+        for (int i = 0; i < 20; i++) {
+            txns.push_back(makeTx("tx-compact-" + std::to_string(i), key));
+        }
+        chain::Block<NetworkTestData> block(txns);
+
+        auto compact = chain::CompactBlock<NetworkTestData>::fromBlock(
+            block, 42, [](const auto &tx) { return tx.uuid_ == "tx-compact-0"; });
+        auto wire = compact.serializeBinary();
+        CHECK(wire.size() * 4 < block.serializeBinary().size());
+        auto decoded = chain::CompactBlock<NetworkTestData>::deserializeBinary(wire);
+        CHECK(decoded.short_ids == compact.short_ids);
+        REQUIRE(decoded.prefilled.size() == 1);
+        CHECK(decoded.prefilled[0].first == 0);
+
+        // The pool lacks one transaction and holds an unrelated one
+        chain::Mempool<NetworkTestData> pool;
+        for (int i = 1; i < 20; i++) {
+            if (i != 7) {
+                pool.add(txns[i]);
+            }
+        }
+        pool.add(makeTx("tx-unrelated", key));
+        chain::PartialBlock<NetworkTestData> partial(decoded, pool);
+        CHECK(partial.getMissing() == std::vector<uint32_t>{7});
+        CHECK_FALSE(partial.build().has_value());
+
+        // A wrong transaction breaks the Merkle root; the right one rebuilds the block exactly
+        auto wrong = partial;
+        REQUIRE(wrong.fill({makeTx("tx-impostor", key)}));
+        CHECK_FALSE(wrong.build().has_value());
+        REQUIRE(partial.fill({txns[7]}));
+        auto rebuilt = partial.build();
+        REQUIRE(rebuilt.has_value());
+        CHECK(rebuilt->hash_ == block.hash_);
+        CHECK(rebuilt->isValid());
+    }
+
+    TEST_CASE("Compact relay fetches only the missing transactions") {
+        auto key = std::make_shared<chain::Crypto>("relay_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string prefix = "/tmp/blokit-test-" + std::to_string(getpid()) + "-compact-";
+
+        chain::EventLoop loop;
+        chain::NetworkNode<NetworkTestData> a(loop, "node-a", genesis);
+        chain::NetworkNode<NetworkTestData> b(loop, "node-b", genesis);
+        chain::NetworkNode<NetworkTestData> c(loop, "node-c", genesis);
+        a.listenUnix(prefix + "a");
+        b.listenUnix(prefix + "b");
+        b.connectUnix(prefix + "a");
+        REQUIRE(loop.runUntil([&] { return a.getPeerCount() == 1 && b.getPeerCount() == 1; }, 2000));
+
+        auto gossipAndProduce = [&](const std::string &tag) {
+            std::vector<chain::Transaction<NetworkTestData>> txns;
+            for (int i = 0; i < 50; i++) {
+                txns.push_back(makeTx(tag + std::to_string(i), key));
+                a.submitTransaction(txns.back());
+            }
+            REQUIRE(loop.runUntil([&] { return b.getPendingTransactions().size() == 50; }, 3000));
+            chain::Block<NetworkTestData> block(txns);
+            block.previous_hash_ = a.getChain().getLastBlock().hash_;
+            block.index_ = a.getChain().getLastBlock().index_ + 1;
+            block.buildMerkleTree();
+            block.hash_ = block.calculateHash();
+            return block;
+        };
+        auto relayCost = [&](const chain::Block<NetworkTestData> &block) {
+            uint64_t before = a.getStats().bytes_sent;
+            CHECK(a.broadcastBlock(block));
+            CHECK(loop.runUntil([&] { return b.getChain().getLastBlock().hash_ == block.hash_; }, 3000));
+            return a.getStats().bytes_sent - before;
+        };
+
+        // b already has every transaction, so the block arrives in one message
+        uint64_t compact_bytes = relayCost(gossipAndProduce("tx-first-"));
+        CHECK(b.getStats().compact_blocks_reconstructed == 1);
+        CHECK(b.getStats().transactions_requested == 0);
+        CHECK(b.getPendingTransactions().empty());
+
+        a.setCompactRelay(false);
+        uint64_t full_bytes = relayCost(gossipAndProduce("tx-second-"));
+        CHECK(compact_bytes * 4 < full_bytes);
+
+        // c joins after the gossip, so it asks b for the block's transactions in a single round trip
+        auto third = gossipAndProduce("tx-third-");
+        c.connectUnix(prefix + "b");
+        REQUIRE(loop.runUntil([&] { return c.getChain().getChainLength() == 3; }, 3000));
+        a.setCompactRelay(true);
+        relayCost(third);
+        CHECK(loop.runUntil([&] { return c.getChain().getLastBlock().hash_ == third.hash_; }, 3000));
+        CHECK(c.getStats().compact_blocks_reconstructed == 0);
+        CHECK(c.getStats().transactions_requested == 50);
+        CHECK(c.getChain().isValid());
+        CHECK(a.getStats().peers_dropped + b.getStats().peers_dropped + c.getStats().peers_dropped == 0);
+    }
+
+    TEST_CASE("Headers-first sync validates headers and bodies") {
+        auto key = std::make_shared<chain::Crypto>("sync_key");
+        chain::Chain<NetworkTestData> source("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        chain::Chain<NetworkTestData> target = source;
+        for (int i = 0; i < 40; i++) {
+            REQUIRE(source.addBlock(chain::Block<NetworkTestData>({makeTx("tx-sync-" + std::to_string(i), key)})));
+        }
+        std::vector<chain::Block<NetworkTestData>> headers;
+        for (size_t i = 1; i < source.blocks_.size(); i++) {
+            headers.push_back(source.blocks_[i]);
+            headers.back().transactions_.clear();
+        }
+        auto bodyOf = [&](const std::string &hash) { return source.findBlock(hash)->transactions_; };
+
+        chain::ChainSync<NetworkTestData>::Config config;
+        config.window_size = 4;
+        config.requests_per_peer = 2;
+        chain::ChainSync<NetworkTestData> sync(target, config);
+
+        // A broken link or a forged hash rejects the batch
+        auto broken = headers;
+        broken[5].previous_hash_ = std::string(64, '0');
+        CHECK_FALSE(sync.addHeaders(broken));
+        sync.clear();
+        auto forged = headers;
+        forged[2].nonce_ += 1;
+        CHECK_FALSE(sync.addHeaders(forged));
+        sync.clear();
+        REQUIRE(sync.addHeaders(headers));
+        CHECK(sync.getHeaderHeight() == 40);
+
+        auto start = chain::ChainSync<NetworkTestData>::Clock::now();
+        auto first = sync.assign(1, 40, start);
+        auto second = sync.assign(2, 40, start);
+        REQUIRE(first.size() == 8);
+        REQUIRE(second.size() == 8);
+        CHECK(first.front() == headers[0].hash_);
+        CHECK(second.front() == headers[8].hash_);
+
+        // Later bodies wait for earlier ones; a body that contradicts its header is refused
+        for (const auto &hash : second) {
+            CHECK(sync.addBody(2, hash, bodyOf(hash)));
+        }
+        CHECK(sync.connect() == 0);
+        CHECK_FALSE(sync.addBody(1, first[0], bodyOf(first[1])));
+
+        // Peer 1 stalls: its blocks go to peer 3
+        auto later = start + std::chrono::seconds(10);
+        CHECK(sync.stalledPeers(later) == std::vector<int>{1});
+        sync.removePeer(1);
+        auto third = sync.assign(3, 40, later);
+        REQUIRE(third.size() == 8);
+        CHECK(third.front() == headers[0].hash_);
+        for (const auto &hash : third) {
+            CHECK(sync.addBody(3, hash, bodyOf(hash)));
+        }
+        CHECK(sync.connect() == 16);
+
+        while (sync.isActive()) {
+            for (const auto &hash : sync.assign(3, 40, later)) {
+                CHECK(sync.addBody(3, hash, bodyOf(hash)));
+            }
+            sync.connect();
+        }
+        CHECK(target.getLastBlock().hash_ == source.getLastBlock().hash_);
+        CHECK(target.isValid());
+    }
+
+    TEST_CASE("Header sync checks the owed target and caps the headers it holds") {
+        auto key = std::make_shared<chain::Crypto>("sync_key");
+        chain::Chain<NetworkTestData> source("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        source.enableProofOfWork(chain::Chain<NetworkTestData>::DEFAULT_TARGET_BITS, 0.5,
+                                 std::make_shared<chain::MovingAverageRetarget>(3, 1.5));
+        chain::Chain<NetworkTestData> target = source;
+        for (int i = 0; i < 8; i++) {
+            REQUIRE(source.mineBlock(chain::Block<NetworkTestData>({makeTx("tx-pow-" + std::to_string(i), key)}), 1));
+        }
+        std::vector<chain::Block<NetworkTestData>> headers;
+        for (size_t i = 1; i < source.blocks_.size(); i++) {
+            headers.push_back(source.blocks_[i]);
+            headers.back().transactions_.clear();
+        }
+
+        // Fast blocks raised the target; a header mined against the starting one has valid work but is refused
+        auto easy = headers;
+        REQUIRE(easy.back().target_bits_ != chain::Chain<NetworkTestData>::DEFAULT_TARGET_BITS);
+        easy.back().target_bits_ = chain::Chain<NetworkTestData>::DEFAULT_TARGET_BITS;
+        chain::Miner<NetworkTestData> miner(1);
+        REQUIRE(miner.mine(easy.back(), chain::Target::fromCompact(easy.back().target_bits_)).found);
+        REQUIRE(target.isValidHeader(easy.back()));
+        chain::ChainSync<NetworkTestData> sync(target);
+        CHECK_FALSE(sync.addHeaders(easy));
+        sync.clear();
+        REQUIRE(sync.addHeaders(headers));
+        CHECK(sync.getHeaderHeight() == 8);
+
+        // Headers past the cap are dropped until blocks connect
+        chain::ChainSync<NetworkTestData>::Config config;
+        config.max_headers = 3;
+        chain::ChainSync<NetworkTestData> capped(target, config);
+        REQUIRE(capped.addHeaders(headers));
+        CHECK(capped.isFull());
+        CHECK(capped.getPendingCount() == 3);
+        CHECK(capped.getHeaderHeight() == 3);
+    }
+
+    TEST_CASE("A new node syncs from several peers at once") {
+        auto key = std::make_shared<chain::Crypto>("catchup_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        chain::Chain<NetworkTestData> history = genesis;
+        for (int i = 0; i < 200; i++) {
+            REQUIRE(history.addBlock(chain::Block<NetworkTestData>({makeTx("tx-history-" + std::to_string(i), key)})));
+        }
+        std::string prefix = "/tmp/blokit-test-" + std::to_string(getpid()) + "-seed-";
+
+        chain::EventLoop loop;
+        std::vector<std::unique_ptr<chain::NetworkNode<NetworkTestData>>> seeds;
+        chain::NetworkNode<NetworkTestData> fresh(loop, "fresh", genesis);
+        for (int i = 0; i < 3; i++) {
+            seeds.push_back(
+                std::make_unique<chain::NetworkNode<NetworkTestData>>(loop, "seed-" + std::to_string(i), history));
+            seeds.back()->listenUnix(prefix + std::to_string(i));
+            fresh.connectUnix(prefix + std::to_string(i));
+        }
+
+        CHECK(loop.runUntil([&] { return fresh.getChain().getChainLength() == 201 && !fresh.isSyncing(); }, 10000));
+        CHECK(fresh.getChain().getLastBlock().hash_ == history.getLastBlock().hash_);
+        CHECK(fresh.getChain().isValid());
+        CHECK(fresh.getStats().blocks_synced == 200);
+        auto served = [](auto &seed) { return seed->getStats().bodies_served > 0; };
+        CHECK(std::count_if(seeds.begin(), seeds.end(), served) >= 2);
+        CHECK(fresh.getStats().peers_dropped == 0);
+    }
+
+    TEST_CASE("Inventory primitives bound memory and order by priority") {
+        chain::SeenSet seen(3);
+        CHECK(seen.insert(1));
+        CHECK_FALSE(seen.insert(1));
+        seen.insert(2);
+        seen.insert(3);
+        seen.insert(4); // Evicts the oldest
+        CHECK(seen.size() == 3);
+        CHECK_FALSE(seen.contains(1));
+        CHECK(seen.contains(4));
+
+        chain::InventoryQueue queue(3);
+        queue.push(10, 5);
+        queue.push(11, 200);
+        queue.push(12, 5);
+        queue.push(13, 0); // Over capacity: the lowest priority goes
+        CHECK(queue.getDropped() == 1);
+        CHECK(queue.pop(10) == std::vector<uint64_t>{11, 10, 12});
+
+        auto start = chain::TokenBucket::Clock::now();
+        chain::TokenBucket bucket(100.0, 10.0, start);
+        CHECK(bucket.take(25, start) == 10);
+        CHECK(bucket.take(25, start) == 0);
+        CHECK(bucket.take(25, start + std::chrono::milliseconds(50)) == 5);
+        CHECK(bucket.take(25, start + std::chrono::seconds(5)) == 10);
+
+        CHECK(chain::transactionDigest("tx-a") == chain::transactionDigest("tx-a"));
+        CHECK(chain::transactionDigest("tx-a") != chain::transactionDigest("tx-b"));
+    }
+
+    TEST_CASE("Each node fetches each transaction once in a full mesh") {
+        auto key = std::make_shared<chain::Crypto>("mesh_key");
+        chain::Chain<NetworkTestData> genesis("net-chain", "genesis", NetworkTestData{"genesis"}, key);
+        std::string prefix = "/tmp/blokit-test-" + std::to_string(getpid()) + "-mesh-";
+
+        const int count = 6;
+        chain::EventLoop loop;
+        std::vector<std::unique_ptr<chain::NetworkNode<NetworkTestData>>> nodes;
+        for (int i = 0; i < count; i++) {
+            nodes.push_back(
+                std::make_unique<chain::NetworkNode<NetworkTestData>>(loop, "mesh-" + std::to_string(i), genesis));
+            nodes.back()->listenUnix(prefix + std::to_string(i));
+            for (int j = 0; j < i; j++) {
+                nodes.back()->connectUnix(prefix + std::to_string(j));
+            }
+        }
+        auto everyone = [&](auto predicate) {
+            return loop.runUntil(
+                [&] { return std::all_of(nodes.begin(), nodes.end(), [&](auto &node) { return predicate(*node); }); },
+                5000);
+        };
+        REQUIRE(everyone([&](auto &node) { return node.getPeerCount() == count - 1; }));
+
+        for (int i = 0; i < count; i++) {
+            for (int n = 0; n < 5; n++) {
+                std::string id = "tx-mesh-" + std::to_string(i) + "-" + std::to_string(n);
+                CHECK(nodes[i]->submitTransaction(makeTx(id, key)));
+            }
+        }
+        CHECK(everyone([&](auto &node) { return node.getPendingTransactions().size() == 5 * count; }));
+
+        // Announcements are cheap and fan out; bodies are fetched exactly once per node
+        for (auto &node : nodes) {
+            CHECK(node->getStats().transactions_fetched == 5 * (count - 1));
+            CHECK(node->getStats().duplicate_transactions == 0);
+            CHECK(node->getStats().inventory_announced <= 5 * count * (count - 1));
+        }
+        CHECK_FALSE(nodes[0]->submitTransaction(makeTx("tx-mesh-0-0", key)));
+    }
+}
+
+TEST_SUITE("Consensus") {
+    TEST_CASE("Fork resolution") {
         auto privateKey = std::make_shared<chain::Crypto>("fork_key");
-        
-        // TODO: Implement fork resolution
-        // chain::Chain<NetworkTestData> chain1("fork-chain", "genesis", NetworkTestData{"genesis"}, privateKey);
-        // chain::Chain<NetworkTestData> chain2("fork-chain", "genesis", NetworkTestData{"genesis"}, privateKey);
-        // 
-        // // Create fork by adding different blocks
-        // chain::Transaction<NetworkTestData> tx1("tx-fork1", NetworkTestData{"branch1"}, 100);
-        // chain::Transaction<NetworkTestData> tx2("tx-fork2", NetworkTestData{"branch2"}, 100);
-        // 
-        // chain1.addBlock(chain::Block<NetworkTestData>({tx1}));
-        // chain2.addBlock(chain::Block<NetworkTestData>({tx2}));
-        // 
-        // // Chains should be different
-        // CHECK(chain1.getLatestBlockHash() != chain2.getLatestBlockHash());
-        // 
-        // // Resolve fork (longest chain wins)
-        // chain::Chain<NetworkTestData> resolved = chain::resolveFork(chain1, chain2);
-        // 
-        // // Should pick the longest/most work chain
-        // CHECK(resolved.isValid());
-        
-        WARN("Fork resolution not yet implemented");
-    }
-    
-    TEST_CASE("Network message validation (NOT IMPLEMENTED)") {
-        auto privateKey = std::make_shared<chain::Crypto>("validation_key");
-        
-        // TODO: Implement network message validation
-        // chain::NetworkNode node("localhost", 7001);
-        // 
-        // // Test invalid message rejection
-        // chain::NetworkMessage invalidMsg;
-        // invalidMsg.type = "INVALID_TYPE";
-        // invalidMsg.payload = "malicious_data";
-        // 
-        // CHECK_FALSE(node.validateMessage(invalidMsg));
-        // 
-        // // Test valid message acceptance
-        // chain::Transaction<NetworkTestData> tx("tx-valid", NetworkTestData{"valid"}, 100);
-        // tx.signTransaction(privateKey);
-        // 
-        // chain::NetworkMessage validMsg = node.createTransactionMessage(tx);
-        // CHECK(node.validateMessage(validMsg));
-        
-        WARN("Network message validation not yet implemented");
+        chain::Chain<NetworkTestData> chain1("fork-chain", "genesis", NetworkTestData{"genesis"}, privateKey);
+        chain::Chain<NetworkTestData> chain2 = chain1;
+
+        // Create fork by adding different blocks
+        REQUIRE(chain1.addBlock(chain::Block<NetworkTestData>({makeTx("tx-fork1", privateKey)})));
+        REQUIRE(chain2.addBlock(chain::Block<NetworkTestData>({makeTx("tx-fork2", privateKey)})));
+        REQUIRE(chain2.addBlock(chain::Block<NetworkTestData>({makeTx("tx-fork3", privateKey)})));
+        CHECK(chain1.getLastBlock().hash_ != chain2.getLastBlock().hash_);
+
+        // Longest chain wins when neither carries work or seals
+        const auto &resolved = chain::resolveFork(chain1, chain2);
+        CHECK(&resolved == &chain2);
+        CHECK(resolved.isValid());
+
+        // Switching rolls back the abandoned branch's transactions
+        CHECK(chain1.switchToFork(chain2.blocks_));
+        CHECK(chain1.getLastBlock().hash_ == chain2.getLastBlock().hash_);
+        CHECK_FALSE(chain1.isTransactionUsed("tx-fork1"));
+        CHECK(chain1.isTransactionUsed("tx-fork3"));
+        CHECK(chain1.isValid());
+
+        // Nothing new, or a different genesis, leaves the chain alone
+        CHECK_FALSE(chain1.switchToFork(chain2.blocks_));
+        chain::Chain<NetworkTestData> stranger("other-chain", "genesis", NetworkTestData{"other"}, privateKey);
+        CHECK_FALSE(chain1.switchToFork(stranger.blocks_));
+
+        // A tampered block anywhere in the fork rejects it and keeps the current branch
+        auto tampered = chain2.blocks_;
+        tampered.push_back(chain2.getLastBlock());
+        tampered.back().index_++;
+        CHECK_FALSE(chain1.switchToFork(tampered));
+        CHECK(chain1.getChainLength() == 3);
+    }
+
+    TEST_CASE("Proof-of-authority network converges") {
+        std::vector<std::shared_ptr<chain::ConsensusEngine<NetworkTestData>>> engines;
+        auto genesis = makeAuthorityNetwork(4, engines);
+
+        chain::SimulatorConfig config;
+        config.min_latency = 0.01;
+        config.max_latency = 0.05;
+        config.seed = 7;
+        chain::NetworkSimulator<NetworkTestData> sim(genesis, config);
+        for (size_t i = 0; i < engines.size(); i++) {
+            sim.addNode("node-" + std::to_string(i), engines[i]);
+        }
+
+        auto key = std::make_shared<chain::Crypto>("client_key");
+        for (int i = 0; i < 20; i++) {
+            sim.submitTransaction(static_cast<size_t>(i) % sim.getNodeCount(), makeTx("cmd-" + std::to_string(i), key));
+        }
+        sim.runFor(10.5);
+
+        // One block per one-second round, in turn every time with this little latency
+        auto stats = sim.getStats();
+        CHECK(stats.blocks_produced == 10);
+        CHECK(stats.reorgs == 0);
+        CHECK(stats.committed_transactions == 20);
+        CHECK(stats.averagePropagationSeconds() < 0.1);
+        CHECK(sim.isConverged());
+        for (size_t i = 0; i < sim.getNodeCount(); i++) {
+            CHECK(sim.getChain(i).getChainLength() == 11);
+            CHECK(sim.getChain(i).isValid());
+        }
+    }
+
+    TEST_CASE("Simulation replays from its seed") {
+        auto run = [](uint64_t seed) {
+            std::vector<std::shared_ptr<chain::ConsensusEngine<NetworkTestData>>> engines;
+            auto genesis = makeAuthorityNetwork(3, engines);
+            chain::SimulatorConfig config;
+            config.drop_rate = 0.2;
+            config.seed = seed;
+            chain::NetworkSimulator<NetworkTestData> sim(genesis, config);
+            for (size_t i = 0; i < engines.size(); i++) {
+                sim.addNode("node-" + std::to_string(i), engines[i]);
+            }
+            sim.runFor(20.0);
+            return sim.getStats();
+        };
+
+        auto first = run(42);
+        auto second = run(42);
+        CHECK(first.messages_sent == second.messages_sent);
+        CHECK(first.messages_dropped == second.messages_dropped);
+        CHECK(first.blocks_produced == second.blocks_produced);
+        CHECK(first.reorgs == second.reorgs);
+        CHECK(first.total_propagation_seconds == doctest::Approx(second.total_propagation_seconds));
+        CHECK(first.messages_dropped > 0);
+    }
+
+    TEST_CASE("Partitioned network reconverges after healing") {
+        std::vector<std::shared_ptr<chain::ConsensusEngine<NetworkTestData>>> engines;
+        auto genesis = makeAuthorityNetwork(5, engines);
+        chain::NetworkSimulator<NetworkTestData> sim(genesis);
+        for (size_t i = 0; i < engines.size(); i++) {
+            sim.addNode("node-" + std::to_string(i), engines[i]);
+        }
+
+        sim.partition({{0, 1, 2}, {3, 4}});
+        sim.runFor(15.0);
+        CHECK_FALSE(sim.isConverged());
+        // The minority side cannot keep sealing: each sealer may only seal one of any three consecutive blocks
+        CHECK(sim.getChain(3).getChainLength() < sim.getChain(0).getChainLength());
+
+        sim.heal();
+        sim.runFor(5.0);
+        CHECK(sim.isConverged());
+        CHECK(sim.getStats().reorgs >= 2);
+        CHECK(sim.getChain(4).isValid());
+    }
+
+    TEST_CASE("Proof-of-work network stays consistent") {
+        auto key = std::make_shared<chain::Crypto>("pow_sim_key");
+        chain::Chain<NetworkTestData> genesis("pow-sim", "genesis", NetworkTestData{"genesis"}, key);
+        genesis.setTargetBlockTime(2.0);
+
+        chain::SimulatorConfig config;
+        config.seed = 3;
+        chain::NetworkSimulator<NetworkTestData> sim(genesis, config);
+        for (int i = 0; i < 3; i++) {
+            // About 256 hashes per block at the default target, so the network finds one every ~2s
+            sim.addNode("miner-" + std::to_string(i),
+                        std::make_shared<chain::ProofOfWorkEngine<NetworkTestData>>(256.0 / 6.0));
+        }
+        sim.runFor(30.0);
+
+        auto stats = sim.getStats();
+        CHECK(stats.blocks_produced > 5);
+        for (size_t i = 0; i < sim.getNodeCount(); i++) {
+            CHECK(sim.getChain(i).isValid());
+        }
+        // Let in-flight blocks land, then everyone must agree on the prefix two blocks below the shortest tip
+        sim.runFor(0.2);
+        size_t shortest = sim.getChain(0).getChainLength();
+        for (size_t i = 1; i < sim.getNodeCount(); i++) {
+            shortest = std::min(shortest, sim.getChain(i).getChainLength());
+        }
+        REQUIRE(shortest > 2);
+        for (size_t i = 1; i < sim.getNodeCount(); i++) {
+            CHECK(sim.getChain(i).blocks_[shortest - 3].hash_ == sim.getChain(0).blocks_[shortest - 3].hash_);
+        }
     }
 }
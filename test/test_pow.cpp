@@ -1,57 +1,290 @@
 #include <doctest/doctest.h>
 #include "blokit/blokit.hpp"
 #include <memory>
+#include <thread>
 
 // These tests are designed to FAIL initially and guide our development of missing features
 
 struct MiningTestData {
     std::string content;
     std::string to_string() const { return "MiningTestData{" + content + "}"; }
+
+    // JSON serialization support, for the save and load round trip
+    std::string serialize() const { return R"({"content": ")" + content + R"("})"; }
+
+    static MiningTestData deserialize(const std::string &data) {
+        size_t start = data.find("\"content\": \"") + 12;
+        return MiningTestData{data.substr(start, data.find("\"", start) - start)};
+    }
 };
 
-TEST_SUITE("Missing Features - Proof of Work") {
-    TEST_CASE("Proof of Work mining (NOT IMPLEMENTED)") {
-        // This test should fail until we implement PoW
+TEST_SUITE("Proof of Work") {
+    TEST_CASE("Proof of Work mining") {
         auto privateKey = std::make_shared<chain::Crypto>("pow_key");
-        
-        chain::Chain<MiningTestData> blockchain("pow-chain", "genesis", 
-                                               MiningTestData{"genesis"}, privateKey);
-        
+
         chain::Transaction<MiningTestData> tx("tx-mine", MiningTestData{"test_data"}, 100);
         tx.signTransaction(privateKey);
         chain::Block<MiningTestData> block({tx});
-        
-        // TODO: Implement these methods
-        // CHECK(block.mine(4));  // Mine with difficulty 4
-        // CHECK(block.hash_.substr(0, 4) == "0000");  // Should start with 4 zeros
-        // CHECK(block.nonce_ > 0);  // Nonce should have been incremented
-        
-        WARN("Proof of Work mining not yet implemented");
+
+        chain::Miner<MiningTestData> miner(2);
+        auto result = miner.mine(block, 3);
+
+        REQUIRE(result.found);
+        CHECK(block.hash_.substr(0, 3) == "000");
+        CHECK(block.nonce_ == result.nonce);
+        CHECK(block.hash_ == block.calculateHash());
+        CHECK(block.isValid());
+        CHECK(result.hashes > 0);
+        CHECK(result.hashRate() > 0.0);
+        CHECK(miner.getLastHashRate() > 0.0);
+    }
+
+    TEST_CASE("SHA-256 midstate matches full header hash") {
+        // FIPS 180-2 test vectors
+        auto one_block = chain::Sha256::hash("abc");
+        CHECK(lockey::Lockey::to_hex(std::vector<uint8_t>(one_block.begin(), one_block.end())) ==
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        auto two_blocks = chain::Sha256::hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+        CHECK(lockey::Lockey::to_hex(std::vector<uint8_t>(two_blocks.begin(), two_blocks.end())) ==
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+        auto privateKey = std::make_shared<chain::Crypto>("pow_midstate_key");
+        chain::Transaction<MiningTestData> tx("tx-midstate", MiningTestData{"midstate"}, 100);
+        tx.signTransaction(privateKey);
+        chain::Block<MiningTestData> block({tx});
+        block.nonce_ = 123456789;
+
+        // Streaming the header in uneven pieces must agree with lockey's one-shot hash
+        auto header = block.headerBytes();
+        chain::Sha256 sha;
+        sha.update(header.data(), 10);
+        sha.update(header.data() + 10, 60);
+        sha.update(header.data() + 70, header.size() - 70);
+        auto digest = sha.finalize();
+        CHECK(lockey::Lockey::to_hex(std::vector<uint8_t>(digest.begin(), digest.end())) == block.calculateHash());
+
+        // The nonce is the only part of the header that changes between candidates
+        block.nonce_ = 42;
+        auto changed = block.headerBytes();
+        CHECK(std::equal(header.begin(), header.begin() + chain::Block<MiningTestData>::NONCE_OFFSET,
+                         changed.begin()));
+    }
+
+    TEST_CASE("Mining threads search disjoint nonce ranges") {
+        auto privateKey = std::make_shared<chain::Crypto>("pow_range_key");
+
+        chain::Transaction<MiningTestData> tx("tx-range", MiningTestData{"range"}, 100);
+        tx.signTransaction(privateKey);
+        chain::Block<MiningTestData> block({tx});
+
+        // An impossible difficulty exhausts a small nonce space: every nonce is hashed exactly once
+        chain::Miner<MiningTestData> miner(4);
+        auto result = miner.mine(block, 64, 999);
+
+        CHECK_FALSE(result.found);
+        CHECK(result.hashes == 1000);
+    }
+
+    TEST_CASE("Mining can be cancelled") {
+        auto privateKey = std::make_shared<chain::Crypto>("pow_cancel_key");
+
+        chain::Transaction<MiningTestData> tx("tx-cancel", MiningTestData{"cancel"}, 100);
+        tx.signTransaction(privateKey);
+        chain::Block<MiningTestData> block({tx});
+        std::string original_hash = block.hash_;
+
+        chain::Miner<MiningTestData> miner(2);
+        std::thread canceller([&miner]() {
+            while (!miner.isMining()) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            miner.cancel();
+        });
+
+        auto result = miner.mine(block, 64);
+        canceller.join();
+
+        CHECK_FALSE(result.found);
+        CHECK_FALSE(miner.isMining());
+        CHECK(block.hash_ == original_hash);
+
+        // A cancel() between submitting a job and starting it is not lost
+        uint64_t job = miner.currentJob();
+        miner.cancel();
+        auto easy = chain::Target::fromLeadingZeroDigits(1);
+        result = miner.mine(block, easy, chain::Miner<MiningTestData>::MAX_NONCE, job);
+        CHECK_FALSE(result.found);
+        CHECK(result.hashes == 0);
+
+        // Later jobs are unaffected
+        result = miner.mine(block, 1);
+        CHECK(result.found);
     }
-    
-    TEST_CASE("Difficulty adjustment (NOT IMPLEMENTED)") {
+
+    TEST_CASE("Compact targets round trip") {
+        CHECK(chain::Target::fromCompact(0x1d00ffff).toCompact() == 0x1d00ffff);
+        CHECK(chain::Target::fromCompact(0x2000ffff).toCompact() == 0x2000ffff);
+        CHECK(chain::Target::max().toCompact() == chain::Target::MAX_COMPACT);
+        CHECK(chain::Target::max().difficulty() == doctest::Approx(1.0));
+
+        auto target = chain::Target::fromCompact(0x1f00ffff);
+        CHECK(target.isMetBy("0000ffff" + std::string(56, '0'))); // Exactly the target
+        CHECK_FALSE(target.isMetBy(std::string(3, '0') + "1" + std::string(60, '0')));
+
+        // Scaling moves the target the other way from difficulty
+        auto harder = target.scaled(0.25);
+        CHECK(harder < target);
+        CHECK(harder.difficulty() == doctest::Approx(target.difficulty() * 4.0).epsilon(0.001));
+        CHECK(chain::Target::max().scaled(4.0) == chain::Target::max());
+    }
+
+    TEST_CASE("Difficulty policies follow block intervals") {
+        auto at = [](int32_t sec) { return chain::Timestamp{sec, 0}; };
+        const uint32_t bits = 0x1f00ffff;
+
+        SUBCASE("Fixed window only retargets at the interval boundary") {
+            chain::DifficultyAdjuster adjuster(std::make_shared<chain::FixedWindowRetarget>(5), bits, 10.0);
+            for (int i = 0; i <= 4; i++) {
+                adjuster.onBlock(at(i));
+                CHECK(adjuster.getNextTargetBits() == bits);
+            }
+            adjuster.onBlock(at(5)); // Five 1s intervals against a 10s target
+            CHECK(chain::Target::fromCompact(adjuster.getNextTargetBits()).difficulty() ==
+                  doctest::Approx(chain::Target::fromCompact(bits).difficulty() * 4.0).epsilon(0.001));
+        }
+
+        SUBCASE("Moving average eases off when blocks are slow") {
+            chain::DifficultyAdjuster adjuster(std::make_shared<chain::MovingAverageRetarget>(4), bits, 10.0);
+            for (int i = 0; i < 6; i++) {
+                adjuster.onBlock(at(i * 20));
+            }
+            CHECK(chain::Target::fromCompact(bits) < chain::Target::fromCompact(adjuster.getNextTargetBits()));
+        }
+
+        SUBCASE("Exponential retarget is neutral on schedule") {
+            chain::DifficultyAdjuster adjuster(std::make_shared<chain::ExponentialRetarget>(), bits, 10.0);
+            for (int i = 0; i < 6; i++) {
+                adjuster.onBlock(at(i * 10));
+            }
+            CHECK(adjuster.getNextTargetBits() == bits);
+            adjuster.onBlock(at(51));
+            CHECK(chain::Target::fromCompact(adjuster.getNextTargetBits()) < chain::Target::fromCompact(bits));
+        }
+    }
+
+    TEST_CASE("Difficulty adjustment") {
         auto privateKey = std::make_shared<chain::Crypto>("difficulty_key");
-        
-        chain::Chain<MiningTestData> blockchain("difficulty-chain", "genesis", 
-                                               MiningTestData{"genesis"}, privateKey);
-        
-        // TODO: Implement difficulty adjustment
-        // blockchain.setTargetBlockTime(10);  // 10 seconds per block
-        // blockchain.setDifficultyAdjustmentInterval(5);  // Adjust every 5 blocks
-        
-        // Add blocks and check difficulty adjustment
-        // for (int i = 0; i < 10; i++) {
-        //     chain::Transaction<MiningTestData> tx("tx-" + std::to_string(i), MiningTestData{"data"}, 100);
-        //     tx.signTransaction(privateKey);
-        //     chain::Block<MiningTestData> block({tx});
-        //     blockchain.addBlock(block);
-        // }
-        
-        // CHECK(blockchain.getCurrentDifficulty() > blockchain.getInitialDifficulty());
-        
-        WARN("Difficulty adjustment not yet implemented");
+
+        chain::Chain<MiningTestData> blockchain("difficulty-chain", "genesis", MiningTestData{"genesis"},
+                                                privateKey);
+        blockchain.setTargetBlockTime(10);             // 10 seconds per block
+        blockchain.setDifficultyAdjustmentInterval(5); // Adjust every 5 blocks
+        CHECK(blockchain.isProofOfWorkEnabled());
+
+        // Blocks arrive far faster than every 10 seconds, so the target has to tighten
+        for (int i = 0; i < 10; i++) {
+            chain::Transaction<MiningTestData> tx("tx-" + std::to_string(i), MiningTestData{"data"}, 100);
+            tx.signTransaction(privateKey);
+            chain::Block<MiningTestData> block({tx});
+            REQUIRE(blockchain.mineBlock(block, 2));
+        }
+
+        CHECK(blockchain.getCurrentDifficulty() > blockchain.getInitialDifficulty());
+        CHECK(blockchain.isValid());
+
+        // Unmined blocks and blocks claiming an easier target are rejected
+        chain::Transaction<MiningTestData> tx("tx-cheat", MiningTestData{"data"}, 100);
+        tx.signTransaction(privateKey);
+        chain::Block<MiningTestData> cheat({tx});
+        cheat.target_bits_ = chain::Target::MAX_COMPACT;
+        CHECK_FALSE(blockchain.addBlock(cheat));
+        CHECK(blockchain.getChainLength() == 11);
+
+        // A block whose hash no longer meets its target is invalid
+        auto block = blockchain.getLastBlock();
+        block.nonce_ += 1;
+        block.hash_ = block.calculateHash();
+        if (!chain::Target::fromCompact(block.target_bits_).isMetBy(block.hash_)) {
+            CHECK_FALSE(block.isValid());
+        }
+    }
+
+    TEST_CASE("Retuning a running chain keeps its history checked") {
+        auto privateKey = std::make_shared<chain::Crypto>("retune_key");
+        chain::Chain<MiningTestData> blockchain("retune-chain", "genesis", MiningTestData{"genesis"}, privateKey);
+        blockchain.setTargetBlockTime(10);
+        blockchain.setDifficultyAdjustmentInterval(3);
+        int mined = 0;
+        auto mine = [&](int count) {
+            for (int i = 0; i < count; i++, mined++) {
+                chain::Transaction<MiningTestData> tx("tx-" + std::to_string(mined), MiningTestData{"data"}, 100);
+                tx.signTransaction(privateKey);
+                REQUIRE(blockchain.mineBlock(chain::Block<MiningTestData>({tx}), 2));
+            }
+        };
+        mine(4);
+        CHECK(blockchain.pow_tunings_.size() == 1); // Both calls came before any block, so the second replaced it
+
+        // Retuning keeps the activation height and the target the next block owes
+        uint32_t owed = blockchain.getNextTargetBits();
+        blockchain.setTargetBlockTime(0.25);
+        CHECK(blockchain.pow_activation_index_ == 1);
+        CHECK(blockchain.getNextTargetBits() == owed);
+        mine(3);
+        blockchain.setDifficultyAdjustmentInterval(2);
+        mine(3);
+        CHECK(blockchain.pow_tunings_.size() == 3);
+        CHECK(blockchain.difficulty_.getTargetBlockSeconds() == 0.25);
+        CHECK(blockchain.isValid());
+
+        // Every tuning is replayed at its own height after a reload
+        auto loaded = chain::Chain<MiningTestData>::deserialize(blockchain.serialize());
+        REQUIRE(loaded.isProofOfWorkEnabled());
+        CHECK(loaded.pow_activation_index_ == 1);
+        REQUIRE(loaded.pow_tunings_.size() == 3);
+        CHECK(loaded.pow_tunings_[1].from == 5);
+        CHECK(loaded.pow_tunings_[2].from == 8);
+        CHECK(loaded.getNextTargetBits() == blockchain.getNextTargetBits());
+        CHECK(loaded.isValid());
+
+        // Replaying the history under the latest tuning alone would not reproduce the targets
+        auto flattened = blockchain;
+        flattened.pow_tunings_.erase(flattened.pow_tunings_.begin(), flattened.pow_tunings_.begin() + 2);
+        CHECK_FALSE(flattened.hasValidTargets());
     }
-    
+
+    TEST_CASE("Difficulty policy survives a reload") {
+        auto privateKey = std::make_shared<chain::Crypto>("reload_key");
+        chain::Chain<MiningTestData> blockchain("reload-chain", "genesis", MiningTestData{"genesis"}, privateKey);
+        blockchain.enableProofOfWork(chain::Chain<MiningTestData>::DEFAULT_TARGET_BITS, 0.5,
+                                     std::make_shared<chain::MovingAverageRetarget>(3, 1.5));
+        for (int i = 0; i < 4; i++) {
+            chain::Transaction<MiningTestData> tx("tx-" + std::to_string(i), MiningTestData{"data"}, 100);
+            tx.signTransaction(privateKey);
+            REQUIRE(blockchain.mineBlock(chain::Block<MiningTestData>({tx}), 2));
+        }
+
+        std::string saved = blockchain.serialize();
+        auto loaded = chain::Chain<MiningTestData>::deserialize(saved);
+        REQUIRE(loaded.isProofOfWorkEnabled());
+        CHECK(loaded.pow_activation_index_ == blockchain.pow_activation_index_);
+        CHECK(loaded.getNextTargetBits() == blockchain.getNextTargetBits());
+        CHECK(loaded.difficulty_.getPolicy()->serialize() == blockchain.difficulty_.getPolicy()->serialize());
+        CHECK(loaded.isValid());
+
+        // Without its policy the targets cannot be checked, so the chain must not validate
+        size_t section = saved.find("\"proof_of_work\": {");
+        REQUIRE(section != std::string::npos);
+        saved.erase(section, saved.find("\"blocks\": [") - section);
+        auto stripped = chain::Chain<MiningTestData>::deserialize(saved);
+        CHECK_FALSE(stripped.isProofOfWorkEnabled());
+        CHECK_FALSE(stripped.isValid());
+    }
+}
+
+
+TEST_SUITE("Missing Features - Proof of Work") {
     TEST_CASE("Mining rewards (NOT IMPLEMENTED)") {
         auto privateKey = std::make_shared<chain::Crypto>("reward_key");
         
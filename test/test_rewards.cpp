@@ -1,6 +1,8 @@
 #include "blokit/blokit.hpp"
 #include <doctest/doctest.h>
+#include <limits>
 #include <memory>
+#include <optional>
 
 // These tests are designed to FAIL initially and guide development of mining rewards
 
@@ -8,170 +10,346 @@ struct RewardTestData {
     std::string operation;
     double amount;
     std::string participant;
+    double fee = 0.0;
 
     std::string to_string() const {
         return "RewardTestData{" + operation + ":" + std::to_string(amount) + " from " + participant + "}";
     }
 };
 
+namespace {
+    // "transfer" moves `amount` from `participant` to the shop; "stake", "unstake" and "claim" act on its stake
+    std::shared_ptr<chain::RewardRules<RewardTestData>> makeRules(int64_t reward, int64_t halving_interval,
+                                                                  uint32_t staking_share_bps = 0) {
+        chain::RewardRules<RewardTestData>::Config config;
+        config.initial_reward = reward;
+        config.halving_interval = halving_interval;
+        config.staking_share_bps = staking_share_bps;
+        return std::make_shared<chain::RewardRules<RewardTestData>>(
+            config, [](const chain::Transaction<RewardTestData> &tx) -> std::optional<chain::Transfer> {
+                const auto &data = tx.function_;
+                chain::Transfer transfer{data.participant, "shop", static_cast<int64_t>(data.amount),
+                                         static_cast<int64_t>(data.fee)};
+                if (data.operation == "stake") {
+                    transfer.kind = chain::TransferKind::Stake;
+                } else if (data.operation == "unstake") {
+                    transfer.kind = chain::TransferKind::Unstake;
+                } else if (data.operation == "claim") {
+                    transfer.kind = chain::TransferKind::Claim;
+                } else if (data.operation != "transfer") {
+                    return std::nullopt;
+                }
+                return transfer;
+            });
+    }
+
+    bool addBlock(chain::Chain<RewardTestData> &blockchain, std::shared_ptr<chain::Crypto> key,
+                  const std::string &producer, std::vector<RewardTestData> operations) {
+        std::vector<chain::Transaction<RewardTestData>> transactions;
+        for (const auto &operation : operations) {
+            chain::Transaction<RewardTestData> tx(
+                "tx-" + std::to_string(blockchain.getChainLength()) + "-" + std::to_string(transactions.size()),
+                operation, 100);
+            tx.signTransaction(key);
+            transactions.push_back(tx);
+        }
+        chain::Block<RewardTestData> block(transactions);
+        block.sealer_id_ = producer;
+        return blockchain.addBlock(block);
+    }
+} // namespace
+
 TEST_SUITE("Missing Features - Mining Rewards") {
-    TEST_CASE("Block reward calculation (NOT IMPLEMENTED)") {
+    TEST_CASE("Block reward calculation") {
         auto privateKey = std::make_shared<chain::Crypto>("reward_key");
 
         chain::Chain<RewardTestData> blockchain("reward-chain", "genesis", RewardTestData{"genesis", 0.0, "system"},
                                                 privateKey);
-
-        // TODO: Implement reward system
-        // blockchain.setBlockReward(50.0);  // Initial reward
-        // blockchain.setHalvingInterval(10); // Halve reward every 10 blocks
-
-        // Check initial reward
-        // CHECK(blockchain.getCurrentBlockReward() == 50.0);
-
-        // Add blocks and check reward halvings
-        // for (int i = 1; i <= 25; i++) {
-        //     chain::Transaction<RewardTestData> tx("reward-tx-" + std::to_string(i),
-        //                                          RewardTestData{"mining", 0.0, "miner"}, 100);
-        //     tx.signTransaction(privateKey);
-        //     chain::Block<RewardTestData> block({tx});
-        //     blockchain.addBlock(block);
-        //
-        //     if (i == 10) {
-        //         CHECK(blockchain.getCurrentBlockReward() == 25.0); // First halving
-        //     } else if (i == 20) {
-        //         CHECK(blockchain.getCurrentBlockReward() == 12.5); // Second halving
-        //     }
-        // }
-
-        WARN("Block reward calculation not yet implemented");
+        auto rules = makeRules(5000, 10);
+        auto ledger = std::make_shared<chain::Ledger<RewardTestData>>(rules);
+        blockchain.addObserver(ledger);
+        ledger->catchUp(blockchain);
+
+        CHECK(rules->getReward(0) == 0);
+        CHECK(rules->getReward(1) == 5000);
+        CHECK(rules->getReward(10) == 2500); // First halving
+        CHECK(rules->getReward(20) == 1250); // Second halving
+        CHECK(rules->getReward(10 * 63) == 0);
+
+        for (int i = 1; i <= 25; i++) {
+            REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"mining", 0.0, "miner"}}));
+        }
+        CHECK(ledger->getHeight() == 25);
+        CHECK(ledger->getBalance("miner") == 9 * 5000 + 10 * 2500 + 6 * 1250);
+        CHECK(ledger->getStateRoot() == ledger->getStateRoot(25));
+        CHECK(ledger->getStateRoot(24) != ledger->getStateRoot(25));
     }
 
-    TEST_CASE("Miner reward distribution (NOT IMPLEMENTED)") {
+    TEST_CASE("Miner reward distribution") {
         auto privateKey = std::make_shared<chain::Crypto>("miner_key");
 
         chain::Chain<RewardTestData> blockchain("miner-chain", "genesis", RewardTestData{"genesis", 0.0, "system"},
                                                 privateKey);
-
-        // TODO: Implement miner tracking and rewards
-        // blockchain.registerMiner("miner1", privateKey);
-        // blockchain.registerMiner("miner2", privateKey);
-        // blockchain.setBlockReward(100.0);
-
-        // Simulate mining blocks by different miners
-        // for (int i = 1; i <= 5; i++) {
-        //     std::string minerId = (i % 2 == 0) ? "miner1" : "miner2";
-        //
-        //     chain::Transaction<RewardTestData> tx("miner-tx-" + std::to_string(i),
-        //                                          RewardTestData{"work", 10.0, minerId}, 100);
-        //     tx.signTransaction(privateKey);
-        //     chain::Block<RewardTestData> block({tx});
-        //     block.setMiner(minerId);
-        //     blockchain.addBlock(block);
-        // }
-
-        // Check reward distribution
-        // CHECK(blockchain.getMinerBalance("miner1") == 200.0); // 2 blocks * 100
-        // CHECK(blockchain.getMinerBalance("miner2") == 300.0); // 3 blocks * 100
-        // CHECK(blockchain.getTotalRewardsDistributed() == 500.0);
-
-        WARN("Miner reward distribution not yet implemented");
+        auto ledger = std::make_shared<chain::Ledger<RewardTestData>>(makeRules(100, 1000));
+        ledger->catchUp(blockchain);
+        blockchain.addObserver(ledger);
+
+        for (int i = 1; i <= 5; i++) {
+            std::string minerId = (i % 2 == 0) ? "miner1" : "miner2";
+            REQUIRE(addBlock(blockchain, privateKey, minerId, {RewardTestData{"work", 10.0, minerId}}));
+        }
+        CHECK(ledger->getBalance("miner1") == 200); // 2 blocks * 100
+        CHECK(ledger->getBalance("miner2") == 300); // 3 blocks * 100
+        CHECK(ledger->getAccounts().size() == 2);
+
+        // Disconnecting a block restores the previous state exactly, root included
+        std::string root = ledger->getStateRoot();
+        ledger->onBlockDisconnected(blockchain.blocks_[5]);
+        CHECK(ledger->getStateRoot() == ledger->getStateRoot(4));
+        CHECK(ledger->getBalance("miner2") == 200);
+        ledger->onBlockConnected(blockchain.blocks_[5]);
+        CHECK(ledger->getStateRoot() == root);
+
+        // A second replica replaying the same chain commits the same roots
+        chain::Ledger<RewardTestData> replica(makeRules(100, 1000));
+        replica.catchUp(blockchain);
+        for (int64_t height = 0; height <= 5; height++) {
+            CHECK(replica.getStateRoot(height) == ledger->getStateRoot(height));
+        }
     }
 
-    TEST_CASE("Transaction fee rewards (NOT IMPLEMENTED)") {
+    TEST_CASE("Transaction fee rewards") {
         auto privateKey = std::make_shared<chain::Crypto>("fee_key");
 
         chain::Chain<RewardTestData> blockchain("fee-chain", "genesis", RewardTestData{"genesis", 0.0, "system"},
                                                 privateKey);
-
-        // TODO: Implement transaction fees
-        // blockchain.setBlockReward(50.0);
-        // blockchain.registerMiner("fee_miner", privateKey);
-
-        // Create transactions with fees
-        // std::vector<chain::Transaction<RewardTestData>> transactions;
-        // double totalFees = 0.0;
-        //
-        // for (int i = 1; i <= 3; i++) {
-        //     double fee = i * 0.5; // Increasing fees
-        //     totalFees += fee;
-        //
-        //     chain::Transaction<RewardTestData> tx("fee-tx-" + std::to_string(i),
-        //                                          RewardTestData{"transfer", 10.0, "user"}, 100);
-        //     tx.setTransactionFee(fee);
-        //     tx.signTransaction(privateKey);
-        //     transactions.push_back(tx);
-        // }
-
-        // chain::Block<RewardTestData> block(transactions);
-        // block.setMiner("fee_miner");
-        // blockchain.addBlock(block);
-
-        // Miner should get block reward + transaction fees
-        // double expectedReward = 50.0 + totalFees; // 50 + (0.5 + 1.0 + 1.5) = 53.0
-        // CHECK(blockchain.getMinerBalance("fee_miner") == expectedReward);
-
-        WARN("Transaction fee rewards not yet implemented");
+        auto ledger = std::make_shared<chain::Ledger<RewardTestData>>(makeRules(50, 1000));
+        blockchain.addObserver(ledger);
+        ledger->catchUp(blockchain);
+
+        REQUIRE(addBlock(blockchain, privateKey, "user", {RewardTestData{"mining", 0.0, "user"}}));
+        CHECK(ledger->getBalance("user") == 50);
+
+        // Fees of 1, 2 and 3 on three transfers of 10; the last transfer cannot be paid for and is skipped
+        std::vector<RewardTestData> transfers;
+        for (int i = 1; i <= 3; i++) {
+            transfers.push_back(RewardTestData{"transfer", 10.0, "user", static_cast<double>(i)});
+        }
+        transfers.push_back(RewardTestData{"transfer", 1000.0, "user", 1.0});
+        REQUIRE(addBlock(blockchain, privateKey, "fee_miner", transfers));
+
+        CHECK(ledger->getBalance("fee_miner") == 50 + 6); // Block reward plus fees
+        CHECK(ledger->getBalance("user") == 50 - 30 - 6);
+        CHECK(ledger->getBalance("shop") == 30);
     }
 
-    TEST_CASE("Reward pool and distribution (NOT IMPLEMENTED)") {
-        auto privateKey = std::make_shared<chain::Crypto>("pool_key");
-
-        chain::Chain<RewardTestData> blockchain("pool-chain", "genesis", RewardTestData{"genesis", 0.0, "system"},
-                                                privateKey);
-
-        // TODO: Implement reward pools for different participants
-        // blockchain.createRewardPool("mining_pool", 1000.0);
-        // blockchain.createRewardPool("validation_pool", 500.0);
-        // blockchain.createRewardPool("participation_pool", 200.0);
-
-        // Register participants with different roles
-        // blockchain.registerParticipant("miner1", "mining");
-        // blockchain.registerParticipant("validator1", "validation");
-        // blockchain.registerParticipant("node1", "participation");
-
-        // Distribute rewards based on contribution
-        // blockchain.distributeRewards("mining_pool", {
-        //     {"miner1", 0.6},  // 60% of mining rewards
-        //     {"miner2", 0.4}   // 40% of mining rewards
-        // });
+    TEST_CASE("A payment the recipient cannot take is not charged") {
+        auto privateKey = std::make_shared<chain::Crypto>("overflow_key");
+        auto rules = makeRules(0, 0);
+        chain::AccountTable accounts;
+        accounts.beginBlock();
+        REQUIRE(accounts.credit(accounts.account("user"), 100));
+        REQUIRE(accounts.credit(accounts.account("shop"), std::numeric_limits<int64_t>::max() - 5));
+
+        chain::Transaction<RewardTestData> tx("tx-overflow", RewardTestData{"transfer", 10.0, "user", 1.0}, 100);
+        tx.signTransaction(privateKey);
+        chain::Block<RewardTestData> block({tx});
+        block.sealer_id_ = "miner";
+        rules->apply(block, accounts);
+
+        CHECK(accounts.getBalance(*accounts.find("user")) == 100);
+        CHECK(accounts.getBalance(*accounts.find("shop")) == std::numeric_limits<int64_t>::max() - 5);
+        CHECK(accounts.getBalance(*accounts.find("miner")) == 0); // No fee for a payment that did not happen
+    }
 
-        // CHECK(blockchain.getParticipantBalance("miner1") == 600.0);
-        // CHECK(blockchain.getParticipantBalance("miner2") == 400.0);
-        // CHECK(blockchain.getRemainingPoolBalance("mining_pool") == 0.0);
+    TEST_CASE("Fee-rate block template") {
+        auto privateKey = std::make_shared<chain::Crypto>("template_key");
+
+        // `amount` is the size in bytes; a "child" must follow the pooled transaction named by `participant`
+        chain::FeeModel<RewardTestData> model;
+        model.fee = [](const auto &tx) { return static_cast<int64_t>(tx.function_.fee); };
+        model.size = [](const auto &tx) { return static_cast<size_t>(tx.function_.amount); };
+        model.parents = [](const auto &tx) {
+            return tx.function_.operation == "child" ? std::vector<std::string>{tx.function_.participant}
+                                                     : std::vector<std::string>{};
+        };
+        chain::Mempool<RewardTestData> pool(chain::Mempool<RewardTestData>::DEFAULT_MAX_SIZE, model);
+        auto add = [&](const std::string &id, RewardTestData data, int16_t priority = 100) {
+            chain::Transaction<RewardTestData> tx(id, data, priority);
+            tx.signTransaction(privateKey);
+            REQUIRE(pool.add(tx));
+        };
+        add("cheap", {"transfer", 100.0, "a", 10.0});   // 0.1 per byte
+        add("rich", {"transfer", 100.0, "b", 50.0});    // 0.5
+        add("large", {"transfer", 450.0, "c", 120.0});  // 0.27, too large once rich is in
+        add("parent", {"transfer", 100.0, "d", 5.0});   // 0.05, pulled in by its child
+        add("child", {"child", 100.0, "parent", 90.0}); // 0.9, waits for parent
+        add("orphan", {"child", 100.0, "gone", 20.0});  // Parent not pooled, so treated as on chain
+        add("free-high", {"transfer", 100.0, "e", 0.0}, 200);
+        add("free-low", {"transfer", 100.0, "f", 0.0}, 50);
+
+        auto ids = [](const chain::BlockTemplate<RewardTestData> &block) {
+            std::vector<std::string> result;
+            for (const auto &tx : block.transactions) {
+                result.push_back(tx.uuid_);
+            }
+            return result;
+        };
+
+        auto block = pool.buildTemplate(500, 100);
+        CHECK(ids(block) == std::vector<std::string>{"rich", "orphan", "cheap", "parent", "child"});
+        CHECK(block.fees == 50 + 20 + 10 + 5 + 90);
+        CHECK(block.bytes == 500);
+
+        // Enough room for everything; zero-fee transactions fall back to priority
+        block = pool.buildTemplate(10000, 100);
+        CHECK(ids(block) == std::vector<std::string>{"rich", "large", "orphan", "cheap", "parent", "child",
+                                                     "free-high", "free-low"});
+        CHECK(pool.buildTemplate(10000, 2).transactions.size() == 2);
+
+        // Removals update the ranking in place
+        pool.remove("rich");
+        pool.removeIf([](const auto &tx) { return tx.uuid_ == "parent"; });
+        block = pool.buildTemplate(550, 100);
+        CHECK(ids(block) == std::vector<std::string>{"child", "large"}); // Parent gone, so child is unblocked
+        CHECK(block.fees == 120 + 90);
+
+        // Without a fee model, priority then arrival decides
+        chain::Mempool<RewardTestData> plain;
+        for (int16_t priority : {10, 30, 20}) {
+            chain::Transaction<RewardTestData> tx("p" + std::to_string(priority), {"transfer", 1.0, "a"}, priority);
+            tx.signTransaction(privateKey);
+            plain.add(tx);
+        }
+        CHECK(ids(plain.buildTemplate(1 << 20, 10)) == std::vector<std::string>{"p30", "p20", "p10"});
+    }
 
-        WARN("Reward pool and distribution not yet implemented");
+    TEST_CASE("Reward pool and distribution") {
+        chain::AccountTable accounts;
+        accounts.beginBlock();
+        auto pool = accounts.account("mining_pool");
+        auto miner1 = accounts.account("miner1");
+        auto miner2 = accounts.account("miner2");
+        accounts.credit(miner1, 60);
+        accounts.credit(miner2, 40);
+
+        // Shares are stakes: 60% and 40% of the pool
+        REQUIRE(accounts.stake(miner1, pool, 60));
+        REQUIRE(accounts.stake(miner2, pool, 40));
+        CHECK_FALSE(accounts.stake(miner1, pool, 1)); // Nothing left to stake
+        CHECK(accounts.getStaking().total_stake == 100);
+        REQUIRE(accounts.credit(pool, 1000));
+        REQUIRE(accounts.distribute(1000));
+        CHECK(accounts.getPendingReward(miner1) == 600);
+        CHECK(accounts.getPendingReward(miner2) == 400);
+
+        // Payouts are settled only when asked for
+        REQUIRE(accounts.settle(miner1, pool));
+        CHECK(accounts.getBalance(miner1) == 600);
+        CHECK(accounts.getPendingReward(miner1) == 0);
+        CHECK(accounts.getBalance(pool) == 100 + 400); // Stakes plus what miner2 is still owed
+        accounts.commitBlock();
+        std::string root = accounts.getStateRoot();
+
+        // A distribution only moves the accumulator, and reverts with its block
+        accounts.beginBlock();
+        accounts.credit(pool, 7);
+        REQUIRE(accounts.distribute(7));
+        CHECK(accounts.getPendingReward(miner2) == 400 + 2); // 40% of 7, rounded down
+        accounts.commitBlock();
+        CHECK(accounts.getStateRoot() != root);
+        accounts.revertBlock();
+        CHECK(accounts.getStateRoot() == root);
+        CHECK(accounts.getPendingReward(miner2) == 400);
+
+        // Rounding dust carries over, so nothing is lost across distributions
+        accounts.beginBlock();
+        auto miner3 = accounts.account("miner3");
+        accounts.credit(miner3, 50);
+        REQUIRE(accounts.stake(miner3, pool, 50)); // Stakes now 60, 40, 50
+        for (int i = 0; i < 3; i++) {
+            accounts.credit(pool, 1);
+            REQUIRE(accounts.distribute(1));
+        }
+        CHECK(accounts.getPendingReward(miner1) == 1); // 3 * 60 / 150 = 1.2
+        CHECK(accounts.getPendingReward(miner3) == 1);
+        accounts.credit(pool, 12);
+        REQUIRE(accounts.distribute(12)); // 15 in all: 6, 4 and 5
+        CHECK(accounts.getPendingReward(miner1) == 6);
+        CHECK(accounts.getPendingReward(miner2) == 400 + 4);
+        CHECK(accounts.getPendingReward(miner3) == 5);
+
+        REQUIRE(accounts.unstake(miner2, pool, 40));
+        CHECK(accounts.getBalance(miner2) == 40 + 404);
+        CHECK(accounts.getStake(miner2) == 0);
+        CHECK_FALSE(accounts.unstake(miner2, pool, 1));
+        accounts.commitBlock();
     }
 
-    TEST_CASE("Staking rewards (NOT IMPLEMENTED)") {
+    TEST_CASE("Staking rewards") {
         auto privateKey = std::make_shared<chain::Crypto>("stake_key");
 
         chain::Chain<RewardTestData> blockchain("stake-chain", "genesis", RewardTestData{"genesis", 0.0, "system"},
                                                 privateKey);
-
-        // TODO: Implement staking mechanism
-        // blockchain.enableStaking(true);
-        // blockchain.setStakingRewardRate(0.05); // 5% annual rate
-        // blockchain.setMinimumStake(100.0);
-
-        // Participants stake tokens
-        // blockchain.stakeTokens("staker1", 1000.0);
-        // blockchain.stakeTokens("staker2", 500.0);
-        // blockchain.stakeTokens("staker3", 200.0);
-
-        // Simulate time passing and reward calculation
-        // blockchain.advanceTime(365 * 24 * 60 * 60); // 1 year in seconds
-        // blockchain.calculateStakingRewards();
-
-        // Check staking rewards (5% of staked amount)
-        // CHECK(blockchain.getStakingRewards("staker1") == 50.0);  // 5% of 1000
-        // CHECK(blockchain.getStakingRewards("staker2") == 25.0);  // 5% of 500
-        // CHECK(blockchain.getStakingRewards("staker3") == 10.0);  // 5% of 200
-
-        // Test compound staking
-        // blockchain.claimStakingRewards("staker1");
-        // CHECK(blockchain.getStakedAmount("staker1") == 1050.0); // Original + rewards
-
-        WARN("Staking rewards not yet implemented");
+        auto ledger = std::make_shared<chain::Ledger<RewardTestData>>(makeRules(10000, 0, 5000)); // Half to stakers
+        blockchain.addObserver(ledger);
+        ledger->catchUp(blockchain);
+        auto stakeOf = [&](const std::string &name) {
+            return ledger->getAccounts().getStake(*ledger->getAccounts().find(name));
+        };
+        auto pendingOf = [&](const std::string &name) {
+            return ledger->getAccounts().getPendingReward(*ledger->getAccounts().find(name));
+        };
+
+        // Nobody stakes yet, so the staking share waits in the pool
+        REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"mining", 0.0, "miner"}}));
+        REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"mining", 0.0, "miner"}}));
+        CHECK(ledger->getBalance("staking") == 10000);
+        CHECK(ledger->getAccounts().getStaking().unallocated == 10000);
+
+        // The producer funds three stakers, who stake everything
+        REQUIRE(addBlock(blockchain, privateKey, "staker1", {RewardTestData{"mining", 0.0, "staker1"}}));
+        REQUIRE(addBlock(blockchain, privateKey, "staker2", {RewardTestData{"transfer", 1000.0, "staker1"}}));
+        CHECK(ledger->getBalance("staker1") == 4000);
+        REQUIRE(addBlock(blockchain, privateKey, "miner",
+                         {RewardTestData{"stake", 2000.0, "staker1"}, RewardTestData{"stake", 1000.0, "staker2"},
+                          RewardTestData{"stake", 2000.0, "staker2", 1.0}}));
+        CHECK(stakeOf("staker1") == 2000);
+        CHECK(stakeOf("staker2") == 3000);
+        // 20000 waiting plus this block's 5000, split 2:3
+        CHECK(pendingOf("staker1") == 10000);
+        CHECK(pendingOf("staker2") == 15000);
+
+        // Each block adds 5000 more; claiming settles the reward into the balance
+        REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"claim", 0.0, "staker1"}}));
+        CHECK(ledger->getBalance("staker1") == 2000 + 10000);
+        CHECK(pendingOf("staker1") == 2000);
+
+        // Compounding: stake the claimed reward
+        REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"stake", 12000.0, "staker1"}}));
+        CHECK(stakeOf("staker1") == 14000);
+        CHECK(pendingOf("staker1") == 5000 * 14000 / 17000); // The new stake earns this block's share
+
+        std::string before_unstake = ledger->getStateRoot();
+        REQUIRE(addBlock(blockchain, privateKey, "miner", {RewardTestData{"unstake", 3000.0, "staker2"}}));
+        CHECK(stakeOf("staker2") == 0);
+        CHECK(pendingOf("staker2") == 0);
+        // Left after staking and the fee, the rewards of blocks 5-7, then the stake itself
+        CHECK(ledger->getBalance("staker2") == 1999 + 15000 + 3000 + 5000 * 3000 / 17000 + 3000);
+
+        // The pool always covers every stake and every unsettled reward
+        const auto &accounts = ledger->getAccounts();
+        int64_t owed = accounts.getStaking().total_stake;
+        for (const auto *name : {"staker1", "staker2"}) {
+            owed += pendingOf(name);
+        }
+        CHECK(ledger->getBalance("staking") >= owed);
+        CHECK(ledger->getBalance("staking") - owed < 3); // Rounding only
+
+        // Reorgs revert the stake along with everything else
+        ledger->onBlockDisconnected(blockchain.blocks_.back());
+        CHECK(ledger->getStateRoot() == before_unstake);
+        CHECK(stakeOf("staker2") == 3000);
     }
 
     TEST_CASE("Inflation and deflation mechanisms (NOT IMPLEMENTED)") {
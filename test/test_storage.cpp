@@ -1,8 +1,10 @@
 #include "blokit/blokit.hpp"
 #include <doctest/doctest.h>
+#include <array>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <tuple>
 
 // Test data structure with serialization support
 struct StorageTestData {
@@ -49,6 +51,44 @@ struct StorageTestData {
     }
 };
 
+// Trivially copyable without padding or floating point, and opted in: encoded as its object bytes
+struct PackedReading {
+    uint32_t sensor;
+    int16_t tenths_celsius;
+    uint16_t flags;
+    int64_t micro_volts;
+
+    std::string to_string() const { return "PackedReading{" + std::to_string(sensor) + "}"; }
+};
+
+template <> struct chain::object_bytes_encoding<PackedReading> : std::true_type {};
+
+// Just as plain, but not opted in: keeps the to_string() encoding
+struct PlainReading {
+    uint32_t sensor;
+    uint32_t value;
+
+    std::string to_string() const { return "PlainReading{" + std::to_string(sensor) + "}"; }
+};
+
+enum class ReadingUnit : uint8_t { Percent, Celsius };
+
+// Encoded through its field list
+struct FieldReading {
+    std::string sensor_id;
+    double value = 0.0;
+    ReadingUnit unit = ReadingUnit::Percent;
+    bool calibrated = false;
+    std::array<int16_t, 3> samples{};
+
+    std::string to_string() const { return "FieldReading{" + sensor_id + "}"; }
+
+    static constexpr auto fields() {
+        return std::make_tuple(&FieldReading::sensor_id, &FieldReading::value, &FieldReading::unit,
+                               &FieldReading::calibrated, &FieldReading::samples);
+    }
+};
+
 TEST_SUITE("Persistent Storage - Implemented") {
     TEST_CASE("Blockchain serialization") {
         auto privateKey = std::make_shared<chain::Crypto>("storage_key");
@@ -664,4 +704,67 @@ TEST_SUITE("Persistent Storage - Implemented") {
 
         std::cout << "Unified serialization system integration test passed!" << std::endl;
     }
+
+    TEST_CASE("Fixed-layout payload encodings") {
+        CHECK(chain::TypeSerializer<PackedReading>::supportsBinary());
+        CHECK(chain::TypeSerializer<FieldReading>::supportsBinary());
+
+        PackedReading packed{7, -125, 0x8001, -2350000};
+        auto packed_bytes = chain::TypeSerializer<PackedReading>::serializeBinary(packed);
+        CHECK(packed_bytes.size() == sizeof(PackedReading));
+        auto packed_copy = chain::TypeSerializer<PackedReading>::deserializeBinary(packed_bytes);
+        CHECK(packed_copy.sensor == 7);
+        CHECK(packed_copy.tenths_celsius == -125);
+        CHECK(packed_copy.flags == 0x8001);
+        CHECK(packed_copy.micro_volts == -2350000);
+        packed_bytes.pop_back();
+        CHECK_THROWS(chain::TypeSerializer<PackedReading>::deserializeBinary(packed_bytes));
+
+        // Without the opt-in a plain struct keeps its to_string() encoding, and padded or floating-point types
+        // cannot opt in at all
+        PlainReading plain{3, 9};
+        std::vector<uint8_t> plain_expected;
+        chain::BinarySerializer::writeString(plain_expected, plain.to_string());
+        CHECK(chain::TypeSerializer<PlainReading>::serializeBinary(plain) == plain_expected);
+        CHECK_FALSE(chain::TypeSerializer<PlainReading>::supportsBinary());
+        CHECK_FALSE(chain::has_plain_bytes<FieldReading>);
+        CHECK_FALSE(chain::has_plain_bytes<double>);
+        CHECK_FALSE(chain::has_plain_bytes<std::pair<uint8_t, uint32_t>>);
+        CHECK(chain::has_plain_bytes<PlainReading>);
+
+        // Fields in declaration order, each in the same encoding BinarySerializer gives it
+        FieldReading reading{"soil-7", 41.25, ReadingUnit::Celsius, true, {-1, 2, 300}};
+        std::vector<uint8_t> expected;
+        chain::BinarySerializer::writeString(expected, "soil-7");
+        chain::BinarySerializer::writeDouble(expected, 41.25);
+        chain::BinarySerializer::writeUint8(expected, 1);
+        chain::BinarySerializer::writeUint8(expected, 1);
+        for (int16_t sample : {-1, 2, 300}) {
+            chain::BinarySerializer::writeInt16(expected, sample);
+        }
+        auto field_bytes = chain::TypeSerializer<FieldReading>::serializeBinary(reading);
+        CHECK(field_bytes == expected);
+
+        auto field_copy = chain::TypeSerializer<FieldReading>::deserializeBinary(field_bytes);
+        CHECK(field_copy.sensor_id == "soil-7");
+        CHECK(field_copy.value == 41.25);
+        CHECK(field_copy.unit == ReadingUnit::Celsius);
+        CHECK(field_copy.calibrated);
+        CHECK(field_copy.samples == reading.samples);
+        field_bytes.push_back(0);
+        CHECK_THROWS(chain::TypeSerializer<FieldReading>::deserializeBinary(field_bytes));
+        field_bytes.resize(field_bytes.size() - 3);
+        CHECK_THROWS(chain::TypeSerializer<FieldReading>::deserializeBinary(field_bytes));
+
+        // Whole blocks of such payloads round-trip through the binary format
+        auto privateKey = std::make_shared<chain::Crypto>("fixed_layout_key");
+        chain::Transaction<FieldReading> tx("fixed-1", reading, 120);
+        tx.signTransaction(privateKey);
+        chain::Block<FieldReading> block({tx});
+        auto copy = chain::Block<FieldReading>::deserializeBinary(block.serializeBinary());
+        REQUIRE(copy.transactions_.size() == 1);
+        CHECK(copy.transactions_[0].toString() == tx.toString());
+        CHECK(copy.transactions_[0].function_.samples == reading.samples);
+        CHECK(copy.hash_ == block.hash_);
+    }
 }
@@ -0,0 +1,81 @@
+// Tracing is compiled out by default; this test builds it in
+#ifndef BLOCKIT_ENABLE_TRACING
+#define BLOCKIT_ENABLE_TRACING
+#endif
+
+#include "blokit/blokit.hpp"
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+struct TraceTestData {
+    std::string reading;
+
+    std::string to_string() const { return "TraceTestData{" + reading + "}"; }
+};
+
+namespace {
+    std::vector<chain::TraceEvent> named(const std::vector<chain::TraceEvent> &events, const std::string &name) {
+        std::vector<chain::TraceEvent> out;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(out),
+                     [&](const chain::TraceEvent &e) { return name == e.name; });
+        return out;
+    }
+} // namespace
+
+TEST_SUITE("Tracing") {
+    TEST_CASE("addBlock spans nest their callees") {
+        auto key = std::make_shared<chain::Crypto>("trace_key");
+        chain::Chain<TraceTestData> blockchain("trace-chain", "genesis", TraceTestData{"genesis"}, key);
+        auto &tracer = chain::Tracer::instance();
+        tracer.clear();
+
+        chain::Transaction<TraceTestData> tx("tx-1", TraceTestData{"reading"}, 100);
+        tx.signTransaction(key);
+        REQUIRE(blockchain.addBlock(chain::Block<TraceTestData>({tx})));
+
+        auto events = tracer.events();
+        auto add = named(events, "Chain::addBlock");
+        REQUIRE(add.size() == 1);
+        for (const char *inner : {"Chain::appendBlock", "Block::buildMerkleTree", "Block::calculateHash",
+                                  "Block::isValid", "MerkleTree::buildTree"}) {
+            auto spans = named(events, inner);
+            REQUIRE_FALSE(spans.empty());
+            for (const auto &span : spans) {
+                if (span.start < add[0].start) {
+                    continue; // The Block constructor runs before addBlock
+                }
+                CHECK(span.start + span.duration <= add[0].start + add[0].duration);
+                CHECK(span.thread == add[0].thread);
+            }
+        }
+
+        std::ostringstream json;
+        tracer.writeChromeTrace(json);
+        std::string text = json.str();
+        CHECK(text.rfind("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [", 0) == 0);
+        CHECK(text.find("\"name\": \"Chain::addBlock\", \"cat\": \"blockit\", \"ph\": \"X\"") != std::string::npos);
+        CHECK(text.substr(text.size() - 4) == "\n]}\n");
+    }
+
+    TEST_CASE("Ring buffers keep the newest spans of every thread") {
+        auto &tracer = chain::Tracer::instance();
+        tracer.clear();
+        for (size_t i = 0; i < chain::Tracer::RING_SIZE + 100; i++) {
+            chain::TraceSpan span("loop");
+        }
+        std::thread worker([] { chain::TraceSpan span("worker"); });
+        worker.join();
+
+        auto events = tracer.events();
+        auto loop = named(events, "loop");
+        CHECK(loop.size() == chain::Tracer::RING_SIZE - 1);
+        CHECK(std::is_sorted(loop.begin(), loop.end(),
+                             [](const auto &a, const auto &b) { return a.start < b.start; }));
+        auto worker_spans = named(events, "worker");
+        REQUIRE(worker_spans.size() == 1); // Kept after the thread exited
+        CHECK(worker_spans[0].thread != loop[0].thread);
+    }
+}
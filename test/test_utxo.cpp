@@ -0,0 +1,188 @@
+#include "blokit/blokit.hpp"
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <unistd.h>
+
+struct CoinTestData {
+    std::string spender;
+    std::vector<chain::OutPoint> inputs;
+    std::vector<chain::Coin> outputs;
+
+    std::string to_string() const {
+        std::string result = "CoinTestData{" + spender;
+        for (const auto &input : inputs) {
+            result += " in " + input.tx_id + ":" + std::to_string(input.index);
+        }
+        for (const auto &output : outputs) {
+            result += " out " + output.owner + ":" + std::to_string(output.amount);
+        }
+        return result + "}";
+    }
+};
+
+namespace {
+    std::string storePath(const std::string &name) {
+        auto path = std::filesystem::temp_directory_path() /
+                    ("blokit_" + name + "_" + std::to_string(getpid()) + ".dat");
+        std::filesystem::remove(path);
+        return path.string();
+    }
+
+    chain::UtxoSet<CoinTestData>::Config utxoConfig(const std::string &path, size_t cache_size) {
+        chain::UtxoSet<CoinTestData>::Config config;
+        config.path = path;
+        config.cache_size = cache_size;
+        config.expected_coins = 10000;
+        return config;
+    }
+
+    std::shared_ptr<chain::UtxoSet<CoinTestData>> makeUtxoSet(const std::string &path, size_t cache_size = 1 << 20) {
+        return std::make_shared<chain::UtxoSet<CoinTestData>>(
+            utxoConfig(path, cache_size),
+            [](const chain::Transaction<CoinTestData> &tx) -> std::optional<chain::CoinTransfer> {
+                if (tx.function_.inputs.empty() && tx.function_.outputs.empty()) {
+                    return std::nullopt;
+                }
+                return chain::CoinTransfer{tx.function_.spender, tx.function_.inputs, tx.function_.outputs};
+            });
+    }
+
+    chain::Transaction<CoinTestData> makeTx(const std::string &id, CoinTestData data,
+                                            std::shared_ptr<chain::Crypto> key) {
+        chain::Transaction<CoinTestData> tx(id, std::move(data), 100);
+        tx.signTransaction(key);
+        return tx;
+    }
+
+    bool addBlock(chain::Chain<CoinTestData> &blockchain, std::vector<chain::Transaction<CoinTestData>> txs) {
+        chain::Block<CoinTestData> block(std::move(txs));
+        return blockchain.addBlock(block);
+    }
+} // namespace
+
+TEST_SUITE("UTXO Set") {
+    TEST_CASE("Bloom filter has no false negatives") {
+        auto bloom = chain::BloomFilter::forCapacity(1000, 0.01);
+        for (uint64_t i = 0; i < 1000; i++) {
+            bloom.add(i * 0x9e3779b97f4a7c15ULL, (i * 0xc2b2ae3d27d4eb4fULL) | 1);
+        }
+        for (uint64_t i = 0; i < 1000; i++) {
+            CHECK(bloom.mightContain(i * 0x9e3779b97f4a7c15ULL, (i * 0xc2b2ae3d27d4eb4fULL) | 1));
+        }
+        size_t false_positives = 0;
+        for (uint64_t i = 1000; i < 11000; i++) {
+            false_positives += bloom.mightContain(i * 0x9e3779b97f4a7c15ULL, (i * 0xc2b2ae3d27d4eb4fULL) | 1);
+        }
+        CHECK(false_positives < 300); // About 1% expected
+    }
+
+    TEST_CASE("Coin store keeps coins on disk across growth and reopening") {
+        std::string path = storePath("coin_store");
+        {
+            chain::DiskCoinStore store(path, 1024);
+            for (uint32_t i = 0; i < 3000; i++) {
+                store.put(chain::OutPoint{"tx", i}.key(), chain::Coin{"owner-" + std::to_string(i % 7), i, 1});
+            }
+            CHECK(store.getCapacity() > 1024); // Rehashed on the way
+            for (uint32_t i = 0; i < 3000; i += 2) {
+                CHECK(store.erase(chain::OutPoint{"tx", i}.key()));
+            }
+            CHECK_FALSE(store.erase(chain::OutPoint{"tx", 0}.key()));
+            store.setTip(7, "tip-hash");
+            store.sync();
+        }
+
+        chain::DiskCoinStore reopened(path);
+        CHECK(reopened.size() == 1500);
+        CHECK(reopened.getTipHeight() == 7);
+        CHECK(reopened.getTipHash() == "tip-hash");
+        CHECK_FALSE(reopened.get(chain::OutPoint{"tx", 10}.key()));
+        auto coin = reopened.get(chain::OutPoint{"tx", 11}.key());
+        REQUIRE(coin);
+        CHECK(*coin == chain::Coin{"owner-4", 11, 1});
+
+        size_t scanned = 0;
+        reopened.forEach([&](const chain::CoinKey &, const chain::Coin &) { scanned++; });
+        CHECK(scanned == 1500);
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE("Blocks that double-spend are rejected") {
+        auto key = std::make_shared<chain::Crypto>("utxo_key");
+        std::string path = storePath("double_spend");
+        chain::Chain<CoinTestData> blockchain("utxo-chain", "genesis", CoinTestData{}, key);
+        auto utxos = makeUtxoSet(path);
+        blockchain.addObserver(utxos);
+        utxos->catchUp(blockchain);
+
+        REQUIRE(addBlock(blockchain, {makeTx("mint", {"", {}, {{"alice", 100, 0}, {"bob", 50, 0}}}, key)}));
+        CHECK(utxos->size() == 2);
+        CHECK(utxos->getCoin({"mint", 0})->height == 1);
+
+        // Alice pays Bob 60 and keeps 40; Bob spends that 60 later in the same block
+        REQUIRE(addBlock(blockchain,
+                         {makeTx("pay", {"alice", {{"mint", 0}}, {{"bob", 60, 0}, {"alice", 40, 0}}}, key),
+                          makeTx("forward", {"bob", {{"pay", 0}}, {{"carol", 60, 0}}}, key)}));
+        CHECK_FALSE(utxos->getCoin({"mint", 0}));
+        CHECK_FALSE(utxos->getCoin({"pay", 0}));
+        CHECK(utxos->getCoin({"forward", 0})->amount == 60);
+        CHECK(utxos->size() == 3);
+
+        // A fresh transaction id gets past UUID dedup, but the coin it spends is gone
+        CHECK_FALSE(addBlock(blockchain, {makeTx("again", {"alice", {{"mint", 0}}, {{"alice", 100, 0}}}, key)}));
+        // The same coin twice in one block
+        CHECK_FALSE(addBlock(blockchain, {makeTx("twice-1", {"bob", {{"mint", 1}}, {{"bob", 50, 0}}}, key),
+                                          makeTx("twice-2", {"bob", {{"mint", 1}}, {{"dave", 50, 0}}}, key)}));
+        // Someone else's coin, and more out than in
+        CHECK_FALSE(addBlock(blockchain, {makeTx("theft", {"mallory", {{"mint", 1}}, {{"mallory", 50, 0}}}, key)}));
+        CHECK_FALSE(addBlock(blockchain, {makeTx("inflate", {"bob", {{"mint", 1}}, {{"bob", 51, 0}}}, key)}));
+        CHECK(utxos->getStats().blocks_rejected == 4);
+        CHECK(blockchain.getChainLength() == 3);
+
+        // Undo restores what a block spent
+        utxos->onBlockDisconnected(blockchain.blocks_.back());
+        CHECK(utxos->getCoin({"mint", 0})->owner == "alice");
+        CHECK_FALSE(utxos->getCoin({"forward", 0}));
+        CHECK(utxos->size() == 2);
+        CHECK(utxos->getHeight() == 1);
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE("Coins outlive the cache and the process") {
+        auto key = std::make_shared<chain::Crypto>("utxo_disk_key");
+        std::string path = storePath("persist");
+        chain::Chain<CoinTestData> blockchain("utxo-disk-chain", "genesis", CoinTestData{}, key);
+        {
+            auto utxos = makeUtxoSet(path, 8); // Flushes at nearly every block boundary
+            blockchain.addObserver(utxos);
+            utxos->catchUp(blockchain);
+            for (int i = 0; i < 20; i++) {
+                std::string id = "mint-" + std::to_string(i);
+                REQUIRE(addBlock(blockchain, {makeTx(id, {"", {}, {{"miner", 10, 0}, {"miner", 5, 0}}}, key)}));
+            }
+            REQUIRE(addBlock(blockchain, {makeTx("spend", {"miner", {{"mint-3", 1}}, {{"shop", 5, 0}}}, key)}));
+            CHECK(utxos->getStats().flushes > 0);
+            CHECK(utxos->getCacheSize() <= 8);
+            CHECK(utxos->getCoin({"mint-0", 0})->amount == 10); // Read back from disk
+            CHECK(utxos->getStats().disk_reads > 0);
+            CHECK_FALSE(utxos->getCoin({"never", 0}));
+            CHECK(utxos->getStats().bloom_skips > 0);
+            CHECK_FALSE(addBlock(blockchain, {makeTx("respend", {"miner", {{"mint-3", 1}}, {{"shop", 5, 0}}}, key)}));
+            blockchain.observers_.clear();
+        }
+
+        auto reopened = makeUtxoSet(path);
+        CHECK(reopened->getHeight() == 21);
+        CHECK(reopened->size() == 40);
+        CHECK_FALSE(reopened->getCoin({"mint-3", 1}));
+        CHECK(reopened->getCoin({"spend", 0})->owner == "shop");
+        reopened->catchUp(blockchain); // Already current
+        CHECK(reopened->getHeight() == 21);
+
+        chain::Chain<CoinTestData> other("other-chain", "genesis", CoinTestData{}, key);
+        CHECK_THROWS(reopened->catchUp(other));
+        std::filesystem::remove(path);
+    }
+}